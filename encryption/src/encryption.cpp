@@ -4,65 +4,191 @@
  */
 
 #include "encryption.hpp"
+#include "vaip/thread_pool.hpp"
 #include <memory>
 #ifdef WITH_OPENSSL
 #  include <openssl/aes.h>
 #  include <openssl/conf.h>
 #  include <openssl/err.h>
 #  include <openssl/evp.h>
+#  include <openssl/rand.h>
 #endif
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
+#include <vector>
 
 namespace vaip_encryption {
-std::string aes_encryption(const std::string& str, const std::string& key) {
 #ifdef WITH_OPENSSL
+namespace {
+// header: magic, chunk size, reserved, plain size, nonce salt
+constexpr char MAGIC[8] = {'V', 'A', 'I', 'P', 'G', 'C', 'M', '1'};
+constexpr size_t HEADER_SIZE = 32;
+constexpr size_t SALT_SIZE = 8;
+constexpr size_t TAG_SIZE = 16;
+constexpr size_t IV_SIZE = 12;
+constexpr uint32_t CHUNK_SIZE = 1u << 20;
+// larger chunks in a header are rejected, they bound the memory a corrupt
+// header makes the reader allocate.
+constexpr uint32_t MAX_CHUNK_SIZE = 64u << 20;
+// chunks in flight per thread when streaming
+constexpr size_t CHUNKS_PER_THREAD = 4;
+
+struct Header {
+  uint32_t chunk_size;
+  uint64_t size;
+  unsigned char salt[SALT_SIZE];
+  // the serialized header, authenticated with every chunk
+  unsigned char bytes[HEADER_SIZE];
+
+  uint64_t num_of_chunks() const {
+    return (size + chunk_size - 1) / chunk_size;
+  }
+  size_t plain_size(uint64_t chunk) const {
+    return (size_t)std::min<uint64_t>(chunk_size, size - chunk * chunk_size);
+  }
+};
+
+void put_le(unsigned char* p, uint64_t v, size_t n) {
+  for (auto i = 0u; i < n; ++i) {
+    p[i] = (unsigned char)(v >> (8 * i));
+  }
+}
+
+uint64_t get_le(const unsigned char* p, size_t n) {
+  auto ret = uint64_t(0);
+  for (auto i = 0u; i < n; ++i) {
+    ret |= (uint64_t)p[i] << (8 * i);
+  }
+  return ret;
+}
+
+void check_key(const std::string& key) {
   if (key.size() * 8 != 256) {
     throw std::runtime_error("key size should be 256 bits");
   }
-  EVP_CIPHER_CTX* ctx;
-  if (!(ctx = EVP_CIPHER_CTX_new())) {
-    throw std::runtime_error("encryption creating context failed");
-  }
+}
 
-  if (1 != EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), NULL,
-                              (const unsigned char*)key.c_str(), NULL)) {
-    throw std::runtime_error("encryption initialization failed");
+Header new_header(size_t size) {
+  auto ret = Header();
+  ret.chunk_size = CHUNK_SIZE;
+  ret.size = size;
+  if (1 != RAND_bytes(ret.salt, (int)SALT_SIZE)) {
+    throw std::runtime_error("encryption generating nonce failed");
   }
+  std::memcpy(ret.bytes, MAGIC, sizeof(MAGIC));
+  put_le(ret.bytes + 8, ret.chunk_size, 4);
+  put_le(ret.bytes + 12, 0, 4);
+  put_le(ret.bytes + 16, ret.size, 8);
+  std::memcpy(ret.bytes + 24, ret.salt, SALT_SIZE);
+  return ret;
+}
 
-  std::string ciphertext;
-  int len = 0;
-  ciphertext.resize(str.size() + AES_BLOCK_SIZE);
-  if (1 != EVP_EncryptUpdate(ctx, (unsigned char*)&ciphertext[0], &len,
-                             (const unsigned char*)str.c_str(),
-                             (int)str.length())) {
-    throw std::runtime_error("encryption update failed");
+// false if `bytes` is not a header, i.e. the data is in the old format.
+bool parse_header(const unsigned char* bytes, Header& header) {
+  if (std::memcmp(bytes, MAGIC, sizeof(MAGIC)) != 0) {
+    return false;
   }
-  int ciphertext_len = len;
+  std::memcpy(header.bytes, bytes, HEADER_SIZE);
+  header.chunk_size = (uint32_t)get_le(bytes + 8, 4);
+  header.size = get_le(bytes + 16, 8);
+  std::memcpy(header.salt, bytes + 24, SALT_SIZE);
+  if (header.chunk_size == 0 || header.chunk_size > MAX_CHUNK_SIZE ||
+      header.size > std::numeric_limits<uint64_t>::max() / 2) {
+    throw std::runtime_error("decryption invalid header");
+  }
+  return true;
+}
+
+// The salt and the chunk index, so that a chunk cannot be moved.
+void chunk_iv(const Header& header, uint64_t chunk, unsigned char* iv) {
+  std::memcpy(iv, header.salt, SALT_SIZE);
+  put_le(iv + SALT_SIZE, chunk, IV_SIZE - SALT_SIZE);
+}
+
+struct CipherCtxDeleter {
+  void operator()(EVP_CIPHER_CTX* ctx) const { EVP_CIPHER_CTX_free(ctx); }
+};
+using CipherCtx = std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter>;
 
-  if (1 != EVP_EncryptFinal_ex(ctx, (unsigned char*)&ciphertext[len], &len)) {
-    throw std::runtime_error("encryption finalization failed");
+CipherCtx new_ctx() {
+  auto ret = CipherCtx(EVP_CIPHER_CTX_new());
+  if (ret == nullptr) {
+    throw std::runtime_error("creating cipher context failed");
   }
-  EVP_CIPHER_CTX_free(ctx);
+  return ret;
+}
 
-  ciphertext_len += len;
-  ciphertext.resize(ciphertext_len);
-  return ciphertext;
-#else
-  return str;
-#endif
+// `out` holds the encrypted chunk followed by its tag.
+void seal_chunk(const std::string& key, const Header& header, uint64_t chunk,
+                const char* in, char* out) {
+  auto size = (int)header.plain_size(chunk);
+  unsigned char iv[IV_SIZE];
+  chunk_iv(header, chunk, iv);
+  auto ctx = new_ctx();
+  int len = 0;
+  if (1 != EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), NULL,
+                              (const unsigned char*)key.data(), iv) ||
+      1 != EVP_EncryptUpdate(ctx.get(), NULL, &len, header.bytes,
+                             (int)HEADER_SIZE) ||
+      1 != EVP_EncryptUpdate(ctx.get(), (unsigned char*)out, &len,
+                             (const unsigned char*)in, size) ||
+      1 != EVP_EncryptFinal_ex(ctx.get(), (unsigned char*)out + len, &len) ||
+      1 != EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, (int)TAG_SIZE,
+                               out + size)) {
+    throw std::runtime_error("encryption failed");
+  }
 }
 
-std::string aes_decryption(const std::string& str, const std::string& key) {
-#ifdef WITH_OPENSSL
-  if (key.size() * 8 != 256) {
-    throw std::runtime_error("key size should be 256 bits");
+void open_chunk(const std::string& key, const Header& header, uint64_t chunk,
+                const char* in, char* out) {
+  auto size = (int)header.plain_size(chunk);
+  unsigned char iv[IV_SIZE];
+  chunk_iv(header, chunk, iv);
+  unsigned char tag[TAG_SIZE];
+  std::memcpy(tag, in + size, TAG_SIZE);
+  auto ctx = new_ctx();
+  int len = 0;
+  if (1 != EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), NULL,
+                              (const unsigned char*)key.data(), iv) ||
+      1 != EVP_DecryptUpdate(ctx.get(), NULL, &len, header.bytes,
+                             (int)HEADER_SIZE) ||
+      1 != EVP_DecryptUpdate(ctx.get(), (unsigned char*)out, &len,
+                             (const unsigned char*)in, size) ||
+      1 != EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, (int)TAG_SIZE,
+                               tag)) {
+    throw std::runtime_error("decryption failed");
   }
-  EVP_CIPHER_CTX* ctx;
-  if (!(ctx = EVP_CIPHER_CTX_new())) {
-    throw std::runtime_error("decryption creating context failed");
+  if (1 != EVP_DecryptFinal_ex(ctx.get(), (unsigned char*)out + len, &len)) {
+    throw std::runtime_error(
+        "decryption failed, wrong key or corrupted data");
   }
+}
 
-  if (1 != EVP_DecryptInit_ex(ctx, EVP_aes_256_ecb(), NULL,
+// chunks per batch when streaming, enough for every thread of the pool.
+uint64_t batch_size() {
+  return (uint64_t)(vaip_core::ThreadPool::instance().size() *
+                    CHUNKS_PER_THREAD);
+}
+
+// func(chunk) for the chunks in [begin, end) on the host pool, the first
+// exception is rethrown.
+template <typename F>
+void for_each_chunk(uint64_t begin, uint64_t end, F&& func) {
+  vaip_core::parallel_for((int64_t)begin, (int64_t)end, 1,
+                          [&func](int64_t b, int64_t e) {
+                            for (auto chunk = b; chunk < e; ++chunk) {
+                              func((uint64_t)chunk);
+                            }
+                          });
+}
+
+std::string ecb_decryption(const char* data, size_t size,
+                           const std::string& key) {
+  auto ctx = new_ctx();
+  if (1 != EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_ecb(), NULL,
                               (const unsigned char*)key.c_str(), NULL)) {
     throw std::runtime_error("decryption initialization failed");
   }
@@ -70,25 +196,157 @@ std::string aes_decryption(const std::string& str, const std::string& key) {
   int len = 0;
   std::string plaintext;
 
-  plaintext.resize(str.size());
+  plaintext.resize(size);
 
-  if (1 != EVP_DecryptUpdate(ctx, (unsigned char*)&plaintext[0], &len,
-                             (const unsigned char*)str.c_str(),
-                             (int)str.length())) {
+  if (1 != EVP_DecryptUpdate(ctx.get(), (unsigned char*)&plaintext[0], &len,
+                             (const unsigned char*)data, (int)size)) {
     throw std::runtime_error("decryption update failed");
   }
   int plaintext_len = len;
 
-  if (1 != EVP_DecryptFinal_ex(ctx, (unsigned char*)&plaintext[len], &len)) {
+  if (1 !=
+      EVP_DecryptFinal_ex(ctx.get(), (unsigned char*)&plaintext[len], &len)) {
     throw std::runtime_error("decryption finalization failed");
   }
-  EVP_CIPHER_CTX_free(ctx);
 
   plaintext_len += len;
-  return plaintext.substr(0, plaintext_len);
+  plaintext.resize(plaintext_len);
+  return plaintext;
+}
+} // namespace
+#endif
+
+void aes_encryption(const char* data, size_t size, const std::string& key,
+                    const std::function<void(const char*, size_t)>& write) {
+#ifdef WITH_OPENSSL
+  check_key(key);
+  auto header = new_header(size);
+  write((const char*)header.bytes, HEADER_SIZE);
+  auto num_of_chunks = header.num_of_chunks();
+  auto batch = batch_size();
+  auto stride = (size_t)header.chunk_size + TAG_SIZE;
+  auto buffer = std::vector<char>();
+  for (auto first = uint64_t(0); first < num_of_chunks; first += batch) {
+    auto last = std::min(first + batch, num_of_chunks);
+    buffer.resize((size_t)(last - first) * stride);
+    for_each_chunk(first, last, [&](uint64_t chunk) {
+      seal_chunk(key, header, chunk, data + chunk * header.chunk_size,
+                 buffer.data() + (chunk - first) * stride);
+    });
+    // only the last chunk is shorter
+    write(buffer.data(), buffer.size() - stride +
+                             header.plain_size(last - 1) + TAG_SIZE);
+  }
+#else
+  write(data, size);
+#endif
+}
+
+std::string aes_encryption(const std::string& str, const std::string& key) {
+#ifdef WITH_OPENSSL
+  check_key(key);
+  std::string ciphertext;
+  ciphertext.reserve(HEADER_SIZE + str.size() +
+                     (str.size() / CHUNK_SIZE + 1) * TAG_SIZE);
+  aes_encryption(str.data(), str.size(), key,
+                 [&ciphertext](const char* data, size_t size) {
+                   ciphertext.append(data, size);
+                 });
+  return ciphertext;
 #else
   return str;
 #endif
 }
 
-} // namespace vaip_encryption
\ No newline at end of file
+std::string aes_decryption(const char* data, size_t size,
+                           const std::string& key) {
+#ifdef WITH_OPENSSL
+  check_key(key);
+  auto header = Header();
+  if (size < HEADER_SIZE ||
+      !parse_header((const unsigned char*)data, header)) {
+    return ecb_decryption(data, size, key);
+  }
+  auto num_of_chunks = header.num_of_chunks();
+  if (header.size > size ||
+      size != HEADER_SIZE + header.size + num_of_chunks * TAG_SIZE) {
+    throw std::runtime_error("decryption failed, truncated data");
+  }
+  auto plaintext = std::string();
+  plaintext.resize((size_t)header.size);
+  auto stride = (size_t)header.chunk_size + TAG_SIZE;
+  for_each_chunk(0, num_of_chunks, [&](uint64_t chunk) {
+    open_chunk(key, header, chunk, data + HEADER_SIZE + chunk * stride,
+               &plaintext[chunk * header.chunk_size]);
+  });
+  return plaintext;
+#else
+  return std::string(data, size);
+#endif
+}
+
+std::string aes_decryption(const std::string& str, const std::string& key) {
+  return aes_decryption(str.data(), str.size(), key);
+}
+
+std::string aes_decryption(const std::function<size_t(char*, size_t)>& read,
+                           const std::string& key) {
+#ifdef WITH_OPENSSL
+  check_key(key);
+  auto read_fully = [&read](char* data, size_t size) {
+    auto ret = size_t(0);
+    for (auto n = size_t(1); ret < size && n != 0; ret += n) {
+      n = read(data + ret, size - ret);
+    }
+    return ret;
+  };
+  auto header = Header();
+  unsigned char bytes[HEADER_SIZE];
+  auto n = read_fully((char*)bytes, HEADER_SIZE);
+  if (n < HEADER_SIZE || !parse_header(bytes, header)) {
+    // the old format, decrypted as a whole
+    auto rest = std::string((const char*)bytes, n);
+    char buf[4096];
+    for (n = read(buf, sizeof(buf)); n != 0; n = read(buf, sizeof(buf))) {
+      rest.append(buf, n);
+    }
+    return ecb_decryption(rest.data(), rest.size(), key);
+  }
+  // the plain text grows with every batch read, the size in the header is
+  // not trusted before the data is there.
+  auto plaintext = std::string();
+  auto num_of_chunks = header.num_of_chunks();
+  auto batch = batch_size();
+  auto stride = (size_t)header.chunk_size + TAG_SIZE;
+  auto buffer = std::vector<char>();
+  for (auto first = uint64_t(0); first < num_of_chunks; first += batch) {
+    auto last = std::min(first + batch, num_of_chunks);
+    auto size = (size_t)(last - 1 - first) * stride +
+                header.plain_size(last - 1) + TAG_SIZE;
+    buffer.resize(size);
+    if (read_fully(buffer.data(), size) != size) {
+      throw std::runtime_error("decryption failed, truncated data");
+    }
+    plaintext.resize((size_t)((last - 1) * header.chunk_size +
+                              header.plain_size(last - 1)));
+    for_each_chunk(first, last, [&](uint64_t chunk) {
+      open_chunk(key, header, chunk, buffer.data() + (chunk - first) * stride,
+                 &plaintext[chunk * header.chunk_size]);
+    });
+  }
+  char extra;
+  if (read_fully(&extra, 1) != 0) {
+    throw std::runtime_error("decryption failed, trailing data");
+  }
+  return plaintext;
+#else
+  auto plaintext = std::string();
+  char buf[4096];
+  for (auto n = read(buf, sizeof(buf)); n != 0; n = read(buf, sizeof(buf))) {
+    plaintext.append(buf, n);
+  }
+  return plaintext;
+#endif
+}
+
+} // namespace vaip_encryption
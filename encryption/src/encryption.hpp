@@ -2,9 +2,34 @@
  *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
  *  Licensed under the MIT License.
  */
-
+#pragma once
+#include <cstddef>
+#include <functional>
 #include <string>
 namespace vaip_encryption {
+/// Encrypted data is AES-256-GCM in chunks of 1MB, each with its own tag,
+/// after a header with the plain size, so that chunks are encrypted and
+/// decrypted in parallel and streamed, and a modified, truncated or
+/// reordered chunk is detected.
+///
+/// The key must be 256 bits; without WITH_OPENSSL the data is not
+/// encrypted.
 std::string aes_encryption(const std::string& str, const std::string& key);
+
+/// Encrypt `size` bytes at `data` and write them with `write` as they are
+/// encrypted, without holding all the encrypted data.
+void aes_encryption(const char* data, size_t size, const std::string& key,
+                    const std::function<void(const char*, size_t)>& write);
+
+/// Decrypt what aes_encryption() returned; data without the header is
+/// decrypted as AES-256-ECB, like caches written by older versions.
 std::string aes_decryption(const std::string& str, const std::string& key);
+std::string aes_decryption(const char* data, size_t size,
+                           const std::string& key);
+
+/// Decrypt what `read` returns, it reads up to the given number of bytes
+/// and returns how many it read, 0 at the end. Only a few chunks of the
+/// encrypted data are held at a time.
+std::string aes_decryption(const std::function<size_t(char*, size_t)>& read,
+                           const std::string& key);
 } // namespace vaip_encryption
@@ -15,6 +15,7 @@
 #include <glog/logging.h>
 
 #include "./reporter.hpp"
+#include "vaip/thread_pool.hpp"
 #include "vitis/ai/profiling.hpp"
 
 DEF_ENV_PARAM(DEBUG_MHA_CUSTOM_OP, "0")
@@ -983,8 +984,14 @@ void MyCustomOpKernel::Compute(OrtKernelContext* context) {
                                    seq_len,
                                    head_size};
     MY_LOG(2) << "ParallelFor Split_QKV.";
-    ctx.ParallelFor(Split_QKV, static_cast<size_t>(seq_len), 0,
-                    &split_qkv_data);
+    auto row_bytes = (int64_t)(num_heads_ + 2 * kv_num_heads_) * head_size *
+                     sizeof(uint16_t) * 2;
+    vaip_core::parallel_for(0, seq_len, vaip_core::grain_size(row_bytes),
+                            [&](int64_t begin, int64_t end) {
+                              for (auto n = begin; n < end; ++n) {
+                                Split_QKV(&split_qkv_data, (size_t)n);
+                              }
+                            });
     __TOC__(SplitQKV)
   } else {
     auto k_data_type = key.GetTensorTypeAndShapeInfo().GetElementType();
@@ -1329,8 +1336,8 @@ void MyCustomOpKernel::Compute(OrtKernelContext* context) {
       bmm2_inputs[1].sync(XCL_BO_SYNC_BO_TO_DEVICE);
       __TOC__(AIET_PadConcatV)
     };
-    auto rst_pad_concat_k = std::async(std::launch::async, func_pad_concat_k);
-    auto rst_pad_concat_v = std::async(std::launch::async, func_pad_concat_v);
+    auto rst_pad_concat_k = vaip_core::AsyncTask(func_pad_concat_k);
+    auto rst_pad_concat_v = vaip_core::AsyncTask(func_pad_concat_v);
 
     /// save present k/v
     /// if past_present_share_buffer, only new k/v should be saved to the share
@@ -1386,7 +1393,7 @@ void MyCustomOpKernel::Compute(OrtKernelContext* context) {
     rst_pad_concat_v.wait();
     // then we could start teh task to save preset KV
     MY_LOG(2) << "AIE Token phase save present K/V." << std::endl;
-    auto rst_savekv = std::async(std::launch::async, func_savekv);
+    auto rst_savekv = vaip_core::AsyncTask(func_savekv);
 
     __TIC__(AIET_AieExecToken)
     aie_execute_token(output_data.cast<uint16_t>(), N_q, N_kv, 128, T_pad, H);
@@ -27,7 +27,9 @@
 #include <glog/logging.h>
 
 #include "matmulnbits_util.hpp"
+#include "packed_weights/packed_weights.hpp"
 #include "reporter.hpp"
+#include "vaip/thread_pool.hpp"
 #include "vitis/ai/profiling.hpp"
 
 namespace fs = std::filesystem;
@@ -364,10 +366,8 @@ void MyCustomOpKernel::LazyInit() {
   }
 }
 
-void MyCustomOpKernel::LazyInit_matmul_nbits(std::vector<int8_t> b,
-                                             std::vector<int8_t> zeros,
-                                             std::vector<float> scales,
-                                             std::vector<float> bias) {
+void MyCustomOpKernel::LazyInit_matmul_nbits(
+    const vaip_packed_weights::MatMulNBits& packed, std::vector<float> bias) {
 
   std::string mladf_version_("v1");
   if (instances__ == 0) {
@@ -383,10 +383,11 @@ void MyCustomOpKernel::LazyInit_matmul_nbits(std::vector<int8_t> b,
   std::vector<size_t> b_shape_dd = {static_cast<size_t>(k_k),
                                     static_cast<size_t>(k_n)};
 
-  Tensor weight_tensor = {b.data(), b_shape_dd, "int4"};
+  Tensor weight_tensor = {packed.weights_data(), b_shape_dd, "int4"};
   Tensor bias_tensor = {bias.data(), {(size_t)k_block_size, 0}, "float"};
-  Tensor scales_tensor = {scales.data(), {(size_t)k_block_size, 0}, "float"};
-  Tensor zeros_tensor = {zeros.data(), b_shape_dd, "int4"};
+  Tensor scales_tensor = {
+      packed.scales_data(), {(size_t)k_block_size, 0}, "float"};
+  Tensor zeros_tensor = {packed.zeros_data(), b_shape_dd, "int4"};
   std::vector<Tensor> constant_tensors = {weight_tensor, bias_tensor,
                                           scales_tensor, zeros_tensor};
   std::map<std::string, std::any> attrs;
@@ -619,49 +620,17 @@ MyCustomOpKernel::MyCustomOpKernel(const OrtKernelInfo* k_info,
   }
 
   m_biased = false;
-  std::vector<float> scales(k_k * k_n / k_block_size);
-  std::vector<int8_t> b(k_k * k_n, 0);
-  size_t kblks = k_k / k_block_size;
-  // fill this with zeros for Symmetric quantization
-  size_t zp_shape = (k_n * std::floor((float)((kblks + 1) * k_bits) / 8.0f));
-  // std::vector<int8_t> zeros(k_k * k_n / k_block_size, 0);
-  std::vector<int8_t> zeros(zp_shape * 2, 0);
-
-  // Original weights are in NxK/2 packed as uint8
-  // Convert to KXN uint8
-  const uint8_t* wts = m_weights.GetTensorData<uint8_t>();
-  for (int64_t i = 0; i < k_k; i += 2) {
-    for (int64_t j = 0; j < k_n; j++) {
-      auto srcv = wts[j * k_k / 2 + i / 2];
-      auto src0 = (srcv & 0xf) - 8;
-      auto src1 = ((srcv & 0xf0) >> 4) - 8;
-      b[i * k_n + j] = static_cast<int8_t>(src0);
-      b[(i + 1) * k_n + j] = static_cast<int8_t>(src1);
-    }
-  }
-
-  // Original Scales are in Nx(K/BlockSize) shape
-  // Convert to (K/BLOCK_SIZE)xN shape
-  const float* scl = m_scales.GetTensorData<float>();
-  for (int i = 0; i < k_n; i++) {
-    for (int j = 0; j < kblks; j++) {
-      scales[j * k_n + i] = scl[i * kblks + j];
-    }
-  }
+  auto src = vaip_packed_weights::MatMulNBitsSource();
+  src.weights = m_weights.GetTensorData<uint8_t>();
+  src.scales = m_scales.GetTensorData<float>();
+  src.zero_points = m_asymmetric ? m_zeros.GetTensorData<uint8_t>() : nullptr;
+  src.k = k_k;
+  src.n = k_n;
+  src.bits = k_bits;
+  src.block_size = k_block_size;
+  auto packed = vaip_packed_weights::get_matmul_nbits(
+      src, ENV_PARAM(XLNX_PACKED_WEIGHTS_DIR));
 
-  // fill this with zeros for Symmetric quantization
-  if (m_asymmetric) {
-    const uint8_t* zero_pt = m_zeros.GetTensorData<uint8_t>();
-    int kblks_pad = 2 * zp_shape / k_n;
-    for (int i = 0; i < k_n; i++) {
-      for (int j = 0; j < kblks_pad; j = j + 2) {
-        // auto zpv = zero_pt[(i * (kblks / 2)) + (j / 2)];
-        auto zpv = zero_pt[(i * kblks_pad) / 2 + j / 2];
-        zeros[j * k_n + i] = (zpv & 0xf) - 8;
-        zeros[(j + 1) * k_n + i] = ((zpv & 0xf0) >> 4) - 8;
-      }
-    }
-  }
   // fill this with zeros for MatMul without bias
   std::vector<float> bias(k_n, 0); // fill with zeros
   if (m_biased) {
@@ -672,7 +641,7 @@ MyCustomOpKernel::MyCustomOpKernel(const OrtKernelInfo* k_info,
   n_sizes_.push_back({static_cast<int>(k_k), static_cast<int>(k_n)});
   grp_sizes_.push_back(k_block_size);
 
-  LazyInit_matmul_nbits(b, zeros, scales, bias);
+  LazyInit_matmul_nbits(*packed, bias);
   cnt = instances__++;
   MY_LOG(2) << "initialization for matmul nbits custom-op Done..." << std::endl;
 }
@@ -1235,8 +1204,14 @@ void MyCustomOpKernel::Compute(OrtKernelContext* context) {
                                    seq_len,
                                    head_size};
     MY_LOG(2) << "ParallelFor Split_QKV.";
-    ctx.ParallelFor(Split_QKV, static_cast<size_t>(seq_len), 0,
-                    &split_qkv_data);
+    auto row_bytes = (int64_t)(num_heads_ + 2 * kv_num_heads_) * head_size *
+                     sizeof(uint16_t) * 2;
+    vaip_core::parallel_for(0, seq_len, vaip_core::grain_size(row_bytes),
+                            [&](int64_t begin, int64_t end) {
+                              for (auto n = begin; n < end; ++n) {
+                                Split_QKV(&split_qkv_data, (size_t)n);
+                              }
+                            });
     // GetQKVFromPackedQKV(q_data_ptr, k_data_ptr, v_data_ptr,
     //                     qkv_data.cast<uint16_t>(), num_heads_, kv_num_heads_,
     //                     seq_len, head_size);
@@ -1593,8 +1568,8 @@ void MyCustomOpKernel::Compute(OrtKernelContext* context) {
       bmm2_inputs[1].sync(XCL_BO_SYNC_BO_TO_DEVICE);
       __TOC__(AIET_PadConcatV)
     };
-    auto rst_pad_concat_k = std::async(std::launch::async, func_pad_concat_k);
-    auto rst_pad_concat_v = std::async(std::launch::async, func_pad_concat_v);
+    auto rst_pad_concat_k = vaip_core::AsyncTask(func_pad_concat_k);
+    auto rst_pad_concat_v = vaip_core::AsyncTask(func_pad_concat_v);
 
     /// save present k/v
     /// if past_present_share_buffer, only new k/v should be saved to the share
@@ -1650,7 +1625,7 @@ void MyCustomOpKernel::Compute(OrtKernelContext* context) {
     rst_pad_concat_v.wait();
     // then we could start teh task to save preset KV
     MY_LOG(2) << "AIE Token phase save present K/V." << std::endl;
-    auto rst_savekv = std::async(std::launch::async, func_savekv);
+    auto rst_savekv = vaip_core::AsyncTask(func_savekv);
 
     __TIC__(AIET_AieExecToken)
     aie_execute_token(nullptr, N_q, N_kv, 128, T_pad, H);
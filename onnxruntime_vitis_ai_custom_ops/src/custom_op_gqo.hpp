@@ -25,6 +25,10 @@
 
 #include "gqa_helper.hpp"
 
+namespace vaip_packed_weights {
+struct MatMulNBits;
+} // namespace vaip_packed_weights
+
 namespace ort_gqo_custom_op {
 
 struct OrtTensor {
@@ -134,8 +138,7 @@ public:
   MyCustomOpKernel(const OrtKernelInfo* info, const OrtApi& api);
   void set_params();
   void LazyInit();
-  void LazyInit_matmul_nbits(std::vector<int8_t> b, std::vector<int8_t> zeros,
-                             std::vector<float> scales,
+  void LazyInit_matmul_nbits(const vaip_packed_weights::MatMulNBits& packed,
                              std::vector<float> bias);
 
   void MyCustomOpKernel::matmul_nbits_aie_execute1(
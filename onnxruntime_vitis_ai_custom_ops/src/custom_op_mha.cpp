@@ -29,6 +29,7 @@
 #include <sstream>
 
 #include "reporter.hpp"
+#include "vaip/thread_pool.hpp"
 #include "vitis/ai/profiling.hpp"
 
 DEF_ENV_PARAM(DEBUG_MHA_CUSTOM_OP, "0")
@@ -663,7 +664,7 @@ void KV_cache_copy(void* raw_data, size_t n) {
                       data->head_size);
 }
 
-/// get the best num_batch for ctx.ParallelFor
+/// get the best number of chunks for the KV cache copy
 /// based on the TPS on Birman+
 int get_best_parallel_batch(int S) {
   assert(S >= 0 && S <= 2048);
@@ -1096,8 +1097,14 @@ void MyCustomOpKernel::Compute(OrtKernelContext* context) {
                                 past_seq_len * head_size,
                                 present_seq_len * head_size,
                                 head_size};
-        ctx.ParallelFor(KV_cache_copy, static_cast<size_t>(num_heads_),
-                        num_batch, &kv_cache);
+        // num_batch chunks of heads, as ctx.ParallelFor() split them.
+        auto grain = ((int64_t)num_heads_ + num_batch - 1) / num_batch;
+        vaip_core::parallel_for(0, num_heads_, grain,
+                                [&](int64_t begin, int64_t end) {
+                                  for (auto n = begin; n < end; ++n) {
+                                    KV_cache_copy(&kv_cache, (size_t)n);
+                                  }
+                                });
       } else {
         vec_float32_to_bf16(present_key_data.cast<uint16_t>(),
                             float_present_key_data_converter, present_key_size);
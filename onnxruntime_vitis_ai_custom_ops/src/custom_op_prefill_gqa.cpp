@@ -15,6 +15,7 @@
 #include <glog/logging.h>
 
 #include "./reporter.hpp"
+#include "vaip/thread_pool.hpp"
 #include "vitis/ai/profiling.hpp"
 
 DEF_ENV_PARAM(DEBUG_MHA_CUSTOM_OP, "0")
@@ -640,8 +641,10 @@ void PrefillGQACustomOpKernel::aie_execute_rope_mha(
   cache_v.wait();
   __TIC__(PadConcatK)
   rope_k_outputs[0].sync(XCL_BO_SYNC_BO_FROM_DEVICE);
-  std::shared_future<void> rst_save_k = std::async(
-      std::launch::async, save_k_func, rope_k_outputs[0].map<uint16_t*>());
+  auto rst_save_k = vaip_core::AsyncTask(
+      [&save_k_func, k_ptr = rope_k_outputs[0].map<uint16_t*>()]() {
+        save_k_func(k_ptr);
+      });
   pad_concat_kv(bmm1_inputs[1].map<uint16_t*>(), past_k_data.cast<uint16_t>(),
                 rope_k_outputs[0].map<uint16_t*>(), N_kv, S - seq_len, S_pad, H,
                 true, T_buffer, seq_len);
@@ -898,8 +901,14 @@ PrefillGQACustomOpKernel::Execute(std::vector<Ort::ConstValue>& inputs,
                                    head_size};
 
     MY_LOG(2) << "ParallelFor Split_QKV.";
-    ctx.ParallelFor(Split_QKV, static_cast<size_t>(seq_len), 0,
-                    &split_qkv_data);
+    auto row_bytes = (int64_t)(num_heads_ + 2 * kv_num_heads_) * head_size *
+                     sizeof(uint16_t) * 2;
+    vaip_core::parallel_for(0, seq_len, vaip_core::grain_size(row_bytes),
+                            [&](int64_t begin, int64_t end) {
+                              for (auto n = begin; n < end; ++n) {
+                                Split_QKV(&split_qkv_data, (size_t)n);
+                              }
+                            });
     __TOC__(SplitQKV)
   } else {
     auto k_data_type = key.GetTensorTypeAndShapeInfo().GetElementType();
@@ -1105,10 +1114,9 @@ PrefillGQACustomOpKernel::Execute(std::vector<Ort::ConstValue>& inputs,
       };
 
       // TODO: chunk cache v, past with pad, chache without pad
-      std::shared_future<void> rst_pad_concat_v =
-          std::async(std::launch::async, func_pad_concat_v);
-      std::shared_future<void> rst_save_v =
-          std::async(std::launch::async, func_save_present_v);
+      auto pad_concat_v_task = vaip_core::AsyncTask(func_pad_concat_v);
+      std::shared_future<void> rst_pad_concat_v = pad_concat_v_task.share();
+      auto rst_save_v = vaip_core::AsyncTask(func_save_present_v);
 
       if (ENV_PARAM(USE_AIE_RoPE) == 1 &&
           mha_aie_kernel_info_.is_seq_aie_supported(S)) {
@@ -1183,8 +1191,10 @@ PrefillGQACustomOpKernel::Execute(std::vector<Ort::ConstValue>& inputs,
         RoPE(fp32_k_rope, fp32_k_data, pos_ids.data(), cos_cache, sin_cache, B,
              N_kv, seq_len, H, context);
         __TOC__(RoPEKey)
-        std::shared_future<void> rst_save_present_kv =
-            std::async(std::launch::async, func_save_present_k, bf16_k_rope);
+        auto rst_save_present_kv = vaip_core::AsyncTask(
+            [&func_save_present_k, bf16_k_rope]() {
+              func_save_present_k(bf16_k_rope);
+            });
 
         __TIC__(KeyFP32toBF16)
         vec_float32_to_bf16(bf16_k_rope, fp32_k_rope, kv_size);
@@ -28,6 +28,7 @@
 
 #include "custom_op_rope.hpp"
 #include "reporter.hpp"
+#include "vaip/thread_pool.hpp"
 #include "vitis/ai/profiling.hpp"
 
 DEF_ENV_PARAM(DEBUG_ROPE_CUSTOM_OP, "0")
@@ -273,6 +274,98 @@ static void vec_bf16_to_float(float* dest, const uint16_t* src, size_t size) {
   bfloat16_to_float_avx512_unrolled(src, dest, size);
 }
 
+// 16 bf16 values to fp32
+static inline __m512 load_bf16x16(const uint16_t* p) {
+  auto v = _mm256_loadu_si256((const __m256i*)p);
+  return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(v), 16));
+}
+
+// 16 fp32 values to bf16, rounded as float_to_bfloat16()
+static inline void store_bf16x16(uint16_t* p, __m512 v) {
+  auto i = _mm512_castps_si512(v);
+  auto lsb = _mm512_and_epi32(_mm512_srli_epi32(i, 16), _mm512_set1_epi32(1));
+  i = _mm512_add_epi32(i, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7fff)));
+  _mm256_storeu_si256((__m256i*)p,
+                      _mm512_cvtepi32_epi16(_mm512_srli_epi32(i, 16)));
+}
+
+// Rotate one head of `head_size` values at one position, as the
+// com.microsoft RotaryEmbedding op does. `cos` and `sin` are the rows of
+// the caches at that position, head_size / 2 values each.
+//
+// half-split: y[i] = x[i] * cos[i] - x[i + h] * sin[i]
+//             y[i + h] = x[i + h] * cos[i] + x[i] * sin[i]
+// interleaved: the same on the pairs (x[2i], x[2i + 1])
+static void rope_head(const uint16_t* x, uint16_t* y, const float* cos,
+                      const float* sin, int64_t head_size, bool interleaved) {
+  auto half = head_size / 2;
+  if (interleaved) {
+    for (int64_t i = 0; i < half; ++i) {
+      auto x0 = bfloat16_to_float_single(x[2 * i]);
+      auto x1 = bfloat16_to_float_single(x[2 * i + 1]);
+      y[2 * i] = float_to_bfloat16(x0 * cos[i] - x1 * sin[i]);
+      y[2 * i + 1] = float_to_bfloat16(x1 * cos[i] + x0 * sin[i]);
+    }
+    return;
+  }
+  int64_t i = 0;
+  for (; i + 16 <= half; i += 16) {
+    auto x0 = load_bf16x16(x + i);
+    auto x1 = load_bf16x16(x + half + i);
+    auto c = _mm512_loadu_ps(cos + i);
+    auto s = _mm512_loadu_ps(sin + i);
+    store_bf16x16(y + i, _mm512_fmsub_ps(x0, c, _mm512_mul_ps(x1, s)));
+    store_bf16x16(y + half + i, _mm512_fmadd_ps(x1, c, _mm512_mul_ps(x0, s)));
+  }
+  for (; i < half; ++i) {
+    auto x0 = bfloat16_to_float_single(x[i]);
+    auto x1 = bfloat16_to_float_single(x[half + i]);
+    y[i] = float_to_bfloat16(x0 * cos[i] - x1 * sin[i]);
+    y[half + i] = float_to_bfloat16(x1 * cos[i] + x0 * sin[i]);
+  }
+}
+
+// `input` and `output` are [batch, seq, num_heads * head_size] bf16, the
+// caches are [max_seq, head_size / 2] fp32. position_ids is either
+// [batch, seq] or a single start position, as in RotaryEmbedding.
+static void rope_bf16(const uint16_t* input, uint16_t* output,
+                      const int64_t* position_ids, bool position_is_start,
+                      const float* cos_cache, const float* sin_cache,
+                      int64_t max_seq, int64_t batch, int64_t seq,
+                      int64_t num_heads, int64_t head_size, bool interleaved) {
+  auto half = head_size / 2;
+  auto hidden = num_heads * head_size;
+  auto position = [&](int64_t b, int64_t s) {
+    return position_is_start ? position_ids[0] + s
+                             : position_ids[b * seq + s];
+  };
+  // validated up front, the workers must not throw.
+  for (int64_t b = 0; b < batch; ++b) {
+    for (int64_t s = 0; s < seq; ++s) {
+      auto pos = position(b, s);
+      CHECK(pos >= 0 && pos < max_seq)
+          << "position id " << pos << " is out of range [0, " << max_seq
+          << ")";
+    }
+  }
+  // one task per (batch, head), all positions of the head.
+  vaip_core::parallel_for(
+      0, batch * num_heads,
+      vaip_core::grain_size(seq * head_size * 2 * (int64_t)sizeof(uint16_t)),
+      [&](int64_t begin, int64_t end) {
+        for (auto bh = begin; bh < end; ++bh) {
+          auto b = bh / num_heads;
+          auto h = bh % num_heads;
+          for (int64_t s = 0; s < seq; ++s) {
+            auto offset = (b * seq + s) * hidden + h * head_size;
+            auto pos = position(b, s);
+            rope_head(input + offset, output + offset, cos_cache + pos * half,
+                      sin_cache + pos * half, head_size, interleaved);
+          }
+        }
+      });
+}
+
 void MyCustomOpKernel::LazyInit() {
   dry_run_ = 0;
   if (ENV_PARAM(DRY_RUN) == 1)
@@ -341,22 +434,12 @@ MyCustomOpKernel::MyCustomOpKernel(const OrtKernelInfo* k_info,
                "builtin op..."
             << std::endl;
 
-  const char* add_type_constraint_names[2] = {"T", "M"};
-  ONNXTensorElementDataType add_type_constraint_values[2] = {
-      ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64};
-
-  int64_t interleaved = 0;
-  auto attr_interleaved = Ort::OpAttr("interleaved", &interleaved, 1,
-                                      OrtOpAttrType::ORT_OP_ATTR_INT);
-  Ort::OpAttr k_attrs[1] = {std::move(attr_interleaved)};
-
-  // Create OP to call the appropriate built in operator
-  // In this use case, we are using an ONNX Contrib OP from Microsoft
-
-  op_k = Ort::Op::Create(info.Copy(), "RotaryEmbedding", "com.microsoft", 1,
-                         add_type_constraint_names, add_type_constraint_values,
-                         2, k_attrs, 1, 4,
-                         1); // 1 attributes, 5 inputs, 4 outputs
+  // layout of the cpu kernel, half-split unless the node says otherwise
+  interleaved_ = 0;
+  try {
+    interleaved_ = info.GetAttribute<int64_t>("interleaved");
+  } catch (const Ort::Exception&) {
+  }
   if (ENV_PARAM(USE_AIE_ROPE) == 1) {
     LazyInit();
 
@@ -535,55 +618,25 @@ void MyCustomOpKernel::Compute(OrtKernelContext* context) {
 
     MY_LOG(2) << "- AMD Prefill ROPE compute done\n";
   } else {
-    size_t batch = input_shape[0];
-    size_t seq_lentgh = input_shape[1];
-    size_t K_new = input_shape[2];
-
     auto cos_cache = ctx.GetInput(2);
     auto sin_cache = ctx.GetInput(3);
-
-    size_t num_elements = batch * seq_lentgh * K_new;
-
-#ifdef _WIN32
-    float* input_fl = (float*)_aligned_malloc(num_elements * sizeof(float), 64);
-    float* output_fl =
-        (float*)_aligned_malloc(num_elements * sizeof(float), 64);
-#else
-    float* input_fl = (float*)aligned_alloc(64, num_elements * sizeof(float));
-    float* output_fl = (float*)aligned_alloc(64, num_elements * sizeof(float));
-#endif
-    std::vector<int64_t> input_shape = {
-        (int64_t)batch, (int64_t)seq_lentgh,
-        (int64_t)K_new}; // Replace with your actual input shape
-
-    bfloat16_to_float_avx512_unrolled(input_data, input_fl,
-                                      batch * seq_lentgh * K_new);
-    // Create memory info
-    Ort::MemoryInfo memory_info =
-        Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-    // Create input tensor
-    Ort::Value input_tensor_a =
-        Ort::Value::CreateTensor<float>(memory_info, input_fl, num_elements,
-                                        input_shape.data(), input_shape.size());
-    // Create output tensor
-    Ort::Value output_tensor =
-        Ort::Value::CreateTensor<float>(memory_info, output_fl, num_elements,
-                                        input_shape.data(), input_shape.size());
-
-    const OrtValue* inputs[4] = {input_tensor_a, posid_tensor, cos_cache,
-                                 sin_cache};
-    OrtValue* outputs[1] = {output_tensor};
-    op_k.Invoke(context, inputs, 4, outputs, 1);
-    float_to_bfloat16_avx512_unrolled(output_fl, out,
-                                      batch * seq_lentgh * K_new); // M x K
-#ifdef _WIN32
-    _aligned_free(input_fl);
-    _aligned_free(output_fl);
-#else
-    free(input_fl);
-    free(output_fl);
-#endif
+    auto cache_shape = cos_cache.GetTensorTypeAndShapeInfo().GetShape();
+    auto head_size = 2 * cache_shape[1];
+    CHECK(head_size > 0 && input_shape[2] % head_size == 0)
+        << "hidden size " << input_shape[2]
+        << " is not a multiple of the head size " << head_size;
+    auto num_position_ids =
+        posid_tensor.GetTensorTypeAndShapeInfo().GetElementCount();
+    auto position_is_start = num_position_ids == 1;
+    CHECK(position_is_start ||
+          (int64_t)num_position_ids == input_shape[0] * input_shape[1])
+        << "unexpected position_ids shape";
+
+    rope_bf16(input_data, out, posid_data, position_is_start,
+              cos_cache.GetTensorData<float>(),
+              sin_cache.GetTensorData<float>(), cache_shape[0], input_shape[0],
+              input_shape[1], input_shape[2] / head_size, head_size,
+              interleaved_ != 0);
   }
   MY_LOG(2) << "- AMD ROPE compute done ...\n";
 }
@@ -45,7 +45,8 @@ private:
   Ort::Op transpose0213_built_in{nullptr};
   Ort::Logger m_logger{nullptr};
   static std::once_flag initFlag;
-  Ort::Op op_k{nullptr};
+  // layout of the cpu kernel, see rope_head()
+  int64_t interleaved_ = 0;
   const OrtApi* api_;
 
   // aie kernels from DD
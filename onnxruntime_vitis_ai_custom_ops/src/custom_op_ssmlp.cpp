@@ -28,6 +28,7 @@
 #include <unsupported/Eigen/CXX11/Tensor>
 
 #include "custom_op_ssmlp.hpp"
+#include "packed_weights/packed_weights.hpp"
 #include "reporter.hpp"
 #include "vitis/ai/profiling.hpp"
 #include <fstream>
@@ -530,136 +531,34 @@ MyCustomOpKernel::MyCustomOpKernel(const OrtKernelInfo* k_info) {
   MY_LOG(2) << "Got attributes for MLP" << std::endl;
 #endif
 
+  auto packed = [](const int8_t* wts, const float* scl, const int8_t* zps,
+                   int64_t k, int64_t n, int64_t bits, int64_t block_size) {
+    auto src = vaip_packed_weights::MatMulNBitsSource();
+    src.weights = wts;
+    src.scales = scl;
+    src.zero_points = zps;
+    src.k = k;
+    src.n = n;
+    src.bits = bits;
+    src.block_size = block_size;
+    return vaip_packed_weights::get_matmul_nbits(
+        src, ENV_PARAM(XLNX_PACKED_WEIGHTS_DIR));
+  };
   /////////////////////////// Gate /////////////////////////////////
   std::vector<float> gp_bias(gp_n, 0); // fill with zeros
-  std::vector<float> gp_scales(gp_k * gp_n / gp_block_size);
-  std::vector<int8_t> gp_weights(gp_k * gp_n, 0);
-  // fill this with zeros for Symmetric quantization
-  std::vector<int8_t> gp_zpoints(
-      gp_zeros.GetTensorTypeAndShapeInfo().GetElementCount() * 2, 0);
-
-  size_t gp_kblks = gp_k / gp_block_size;
-
-  // Original weights are in NxK/2 packed as uint8
-  // Convert to KXN uint8
-  for (int64_t i = 0; i < gp_k; i += 2) {
-    for (int64_t j = 0; j < gp_n; j++) {
-      auto srcv = gp_wts[j * gp_k / 2 + i / 2];
-      auto src0 = (srcv & 0xf) - 8;
-      auto src1 = ((srcv & 0xf0) >> 4) - 8;
-      gp_weights[i * gp_n + j] = static_cast<int8_t>(src0);
-      gp_weights[(i + 1) * gp_n + j] = static_cast<int8_t>(src1);
-    }
-  }
-
-  // Original Scales are in Nx(K/BlockSize) shape
-  // Convert to (K/BLOCK_SIZE)xN shape
-  for (int i = 0; i < gp_n; i++) {
-    for (int j = 0; j < gp_kblks; j++) {
-      gp_scales[j * gp_n + i] = gp_scl[i * gp_kblks + j];
-    }
-  }
-  int64_t gzp_shape =
-      (gp_n * std::floor((float)((gp_kblks + 1) * gp_bits) / 8.0f));
-  // fill this with zeros for Symmetric quantization
-  if (is_gpz_constant) {
-    int gp_kblks_pad = 2 * gzp_shape / gp_n;
-    for (int i = 0; i < gp_n; i++) {
-      for (int j = 0; j < gp_kblks_pad; j = j + 2) {
-        auto zpv = gp_zps[((i * gp_kblks_pad) / 2) + (j / 2)];
-        gp_zpoints[j * gp_n + i] = (zpv & 0xf) - 8;
-        gp_zpoints[(j + 1) * gp_n + i] = ((zpv & 0xf0) >> 4) - 8;
-      }
-    }
-  }
+  // zeros for Symmetric quantization
+  auto gp_packed = packed(gp_wts, gp_scl, is_gpz_constant ? gp_zps : nullptr,
+                          gp_k, gp_n, gp_bits, gp_block_size);
 
   /////////////////////////// Up /////////////////////////////////
   std::vector<float> up_bias(up_n, 0); // fill with zeros
-  std::vector<float> up_scales(up_k * up_n / up_block_size);
-  std::vector<int8_t> up_weights(up_k * up_n, 0);
-  // fill this with zeros for Symmetric quantization
-  std::vector<int8_t> up_zpoints(
-      up_zeros.GetTensorTypeAndShapeInfo().GetElementCount() * 2, 0);
-
-  size_t up_kblks = up_k / up_block_size;
-
-  // Original weights are in NxK/2 packed as uint8
-  // Convert to KXN uint8
-  for (int64_t i = 0; i < up_k; i += 2) {
-    for (int64_t j = 0; j < up_n; j++) {
-      auto srcv = up_wts[j * up_k / 2 + i / 2];
-      auto src0 = (srcv & 0xf) - 8;
-      auto src1 = ((srcv & 0xf0) >> 4) - 8;
-      up_weights[i * up_n + j] = static_cast<int8_t>(src0);
-      up_weights[(i + 1) * up_n + j] = static_cast<int8_t>(src1);
-    }
-  }
-
-  // Original Scales are in Nx(K/BlockSize) shape
-  // Convert to (K/BLOCK_SIZE)xN shape
-  for (int i = 0; i < up_n; i++) {
-    for (int j = 0; j < up_kblks; j++) {
-      up_scales[j * up_n + i] = up_scl[i * up_kblks + j];
-    }
-  }
-  int64_t uzp_shape =
-      (up_n * std::floor((float)((up_kblks + 1) * up_bits) / 8.0f));
-  // fill this with zeros for Symmetric quantization
-  if (is_upz_constant) {
-    int up_kblks_pad = 2 * uzp_shape / up_n;
-    for (int i = 0; i < up_n; i++) {
-      for (int j = 0; j < up_kblks_pad; j = j + 2) {
-        auto zpv = up_zps[((i * up_kblks_pad) / 2) + (j / 2)];
-        up_zpoints[j * up_n + i] = (zpv & 0xf) - 8;
-        up_zpoints[(j + 1) * up_n + i] = ((zpv & 0xf0) >> 4) - 8;
-      }
-    }
-  }
+  auto up_packed = packed(up_wts, up_scl, is_upz_constant ? up_zps : nullptr,
+                          up_k, up_n, up_bits, up_block_size);
 
   /////////////////////////// Down /////////////////////////////////
   std::vector<float> dp_bias(dp_n, 0); // fill with zeros
-  std::vector<float> dp_scales(dp_k * dp_n / dp_block_size);
-  std::vector<int8_t> dp_weights(dp_k * dp_n, 0);
-  // fill this with zeros for Symmetric quantization
-  std::vector<int8_t> dp_zpoints(
-      dp_zeros.GetTensorTypeAndShapeInfo().GetElementCount() * 2, 0);
-
-  size_t dp_kblks = dp_k / dp_block_size;
-  int64_t zp_shape =
-      (dp_n * std::floor((float)((dp_kblks + 1) * dp_bits) / 8.0f));
-
-  // Original weights are in NxK/2 packed as uint8
-  // Convert to KXN uint8
-  for (int64_t i = 0; i < dp_k; i += 2) {
-    for (int64_t j = 0; j < dp_n; j++) {
-      auto srcv = dp_wts[j * dp_k / 2 + i / 2];
-      auto src0 = (srcv & 0xf) - 8;
-      auto src1 = ((srcv & 0xf0) >> 4) - 8;
-      dp_weights[i * dp_n + j] = static_cast<int8_t>(src0);
-      dp_weights[(i + 1) * dp_n + j] = static_cast<int8_t>(src1);
-    }
-  }
-
-  // Original Scales are in Nx(K/BlockSize) shape
-  // Convert to (K/BLOCK_SIZE)xN shape
-  for (int i = 0; i < dp_n; i++) {
-    for (int j = 0; j < dp_kblks; j++) {
-      dp_scales[j * dp_n + i] = dp_scl[i * dp_kblks + j];
-    }
-  }
-
-  // fill this with zeros for Symmetric quantization
-  if (is_dpz_constant) {
-    int dp_kblks_pad = 2 * zp_shape / dp_n;
-    for (int i = 0; i < dp_n; i++) {
-      for (int j = 0; j < dp_kblks_pad; j = j + 2) {
-        // auto zpv = dp_zps[((i * dp_kblks) / 2) + (j / 2)];
-        auto zpv = dp_zps[((i * dp_kblks_pad) / 2 + j / 2)];
-        dp_zpoints[j * dp_n + i] = (zpv & 0xf) - 8;
-        dp_zpoints[(j + 1) * dp_n + i] = ((zpv & 0xf0) >> 4) - 8;
-      }
-    }
-  }
+  auto dp_packed = packed(dp_wts, dp_scl, is_dpz_constant ? dp_zps : nullptr,
+                          dp_k, dp_n, dp_bits, dp_block_size);
 
   std::string mladf_version_("v1");
 
@@ -685,10 +584,10 @@ MyCustomOpKernel::MyCustomOpKernel(const OrtKernelInfo* k_info) {
       (ryzenai::mladfmatmulbias<uint16_t, int8_t, uint16_t, uint16_t>*)
           gate_proj_.get();
 
-  Tensor gp_wts_tensor = {gp_weights.data(), gp_wts_shape_dd, "int4"};
+  Tensor gp_wts_tensor = {gp_packed->weights_data(), gp_wts_shape_dd, "int4"};
   Tensor gp_scl_tensor = {
-      gp_scales.data(), {(size_t)gp_block_size, 1}, "float"};
-  Tensor gp_zps_tensor = {gp_zpoints.data(), gp_wts_shape_dd, "int4"};
+      gp_packed->scales_data(), {(size_t)gp_block_size, 1}, "float"};
+  Tensor gp_zps_tensor = {gp_packed->zeros_data(), gp_wts_shape_dd, "int4"};
   Tensor gp_bias_tensor = {gp_bias.data(), {(size_t)gp_block_size, 1}, "float"};
 
   std::vector<Tensor> gp_const_tensors = {gp_wts_tensor, gp_bias_tensor,
@@ -720,10 +619,10 @@ MyCustomOpKernel::MyCustomOpKernel(const OrtKernelInfo* k_info) {
       (ryzenai::mladfmatmulbias<uint16_t, int8_t, uint16_t, uint16_t>*)
           up_proj_.get();
 
-  Tensor up_wts_tensor = {up_weights.data(), up_wts_shape_dd, "int4"};
+  Tensor up_wts_tensor = {up_packed->weights_data(), up_wts_shape_dd, "int4"};
   Tensor up_scl_tensor = {
-      up_scales.data(), {(size_t)up_block_size, 1}, "float"};
-  Tensor up_zps_tensor = {up_zpoints.data(), up_wts_shape_dd, "int4"};
+      up_packed->scales_data(), {(size_t)up_block_size, 1}, "float"};
+  Tensor up_zps_tensor = {up_packed->zeros_data(), up_wts_shape_dd, "int4"};
   Tensor up_bias_tensor = {up_bias.data(), {(size_t)up_block_size, 1}, "float"};
 
   std::vector<Tensor> up_const_tensors = {up_wts_tensor, up_bias_tensor,
@@ -755,10 +654,10 @@ MyCustomOpKernel::MyCustomOpKernel(const OrtKernelInfo* k_info) {
       (ryzenai::mladfmatmulbias<uint16_t, int8_t, uint16_t, uint16_t>*)
           down_proj_.get();
 
-  Tensor dp_wts_tensor = {dp_weights.data(), dp_wts_shape_dd, "int4"};
+  Tensor dp_wts_tensor = {dp_packed->weights_data(), dp_wts_shape_dd, "int4"};
   Tensor dp_scl_tensor = {
-      dp_scales.data(), {(size_t)dp_block_size, 1}, "float"};
-  Tensor dp_zps_tensor = {dp_zpoints.data(), dp_wts_shape_dd, "int4"};
+      dp_packed->scales_data(), {(size_t)dp_block_size, 1}, "float"};
+  Tensor dp_zps_tensor = {dp_packed->zeros_data(), dp_wts_shape_dd, "int4"};
   Tensor dp_bias_tensor = {dp_bias.data(), {(size_t)dp_block_size, 1}, "float"};
 
   std::vector<Tensor> dp_const_tensors = {dp_wts_tensor, dp_bias_tensor,
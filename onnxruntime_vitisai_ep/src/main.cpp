@@ -111,6 +111,7 @@ void profiler_collect_c(std::vector<EventInfo>& api_events,
   // TODO
 }
 ONNXRUNTIME_VITISAI_EP_DLL_SPEC void deinitialize_onnxruntime_vitisai_ep_c() {
+  vaip_core::runtime_trace::finish();
   // TODO
 }
 }
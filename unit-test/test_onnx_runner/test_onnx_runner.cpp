@@ -20,12 +20,17 @@
 #include "./unit_test_env_params.hpp"
 #include <algorithm> // std::generate
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <random>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 static int calculate_product(const std::vector<int64_t>& v) {
@@ -122,16 +127,14 @@ class TesOnnxRunner : public ::testing::Test {
   void TearDown() override { //
   }
 };
-void run(std::string& model_name, bool enable_cache_context) {
-  LOG(INFO) << "start to test " << ENV_PARAM(INPUT_MODEL);
-  int64_t batch_number = 1;
-  bool enable_ep = true;
+static std::unique_ptr<Ort::Session>
+create_session(Ort::Env& env, const std::string& model_name, bool enable_ep,
+               bool enable_cache_context) {
   int ort_opt_level = -1;
   std::string encryption_key = "";
   std::string opt_target_name = "";
   std::vector<std::string> customops;
 
-  Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "test_onnx_runner");
   auto model_path_in = std::filesystem::path(model_name);
   auto model_path_out = model_path_in;
 
@@ -191,7 +194,6 @@ void run(std::string& model_name, bool enable_cache_context) {
       model_path_out.u8string()
 #endif
       ;
-  Ort::AllocatorWithDefaultOptions allocator;
   std::unique_ptr<Ort::Session> p_session = nullptr;
   if (ENV_PARAM(XLNX_USE_MEMORY_MODEL)) {
     auto model_data = ReadBinaryFile(model_path_out.string());
@@ -201,6 +203,18 @@ void run(std::string& model_name, bool enable_cache_context) {
     p_session =
         std::make_unique<Ort::Session>(env, model_path.data(), session_options);
   }
+  return p_session;
+}
+
+void run(std::string& model_name, bool enable_cache_context) {
+  LOG(INFO) << "start to test " << ENV_PARAM(INPUT_MODEL);
+  int64_t batch_number = 1;
+  bool enable_ep = true;
+
+  Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "test_onnx_runner");
+  auto p_session =
+      create_session(env, model_name, enable_ep, enable_cache_context);
+  Ort::AllocatorWithDefaultOptions allocator;
   auto& session = *p_session;
   auto input_count = session.GetInputCount();
   auto input_shapes = std::vector<std::vector<int64_t>>();
@@ -363,6 +377,286 @@ void run(std::string& model_name, bool enable_cache_context) {
   save_input_output_json(input_file_list, output_file_list);
 }
 
+// One thread of TesOnnxRunner.Benchmark.
+struct BenchmarkThread {
+  size_t session = 0;
+  size_t thread = 0;
+  std::vector<int64_t> latency_ns;
+  // false when the warm-up failed, begin and end are then unset
+  bool measured = false;
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::time_point end;
+  std::string error;
+};
+
+// Latencies of a set of runs, sorted.
+struct BenchmarkStat {
+  explicit BenchmarkStat(std::vector<int64_t> latency_ns)
+      : sorted{std::move(latency_ns)} {
+    std::sort(sorted.begin(), sorted.end());
+  }
+  // nearest rank, in us
+  double percentile(double p) const {
+    if (sorted.empty()) {
+      return 0.0;
+    }
+    auto rank = (size_t)std::ceil(p * (double)sorted.size());
+    return (double)sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1] /
+           1000.0;
+  }
+  std::vector<int64_t> sorted;
+};
+
+static double seconds_of(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+// runs per second, 0 instead of inf for a span the clock did not resolve
+static double throughput(size_t runs, double seconds) {
+  return seconds > 0.0 ? (double)runs / seconds : 0.0;
+}
+
+// Releases all threads at once when the last one arrives, so that the
+// measured runs of all sessions overlap.
+class StartLine {
+public:
+  explicit StartLine(size_t count) : count_{count} {}
+  void arrive_and_wait() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (--count_ == 0) {
+      cv_.notify_all();
+    }
+    cv_.wait(lock, [this] { return count_ == 0; });
+  }
+
+private:
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  size_t count_;
+};
+
+static void benchmark_thread(Ort::Session& session, StartLine& start_line,
+                             BenchmarkThread& result) {
+  // the inputs are created once and reused by all runs of the thread
+  Ort::AllocatorWithDefaultOptions allocator;
+  auto input_count = session.GetInputCount();
+  auto output_count = session.GetOutputCount();
+  auto names_ptr = std::vector<Ort::AllocatedStringPtr>();
+  auto input_names = std::vector<const char*>();
+  auto output_names = std::vector<const char*>();
+  auto buffers = std::vector<std::vector<char>>(input_count);
+  auto input_tensors = std::vector<Ort::Value>();
+  auto info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+  auto gen = std::mt19937((unsigned int)(result.session * 1000 + result.thread));
+  for (auto i = 0u; i < input_count; ++i) {
+    auto name = session.GetInputNameAllocated(i, allocator);
+    input_names.push_back(name.get());
+    names_ptr.push_back(std::move(name));
+    auto type_info = session.GetInputTypeInfo(i).GetTensorTypeAndShapeInfo();
+    auto shape = type_info.GetShape();
+    for (auto& dim : shape) {
+      dim = dim < 0 ? 1 : dim;
+    }
+    buffers[i].resize(calculate_product(shape) *
+                      get_data_type_size(type_info.GetElementType()));
+    std::generate(buffers[i].begin(), buffers[i].end(),
+                  [&gen] { return (char)(gen() % 128); });
+    input_tensors.push_back(Ort::Value::CreateTensor(
+        info, buffers[i].data(), buffers[i].size(), shape.data(), shape.size(),
+        type_info.GetElementType()));
+  }
+  for (auto i = 0u; i < output_count; ++i) {
+    auto name = session.GetOutputNameAllocated(i, allocator);
+    output_names.push_back(name.get());
+    names_ptr.push_back(std::move(name));
+  }
+  auto run_once = [&]() {
+    session.Run(Ort::RunOptions(), input_names.data(), input_tensors.data(),
+                input_count, output_names.data(), output_count);
+  };
+
+  try {
+    for (auto i = 0; i < ENV_PARAM(XLNX_BENCHMARK_WARMUP); ++i) {
+      run_once();
+    }
+  } catch (const Ort::Exception& exception) {
+    result.error = exception.what();
+  }
+  start_line.arrive_and_wait();
+  if (!result.error.empty()) {
+    return;
+  }
+
+  auto seconds = ENV_PARAM(XLNX_BENCHMARK_SECONDS);
+  auto iterations = ENV_PARAM(XLNX_BENCHMARK_ITERATIONS);
+  if (seconds == 0) {
+    result.latency_ns.reserve(iterations);
+  }
+  result.measured = true;
+  result.begin = std::chrono::steady_clock::now();
+  auto deadline = result.begin + std::chrono::seconds(seconds);
+  try {
+    for (auto i = 0;
+         seconds > 0 ? std::chrono::steady_clock::now() < deadline
+                     : i < iterations;
+         ++i) {
+      auto start_time = std::chrono::steady_clock::now();
+      run_once();
+      auto end_time = std::chrono::steady_clock::now();
+      result.latency_ns.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                               start_time)
+              .count());
+    }
+  } catch (const Ort::Exception& exception) {
+    result.error = exception.what();
+  }
+  result.end = std::chrono::steady_clock::now();
+}
+
+static std::string benchmark_json(const std::vector<BenchmarkThread>& results,
+                                  const BenchmarkStat& total,
+                                  double wall_seconds) {
+  auto stat_json = [](const BenchmarkStat& stat, double seconds) {
+    std::ostringstream str;
+    str << std::fixed << std::setprecision(3) << "\"runs\": "
+        << stat.sorted.size()
+        << ", \"throughput\": " << throughput(stat.sorted.size(), seconds)
+        << ", \"p50_us\": " << stat.percentile(0.5)
+        << ", \"p90_us\": " << stat.percentile(0.9)
+        << ", \"p99_us\": " << stat.percentile(0.99)
+        << ", \"p999_us\": " << stat.percentile(0.999)
+        << ", \"max_us\": " << stat.percentile(1.0);
+    return str.str();
+  };
+  auto model = std::string();
+  for (auto c : ENV_PARAM(INPUT_MODEL)) {
+    if (c == '\\' || c == '"') {
+      model += '\\';
+    }
+    model += c;
+  }
+  std::ostringstream str;
+  str << "{\n";
+  str << "\t\"model\": \"" << model << "\",\n";
+  str << "\t\"sessions\": " << ENV_PARAM(XLNX_BENCHMARK_SESSIONS) << ",\n";
+  str << "\t\"threads_per_session\": " << ENV_PARAM(XLNX_BENCHMARK_THREADS)
+      << ",\n";
+  str << "\t\"warmup\": " << ENV_PARAM(XLNX_BENCHMARK_WARMUP) << ",\n";
+  str << "\t\"seconds\": " << std::fixed << std::setprecision(3)
+      << wall_seconds << ",\n";
+  str << "\t\"total\": {" << stat_json(total, wall_seconds) << "},\n";
+  // log2 buckets of us: [0, 2), [2, 4), [4, 8) ...
+  str << "\t\"histogram_us\": [";
+  auto bucket_end = int64_t(2);
+  auto count = size_t(0);
+  auto first = true;
+  for (auto latency : total.sorted) {
+    while (latency / 1000 >= bucket_end) {
+      if (count != 0) {
+        str << (first ? "" : ", ") << "{\"lt\": " << bucket_end
+            << ", \"count\": " << count << "}";
+        first = false;
+      }
+      bucket_end *= 2;
+      count = 0;
+    }
+    count++;
+  }
+  if (count != 0) {
+    str << (first ? "" : ", ") << "{\"lt\": " << bucket_end
+        << ", \"count\": " << count << "}";
+  }
+  str << "],\n";
+  str << "\t\"threads\": [";
+  for (auto i = 0u; i < results.size(); ++i) {
+    auto& r = results[i];
+    str << (i == 0 ? "\n" : ",\n") << "\t\t{\"session\": " << r.session
+        << ", \"thread\": " << r.thread << ", "
+        << stat_json(BenchmarkStat(r.latency_ns), seconds_of(r.end - r.begin))
+        << "}";
+  }
+  str << "\n\t]\n";
+  str << "}\n";
+  return str.str();
+}
+
+// XLNX_BENCHMARK_SESSIONS sessions of INPUT_MODEL, each run by
+// XLNX_BENCHMARK_THREADS threads at the same time, XLNX_BENCHMARK_WARMUP
+// runs and then XLNX_BENCHMARK_ITERATIONS runs or XLNX_BENCHMARK_SECONDS
+// seconds per thread. With XLNX_BENCHMARK_USE_EP=0 the sessions run on
+// the ORT CPU provider only.
+static void benchmark() {
+  auto num_of_sessions = (size_t)ENV_PARAM(XLNX_BENCHMARK_SESSIONS);
+  auto num_of_threads =
+      (size_t)std::max(ENV_PARAM(XLNX_BENCHMARK_THREADS), 1);
+  auto model_name = ENV_PARAM(INPUT_MODEL);
+  LOG(INFO) << "benchmark " << model_name << " with " << num_of_sessions
+            << " sessions x " << num_of_threads << " threads";
+
+  Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "test_onnx_runner");
+  auto sessions = std::vector<std::unique_ptr<Ort::Session>>();
+  for (auto s = 0u; s < num_of_sessions; ++s) {
+    sessions.push_back(create_session(
+        env, model_name, ENV_PARAM(XLNX_BENCHMARK_USE_EP) != 0, false));
+  }
+
+  auto results = std::vector<BenchmarkThread>(num_of_sessions * num_of_threads);
+  auto start_line = StartLine(results.size());
+  auto threads = std::vector<std::thread>();
+  for (auto s = 0u; s < num_of_sessions; ++s) {
+    for (auto t = 0u; t < num_of_threads; ++t) {
+      auto& result = results[s * num_of_threads + t];
+      result.session = s;
+      result.thread = t;
+      threads.emplace_back(benchmark_thread, std::ref(*sessions[s]),
+                           std::ref(start_line), std::ref(result));
+    }
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  auto all = std::vector<int64_t>();
+  auto measured = false;
+  auto begin = std::chrono::steady_clock::time_point();
+  auto end = std::chrono::steady_clock::time_point();
+  for (auto& r : results) {
+    EXPECT_TRUE(r.error.empty()) << "session " << r.session << " thread "
+                                 << r.thread << ": " << r.error;
+    if (!r.measured) {
+      continue;
+    }
+    all.insert(all.end(), r.latency_ns.begin(), r.latency_ns.end());
+    begin = measured ? std::min(begin, r.begin) : r.begin;
+    end = measured ? std::max(end, r.end) : r.end;
+    measured = true;
+  }
+  auto total = BenchmarkStat(std::move(all));
+  auto wall_seconds = seconds_of(end - begin);
+
+  cout << std::fixed << std::setprecision(1);
+  cout << "benchmark: " << total.sorted.size() << " runs in " << wall_seconds
+       << "s, " << throughput(total.sorted.size(), wall_seconds) << " runs/s"
+       << ", p50 " << total.percentile(0.5) << "us, p90 "
+       << total.percentile(0.9) << "us, p99 " << total.percentile(0.99)
+       << "us, p99.9 " << total.percentile(0.999) << "us, max "
+       << total.percentile(1.0) << "us" << endl;
+  for (auto& r : results) {
+    auto stat = BenchmarkStat(r.latency_ns);
+    cout << "  session " << r.session << " thread " << r.thread << ": "
+         << stat.sorted.size() << " runs, "
+         << throughput(stat.sorted.size(), seconds_of(r.end - r.begin))
+         << " runs/s, p50 " << stat.percentile(0.5) << "us, p99 "
+         << stat.percentile(0.99) << "us" << endl;
+  }
+  auto json_file = ENV_PARAM(XLNX_BENCHMARK_JSON);
+  if (!json_file.empty()) {
+    std::ofstream(json_file) << benchmark_json(results, total, wall_seconds);
+    cout << "benchmark summary: " << json_file << endl;
+  }
+}
+
 TEST_F(TesOnnxRunner, Main) {
   auto model_name = ENV_PARAM(INPUT_MODEL);
   bool with_cache_context = true;
@@ -373,3 +667,10 @@ TEST_F(TesOnnxRunner, Main) {
   auto ctx_model_name = ENV_PARAM(CACHE_CONTEXT_FILE_PATH);
   run(ctx_model_name, with_cache_context);
 }
+
+TEST_F(TesOnnxRunner, Benchmark) {
+  if (ENV_PARAM(XLNX_BENCHMARK_SESSIONS) <= 0) {
+    GTEST_SKIP() << "set XLNX_BENCHMARK_SESSIONS to run the benchmark";
+  }
+  benchmark();
+}
@@ -87,3 +87,31 @@ TEST_F(TestAnchorPoint, Append) {
   auto pass = IPass::create_pass(context, pass_proto);
   test_append(*pass, "case0.prototxt", "case1.prototxt");
 }
+
+TEST_F(TestAnchorPoint, AppendKeepsRest) {
+  auto cwd =
+      std::filesystem::path(__FILE__).parent_path() / "test_anchor_point.data";
+  std::shared_ptr<PassContext> context = PassContext::create();
+  auto pass_proto = PassProto();
+  pass_proto.set_name("test");
+  pass_proto.set_plugin("vaip-pass_init");
+  auto pass = IPass::create_pass(context, pass_proto);
+  auto head = create(cwd / "case4.prototxt");
+  auto rest = create(cwd / "case1.prototxt");
+  auto ret = head->append(*pass, *rest);
+  auto num_links = [](const AnchorPoint& ap) {
+    auto n = 0;
+    ap.for_each([&n](const AnchorPointProto&) { n = n + 1; });
+    return n;
+  };
+  EXPECT_EQ(num_links(*ret), num_links(*head) + num_links(*rest));
+  EXPECT_EQ(ret->origin_node_arg_name(), rest->origin_node_arg_name());
+  const auto* tail = &ret->get_proto();
+  for (auto i = 0; i < num_links(*head); ++i) {
+    tail = &tail->next();
+  }
+  EXPECT_EQ(tail->SerializeAsString(), rest->get_proto().SerializeAsString());
+  // optimize() is memoized, the same chain gives the same result
+  EXPECT_EQ(ret->optimize(*pass)->get_proto().SerializeAsString(),
+            ret->optimize(*pass)->get_proto().SerializeAsString());
+}
@@ -0,0 +1,222 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "vaip/dd/coeffs.hpp"
+#include "debug_logger.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace vaip::dd::qmatmulcalc;
+class CoeffsTest : public DebugLogger {
+protected:
+  template <typename T>
+  std::vector<std::vector<T>> random(size_t rows, size_t cols) {
+    auto dist = std::uniform_int_distribution<int>(
+        0, (int)std::numeric_limits<T>::max());
+    auto ret = std::vector<std::vector<T>>(rows, std::vector<T>(cols));
+    for (auto& row : ret) {
+      for (auto& x : row) {
+        x = (T)dist(rng_);
+      }
+    }
+    return ret;
+  }
+
+  // the loops the calculators had before column_sums().
+  template <typename T>
+  static std::vector<int64_t> naive(const std::vector<std::vector<T>>& w) {
+    auto ret = std::vector<int64_t>(w.empty() ? 0 : w[0].size(), 0);
+    for (auto& row : w) {
+      for (auto c = 0u; c < row.size(); ++c) {
+        ret[c] += row[c];
+      }
+    }
+    return ret;
+  }
+
+  // `w` in a buffer of `stride` elements per row, the padding filled with
+  // a value that shows up in the sums if it is read.
+  template <typename T>
+  static std::vector<T> strided(const std::vector<std::vector<T>>& w,
+                                size_t stride) {
+    auto ret = std::vector<T>(w.size() * stride, std::numeric_limits<T>::max());
+    for (auto r = 0u; r < w.size(); ++r) {
+      std::copy(w[r].begin(), w[r].end(), ret.begin() + r * stride);
+    }
+    return ret;
+  }
+
+  template <typename T> void check_column_sums() {
+    // cols around the block of 2048 columns
+    for (auto cols :
+         {size_t(1), size_t(7), size_t(2048), size_t(2 * 2048 + 3)}) {
+      for (auto rows : {size_t(0), size_t(1), size_t(33)}) {
+        SCOPED_TRACE("rows=" + std::to_string(rows) +
+                     " cols=" + std::to_string(cols));
+        auto w = random<T>(rows, cols);
+        auto expected = rows == 0 ? std::vector<int64_t>() : naive(w);
+        EXPECT_EQ(column_sums(w), expected);
+        if (rows == 0) {
+          continue;
+        }
+        auto flat = strided(w, cols);
+        EXPECT_EQ(
+            column_sums(WeightsView<T>(flat, {(int64_t)rows, (int64_t)cols})),
+            expected);
+        auto padded = strided(w, cols + 5);
+        EXPECT_EQ(column_sums(WeightsView<T>(padded, rows, cols, cols + 5)),
+                  expected);
+      }
+    }
+  }
+
+  // the weights of the golden values below.
+  static std::vector<std::vector<uint8_t>> weights_u8() {
+    auto ret = std::vector<std::vector<uint8_t>>(200, std::vector<uint8_t>(4));
+    for (auto r = 0u; r < ret.size(); ++r) {
+      for (auto c = 0u; c < 4u; ++c) {
+        ret[r][c] = (uint8_t)((r * 31 + c * 17 + 5) % 256);
+      }
+    }
+    return ret;
+  }
+
+  static std::vector<std::vector<uint16_t>> weights_u16() {
+    auto ret =
+        std::vector<std::vector<uint16_t>>(200, std::vector<uint16_t>(4));
+    for (auto r = 0u; r < ret.size(); ++r) {
+      for (auto c = 0u; c < 4u; ++c) {
+        ret[r][c] = (uint16_t)((r * 2741 + c * 977 + 5) % 65536);
+      }
+    }
+    return ret;
+  }
+
+  static void check_params(const MatmulQDQParams& p,
+                           const std::vector<int64_t>& c0,
+                           const std::vector<int32_t>& qdq) {
+    EXPECT_EQ(p.c0_coeffs, c0);
+    EXPECT_EQ(p.qdq_params, qdq);
+    EXPECT_EQ(p.c3_coeff_scale, qdq[2]);
+  }
+
+  std::mt19937 rng_{5};
+  const std::vector<uint16_t> bias_ = {100, 40000, 7, 65535};
+  const std::vector<int32_t> bias32_ = {-5000, 0, 123456, 77};
+  const float a_sc_ = 0.0123f;
+  const float w_sc_ = 0.0031f;
+  const float b_sc_ = 0.0007f;
+  const float q_sc_ = 0.0456f;
+};
+
+TEST_F(CoeffsTest, ColumnSumsUint8) { check_column_sums<uint8_t>(); }
+
+TEST_F(CoeffsTest, ColumnSumsUint16) { check_column_sums<uint16_t>(); }
+
+TEST_F(CoeffsTest, ColumnSumsFlush) {
+  // uint16 rows are flushed from the uint32 accumulators every 65537 rows,
+  // all at the maximum would overflow them without.
+  const auto rows = size_t(2 * 65537 + 5);
+  for (auto cols : {size_t(3), size_t(35)}) {
+    SCOPED_TRACE("cols=" + std::to_string(cols));
+    auto flat = std::vector<uint16_t>(rows * cols, 0xffff);
+    EXPECT_EQ(column_sums(WeightsView<uint16_t>(
+                  flat, {(int64_t)rows, (int64_t)cols})),
+              std::vector<int64_t>(cols, (int64_t)rows * 0xffff));
+  }
+}
+
+TEST_F(CoeffsTest, WeightsViewBadShape) {
+  auto flat = std::vector<uint8_t>(12);
+  EXPECT_DEATH(WeightsView<uint8_t>(flat, std::vector<int64_t>{12}), "");
+  EXPECT_DEATH(WeightsView<uint8_t>(flat, std::vector<int64_t>{3, 5}), "");
+  EXPECT_DEATH(WeightsView<uint8_t>(flat, 3, 4, 5), "");
+}
+
+// The golden values are the outputs of the calculators when they still
+// summed nested vectors, one calculator per family.
+TEST_F(CoeffsTest, MatmulAddUint16Uint8) {
+  check_params(
+      calculate_matmuladd_qdq_params_uint16_uint8(
+          weights_u8(), bias_, a_sc_, 32768, w_sc_, 128, b_sc_, 30000, q_sc_,
+          20000),
+      {15492504227660, 14762195405552, 13373453297417, 12854356074001},
+      {0, 0, -57462144, 897846, 0, 64, 64, 0, 29, 1, 1, 0, 0, 0, 0, 0});
+}
+
+TEST_F(CoeffsTest, MatmulAddUint8Uint8B32) {
+  check_params(
+      calculate_matmuladd_qdq_params_uint8_uint8_b32(
+          weights_u8(), bias32_, a_sc_, 120, w_sc_, 128, b_sc_, 0, q_sc_,
+          130),
+      {46902081960, 84230582240, 1097806980704, 77107783603},
+      {0, 0, -57462144, 448923, 0, 64, 64, 0, 29, 0, 0, 0, 0, 0, 0, 0});
+}
+
+TEST_F(CoeffsTest, MatmulUint16Uint8) {
+  auto w = weights_u8();
+  auto expected_c0 = std::vector<int64_t>{15738923253760, 14679781015552,
+                                          13620638777344, 12561496539136};
+  auto expected_qdq = std::vector<int32_t>{
+      0, 0, -57462144, 897846, 897846, 64, 64, 0, 29, 1, 1, 0, 0, 0, 0, 0};
+  check_params(calculate_matmul_qdq_params_uint16_uint8(
+                   w, a_sc_, 32768, w_sc_, 128, q_sc_, 20000),
+               expected_c0, expected_qdq);
+
+  // the 3d variant, from nested vectors and from a flat constant
+  auto w1 = w;
+  for (auto& row : w1) {
+    for (auto& x : row) {
+      x = 255 - x;
+    }
+  }
+  auto expected_c0_1 = std::vector<int64_t>{8677974999040, 9737117237248,
+                                            10796259475456, 11855401713664};
+  auto flat = strided(w, 4);
+  auto flat1 = strided(w1, 4);
+  flat.insert(flat.end(), flat1.begin(), flat1.end());
+  for (auto p :
+       {calculate_matmul_3d_qdq_params_uint16_uint8(
+            {w, w1}, a_sc_, 32768, w_sc_, 128, q_sc_, 20000),
+        calculate_matmul_3d_qdq_params_uint16_uint8(
+            gsl::span<const uint8_t>(flat), {2, 200, 4}, a_sc_, 32768, w_sc_,
+            128, q_sc_, 20000)}) {
+    ASSERT_EQ(p.c0_coeffs.size(), 2u);
+    EXPECT_EQ(p.c0_coeffs[0], expected_c0);
+    EXPECT_EQ(p.c0_coeffs[1], expected_c0_1);
+    EXPECT_EQ(p.qdq_params, expected_qdq);
+  }
+}
+
+TEST_F(CoeffsTest, MatmulBias) {
+  auto ret = compute_qdq_coeff_matmul_bias(a_sc_, 120, weights_u8(), w_sc_,
+                                           128, bias_, b_sc_, 30, q_sc_, 130);
+  EXPECT_EQ(std::get<0>(ret),
+            (std::vector<int64_t>{88686177690, 413640899070, 80162334423,
+                                  616328654495}));
+  EXPECT_EQ(std::get<1>(ret), -57462144);
+  EXPECT_EQ(std::get<2>(ret), 448923);
+  EXPECT_EQ(std::get<3>(ret), 0);
+  EXPECT_EQ(std::get<4>(ret), 29);
+  EXPECT_EQ(std::get<5>(ret), 0);
+}
+
+TEST_F(CoeffsTest, Uint16WeightsBiasMatmul) {
+  auto ret = dq_uint16A_uint16W_bias_matmul_q_param_gen(
+      a_sc_, 32768, weights_u16(), w_sc_, 30000, bias_, b_sc_, 30000, q_sc_,
+      20000, {1, 0, 2});
+  EXPECT_EQ(std::get<0>(ret),
+            (std::vector<int64_t>{-71642492413744, -101486742336448,
+                                  -86150708093860, -85864609749956}));
+  EXPECT_EQ(std::get<1>(ret), -420870000);
+  EXPECT_EQ(std::get<2>(ret), 448928);
+  EXPECT_EQ(std::get<3>(ret), 0);
+  EXPECT_EQ(std::get<4>(ret), 24);
+  EXPECT_EQ(std::get<5>(ret), 7);
+}
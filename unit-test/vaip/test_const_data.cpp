@@ -221,3 +221,27 @@ TEST_F(ConstDataTest, uint64) {
     EXPECT_EQ(const_data_value, std::vector<uint64_t>({9, 10}));
   });
 }
+
+TEST_F(ConstDataTest, info) {
+  run_test([this]() {
+    auto const_value_opt = graph->find_node_arg("const_int8");
+    ASSERT_TRUE(const_value_opt);
+    auto& info = const_value_opt.value().info();
+    EXPECT_TRUE(info.has_shape);
+    EXPECT_EQ(std::vector<int64_t>(info.shape.begin(), info.shape.end()),
+              *const_value_opt.value().shape());
+    EXPECT_EQ(info.element_type, ONNX_NAMESPACE::TensorProto_DataType_INT8);
+    EXPECT_FALSE(info.is_dynamic_shape);
+    EXPECT_FALSE(info.is_zero_shape);
+    // cached, the same info and the same const data again.
+    EXPECT_EQ(&const_value_opt.value().info(), &info);
+    for (auto i = 0; i < 2; ++i) {
+      auto const_data = const_value_opt.value().const_data_as_i8_span();
+      EXPECT_EQ(std::vector<int8_t>(const_data.begin(), const_data.end()),
+                std::vector<int8_t>({-1, -2}));
+    }
+    auto scalar_opt = graph->find_node_arg("const_int8_scalar");
+    ASSERT_TRUE(scalar_opt);
+    EXPECT_TRUE(scalar_opt.value().is_scalar());
+  });
+}
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "../vaip_pass_level1_dpu/src/const_pool.hpp"
+#include "debug_logger.hpp"
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace vaip_core;
+class ConstPoolTest : public DebugLogger {
+protected:
+  // a const op of `bytes`, keyed like export_to_xir does. The pool refers
+  // to the bytes, kept by the fixture like the onnx graph keeps them.
+  xir::Op* add_const(ConstPool& pool, const std::string& name,
+                     const std::vector<char>& bytes,
+                     const std::string& data_type = "INT8") {
+    auto& data = data_.emplace_back(bytes);
+    auto shape = std::vector<int>{(int)data.size()};
+    auto key = data_type + std::to_string(data.size());
+    return pool.intern(name, key, data, [&]() {
+      auto attrs = xir::Attrs::create();
+      attrs->set_attr<std::vector<int>>("shape", shape);
+      attrs->set_attr<std::string>("data_type", data_type);
+      attrs->set_attr<std::vector<char>>("data", data);
+      return graph_->add_op(name, "const", std::move(attrs),
+                            std::map<std::string, std::vector<xir::Op*>>{});
+    });
+  }
+
+  std::list<std::vector<char>> data_;
+  std::unique_ptr<xir::Graph> graph_ = xir::Graph::create("test");
+};
+
+TEST_F(ConstPoolTest, SharesIdenticalConstants) {
+  auto pool = ConstPool();
+  auto w0 = add_const(pool, "w0", {1, 2, 3, 4});
+  auto w1 = add_const(pool, "w1", {1, 2, 3, 4});
+  auto w2 = add_const(pool, "w2", {1, 2, 3, 5});
+  EXPECT_EQ(w0, w1);
+  EXPECT_NE(w0, w2);
+  EXPECT_EQ(pool.num_aliases(), 1u);
+  EXPECT_EQ(pool.bytes_saved(), 4u);
+  EXPECT_EQ(pool.get_op(graph_.get(), "w1"), w0);
+  EXPECT_EQ(graph_->get_op_num(), 2);
+  pool.save_aliases(graph_.get());
+
+  // both names resolve, the alias to the tensor holding its data.
+  auto t0 = get_xir_tensor(graph_.get(), "w0");
+  auto t1 = get_xir_tensor(graph_.get(), "w1");
+  ASSERT_NE(t0, nullptr);
+  EXPECT_EQ(t0, t1);
+  EXPECT_EQ(t1->get_shape(), std::vector<int>{4});
+  EXPECT_EQ(get_xir_tensor(graph_.get(), "w2"), w2->get_output_tensor());
+  EXPECT_EQ(get_xir_tensor(graph_.get(), "no_such_const"), nullptr);
+}
+
+TEST_F(ConstPoolTest, SameBytesOtherKey) {
+  auto pool = ConstPool();
+  auto w0 = add_const(pool, "w0", {1, 2, 3, 4});
+  auto w1 = add_const(pool, "w1", {1, 2, 3, 4}, "UINT8");
+  EXPECT_NE(w0, w1);
+  EXPECT_EQ(pool.num_aliases(), 0u);
+}
+
+TEST_F(ConstPoolTest, Disabled) {
+  auto pool = ConstPool(false);
+  auto w0 = add_const(pool, "w0", {1, 2, 3, 4});
+  auto w1 = add_const(pool, "w1", {1, 2, 3, 4});
+  EXPECT_NE(w0, w1);
+  pool.save_aliases(graph_.get());
+  EXPECT_FALSE(graph_->has_attr(XIR_CONST_ALIASES));
+  EXPECT_EQ(get_xir_tensor(graph_.get(), "w1"), w1->get_output_tensor());
+}
+
+TEST_F(ConstPoolTest, AliasesSavedWithTheXmodel) {
+  // the exported graph is cached as xir.xmodel and loaded again.
+  auto pool = ConstPool();
+  add_const(pool, "w0", {7, 7});
+  add_const(pool, "w1", {7, 7});
+  pool.save_aliases(graph_.get());
+  auto file = CMAKE_CURRENT_BINARY_PATH / "test_const_pool.xmodel";
+  graph_->serialize(file.u8string());
+  auto loaded = xir::Graph::deserialize(file.u8string());
+  auto t1 = get_xir_tensor(loaded.get(), "w1");
+  ASSERT_NE(t1, nullptr);
+  EXPECT_EQ(t1->get_name(), "w0");
+}
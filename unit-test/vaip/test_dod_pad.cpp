@@ -0,0 +1,229 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "../vaip_custom_op_dod/src/pad.hpp"
+#include "debug_logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace vaip_dod_custom_op;
+class DodPadTest : public DebugLogger {
+protected:
+  template <typename T> std::vector<T> random(size_t size, int lo, int hi) {
+    auto dist = std::uniform_int_distribution<int>(lo, hi);
+    auto ret = std::vector<T>(size);
+    for (auto& x : ret) {
+      x = (T)dist(rng_);
+    }
+    return ret;
+  }
+
+  static size_t size_of(const std::vector<int64_t>& shape) {
+    auto ret = size_t(1);
+    for (auto d : shape) {
+      ret *= (size_t)d;
+    }
+    return ret;
+  }
+
+  // the padded offset of every dense element, one at a time.
+  static std::vector<size_t> offsets(const std::vector<int64_t>& shape,
+                                     const std::vector<int64_t>& padded) {
+    auto ret = std::vector<size_t>(size_of(shape));
+    for (auto i = 0u; i < ret.size(); ++i) {
+      auto rest = (size_t)i;
+      auto offset = size_t(0);
+      auto stride = size_t(1);
+      for (auto d = (int)shape.size() - 1; d >= 0; --d) {
+        offset += rest % shape[d] * stride;
+        rest /= shape[d];
+        stride *= padded[d];
+      }
+      ret[i] = offset;
+    }
+    return ret;
+  }
+
+  static std::string str(const std::vector<int64_t>& v) {
+    std::ostringstream ret;
+    for (auto x : v) {
+      ret << x << " ";
+    }
+    return ret.str();
+  }
+
+  static uint16_t dequantize(int q, float scale, float zp) {
+    return float_to_bfloat16_1((static_cast<float>(q) - zp) * scale);
+  }
+
+  template <typename Q>
+  static Q quantize(uint16_t bf16, float scale, float zp) {
+    constexpr auto q_max = (float)std::numeric_limits<Q>::max();
+    return static_cast<Q>(std::clamp(
+        std::roundf(bfloat_to_float(bf16) / scale) + zp, 0.0f, q_max));
+  }
+
+  std::mt19937 rng_{13};
+  const float scale_ = 0.00123f;
+  const float zp_ = 32768.0f;
+};
+
+TEST_F(DodPadTest, Layout) {
+  // padded on the outermost dim only: one row
+  auto l =
+      PadLayout(std::vector<int64_t>{3, 4, 5}, std::vector<size_t>{6, 4, 5});
+  EXPECT_EQ(l.row, 60);
+  EXPECT_EQ(l.num_rows, 1);
+  EXPECT_EQ(l.padded_size, 120);
+  // padded on the innermost dim: a row per element of the outer dims
+  l = PadLayout(std::vector<int64_t>{3, 4, 5}, std::vector<size_t>{3, 4, 8});
+  EXPECT_EQ(l.row, 5);
+  EXPECT_EQ(l.num_rows, 12);
+  EXPECT_EQ(l.padded_offset(5), 40);
+  // unpadded
+  l = PadLayout(std::vector<int64_t>{2, 3}, std::vector<size_t>{2, 3});
+  EXPECT_EQ(l.row, 6);
+  EXPECT_EQ(l.num_rows, 1);
+  EXPECT_EQ(l.padded_size, 6);
+}
+
+TEST_F(DodPadTest, PadOneDim) {
+  // the loops of the op before PadLayout, which padded one dim `dim`:
+  // rows of shape[dim:] elements, copied to the start of the padded rows.
+  struct Case {
+    std::vector<int64_t> shape;
+    std::vector<int64_t> padded;
+    int dim;
+  };
+  for (auto& c : std::vector<Case>{{{1, 77, 768}, {1, 128, 768}, 1},
+                                   {{1000, 33}, {1000, 40}, 1},
+                                   {{5, 1, 7, 3}, {5, 2, 7, 3}, 1},
+                                   {{70001}, {70013}, 0}}) {
+    SCOPED_TRACE(str(c.shape));
+    auto src = random<uint16_t>(size_of(c.shape), 0, 65535);
+    auto elems = 1;
+    for (auto d = c.dim + 1; d < (int)c.shape.size(); ++d) {
+      elems *= (int)c.shape[d];
+    }
+    auto iters = 1;
+    for (auto d = 0; d < c.dim; ++d) {
+      iters *= (int)c.shape[d];
+    }
+    auto s_off = (int)c.shape[c.dim] * elems;
+    auto d_off = (int)c.padded[c.dim] * elems;
+    auto expected = std::vector<uint16_t>(size_of(c.padded), 7);
+    for (auto f = 0; f < iters; ++f) {
+      for (auto idx = 0; idx < s_off; ++idx) {
+        expected[f * d_off + idx] =
+            dequantize(src[f * s_off + idx], scale_, zp_);
+      }
+    }
+    auto dst = std::vector<uint16_t>(expected.size(), 7);
+    pad_copy(
+        PadLayout(c.shape, c.padded), src.data(), dst.data(),
+        [&](const uint16_t* s, uint16_t* d, int64_t n) {
+          dequantize_to_bf16(s, d, n, scale_, zp_);
+        },
+        std::optional<uint16_t>());
+    EXPECT_EQ(dst, expected);
+  }
+}
+
+TEST_F(DodPadTest, PadFill) {
+  // any number of padded dims; with a fill every padded element gets it,
+  // e.g. bf16(-zp * scale) for the 1x1x1x77 attention mask.
+  auto fill = dequantize(0, scale_, zp_);
+  for (auto& [shape, padded] :
+       std::vector<std::pair<std::vector<int64_t>, std::vector<int64_t>>>{
+           {{1, 1, 1, 77}, {1, 1, 1, 128}},
+           {{3, 5, 7}, {4, 6, 9}},
+           {{2, 3, 1, 17}, {2, 4, 3, 17}},
+           {{2, 3}, {2, 3}}}) {
+    SCOPED_TRACE(str(shape));
+    auto src = random<uint8_t>(size_of(shape), 0, 255);
+    auto expected = std::vector<uint16_t>(size_of(padded), fill);
+    auto dense = offsets(shape, padded);
+    for (auto i = 0u; i < dense.size(); ++i) {
+      expected[dense[i]] = dequantize(src[i], scale_, zp_);
+    }
+    auto dst = std::vector<uint16_t>(expected.size(), 7);
+    pad_copy(
+        PadLayout(shape, padded), src.data(), dst.data(),
+        [&](const uint8_t* s, uint16_t* d, int64_t n) {
+          dequantize_to_bf16(s, d, n, scale_, zp_);
+        },
+        std::optional<uint16_t>(fill));
+    EXPECT_EQ(dst, expected);
+  }
+}
+
+TEST_F(DodPadTest, Depad) {
+  for (auto& [shape, padded] :
+       std::vector<std::pair<std::vector<int64_t>, std::vector<int64_t>>>{
+           {{1, 77, 768}, {1, 128, 768}},
+           {{3, 5, 7}, {4, 6, 9}},
+           {{5000, 3}, {5000, 3}}}) {
+    SCOPED_TRACE(str(shape));
+    // bf16 of values around the quantized range, and beyond it
+    auto src = std::vector<uint16_t>(size_of(padded));
+    for (auto& x : src) {
+      x = float_to_bfloat16_1(
+          std::uniform_real_distribution<float>(-50.0f, 50.0f)(rng_));
+    }
+    auto dense = offsets(shape, padded);
+    auto expected16 = std::vector<uint16_t>(dense.size());
+    auto expected8 = std::vector<uint8_t>(dense.size());
+    for (auto i = 0u; i < dense.size(); ++i) {
+      expected16[i] = quantize<uint16_t>(src[dense[i]], scale_, zp_);
+      expected8[i] = quantize<uint8_t>(src[dense[i]], 0.2f, 128.0f);
+    }
+    auto layout = PadLayout(shape, padded);
+    auto dst16 = std::vector<uint16_t>(dense.size());
+    depad_copy(layout, src.data(), dst16.data(),
+               [&](const uint16_t* s, uint16_t* d, int64_t n) {
+                 quantize_from_bf16(s, d, n, scale_, zp_);
+               });
+    EXPECT_EQ(dst16, expected16);
+    auto dst8 = std::vector<uint8_t>(dense.size());
+    depad_copy(layout, src.data(), dst8.data(),
+               [&](const uint16_t* s, uint8_t* d, int64_t n) {
+                 quantize_from_bf16(s, d, n, 0.2f, 128.0f);
+               });
+    EXPECT_EQ(dst8, expected8);
+  }
+}
+
+TEST_F(DodPadTest, Conversions) {
+  // lengths around the batches of 8, the scalar tails included.
+  for (auto n : {1, 7, 8, 9, 37}) {
+    SCOPED_TRACE("n=" + std::to_string(n));
+    auto f = std::vector<float>(n);
+    for (auto& x : f) {
+      x = std::uniform_real_distribution<float>(-45.0f, 45.0f)(rng_);
+    }
+    // halfway cases round away from zero
+    f[0] = scale_ * 2.5f;
+    auto q = std::vector<uint16_t>(n);
+    quantize_float(f.data(), q.data(), n, scale_, zp_);
+    auto bf16 = std::vector<uint16_t>(n);
+    float_to_bf16(f.data(), bf16.data(), n);
+    auto back = std::vector<float>(n);
+    bf16_to_float(bf16.data(), back.data(), n);
+    for (auto i = 0; i < n; ++i) {
+      EXPECT_EQ(q[i], (uint16_t)std::clamp(std::roundf(f[i] / scale_) + zp_,
+                                           0.0f, 65535.0f))
+          << i;
+      EXPECT_EQ(bf16[i], float_to_bfloat16_1(f[i])) << i;
+      EXPECT_EQ(back[i], bfloat_to_float(bf16[i])) << i;
+    }
+  }
+}
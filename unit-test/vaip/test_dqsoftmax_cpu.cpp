@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "../vaip_custom_op_dqsoftmax/src/dqsoftmax_cpu.hpp"
+#include "cpu_features/cpu_features.hpp"
+#include "debug_logger.hpp"
+#include <cmath>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace vaip_dqsoftmax_custom_op;
+class DqSoftmaxCpuTest : public DebugLogger {
+protected:
+  std::vector<uint16_t> random(size_t size, int lo, int hi) {
+    auto dist = std::uniform_int_distribution<int>(lo, hi);
+    auto ret = std::vector<uint16_t>(size);
+    for (auto& x : ret) {
+      x = (uint16_t)dist(rng_);
+    }
+    return ret;
+  }
+
+  // dequantize and softmax every row in double, as the op did before the
+  // table, with the zero point of the model.
+  static void check(const std::vector<uint16_t>& input, float scale,
+                    uint16_t zp, int channel, const std::vector<float>& out) {
+    auto h_w = (int)(input.size() / channel);
+    for (auto h = 0; h < h_w; ++h) {
+      auto row = input.data() + (size_t)h * channel;
+      auto max = 0.0;
+      for (auto c = 0; c < channel; ++c) {
+        max = std::max(max, (double)scale * (row[c] - zp));
+      }
+      auto sum = 0.0;
+      for (auto c = 0; c < channel; ++c) {
+        sum += std::exp((double)scale * (row[c] - zp) - max);
+      }
+      for (auto c = 0; c < channel; ++c) {
+        auto expected = std::exp((double)scale * (row[c] - zp) - max) / sum;
+        EXPECT_NEAR(out[(size_t)h * channel + c], expected,
+                    1e-5 * expected + 1e-30)
+            << "h=" << h << " c=" << c;
+      }
+    }
+  }
+
+  // the AVX2 gather where the CPU has it, and the scalar loop.
+  static std::vector<bool> kernels() {
+    auto ret = std::vector<bool>{false};
+    if (vaip_cpu::has_avx2()) {
+      ret.push_back(true);
+    }
+    return ret;
+  }
+
+  std::mt19937 rng_{9};
+};
+
+TEST_F(DqSoftmaxCpuTest, Rows) {
+  const auto scale = 0.0015f;
+  const auto zp = uint16_t(31000);
+  // channels around the batches of 8, rows over several tasks.
+  for (auto channel : {1, 7, 8, 21, 64}) {
+    for (auto avx2 : kernels()) {
+      SCOPED_TRACE("channel=" + std::to_string(channel) +
+                   " avx2=" + std::to_string(avx2));
+      const auto h_w = 300;
+      auto input = random((size_t)h_w * channel, 28000, 34000);
+      auto out = std::vector<float>(input.size());
+      DqSoftmaxCpu(scale).run(input.data(), out.data(), channel, h_w, avx2);
+      check(input, scale, zp, channel, out);
+    }
+  }
+}
+
+TEST_F(DqSoftmaxCpuTest, FullRange) {
+  // exp(scale * (q - zp)) alone overflows float here, the difference to the
+  // row maximum does not; terms far below the maximum become 0.
+  const auto scale = 0.01f;
+  const auto channel = 19;
+  for (auto avx2 : kernels()) {
+    SCOPED_TRACE("avx2=" + std::to_string(avx2));
+    auto input = random(50 * channel, 0, 65535);
+    input[0] = 65535;
+    input[1] = 0;
+    auto out = std::vector<float>(input.size());
+    DqSoftmaxCpu(scale).run(input.data(), out.data(), channel, 50, avx2);
+    check(input, scale, 0, channel, out);
+    for (auto h = 0; h < 50; ++h) {
+      auto sum = 0.0f;
+      for (auto c = 0; c < channel; ++c) {
+        sum += out[h * channel + c];
+      }
+      EXPECT_NEAR(sum, 1.0f, 1e-5f) << "h=" << h;
+    }
+  }
+}
@@ -0,0 +1,193 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "embedding/embedding.hpp"
+#include "debug_logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace vaip_embedding;
+class EmbeddingTest : public DebugLogger {
+protected:
+  void SetUp() override {
+    context_ = vaip_core::PassContext::create();
+    table_data_.resize(ROWS * DIM);
+    for (auto& x : table_data_) {
+      x = (uint8_t)std::uniform_int_distribution<int>(0, 255)(rng_);
+    }
+    ASSERT_TRUE(context_->write_file(
+        NAME, gsl::span<const char>((const char*)table_data_.data(),
+                                    table_data_.size())));
+    table_ = Table::load(*context_, "not_there" / std::filesystem::path(NAME),
+                         ROWS, DIM);
+  }
+
+  template <typename Index> std::vector<Index> indices(size_t n) {
+    auto dist = std::uniform_int_distribution<int64_t>(-ROWS, ROWS - 1);
+    auto ret = std::vector<Index>(n);
+    for (auto& x : ret) {
+      x = (Index)dist(rng_);
+    }
+    return ret;
+  }
+
+  // the row of an index as the ops computed it before Table, with the
+  // negative indices of onnx Gather.
+  const uint8_t* expected_row(int64_t index) const {
+    return table_data_.data() + (index < 0 ? index + ROWS : index) * DIM;
+  }
+
+  static constexpr int64_t ROWS = 1000;
+  static constexpr int64_t DIM = 77;
+  static constexpr const char* NAME = "test_embedding.bin";
+  std::mt19937 rng_{17};
+  std::unique_ptr<vaip_core::PassContext> context_;
+  std::vector<uint8_t> table_data_;
+  Table table_;
+};
+
+TEST_F(EmbeddingTest, Load) {
+  EXPECT_EQ(table_.num_rows(), ROWS);
+  EXPECT_EQ(table_.row_bytes(), DIM);
+  EXPECT_EQ(std::memcmp(table_.row(0), table_data_.data(), ROWS * DIM), 0);
+
+  // a file that was never added to the cache is read from its path
+  auto path = CMAKE_CURRENT_BINARY_PATH / "test_embedding_path.bin";
+  std::ofstream(path, std::ios::binary)
+      .write((const char*)table_data_.data(), 10 * DIM);
+  auto table = Table::load(*context_, path, 10, DIM);
+  EXPECT_EQ(std::memcmp(table.row(9), expected_row(9), DIM), 0);
+
+  EXPECT_THROW(Table::load(*context_, path, 11, DIM), std::runtime_error);
+  EXPECT_THROW(Table::load(*context_, CMAKE_CURRENT_BINARY_PATH / "nothing",
+                           1, DIM),
+               std::runtime_error);
+}
+
+TEST_F(EmbeddingTest, Gather) {
+  // a few indices, and enough to split over the thread pool.
+  for (auto n : {size_t(1), size_t(7), size_t(5000)}) {
+    SCOPED_TRACE("n=" + std::to_string(n));
+    auto idx = indices<int64_t>(n);
+    idx[0] = -ROWS;
+    auto out = std::vector<uint8_t>(n * DIM);
+    gather(table_, idx.data(), (int64_t)n,
+           [&](int64_t i, const uint8_t* row) {
+             std::memcpy(out.data() + i * DIM, row, DIM);
+           });
+    for (auto i = 0u; i < n; ++i) {
+      EXPECT_EQ(std::memcmp(out.data() + i * DIM, expected_row(idx[i]), DIM),
+                0)
+          << "index " << idx[i] << " at " << i;
+    }
+  }
+}
+
+TEST_F(EmbeddingTest, GatherAdd) {
+  // gather_add: dequantized rows plus a dequantized weight per position,
+  // as the per-element loop of the op.
+  const auto act_scale = 0.0123f, act_zp = 131.0f;
+  const auto wt_scale = 0.5f, wt_zp = 7.0f;
+  auto act_lut = ByteLut<float>::make(
+      [=](uint8_t v) { return ((float)v - act_zp) * act_scale; });
+  auto wts_lut = ByteLut<float>::make(
+      [=](uint8_t v) { return ((float)v - wt_zp) * wt_scale; });
+  EXPECT_FALSE(act_lut.identity);
+  const auto n = size_t(300);
+  auto idx = indices<float>(n);
+  auto out = std::vector<float>(n * DIM);
+  gather(table_, idx.data(), (int64_t)n, [&](int64_t i, const uint8_t* row) {
+    auto wts = table_.row(i);
+    for (auto j = 0; j < DIM; ++j) {
+      out[i * DIM + j] = act_lut.values[row[j]] + wts_lut.values[wts[j]];
+    }
+  });
+  for (auto i = 0u; i < n; ++i) {
+    auto row = expected_row((int64_t)idx[i]);
+    for (auto j = 0; j < DIM; ++j) {
+      auto wt = ((float)table_data_[i * DIM + j] - wt_zp) * wt_scale;
+      ASSERT_EQ(out[i * DIM + j], ((float)row[j] - act_zp) * act_scale + wt)
+          << "i=" << i << " j=" << j;
+    }
+  }
+}
+
+TEST_F(EmbeddingTest, DqCastGather) {
+  // dqcastgather: dequantize to float and quantize back to int8, the
+  // identity unless the scale loses precision.
+  for (auto zp : {int8_t(0), int8_t(-3), int8_t(17)}) {
+    for (auto scale : {0.1f, 0.0078125f, 3.7f}) {
+      SCOPED_TRACE("zp=" + std::to_string(zp) +
+                   " scale=" + std::to_string(scale));
+      auto requantize = [=](float dq) {
+        auto temp = dq / scale + static_cast<float>(zp);
+        return static_cast<int8_t>(std::min(127.0f, std::max(-128.0f, temp)));
+      };
+      auto lut = ByteLut<int8_t>::make([=](uint8_t v) {
+        return requantize((float)((float)(int8_t)v - (float)zp) * scale);
+      });
+      const auto n = size_t(300);
+      auto idx = indices<float>(n);
+      auto out = std::vector<int8_t>(n * DIM);
+      gather(table_, idx.data(), (int64_t)n,
+             [&](int64_t i, const uint8_t* row) {
+               lut.convert(row, out.data() + i * DIM, DIM);
+             });
+      for (auto i = 0u; i < n; ++i) {
+        auto row = expected_row((int64_t)idx[i]);
+        for (auto j = 0; j < DIM; ++j) {
+          auto dq = (float)((float)(int8_t)row[j] - (float)zp) * scale;
+          ASSERT_EQ(out[i * DIM + j], requantize(dq))
+              << "i=" << i << " j=" << j;
+        }
+      }
+      auto identity = true;
+      for (auto b = 0; b < 256; ++b) {
+        identity = identity && (uint8_t)lut.values[b] == b;
+      }
+      EXPECT_EQ(lut.identity, identity);
+    }
+  }
+}
+
+TEST_F(EmbeddingTest, CheckIndices) {
+  auto ok = std::vector<int64_t>{0, ROWS - 1, -1, -ROWS};
+  EXPECT_NO_THROW(check_indices(ok.data(), (int64_t)ok.size(), ROWS));
+  // float indices truncate like (int)
+  auto ok_f = std::vector<float>{0.0f, ROWS - 0.5f, -ROWS - 0.5f};
+  EXPECT_NO_THROW(check_indices(ok_f.data(), (int64_t)ok_f.size(), ROWS));
+
+  for (auto bad : {ROWS, -ROWS - 1, std::numeric_limits<int64_t>::max(),
+                   std::numeric_limits<int64_t>::min()}) {
+    SCOPED_TRACE("index " + std::to_string(bad));
+    auto idx = indices<int64_t>(100);
+    idx[63] = bad;
+    EXPECT_THROW(check_indices(idx.data(), (int64_t)idx.size(), ROWS),
+                 std::out_of_range);
+    // nothing is gathered
+    auto called = false;
+    EXPECT_THROW(gather(table_, idx.data(), (int64_t)idx.size(),
+                        [&](int64_t, const uint8_t*) { called = true; }),
+                 std::out_of_range);
+    EXPECT_FALSE(called);
+  }
+  for (auto bad : {(float)ROWS, -ROWS - 1.0f, std::nanf(""),
+                   std::numeric_limits<float>::infinity()}) {
+    SCOPED_TRACE("index " + std::to_string(bad));
+    auto idx = indices<float>(10);
+    idx[9] = bad;
+    EXPECT_THROW(check_indices(idx.data(), (int64_t)idx.size(), ROWS),
+                 std::out_of_range);
+  }
+}
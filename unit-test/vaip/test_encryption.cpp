@@ -0,0 +1,147 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "../encryption/src/encryption.hpp"
+#include "debug_logger.hpp"
+#include "vaip/thread_pool.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#ifdef WITH_OPENSSL
+#  include <openssl/evp.h>
+#endif
+
+using namespace vaip_encryption;
+class EncryptionTest : public DebugLogger {
+protected:
+  std::string random(size_t size) {
+    auto dist = std::uniform_int_distribution<int>(0, 255);
+    auto ret = std::string(size, '\0');
+    for (auto& c : ret) {
+      c = (char)dist(rng_);
+    }
+    return ret;
+  }
+
+  // the streaming decryption, reading `data` in pieces of `piece` bytes.
+  std::string decrypt_stream(const std::string& data, size_t piece = 4096) {
+    auto pos = size_t(0);
+    return aes_decryption(
+        [&](char* buf, size_t size) {
+          auto n = std::min({size, piece, data.size() - pos});
+          std::copy_n(data.data() + pos, n, buf);
+          pos += n;
+          return n;
+        },
+        key_);
+  }
+
+  // the streaming encryption, collecting what it writes.
+  std::string encrypt_stream(const std::string& plain) {
+    auto ret = std::string();
+    aes_encryption(plain.data(), plain.size(), key_,
+                   [&ret](const char* data, size_t size) {
+                     ret.append(data, size);
+                   });
+    return ret;
+  }
+
+  // the sizes of the format: a header, then every chunk followed by its
+  // tag.
+  static constexpr size_t HEADER = 32;
+  static constexpr size_t CHUNK = 1u << 20;
+  static constexpr size_t TAG = 16;
+
+  std::mt19937 rng_{42};
+  const std::string key_ = "0123456789abcdef0123456789abcdef";
+};
+
+TEST_F(EncryptionTest, RoundTrip) {
+  // more chunks than the streaming functions hold at a time.
+  auto batch = vaip_core::ThreadPool::instance().size() * 4;
+  for (auto size : {size_t(0), size_t(1), size_t(1000), CHUNK,
+                    (batch + 1) * CHUNK + 123}) {
+    SCOPED_TRACE("size=" + std::to_string(size));
+    auto plain = random(size);
+    auto cipher = aes_encryption(plain, key_);
+    EXPECT_EQ(encrypt_stream(plain).size(), cipher.size());
+    EXPECT_EQ(aes_decryption(cipher, key_), plain);
+    EXPECT_EQ(decrypt_stream(cipher), plain);
+#ifdef WITH_OPENSSL
+    auto chunks = (size + CHUNK - 1) / CHUNK;
+    EXPECT_EQ(cipher.size(), HEADER + size + chunks * TAG);
+    // a fresh nonce every time
+    EXPECT_NE(aes_encryption(plain, key_), cipher);
+#endif
+  }
+}
+
+#ifdef WITH_OPENSSL
+TEST_F(EncryptionTest, RejectsModifiedData) {
+  auto plain = random(2 * CHUNK + 100);
+  auto cipher = aes_encryption(plain, key_);
+  auto rejected = [this](const std::string& data) {
+    EXPECT_THROW(aes_decryption(data, key_), std::runtime_error);
+    EXPECT_THROW(decrypt_stream(data), std::runtime_error);
+  };
+  // a flipped bit in a chunk, in a tag and in the header
+  for (auto pos : {HEADER + CHUNK + 7, HEADER + CHUNK + 1, size_t(17)}) {
+    SCOPED_TRACE("pos=" + std::to_string(pos));
+    auto data = cipher;
+    data[pos] ^= 1;
+    rejected(data);
+  }
+  // the first two chunks swapped
+  auto stride = CHUNK + TAG;
+  auto swapped = cipher;
+  std::swap_ranges(swapped.begin() + HEADER, swapped.begin() + HEADER + stride,
+                   swapped.begin() + HEADER + stride);
+  rejected(swapped);
+  // truncated, in the last chunk and at a chunk boundary
+  rejected(cipher.substr(0, cipher.size() - 1));
+  rejected(cipher.substr(0, HEADER + 2 * stride));
+  // trailing bytes
+  rejected(cipher + "x");
+  // another key
+  EXPECT_THROW(
+      aes_decryption(cipher, "fedcba9876543210fedcba9876543210"),
+      std::runtime_error);
+}
+
+TEST_F(EncryptionTest, RejectsHugeSize) {
+  // a header that claims more data than there is must fail on reading,
+  // not on allocating the claimed size.
+  auto cipher = aes_encryption(random(100), key_);
+  for (auto i = 0; i < 7; ++i) {
+    cipher[16 + i] = (char)0xff;
+  }
+  EXPECT_THROW(aes_decryption(cipher, key_), std::runtime_error);
+  EXPECT_THROW(decrypt_stream(cipher), std::runtime_error);
+}
+
+TEST_F(EncryptionTest, LegacyEcb) {
+  // caches written by older versions: AES-256-ECB without a header.
+  auto plain = random(5000);
+  auto cipher = std::string(plain.size() + 32, '\0');
+  auto ctx = EVP_CIPHER_CTX_new();
+  int len = 0;
+  int total = 0;
+  ASSERT_EQ(EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), nullptr,
+                               (const unsigned char*)key_.data(), nullptr),
+            1);
+  ASSERT_EQ(EVP_EncryptUpdate(ctx, (unsigned char*)&cipher[0], &len,
+                              (const unsigned char*)plain.data(),
+                              (int)plain.size()),
+            1);
+  total = len;
+  ASSERT_EQ(EVP_EncryptFinal_ex(ctx, (unsigned char*)&cipher[total], &len), 1);
+  EVP_CIPHER_CTX_free(ctx);
+  cipher.resize(total + len);
+  EXPECT_EQ(aes_decryption(cipher, key_), plain);
+  EXPECT_EQ(decrypt_stream(cipher, 100), plain);
+}
+#endif
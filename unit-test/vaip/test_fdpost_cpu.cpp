@@ -0,0 +1,129 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "../vaip_custom_op_decode_filter_boxes/src/fdpost_cpu.hpp"
+#include "debug_logger.hpp"
+#include <array>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace vaip_decode_filter_boxes_custom_op;
+class FdPostCpuTest : public DebugLogger {
+protected:
+  std::vector<float> random(size_t size, float lo, float hi) {
+    auto dist = std::uniform_real_distribution<float>(lo, hi);
+    auto ret = std::vector<float>(size);
+    for (auto& x : ret) {
+      x = dist(rng_);
+    }
+    return ret;
+  }
+
+  std::vector<std::array<float, 4>> anchors(size_t n) {
+    auto pos = std::uniform_real_distribution<float>(0.0f, 1.0f);
+    auto size = std::uniform_real_distribution<float>(0.05f, 0.5f);
+    auto ret = std::vector<std::array<float, 4>>(n);
+    for (auto& a : ret) {
+      a = {pos(rng_), pos(rng_), size(rng_), size(rng_)};
+    }
+    return ret;
+  }
+
+  // the scalar loops the op had before FdPostCpu: every anchor with a
+  // score >= threshold, decoded with std::exp.
+  void check(const std::vector<std::array<float, 4>>& anchors,
+             const std::vector<float>& boxes, size_t box_dims,
+             const std::vector<float>& scores, size_t num_classes) {
+    auto fdpost = FdPostCpu(anchors, THRESHOLD);
+    auto out = DecodedBoxes();
+    fdpost.run(boxes.data(), box_dims, scores.data(), num_classes, out);
+    auto k = 0u;
+    for (auto i = 0u; i < anchors.size(); ++i) {
+      auto kept = false;
+      for (auto c = 0u; c < num_classes; ++c) {
+        kept = kept || scores[i * num_classes + c] >= THRESHOLD;
+      }
+      if (!kept) {
+        continue;
+      }
+      ASSERT_LT(k, out.size) << "anchor " << i << " not kept";
+      ASSERT_EQ(out.index[k], i);
+      auto& a = anchors[i];
+      auto b = boxes.data() + i * box_dims;
+      auto ycenter = (b[0] / 10.0f) * a[2] + a[0];
+      auto xcenter = (b[1] / 10.0f) * a[3] + a[1];
+      auto half_h = 0.5f * std::exp(b[2] / 5.0f) * a[2];
+      auto half_w = 0.5f * std::exp(b[3] / 5.0f) * a[3];
+      // the vectorized exp is within ~2e-7 of std::exp
+      EXPECT_NEAR(out.ymin[k], ycenter - half_h, 1e-5f) << "anchor " << i;
+      EXPECT_NEAR(out.xmin[k], xcenter - half_w, 1e-5f) << "anchor " << i;
+      EXPECT_NEAR(out.ymax[k], ycenter + half_h, 1e-5f) << "anchor " << i;
+      EXPECT_NEAR(out.xmax[k], xcenter + half_w, 1e-5f) << "anchor " << i;
+      ++k;
+    }
+    EXPECT_EQ(out.size, k);
+  }
+
+  static constexpr float THRESHOLD = 0.5f;
+  std::mt19937 rng_{3};
+};
+
+TEST_F(FdPostCpuTest, SelectAndDecode) {
+  // counts of scores and of kept anchors around the batches of 8, so that
+  // both the vectorized loops and their scalar tails run.
+  for (auto n : {size_t(1), size_t(7), size_t(8), size_t(29), size_t(300)}) {
+    for (auto num_classes : {size_t(1), size_t(2), size_t(3)}) {
+      SCOPED_TRACE("n=" + std::to_string(n) +
+                   " num_classes=" + std::to_string(num_classes));
+      auto box_dims = size_t(10);
+      check(anchors(n), random(n * box_dims, -4.0f, 4.0f), box_dims,
+            random(n * num_classes, 0.0f, 1.0f), num_classes);
+    }
+  }
+}
+
+TEST_F(FdPostCpuTest, ScoresAtThreshold) {
+  // a score equal to the threshold is kept, an anchor hit by several
+  // classes is kept once.
+  auto scores = std::vector<float>{
+      THRESHOLD, 0.0f, //
+      0.9f,      0.9f, //
+      0.4999f,   0.0f, //
+      0.0f,      THRESHOLD,
+  };
+  check(anchors(4), random(4 * 4, -1.0f, 1.0f), 4, scores, 2);
+}
+
+TEST_F(FdPostCpuTest, CompactsParts) {
+  // with 91 classes a part is ~180 anchors, i.e. the scan is split over
+  // the thread pool. Some parts keep nothing, others everything.
+  const auto n = size_t(5000);
+  const auto num_classes = size_t(91);
+  auto scores = random(n * num_classes, 0.0f, 0.502f);
+  for (auto i = 0u; i < n; ++i) {
+    auto region = i / 700;
+    for (auto c = 0u; c < num_classes; ++c) {
+      auto& s = scores[i * num_classes + c];
+      if (region % 3 == 1) {
+        s = 0.0f;
+      } else if (region % 3 == 2 && c == 0) {
+        s = 1.0f;
+      }
+    }
+  }
+  check(anchors(n), random(n * 4, -4.0f, 4.0f), 4, scores, num_classes);
+}
+
+TEST_F(FdPostCpuTest, NothingKept) {
+  auto out = DecodedBoxes();
+  auto fdpost = FdPostCpu(anchors(100), THRESHOLD);
+  auto scores = std::vector<float>(100 * 2, 0.1f);
+  auto boxes = random(100 * 4, -1.0f, 1.0f);
+  fdpost.run(boxes.data(), 4, scores.data(), 2, out);
+  EXPECT_EQ(out.size, 0u);
+}
@@ -5,13 +5,17 @@
 
 #include "debug_logger.hpp"
 #include "unit_test_env_params.hpp"
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <limits>
+#include <memory>
 //
 #include "vaip/vaip.hpp"
+//
+#include "../vaip/src/fuse_analysis.hpp"
 class GraphTest : public DebugLogger {};
 
 TEST_F(GraphTest, LoadAndSave) {
@@ -237,6 +241,172 @@ TEST_F(GraphTest, TryFuse) {
   LOG(INFO) << " fused_node=" << meta_def->DebugString();
 }
 
+static std::unique_ptr<vaip_core::IPass>
+create_test_pass(const std::string& name) {
+  std::shared_ptr<vaip_core::PassContext> context =
+      vaip_core::PassContext::create();
+  auto pass_proto = vaip_core::PassProto();
+  pass_proto.set_plugin("vaip-pass_init");
+  pass_proto.set_name(name);
+  return vaip_core::IPass::create_pass(context, pass_proto);
+}
+
+static bool contains(const google::protobuf::RepeatedPtrField<std::string>& v,
+                     const std::string& name) {
+  return std::find(v.begin(), v.end(), name) != v.end();
+}
+
+TEST_F(GraphTest, TryFuseByIds) {
+  auto model = vaip_cxx::Model::load(RESNET_50_PATH);
+  auto graph = model->main_graph();
+  graph.resolve();
+  auto input = vaip_core::graph_find_node_arg_id(graph, "111");
+  auto output = vaip_core::graph_find_node_arg_id(graph, "138");
+  ASSERT_TRUE(input.has_value());
+  ASSERT_TRUE(output.has_value());
+  EXPECT_FALSE(vaip_core::graph_find_node_arg_id(graph, "no_such_node_arg")
+                   .has_value());
+  EXPECT_EQ(vaip_core::node_arg_get_name(
+                *vaip_core::graph_get_node_arg_by_id(graph, *output)),
+            "138");
+  auto [by_name, error] = vaip_core::IPass_try_fuse(graph, "a_name", {"111"},
+                                                    {"138"}, {}, "NPU");
+  ASSERT_TRUE(by_name != nullptr) << error.comments;
+  auto inputs = std::vector<vaip_core::NodeArgId>{*input};
+  auto outputs = std::vector<vaip_core::NodeArgId>{*output};
+  auto [by_id, error_by_id] =
+      vaip_core::IPass_try_fuse(graph, "a_name", inputs, outputs, {}, "NPU");
+  ASSERT_TRUE(by_id != nullptr) << error_by_id.comments;
+  EXPECT_EQ(by_id->DebugString(), by_name->DebugString());
+}
+
+// a node added with NodeBuilder marks the table stale, the next lookup
+// refreshes it and the ids handed out before stay the same.
+TEST_F(GraphTest, TryFuseByIdsAfterNodeBuilder) {
+  auto model = vaip_cxx::Model::load(RESNET_50_PATH);
+  auto graph = model->main_graph();
+  graph.resolve();
+  auto pass = create_test_pass("GraphTest.TryFuseByIdsAfterNodeBuilder");
+  auto id_111 = vaip_core::graph_find_node_arg_id(graph, "111");
+  auto id_138 = vaip_core::graph_find_node_arg_id(graph, "138");
+  ASSERT_TRUE(id_111.has_value());
+  ASSERT_TRUE(id_138.has_value());
+  auto& arg_138 = *vaip_core::graph_get_node_arg_by_id(graph, *id_138);
+  auto shape = *vaip_core::node_arg_get_shape_i64(arg_138);
+
+  auto& relu = vaip_core::NodeBuilder(graph, *pass)
+                   .set_input_node_args({&arg_138})
+                   .set_op_type("Relu", "")
+                   .set_anchor_point4(arg_138, {"Relu"}, shape, "float32")
+                   .build();
+  auto& relu_output = vaip_core::node_get_output_node_arg(relu);
+  auto relu_output_name = vaip_core::node_arg_get_name(relu_output);
+
+  auto id_relu = vaip_core::graph_find_node_arg_id(graph, relu_output_name);
+  ASSERT_TRUE(id_relu.has_value());
+  EXPECT_EQ(vaip_core::graph_find_node_arg_id(graph, relu_output), id_relu);
+  EXPECT_EQ(vaip_core::graph_find_node_arg_id(graph, "111"), id_111);
+  EXPECT_EQ(vaip_core::graph_find_node_arg_id(graph, "138"), id_138);
+  EXPECT_NE(*id_relu, *id_111);
+  EXPECT_NE(*id_relu, *id_138);
+  EXPECT_EQ(vaip_core::graph_get_producer_node_by_id(graph, *id_relu), &relu);
+  auto consumers = vaip_core::graph_get_consumer_nodes_by_id(graph, *id_138);
+  EXPECT_NE(std::find(consumers.begin(), consumers.end(), &relu),
+            consumers.end());
+
+  auto inputs = std::vector<vaip_core::NodeArgId>{*id_138};
+  auto outputs = std::vector<vaip_core::NodeArgId>{*id_relu};
+  auto [meta_def, error] =
+      vaip_core::IPass_try_fuse(graph, "a_name", inputs, outputs, {}, "NPU");
+  ASSERT_TRUE(meta_def != nullptr) << error.comments;
+  EXPECT_TRUE(contains(meta_def->inputs(), "138"));
+  EXPECT_TRUE(contains(meta_def->outputs(), relu_output_name));
+  EXPECT_TRUE(contains(meta_def->nodes(), relu_output_name));
+}
+
+// a node added through the ORT API directly does not mark the table
+// stale: the name based try_fuse finds out that its output is unknown.
+TEST_F(GraphTest, TryFuseAfterNodeAddedWithoutResolve) {
+  auto model = vaip_cxx::Model::load(RESNET_50_PATH);
+  auto graph = model->main_graph();
+  graph.resolve();
+  auto id_138 = vaip_core::graph_find_node_arg_id(graph, "138");
+  ASSERT_TRUE(id_138.has_value());
+  auto& arg_138 = *vaip_core::graph_get_node_arg_by_id(graph, *id_138);
+  auto shape = *vaip_core::node_arg_get_shape_i64(arg_138);
+  auto& output = VAIP_ORT_API(node_arg_new)(
+      graph, "test_relu", &shape,
+      vaip_core::node_arg_get_element_type(arg_138));
+  auto attrs = vaip_core::NodeAttributesBuilder().build();
+  VAIP_ORT_API(graph_add_node)
+  (graph, "test_relu", "Relu", "", {&arg_138}, {&output}, *attrs, "");
+
+  auto [meta_def, error] = vaip_core::IPass_try_fuse(
+      graph, "a_name", {"138"}, {"test_relu"}, {}, "NPU");
+  ASSERT_TRUE(meta_def != nullptr) << error.comments;
+  EXPECT_TRUE(contains(meta_def->nodes(), "test_relu"));
+  EXPECT_EQ(vaip_core::graph_find_node_arg_id(graph, "138"), id_138);
+}
+
+// an island added through the ORT API directly is only seen when the fuse
+// walks the body, the table is refreshed then.
+TEST_F(GraphTest, TryFuseByIdsWithNewIsland) {
+  auto model = vaip_cxx::Model::load(RESNET_50_PATH);
+  auto graph = model->main_graph();
+  graph.resolve();
+  auto id_111 = vaip_core::graph_find_node_arg_id(graph, "111");
+  auto id_126 = vaip_core::graph_find_node_arg_id(graph, "126");
+  auto id_138 = vaip_core::graph_find_node_arg_id(graph, "138");
+  ASSERT_TRUE(id_111.has_value());
+  ASSERT_TRUE(id_126.has_value());
+  ASSERT_TRUE(id_138.has_value());
+  // consumes a node arg inside the fused body, nothing consumes its output.
+  auto& arg_126 = *vaip_core::graph_get_node_arg_by_id(graph, *id_126);
+  auto shape = *vaip_core::node_arg_get_shape_i64(arg_126);
+  auto& output = VAIP_ORT_API(node_arg_new)(
+      graph, "test_island", &shape,
+      vaip_core::node_arg_get_element_type(arg_126));
+  auto attrs = vaip_core::NodeAttributesBuilder().build();
+  VAIP_ORT_API(graph_add_node)
+  (graph, "test_island", "Relu", "", {&arg_126}, {&output}, *attrs, "");
+
+  auto inputs = std::vector<vaip_core::NodeArgId>{*id_111};
+  auto outputs = std::vector<vaip_core::NodeArgId>{*id_138};
+  auto [meta_def, error] =
+      vaip_core::IPass_try_fuse(graph, "a_name", inputs, outputs, {}, "NPU");
+  ASSERT_TRUE(meta_def != nullptr) << error.comments;
+  EXPECT_TRUE(contains(meta_def->nodes(), "test_island"));
+  EXPECT_TRUE(contains(meta_def->outputs(), "138"));
+  EXPECT_EQ(vaip_core::graph_find_node_arg_id(graph, "111"), id_111);
+  EXPECT_EQ(vaip_core::graph_find_node_arg_id(graph, "138"), id_138);
+}
+
+// the fuse analysis is kept while the graph does not change, and is
+// dropped by a resolve and with the model, so a graph created later at the
+// same address never sees it.
+TEST_F(GraphTest, FuseAnalysisLifetime) {
+  using vaip_core::FuseAnalysis;
+  auto model = vaip_cxx::Model::load(RESNET_50_PATH);
+  auto graph = model->main_graph();
+  graph.resolve();
+  auto analysis = FuseAnalysis::get(graph);
+  EXPECT_EQ(FuseAnalysis::get(graph), analysis);
+  auto [meta_def, error] =
+      vaip_core::IPass_try_fuse(graph, "a_name", {"111"}, {"138"}, {}, "NPU");
+  ASSERT_TRUE(meta_def != nullptr) << error.comments;
+  EXPECT_EQ(FuseAnalysis::get(graph), analysis);
+
+  auto weak = std::weak_ptr<const FuseAnalysis>(analysis);
+  analysis = nullptr;
+  graph.resolve();
+  EXPECT_TRUE(weak.expired());
+
+  weak = FuseAnalysis::get(graph);
+  EXPECT_FALSE(weak.expired());
+  model = nullptr;
+  EXPECT_TRUE(weak.expired());
+}
+
 TEST_F(GraphTest, NewConstantInitializer) {
   LOG(INFO) << "LOADING " << ENV_PARAM(SAMPLE_ONNX) << std::endl;
   auto model = vaip_cxx::Model::load(ENV_PARAM(SAMPLE_ONNX));
@@ -0,0 +1,200 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "packed_weights/packed_weights.hpp"
+#include "debug_logger.hpp"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace vaip_packed_weights;
+class PackedWeightsTest : public DebugLogger {
+protected:
+  void SetUp() override {
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_);
+  }
+
+  // MatMulNBits constants of [k, n], with random content.
+  struct Constants {
+    std::vector<uint8_t> weights;
+    std::vector<float> scales;
+    std::vector<uint8_t> zero_points;
+    MatMulNBitsSource src;
+  };
+
+  std::unique_ptr<Constants> constants(int64_t k, int64_t n, bool asym) {
+    auto ret = std::make_unique<Constants>();
+    auto& src = ret->src;
+    src.k = k;
+    src.n = n;
+    auto dist = std::uniform_int_distribution<int>(0, 255);
+    ret->weights.resize(k * n / 2);
+    for (auto& x : ret->weights) {
+      x = (uint8_t)dist(rng_);
+    }
+    ret->scales.resize(src.blocks() * n);
+    for (auto& x : ret->scales) {
+      x = (float)dist(rng_) / 1024.0f;
+    }
+    src.weights = ret->weights.data();
+    src.scales = ret->scales.data();
+    if (asym) {
+      ret->zero_points.resize(src.zero_point_bytes());
+      for (auto& x : ret->zero_points) {
+        x = (uint8_t)dist(rng_);
+      }
+      src.zero_points = ret->zero_points.data();
+    }
+    return ret;
+  }
+
+  // the loops the ops had before packed_weights, e.g. in gqo.
+  static void check_packed(const MatMulNBitsSource& src,
+                           const MatMulNBits& packed) {
+    auto k = src.k;
+    auto n = src.n;
+    auto kblks = k / src.block_size;
+    auto zp_shape = (int64_t)(n * std::floor((float)((kblks + 1) * 4) / 8.0f));
+    auto wts = static_cast<const uint8_t*>(src.weights);
+    auto b = std::vector<int8_t>(k * n);
+    for (int64_t i = 0; i < k; i += 2) {
+      for (int64_t j = 0; j < n; j++) {
+        auto srcv = wts[j * k / 2 + i / 2];
+        b[i * n + j] = (srcv & 0xf) - 8;
+        b[(i + 1) * n + j] = ((srcv & 0xf0) >> 4) - 8;
+      }
+    }
+    auto scales = std::vector<float>(kblks * n);
+    for (int64_t i = 0; i < n; i++) {
+      for (int64_t j = 0; j < kblks; j++) {
+        scales[j * n + i] = src.scales[i * kblks + j];
+      }
+    }
+    auto zeros = std::vector<int8_t>(2 * zp_shape, 0);
+    if (src.zero_points != nullptr) {
+      auto zp = static_cast<const uint8_t*>(src.zero_points);
+      auto kblks_pad = 2 * zp_shape / n;
+      for (int64_t i = 0; i < n; i++) {
+        for (int64_t j = 0; j < kblks_pad; j = j + 2) {
+          auto zpv = zp[(i * kblks_pad) / 2 + j / 2];
+          zeros[j * n + i] = (zpv & 0xf) - 8;
+          zeros[(j + 1) * n + i] = ((zpv & 0xf0) >> 4) - 8;
+        }
+      }
+    }
+    EXPECT_EQ(packed.k, k);
+    EXPECT_EQ(packed.n, n);
+    EXPECT_EQ(std::vector<int8_t>(packed.weights, packed.weights + b.size()),
+              b);
+    EXPECT_EQ(std::vector<float>(packed.scales, packed.scales + scales.size()),
+              scales);
+    EXPECT_EQ(std::vector<int8_t>(packed.zeros, packed.zeros + zeros.size()),
+              zeros);
+  }
+
+  std::vector<std::filesystem::path> files() const {
+    auto ret = std::vector<std::filesystem::path>();
+    for (auto& e : std::filesystem::directory_iterator(dir_)) {
+      ret.push_back(e.path());
+    }
+    return ret;
+  }
+
+  std::mt19937 rng_{11};
+  std::filesystem::path dir_ = CMAKE_CURRENT_BINARY_PATH / "packed_weights";
+};
+
+TEST_F(PackedWeightsTest, Pack) {
+  // an odd number of blocks pads the zero points, a large k splits the
+  // weights over the thread pool.
+  struct Case {
+    int64_t k, n;
+  };
+  for (auto c : {Case{64, 48}, Case{96, 24}, Case{4096, 40}}) {
+    for (auto asym : {false, true}) {
+      SCOPED_TRACE("k=" + std::to_string(c.k) + " n=" + std::to_string(c.n) +
+                   " asym=" + std::to_string(asym));
+      auto w = constants(c.k, c.n, asym);
+      auto packed = get_matmul_nbits(w->src, std::filesystem::path());
+      check_packed(w->src, *packed);
+    }
+  }
+}
+
+TEST_F(PackedWeightsTest, SharedWhileAlive) {
+  auto w = constants(64, 32, true);
+  auto p1 = get_matmul_nbits(w->src, std::filesystem::path());
+  auto p2 = get_matmul_nbits(w->src, std::filesystem::path());
+  EXPECT_EQ(p1, p2);
+  // other constants are another key
+  auto other = constants(64, 32, true);
+  EXPECT_NE(get_matmul_nbits(other->src, std::filesystem::path()), p1);
+
+  auto weak = std::weak_ptr<const MatMulNBits>(p1);
+  p1 = nullptr;
+  p2 = nullptr;
+  EXPECT_TRUE(weak.expired());
+  // packed again after the last user released it
+  auto p3 = get_matmul_nbits(w->src, std::filesystem::path());
+  check_packed(w->src, *p3);
+}
+
+TEST_F(PackedWeightsTest, DirRoundTrip) {
+  auto w = constants(64, 32, true);
+  auto p1 = get_matmul_nbits(w->src, dir_);
+  check_packed(w->src, *p1);
+  auto saved = files();
+  ASSERT_EQ(saved.size(), 1u) << "one file, no temporary left";
+  auto file = saved[0];
+  EXPECT_EQ(file.extension(), ".bin");
+  EXPECT_EQ(std::filesystem::file_size(file), p1->size);
+  p1 = nullptr;
+
+  // a new session maps the file instead of packing: a byte changed in the
+  // file shows up in the result.
+  auto offset = (size_t)(sizeof(detail::Header) +
+                         w->src.blocks() * w->src.n * sizeof(float));
+  {
+    auto f = std::fstream(file, std::ios::binary | std::ios::in |
+                                    std::ios::out);
+    f.seekp(offset);
+    f.put((char)100);
+  }
+  auto p2 = get_matmul_nbits(w->src, dir_);
+  EXPECT_EQ(p2->weights[0], 100);
+  EXPECT_EQ(p2->data + offset, (const uint8_t*)p2->weights);
+}
+
+TEST_F(PackedWeightsTest, RejectsCorruptFiles) {
+  auto w = constants(64, 32, false);
+  auto other = constants(64, 32, false);
+  get_matmul_nbits(other->src, dir_);
+  auto other_file = files().at(0);
+  get_matmul_nbits(w->src, dir_);
+  auto file = files().at(0) == other_file ? files().at(1) : files().at(0);
+  auto size = std::filesystem::file_size(file);
+
+  // truncated
+  std::filesystem::resize_file(file, size - 2);
+  check_packed(w->src, *get_matmul_nbits(w->src, dir_));
+  // ... and written again
+  EXPECT_EQ(std::filesystem::file_size(file), size);
+
+  // the file of other constants of the same size
+  std::filesystem::copy_file(other_file, file,
+                             std::filesystem::copy_options::overwrite_existing);
+  check_packed(w->src, *get_matmul_nbits(w->src, dir_));
+
+  // not a packed weights file at all
+  std::ofstream(file, std::ios::binary | std::ios::trunc) << "garbage";
+  check_packed(w->src, *get_matmul_nbits(w->src, dir_));
+  EXPECT_EQ(std::filesystem::file_size(file), size);
+}
@@ -0,0 +1,182 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "inst_gen/pp_instr_cache.hpp"
+#include "debug_logger.hpp"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Stands in for the pp instruction compilers: rtps[0] words derived from
+// rtps[1], and the number of words written back to rtps[2]. Every ID is a
+// separate type, so it has its own memo in generate_cached().
+template <int ID, std::uint32_t V = 1> class FakeCompiler {
+public:
+  static constexpr std::uint32_t COMMON_VERSION = 1;
+  static constexpr std::uint32_t VERSION = V;
+  explicit FakeCompiler(std::uint32_t* instr_buffer) : buf_{instr_buffer} {}
+  int generate(std::uint16_t* rtps) {
+    runs++;
+    for (auto i = 0; i < rtps[0]; ++i) {
+      buf_[i] = rtps[1] * 1000u + i + salt;
+    }
+    rtps[2] = rtps[0];
+    return rtps[0];
+  }
+  static inline int runs = 0;
+  // changes the words, as a change of the generator code would.
+  static inline std::uint32_t salt = 0;
+
+private:
+  std::uint32_t* buf_;
+};
+
+class PpInstrCacheTest : public DebugLogger {
+protected:
+  void SetUp() override {
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_);
+  }
+
+  template <class Compiler>
+  std::vector<std::uint32_t> generate(const std::string& name,
+                                      std::vector<std::uint16_t>& rtps,
+                                      const std::filesystem::path& dir = {},
+                                      bool check = false) {
+    auto instr = std::vector<std::uint32_t>(64, 0xdeadbeef);
+    auto n = IC::generate_cached<Compiler>(name, rtps.data(), rtps.size(),
+                                           instr.data(), instr.size(), dir,
+                                           check);
+    instr.resize(n);
+    return instr;
+  }
+
+  template <class Compiler>
+  std::filesystem::path file_of(const std::string& name,
+                                const std::vector<std::uint16_t>& rtps) {
+    std::ostringstream str;
+    str << name << "_" << std::hex << std::setw(16) << std::setfill('0')
+        << IC::detail::hash_rtps(name,
+                                 IC::detail::compiler_version<Compiler>(),
+                                 rtps.data(), rtps.size())
+        << ".instr";
+    return dir_ / str.str();
+  }
+
+  static std::vector<std::uint32_t> expected(std::uint16_t n,
+                                             std::uint16_t v) {
+    auto ret = std::vector<std::uint32_t>();
+    for (auto i = 0; i < n; ++i) {
+      ret.push_back(v * 1000u + i);
+    }
+    return ret;
+  }
+
+  std::filesystem::path dir_ = CMAKE_CURRENT_BINARY_PATH / "pp_instr_cache";
+};
+
+TEST_F(PpInstrCacheTest, MemoHit) {
+  using C = FakeCompiler<0>;
+  auto rtps = std::vector<std::uint16_t>{5, 7, 0};
+  EXPECT_EQ(generate<C>("fake", rtps), expected(5, 7));
+  EXPECT_EQ(rtps[2], 5);
+  EXPECT_EQ(C::runs, 1);
+
+  // the rtps the compiler updated are restored on a hit too.
+  rtps = {5, 7, 0};
+  EXPECT_EQ(generate<C>("fake", rtps), expected(5, 7));
+  EXPECT_EQ(rtps[2], 5);
+  EXPECT_EQ(C::runs, 1);
+
+  // another configuration, or another name, is generated.
+  rtps = {3, 7, 0};
+  EXPECT_EQ(generate<C>("fake", rtps), expected(3, 7));
+  rtps = {5, 7, 0};
+  EXPECT_EQ(generate<C>("other", rtps), expected(5, 7));
+  EXPECT_EQ(C::runs, 3);
+}
+
+TEST_F(PpInstrCacheTest, FileRoundTrip) {
+  auto rtps = std::vector<std::uint16_t>{6, 2, 0};
+  EXPECT_EQ(generate<FakeCompiler<1>>("fake", rtps, dir_), expected(6, 2));
+  EXPECT_TRUE(
+      std::filesystem::exists(file_of<FakeCompiler<1>>("fake", {6, 2, 0})));
+  EXPECT_EQ(FakeCompiler<1>::runs, 1);
+
+  // a new process, i.e. an empty memo, reads the file.
+  rtps = {6, 2, 0};
+  EXPECT_EQ(generate<FakeCompiler<2>>("fake", rtps, dir_), expected(6, 2));
+  EXPECT_EQ(rtps[2], 6);
+  EXPECT_EQ(FakeCompiler<2>::runs, 0);
+}
+
+TEST_F(PpInstrCacheTest, RejectsCorruptFiles) {
+  auto rtps = std::vector<std::uint16_t>{4, 3, 0};
+  generate<FakeCompiler<3>>("fake", rtps, dir_);
+  auto file = file_of<FakeCompiler<3>>("fake", {4, 3, 0});
+  auto size = std::filesystem::file_size(file);
+
+  // truncated
+  std::filesystem::resize_file(file, size - 2);
+  rtps = {4, 3, 0};
+  EXPECT_EQ(generate<FakeCompiler<4>>("fake", rtps, dir_), expected(4, 3));
+  EXPECT_EQ(FakeCompiler<4>::runs, 1);
+  // ... and written again
+  EXPECT_EQ(std::filesystem::file_size(file), size);
+
+  // trailing bytes
+  std::ofstream(file, std::ios::binary | std::ios::app) << "xx";
+  rtps = {4, 3, 0};
+  generate<FakeCompiler<5>>("fake", rtps, dir_);
+  EXPECT_EQ(FakeCompiler<5>::runs, 1);
+
+  // not a cache file at all
+  std::ofstream(file, std::ios::binary | std::ios::trunc) << "garbage";
+  rtps = {4, 3, 0};
+  EXPECT_EQ(generate<FakeCompiler<6>>("fake", rtps, dir_), expected(4, 3));
+  EXPECT_EQ(FakeCompiler<6>::runs, 1);
+}
+
+TEST_F(PpInstrCacheTest, RejectsOtherVersion) {
+  using V1 = FakeCompiler<7, 1>;
+  using V2 = FakeCompiler<7, 2>;
+  auto rtps = std::vector<std::uint16_t>{4, 1, 0};
+  generate<V1>("fake", rtps, dir_);
+  // the version changes the file name ...
+  EXPECT_NE(file_of<V1>("fake", {4, 1, 0}), file_of<V2>("fake", {4, 1, 0}));
+  // ... and is checked on load, in case of a hash collision.
+  std::filesystem::copy_file(file_of<V1>("fake", {4, 1, 0}),
+                             file_of<V2>("fake", {4, 1, 0}));
+  rtps = {4, 1, 0};
+  generate<V2>("fake", rtps, dir_);
+  EXPECT_EQ(V2::runs, 1);
+
+  // the same holds for the name.
+  std::filesystem::copy_file(file_of<V1>("fake", {4, 1, 0}),
+                             file_of<V1>("fake2", {4, 1, 0}));
+  rtps = {4, 1, 0};
+  generate<V1>("fake2", rtps, dir_);
+  EXPECT_EQ(V1::runs, 2);
+}
+
+TEST_F(PpInstrCacheTest, CheckMode) {
+  using C = FakeCompiler<8>;
+  auto rtps = std::vector<std::uint16_t>{5, 9, 0};
+  generate<C>("fake", rtps, dir_);
+  // an up to date stream passes, the compiler runs to compare.
+  rtps = {5, 9, 0};
+  EXPECT_EQ(generate<C>("fake", rtps, dir_, true), expected(5, 9));
+  EXPECT_EQ(C::runs, 2);
+  // a stale one is reported with the first difference.
+  C::salt = 1;
+  rtps = {5, 9, 0};
+  EXPECT_DEATH(generate<C>("fake", rtps, dir_, true),
+               "stale, first difference at word 0 of 5");
+  C::salt = 0;
+}
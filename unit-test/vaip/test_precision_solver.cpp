@@ -0,0 +1,147 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "debug_logger.hpp"
+#include "unit_test_env_params.hpp"
+#include <filesystem>
+#include <fstream>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <limits>
+//
+#include "../../vaip_pass_dd_merge_dtype/src/precision_solver.h"
+#include "vaip/vaip.hpp"
+
+// The DD ops are built on top of the sample model, whose "input" is the
+// activation of the first op; the solver only looks at op types, in_dtypes,
+// out_dtypes and the edges between them.
+class PrecisionSolverTest : public DebugLogger {
+protected:
+  void SetUp() override {
+    LOG(INFO) << "LOADING " << ENV_PARAM(SAMPLE_ONNX) << std::endl;
+    model_ = vaip_cxx::Model::load(ENV_PARAM(SAMPLE_ONNX));
+    graph_ = std::make_unique<vaip_cxx::GraphRef>(model_->main_graph());
+    graph_->resolve();
+    context_ = vaip_core::PassContext::create();
+    auto pass_proto = vaip_core::PassProto();
+    pass_proto.set_plugin("vaip-pass_init");
+    pass_proto.set_name("PrecisionSolverTest");
+    pass_ = vaip_core::IPass::create_pass(context_, pass_proto);
+    auto input = graph_->find_node_arg("input");
+    ASSERT_TRUE(input.has_value());
+    input_ = &static_cast<const vaip_core::NodeArg&>(input.value());
+  }
+
+  // a com.xilinx op of one output, a new activation of float32[2].
+  const vaip_core::Node*
+  add_op(const std::string& op_type,
+         const std::vector<const vaip_core::NodeArg*>& inputs,
+         const std::vector<std::string>& in_dtypes,
+         const std::vector<std::string>& out_dtypes) {
+    auto& node = vaip_core::NodeBuilder(*graph_, *pass_)
+                     .set_input_node_args(inputs)
+                     .set_op_type(op_type, "com.xilinx")
+                     .add("in_dtypes", in_dtypes)
+                     .add("out_dtypes", out_dtypes)
+                     .set_anchor_point4(*input_, {op_type}, {2}, "float32")
+                     .build();
+    return &node;
+  }
+
+  static const vaip_core::NodeArg* output_of(const vaip_core::Node* node) {
+    return &vaip_core::node_get_output_node_arg(*node);
+  }
+
+  std::map<const vaip_core::Node*, vaip::dtype_util::PrecisionSolver::Dtypes>
+  solve(const std::vector<const vaip_core::Node*>& free_ops) {
+    graph_->resolve();
+    auto solver = vaip::dtype_util::PrecisionSolver(
+        *graph_, vaip::dtype_util::CONVERSION_COST, "uint16");
+    for (auto node : free_ops) {
+      auto rule = vaip::dtype_util::get_dd_dtype_rule(*node);
+      EXPECT_TRUE(rule.has_value());
+      solver.add_op(node, *rule);
+    }
+    return solver.solve();
+  }
+
+  using Dtypes = std::vector<std::string>;
+
+  std::unique_ptr<vaip_cxx::Model> model_;
+  std::unique_ptr<vaip_cxx::GraphRef> graph_;
+  std::shared_ptr<vaip_core::PassContext> context_;
+  std::unique_ptr<vaip_core::IPass> pass_;
+  const vaip_core::NodeArg* input_ = nullptr;
+};
+
+TEST_F(PrecisionSolverTest, Chain) {
+  // add -> layernorm: the add produces bfloat16 for 1 instead of the
+  // layernorm dequantizing for 4 or a conversion for 8.
+  auto add = add_op("QEltWiseAdd", {input_, input_}, {"uint16", "uint16"},
+                    {"uint16"});
+  auto ln = add_op("QLayerNorm", {output_of(add)}, {"uint16"}, {"uint16"});
+  auto dtypes = solve({add, ln});
+  ASSERT_EQ(dtypes.size(), 2u);
+  EXPECT_EQ(dtypes[add].in_dtypes, (Dtypes{"uint16", "uint16"}));
+  EXPECT_EQ(dtypes[add].out_dtypes, (Dtypes{"bfloat16"}));
+  EXPECT_EQ(dtypes[ln].in_dtypes, (Dtypes{"bfloat16"}));
+  // not a port of the rule, kept.
+  EXPECT_EQ(dtypes[ln].out_dtypes, (Dtypes{"uint16"}));
+}
+
+TEST_F(PrecisionSolverTest, ChainBackToInteger) {
+  // a bfloat16 port with no reason for it goes back to the integer dtype.
+  auto add0 = add_op("QEltWiseAdd", {input_, input_}, {"uint16", "uint16"},
+                     {"bfloat16"});
+  auto add1 = add_op("QEltWiseAdd", {output_of(add0), input_},
+                     {"bfloat16", "uint16"}, {"uint16"});
+  auto dtypes = solve({add0, add1});
+  EXPECT_EQ(dtypes[add0].out_dtypes, (Dtypes{"uint16"}));
+  EXPECT_EQ(dtypes[add1].in_dtypes, (Dtypes{"uint16", "uint16"}));
+  EXPECT_EQ(dtypes[add1].out_dtypes, (Dtypes{"uint16"}));
+}
+
+TEST_F(PrecisionSolverTest, FanOut) {
+  // the add feeds a layernorm and a fixed uint16 consumer: bfloat16 would
+  // cost 1 and a conversion for 8, the layernorm dequantizes for 4.
+  auto add = add_op("QEltWiseAdd", {input_, input_}, {"uint16", "uint16"},
+                    {"uint16"});
+  auto ln = add_op("QLayerNorm", {output_of(add)}, {"uint16"}, {"uint16"});
+  auto mm = add_op("QMatMul", {output_of(add)}, {"uint16"}, {"uint16"});
+  auto dtypes = solve({add, ln});
+  ASSERT_EQ(dtypes.count(mm), 0u);
+  EXPECT_EQ(dtypes[add].out_dtypes, (Dtypes{"uint16"}));
+  EXPECT_EQ(dtypes[ln].in_dtypes, (Dtypes{"uint16"}));
+}
+
+TEST_F(PrecisionSolverTest, FanOutToLayerNorms) {
+  // two layernorms save 8 by dequantizing nothing, the add pays 1.
+  auto add = add_op("QEltWiseAdd", {input_, input_}, {"uint16", "uint16"},
+                    {"uint16"});
+  auto ln0 = add_op("QLayerNorm", {output_of(add)}, {"uint16"}, {"uint16"});
+  auto ln1 = add_op("QLayerNorm", {output_of(add)}, {"uint16"}, {"uint16"});
+  auto dtypes = solve({add, ln0, ln1});
+  EXPECT_EQ(dtypes[add].out_dtypes, (Dtypes{"bfloat16"}));
+  EXPECT_EQ(dtypes[ln0].in_dtypes, (Dtypes{"bfloat16"}));
+  EXPECT_EQ(dtypes[ln1].in_dtypes, (Dtypes{"bfloat16"}));
+}
+
+TEST_F(PrecisionSolverTest, FixedAnchors) {
+  // ops not added to the solver keep their dtypes and pull their free
+  // neighbours: a conversion costs more than an add in bfloat16.
+  auto gn = add_op("QGroupNorm", {input_}, {"uint16"}, {"bfloat16"});
+  auto add = add_op("QEltWiseAdd", {output_of(gn), input_},
+                    {"uint16", "uint16"}, {"uint16"});
+  auto mm = add_op("QMatMul", {output_of(add)}, {"bfloat16"}, {"uint16"});
+  auto dtypes = solve({add});
+  ASSERT_EQ(dtypes.size(), 1u);
+  EXPECT_EQ(dtypes[add].in_dtypes, (Dtypes{"bfloat16", "uint16"}));
+  EXPECT_EQ(dtypes[add].out_dtypes, (Dtypes{"bfloat16"}));
+  // the anchors themselves are untouched.
+  EXPECT_EQ(vaip_core::node_get_attr_strings(*gn, "out_dtypes"),
+            (Dtypes{"bfloat16"}));
+  EXPECT_EQ(vaip_core::node_get_attr_strings(*mm, "in_dtypes"),
+            (Dtypes{"bfloat16"}));
+}
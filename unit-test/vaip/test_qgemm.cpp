@@ -0,0 +1,227 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "qgemm/qgemm.hpp"
+#include "debug_logger.hpp"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace vaip_qgemm;
+class QgemmTest : public DebugLogger {
+protected:
+  // the ISAs the kernels of this cpu can run, SCALAR always.
+  static std::vector<Isa> targets() {
+    auto ret = std::vector<Isa>{Isa::SCALAR};
+    if (vaip_cpu::has_avx2()) {
+      ret.push_back(Isa::AVX2);
+    }
+    if (vaip_cpu::has_avx512_vnni()) {
+      ret.push_back(Isa::AVX512_VNNI);
+    }
+    return ret;
+  }
+
+  template <typename T> std::vector<T> random(size_t size, int lo, int hi) {
+    auto dist = std::uniform_int_distribution<int>(lo, hi);
+    auto ret = std::vector<T>(size);
+    for (auto& x : ret) {
+      x = static_cast<T>(dist(rng_));
+    }
+    return ret;
+  }
+
+  // (A - a_zp) x (B - b_zp), B taken with int8 wrap around like
+  // PackedWeights does.
+  template <typename AType>
+  static std::vector<int32_t> naive(const std::vector<AType>& a, int32_t a_zp,
+                                    const std::vector<int8_t>& b,
+                                    int32_t b_zp, int64_t M, int64_t K,
+                                    int64_t N) {
+    auto ret = std::vector<int32_t>(M * N, 0);
+    for (int64_t m = 0; m < M; ++m) {
+      for (int64_t n = 0; n < N; ++n) {
+        int32_t acc = 0;
+        for (int64_t k = 0; k < K; ++k) {
+          auto w = static_cast<int8_t>(b[k * N + n] - b_zp);
+          acc += (static_cast<int32_t>(a[m * K + k]) - a_zp) * w;
+        }
+        ret[m * N + n] = acc;
+      }
+    }
+    return ret;
+  }
+
+  static std::string name(Isa isa, int64_t M, int64_t K, int64_t N) {
+    return "isa=" + std::to_string((int)isa) + " M=" + std::to_string(M) +
+           " K=" + std::to_string(K) + " N=" + std::to_string(N);
+  }
+
+  std::mt19937 rng_{20240607};
+  // sizes around the k groups (2, 4) and the n blocks (8, 16).
+  const std::vector<int64_t> ms_ = {1, 3, 6, 7};
+  const std::vector<int64_t> ks_ = {1, 3, 4, 9, 64, 67};
+  const std::vector<int64_t> ns_ = {1, 7, 8, 16, 17, 40};
+};
+
+TEST_F(QgemmTest, ColumnSums) {
+  const int64_t K = 5, N = 3;
+  auto b = random<int8_t>(K * N, -128, 127);
+  auto sums = column_sums(b.data(), K, N);
+  ASSERT_EQ(sums.size(), (size_t)N);
+  for (int64_t n = 0; n < N; ++n) {
+    int32_t expected = 0;
+    for (int64_t k = 0; k < K; ++k) {
+      expected += b[k * N + n];
+    }
+    EXPECT_EQ(sums[n], expected) << "n=" << n;
+  }
+}
+
+TEST_F(QgemmTest, PackedColumnSums) {
+  const int64_t K = 19, N = 21;
+  const int32_t b_zp = 3;
+  auto b = random<int8_t>(K * N, -128, 127);
+  for (auto isa : targets()) {
+    SCOPED_TRACE(name(isa, 0, K, N));
+    auto packed = PackedWeights(b.data(), K, N, b_zp, isa);
+    EXPECT_EQ(packed.target(), isa);
+    auto padded = packed.n_blocks() * packed.n_block();
+    EXPECT_GE(padded, N);
+    for (int64_t n = 0; n < padded; ++n) {
+      int32_t expected = 0;
+      for (int64_t k = 0; n < N && k < K; ++k) {
+        expected += static_cast<int8_t>(b[k * N + n] - b_zp);
+      }
+      EXPECT_EQ(packed.colsum()[n], expected) << "n=" << n;
+    }
+  }
+}
+
+TEST_F(QgemmTest, Uint8ToInt32) {
+  for (auto isa : targets()) {
+    for (auto M : ms_) {
+      for (auto K : ks_) {
+        for (auto N : ns_) {
+          SCOPED_TRACE(name(isa, M, K, N));
+          auto a = random<uint8_t>(M * K, 0, 255);
+          auto b = random<int8_t>(K * N, -128, 127);
+          auto packed = PackedWeights(b.data(), K, N, 0, isa);
+          auto c = std::vector<int32_t>(M * N);
+          qgemm(a.data(), M, K, packed, 131, c.data(), N);
+          EXPECT_EQ(c, naive(a, 131, b, 0, M, K, N));
+        }
+      }
+    }
+  }
+}
+
+TEST_F(QgemmTest, Int8ToInt32) {
+  for (auto isa : targets()) {
+    for (auto M : ms_) {
+      for (auto K : ks_) {
+        for (auto N : ns_) {
+          SCOPED_TRACE(name(isa, M, K, N));
+          auto a = random<int8_t>(M * K, -128, 127);
+          auto b = random<int8_t>(K * N, -128, 127);
+          auto packed = PackedWeights(b.data(), K, N, 5, isa);
+          auto c = std::vector<int32_t>(M * N);
+          qgemm(a.data(), M, K, packed, -3, c.data(), N);
+          EXPECT_EQ(c, naive(a, -3, b, 5, M, K, N));
+        }
+      }
+    }
+  }
+}
+
+TEST_F(QgemmTest, Float32WithBias) {
+  const int64_t M = 5, K = 37, N = 19;
+  const float scale = 0.125f;
+  auto a = random<uint8_t>(M * K, 0, 255);
+  auto b = random<int8_t>(K * N, -128, 127);
+  auto bias = std::vector<float>(N);
+  for (int64_t n = 0; n < N; ++n) {
+    bias[n] = 0.5f * n - 3.0f;
+  }
+  auto expected = naive(a, 77, b, 0, M, K, N);
+  for (auto isa : targets()) {
+    SCOPED_TRACE(name(isa, M, K, N));
+    auto packed = PackedWeights(b.data(), K, N, 0, isa);
+    // C has a wider row stride than N, the padding is left alone.
+    const int64_t ldc = N + 3;
+    auto c = std::vector<float>(M * ldc, -1.0f);
+    qgemm(a.data(), M, K, packed, 77, scale, bias.data(), c.data(), ldc);
+    auto no_bias = std::vector<float>(M * N);
+    qgemm(a.data(), M, K, packed, 77, scale, nullptr, no_bias.data(), N);
+    for (int64_t m = 0; m < M; ++m) {
+      for (int64_t n = 0; n < N; ++n) {
+        auto v = expected[m * N + n] * scale;
+        EXPECT_FLOAT_EQ(c[m * ldc + n], v + bias[n]);
+        EXPECT_FLOAT_EQ(no_bias[m * N + n], v);
+      }
+      for (int64_t n = N; n < ldc; ++n) {
+        EXPECT_EQ(c[m * ldc + n], -1.0f);
+      }
+    }
+  }
+}
+
+TEST_F(QgemmTest, SignFlip) {
+  // 8 bytes at a time plus a tail.
+  auto x = random<uint8_t>(8 * 1000 + 5, 0, 255);
+  auto s8 = std::vector<int8_t>(x.size());
+  auto s16 = std::vector<int16_t>(x.size());
+  to_s8(x.data(), (int64_t)x.size(), s8.data());
+  to_s16(x.data(), (int64_t)x.size(), s16.data());
+  for (size_t i = 0; i < x.size(); ++i) {
+    EXPECT_EQ(s8[i], x[i] - 128) << "i=" << i;
+    EXPECT_EQ(s16[i], x[i]) << "i=" << i;
+  }
+}
+
+TEST_F(QgemmTest, NpuEpilogue) {
+  // the NPU paths: int8 activations (x - 128) with zp - 128 left, int16
+  // activations as they are with the whole zp left.
+  const int64_t M = 3, K = 23, N = 10;
+  const int32_t zp = 140;
+  auto a = random<uint8_t>(M * K, 0, 255);
+  auto b = random<int8_t>(K * N, -128, 127);
+  auto colsum = column_sums(b.data(), K, N);
+  auto expected = naive(a, zp, b, 0, M, K, N);
+
+  auto s8 = std::vector<int8_t>(a.size());
+  to_s8(a.data(), (int64_t)a.size(), s8.data());
+  auto acc32 = naive(s8, 0, b, 0, M, K, N);
+  auto c = std::vector<int32_t>(M * N);
+  zp_epilogue(acc32.data(), M, N, N, colsum.data(), zp - 128, c.data(), N);
+  EXPECT_EQ(c, expected);
+
+  auto s16 = std::vector<int16_t>(a.size());
+  to_s16(a.data(), (int64_t)a.size(), s16.data());
+  auto acc = naive(s16, 0, b, 0, M, K, N);
+  auto acc64 = std::vector<int64_t>(acc.begin(), acc.end());
+  zp_epilogue(acc64.data(), M, N, N, colsum.data(), zp, c.data(), N);
+  EXPECT_EQ(c, expected);
+
+  // one split of a wider output, as gmatmul_integer does.
+  const int64_t offset = 4, width = 5;
+  auto split = std::vector<int32_t>(M * width);
+  zp_epilogue(acc32.data() + offset, M, width, N, colsum.data() + offset,
+              zp - 128, split.data(), width);
+  for (int64_t m = 0; m < M; ++m) {
+    for (int64_t n = 0; n < width; ++n) {
+      EXPECT_EQ(split[m * width + n], expected[m * N + offset + n]);
+    }
+  }
+
+  auto f = std::vector<float>(M * N);
+  auto bias = std::vector<float>(N, 2.0f);
+  dequant_epilogue(acc32.data(), M, N, N, colsum.data(), zp - 128, 0.5f,
+                   bias.data(), f.data(), N);
+  for (int64_t i = 0; i < M * N; ++i) {
+    EXPECT_FLOAT_EQ(f[i], expected[i] * 0.5f + 2.0f);
+  }
+}
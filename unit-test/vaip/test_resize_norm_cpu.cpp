@@ -0,0 +1,159 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "../vaip_custom_op_resize_norm/src/resize_norm_cpu.hpp"
+#include "debug_logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace vaip_resize_norm_custom_op;
+class ResizeNormCpuTest : public DebugLogger {
+protected:
+  template <typename T> std::vector<T> random(size_t size, int lo, int hi) {
+    auto dist = std::uniform_int_distribution<int>(lo, hi);
+    auto ret = std::vector<T>(size);
+    for (auto& x : ret) {
+      x = static_cast<T>(dist(rng_));
+    }
+    return ret;
+  }
+
+  // element (y, x, c) of a HWC or CHW tensor of `channels` channels.
+  static size_t index(int y, int x, int c, int h, int w, int channels,
+                      bool to_chw) {
+    return to_chw ? ((size_t)c * h + y) * w + x
+                  : ((size_t)y * w + x) * channels + c;
+  }
+
+  // the int8 norm output of one channel value, as the PP_NORM kernel
+  // computes it.
+  static int8_t norm(int v, float mean, float std_dev, int fa, int fb,
+                     int fo) {
+    int32_t alpha = (unsigned char)(mean * (float)(1 << fa));
+    int32_t beta = (char)((1.0f / std_dev) * (float)(1 << fb));
+    auto shift = fa + fb - fo;
+    auto round = shift > 0 ? 1 << (shift - 1) : 0;
+    auto r = (((v << fa) - alpha) * beta + round) >> shift;
+    return (int8_t)std::clamp(r, -128, 127);
+  }
+
+  // the source position of output `o` of the PP_RESIZE_DOWN kernel: the
+  // first and second tap and the Q8 weight of the second.
+  static void tap(int o, int in, int out, int& i0, int& i1, int& frac) {
+    auto scale =
+        (int64_t)std::roundf((float)in / (float)out * (float)(1 << 16));
+    auto pos = std::max((((2 * o + 1) * scale) >> 1) - (1 << 15), (int64_t)0);
+    i0 = (int)(pos >> 16);
+    frac = (int)((pos >> 8) & 0xff);
+    if (i0 >= in - 1) {
+      i0 = in - 1;
+      frac = 0;
+    }
+    i1 = std::min(i0 + 1, in - 1);
+  }
+
+  std::mt19937 rng_{7};
+  const std::vector<float> mean_ = {0.5f, 0.25f, 0.125f};
+  const std::vector<float> std_ = {0.5f, 0.25f, 1.0f};
+  const std::vector<int> fl_bits_ = {0, 4, 3};
+};
+
+TEST_F(ResizeNormCpuTest, FixedToFloat) {
+  const int fbits = 3;
+  // odd widths leave a tail after the groups of 4 pixels.
+  for (auto width : {1, 3, 4, 5, 8, 13}) {
+    for (auto channels : {3, 4}) {
+      for (auto to_chw : {false, true}) {
+        SCOPED_TRACE("width=" + std::to_string(width) +
+                     " channels=" + std::to_string(channels) +
+                     " to_chw=" + std::to_string(to_chw));
+        const int height = 3;
+        auto src = random<int8_t>((size_t)height * width * 4, -128, 127);
+        auto dst = std::vector<float>((size_t)height * width * channels);
+        hwc4_fixed_to_float(src.data(), dst.data(), height, width, channels,
+                            fbits, to_chw);
+        for (auto y = 0; y < height; ++y) {
+          for (auto x = 0; x < width; ++x) {
+            for (auto c = 0; c < channels; ++c) {
+              auto expected = src[((size_t)y * width + x) * 4 + c] / 8.0f;
+              EXPECT_EQ(
+                  dst[index(y, x, c, height, width, channels, to_chw)],
+                  expected)
+                  << "y=" << y << " x=" << x << " c=" << c;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_F(ResizeNormCpuTest, SameSizeIsNormOnly) {
+  for (auto width : {1, 5, 7, 16}) {
+    for (auto to_chw : {false, true}) {
+      SCOPED_TRACE("width=" + std::to_string(width) +
+                   " to_chw=" + std::to_string(to_chw));
+      const int height = 2;
+      auto in = random<uint8_t>((size_t)height * width * 4, 0, 255);
+      auto cpu = ResizeNormCpu({height, width, 4}, {height, width}, fl_bits_,
+                               mean_, std_);
+      auto out = std::vector<float>((size_t)height * width * 3);
+      cpu.run(in.data(), out.data(), 3, to_chw);
+      for (auto y = 0; y < height; ++y) {
+        for (auto x = 0; x < width; ++x) {
+          for (auto c = 0; c < 3; ++c) {
+            auto v = norm(in[((size_t)y * width + x) * 4 + c], mean_[c],
+                          std_[c], fl_bits_[0], fl_bits_[1], fl_bits_[2]);
+            EXPECT_EQ(out[index(y, x, c, height, width, 3, to_chw)],
+                      v / 8.0f)
+                << "y=" << y << " x=" << x << " c=" << c;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_F(ResizeNormCpuTest, Downscale) {
+  const int in_h = 17, in_w = 23;
+  for (auto out_w : {5, 8, 11}) {
+    for (auto to_chw : {false, true}) {
+      SCOPED_TRACE("out_w=" + std::to_string(out_w) +
+                   " to_chw=" + std::to_string(to_chw));
+      const int out_h = 7;
+      auto in = random<uint8_t>((size_t)in_h * in_w * 4, 0, 255);
+      auto cpu = ResizeNormCpu({in_h, in_w, 4}, {out_h, out_w}, fl_bits_,
+                               mean_, std_);
+      ASSERT_EQ(cpu.out_height(), out_h);
+      ASSERT_EQ(cpu.out_width(), out_w);
+      auto out = std::vector<float>((size_t)out_h * out_w * 3);
+      cpu.run(in.data(), out.data(), 3, to_chw);
+      auto px = [&](int y, int x, int c) {
+        return (int)in[((size_t)y * in_w + x) * 4 + c];
+      };
+      for (auto y = 0; y < out_h; ++y) {
+        int y0, y1, fy;
+        tap(y, in_h, out_h, y0, y1, fy);
+        for (auto x = 0; x < out_w; ++x) {
+          int x0, x1, fx;
+          tap(x, in_w, out_w, x0, x1, fx);
+          for (auto c = 0; c < 3; ++c) {
+            auto top = px(y0, x0, c) * (256 - fx) + px(y0, x1, c) * fx;
+            auto bot = px(y1, x0, c) * (256 - fx) + px(y1, x1, c) * fx;
+            auto v = (top * (256 - fy) + bot * fy + (1 << 15)) >> 16;
+            auto n = norm(v, mean_[c], std_[c], fl_bits_[0], fl_bits_[1],
+                          fl_bits_[2]);
+            EXPECT_EQ(out[index(y, x, c, out_h, out_w, 3, to_chw)], n / 8.0f)
+                << "y=" << y << " x=" << x << " c=" << c;
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,226 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "../vaip_custom_op_dpu/src/custom_op.hpp"
+#include "../vaip_custom_op_dpu/src/mock_runner.hpp"
+#include "debug_logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace vaip_dpu_custom_op;
+
+// std::latch of C++20. wait() gives up after a while and returns false, so
+// that an order the queue does not allow fails the test instead of
+// hanging it.
+class Latch {
+public:
+  explicit Latch(int count) : count_{count} {}
+
+  void count_down() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (--count_ == 0) {
+      cv_.notify_all();
+    }
+  }
+
+  bool wait() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    return cv_.wait_for(lock, std::chrono::seconds(10),
+                        [this] { return count_ <= 0; });
+  }
+
+private:
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  int count_;
+};
+
+class RunnerRequestsQueueTest : public DebugLogger {
+protected:
+  void SetUp() override {
+    for (auto i = 0u; i < NUM_OF_RUNNERS; ++i) {
+      auto holder = std::make_unique<RunnerHolder>();
+      holder->runner_ = create_mock_runner(graph_->get_root_subgraph());
+      runner_ptrs_.push_back(holder->runner_.get());
+      runners_.push_back(std::move(holder));
+    }
+    queue_ = std::make_unique<RunnerRequestsQueue>(runners_);
+  }
+
+  static uint32_t launch(vart::RunnerExt* runner) {
+    return runner->execute_async(runner->get_inputs(), runner->get_outputs())
+        .first;
+  }
+
+  static void wait_for(vart::RunnerExt* runner, uint32_t job_id) {
+    EXPECT_EQ(runner->wait((int)job_id, -1), 0);
+  }
+
+  static constexpr auto NUM_OF_RUNNERS = 2u;
+  std::unique_ptr<xir::Graph> graph_ = xir::Graph::create("test");
+  std::vector<std::unique_ptr<RunnerHolder>> runners_;
+  std::vector<vart::RunnerExt*> runner_ptrs_;
+  std::unique_ptr<RunnerRequestsQueue> queue_;
+};
+
+// Several threads call like MyCustomOp::Compute() in pipelined mode.
+TEST_F(RunnerRequestsQueueTest, TicketsInOrder) {
+  constexpr auto NUM_OF_THREADS = 4;
+  constexpr auto NUM_OF_CALLS = 10;
+  constexpr auto NUM_OF_TICKETS = (size_t)(NUM_OF_THREADS * NUM_OF_CALLS);
+  struct Record {
+    vart::RunnerExt* runner = nullptr;
+    uint32_t job_id = 0;
+  };
+  auto records = std::vector<Record>(NUM_OF_TICKETS);
+  auto launches = std::vector<uint64_t>();
+  auto mtx = std::mutex();
+  auto in_use = std::vector<bool>(NUM_OF_RUNNERS, false);
+  auto shared_runner = false;
+  auto slot_of = [&](vart::RunnerExt* runner) {
+    return std::find(runner_ptrs_.begin(), runner_ptrs_.end(), runner) -
+           runner_ptrs_.begin();
+  };
+
+  auto call = [&]() {
+    auto ticket = queue_->takeTicket();
+    auto id = ticket->id();
+    pipelined_run(
+        0, *ticket,
+        [&](vart::RunnerExt* runner) {
+          std::lock_guard<std::mutex> lock(mtx);
+          shared_runner = shared_runner || in_use[slot_of(runner)];
+          in_use[slot_of(runner)] = true;
+        },
+        [&](vart::RunnerExt* runner) {
+          std::lock_guard<std::mutex> lock(mtx);
+          launches.push_back(id);
+          return launch(runner);
+        },
+        [&](vart::RunnerExt* runner, uint32_t job_id) {
+          wait_for(runner, job_id);
+          std::lock_guard<std::mutex> lock(mtx);
+          in_use[slot_of(runner)] = false;
+          records[id] = Record{runner, job_id};
+        });
+    ticket = nullptr;
+  };
+  auto threads = std::vector<std::thread>();
+  for (auto t = 0; t < NUM_OF_THREADS; ++t) {
+    threads.emplace_back([&]() {
+      for (auto i = 0; i < NUM_OF_CALLS; ++i) {
+        call();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_FALSE(shared_runner) << "a runner was used by two tickets at once";
+  ASSERT_EQ(launches.size(), NUM_OF_TICKETS);
+  for (auto id = 0u; id < NUM_OF_TICKETS; ++id) {
+    EXPECT_EQ(launches[id], id);
+    auto& r = records[id];
+    EXPECT_EQ(r.runner, runner_ptrs_[id % NUM_OF_RUNNERS]) << "ticket " << id;
+    // the mock device numbers the jobs in the order they are launched.
+    if (id > 0) {
+      EXPECT_EQ(r.job_id, records[id - 1].job_id + 1) << "ticket " << id;
+    }
+  }
+}
+
+// Ticket 1 fills its inputs before ticket 0 launches, and launches before
+// ticket 0 waits for its job. Each step blocks until the other ticket got
+// there, i.e. a queue that serialized more than the launches would fail.
+TEST_F(RunnerRequestsQueueTest, OverlapsHostWork) {
+  auto tickets = std::vector<std::unique_ptr<RunnerRequestsQueue::Ticket>>();
+  tickets.push_back(queue_->takeTicket());
+  tickets.push_back(queue_->takeTicket());
+  auto prepared_1 = Latch(1);
+  auto launched_1 = Latch(1);
+  auto mtx = std::mutex();
+  auto steps = std::vector<std::string>();
+  auto step = [&](uint64_t id, const char* name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    steps.push_back(name + std::to_string(id));
+  };
+
+  auto call = [&](RunnerRequestsQueue::Ticket& ticket) {
+    auto id = ticket.id();
+    pipelined_run(
+        0, ticket,
+        [&](vart::RunnerExt* runner) {
+          if (id == 0) {
+            EXPECT_TRUE(prepared_1.wait()) << "inputs filled one at a time";
+            step(id, "prepare");
+          } else {
+            step(id, "prepare");
+            prepared_1.count_down();
+          }
+        },
+        [&](vart::RunnerExt* runner) {
+          step(id, "launch");
+          return launch(runner);
+        },
+        [&](vart::RunnerExt* runner, uint32_t job_id) {
+          if (id == 0) {
+            EXPECT_TRUE(launched_1.wait()) << "launch waited for the last job";
+          } else {
+            launched_1.count_down();
+          }
+          wait_for(runner, job_id);
+          step(id, "finish");
+        });
+  };
+  auto threads = std::vector<std::thread>();
+  for (auto& ticket : tickets) {
+    threads.emplace_back([&call, &ticket]() {
+      call(*ticket);
+      ticket = nullptr;
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(steps.size(), 6u);
+  EXPECT_EQ(steps[0], "prepare1");
+  EXPECT_EQ(steps[1], "prepare0");
+  EXPECT_EQ(steps[2], "launch0");
+  EXPECT_EQ(steps[3], "launch1");
+}
+
+// A call that throws, e.g. on an input it cannot convert, still passes the
+// launch turn and its request on to the later tickets.
+TEST_F(RunnerRequestsQueueTest, FailedCallDoesNotBlock) {
+  auto done = std::vector<uint64_t>();
+  for (auto i = 0; i < 4; ++i) {
+    auto ticket = queue_->takeTicket();
+    auto id = ticket->id();
+    try {
+      pipelined_run(
+          0, *ticket,
+          [&](vart::RunnerExt*) {
+            if (id == 0 || id == 1) {
+              throw std::runtime_error("bad input");
+            }
+          },
+          launch,
+          [&](vart::RunnerExt* runner, uint32_t job_id) {
+            wait_for(runner, job_id);
+            done.push_back(id);
+          });
+    } catch (const std::runtime_error&) {
+    }
+  }
+  EXPECT_EQ(done, (std::vector<uint64_t>{2, 3}));
+}
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#include "../vaip/include/vaip/vaip.hpp"
+#include "debug_logger.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace vaip_core;
+class RuntimeTraceTest : public DebugLogger {};
+
+static size_t count_of(const std::string& text, const std::string& pattern) {
+  auto ret = size_t(0);
+  for (auto pos = text.find(pattern); pos != std::string::npos;
+       pos = text.find(pattern, pos + pattern.size())) {
+    ret++;
+  }
+  return ret;
+}
+
+TEST_F(RuntimeTraceTest, SpansOfAllThreadsReachTheTrace) {
+  auto file =
+      (std::filesystem::temp_directory_path() / "vaip_runtime_trace.json")
+          .string();
+  // read once, on the first use of the tracer
+#ifdef _WIN32
+  _putenv_s("XLNX_RUNTIME_TRACE", file.c_str());
+#else
+  setenv("XLNX_RUNTIME_TRACE", file.c_str(), 1);
+#endif
+  auto op = runtime_trace::intern("test_runtime_trace_op");
+  if (op == 0) {
+    GTEST_SKIP() << "the tracer was first used without XLNX_RUNTIME_TRACE";
+  }
+  auto phase = runtime_trace::intern("test_phase");
+  EXPECT_NE(op, phase);
+  EXPECT_EQ(op, runtime_trace::intern("test_runtime_trace_op"));
+
+  constexpr auto NUM_THREADS = 4;
+  constexpr auto NUM_CALLS = 100;
+  auto threads = std::vector<std::thread>();
+  for (auto t = 0; t < NUM_THREADS; ++t) {
+    threads.emplace_back([op, phase]() {
+      for (auto i = 0; i < NUM_CALLS; ++i) {
+        auto call = TraceSpan(op, runtime_trace::CALL);
+        auto span = TraceSpan(op, phase);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  runtime_trace::flush();
+
+  auto text = std::stringstream();
+  text << std::ifstream(file).rdbuf();
+  EXPECT_EQ(count_of(text.str(), "\"name\":\"test_runtime_trace_op\""),
+            (size_t)(NUM_THREADS * NUM_CALLS));
+  EXPECT_EQ(count_of(text.str(), "\"name\":\"test_phase\""),
+            (size_t)(NUM_THREADS * NUM_CALLS));
+
+  // what the EP's deinitialize hook does; twice is fine.
+  runtime_trace::finish();
+  runtime_trace::finish();
+  text = std::stringstream();
+  text << std::ifstream(file).rdbuf();
+  EXPECT_EQ(count_of(text.str(), "\"name\":\"summary test_runtime_trace_op "
+                                 "call\""),
+            (size_t)1);
+  EXPECT_EQ(text.str().substr(text.str().size() - 3), "\n]\n");
+}
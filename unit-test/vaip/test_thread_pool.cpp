@@ -0,0 +1,102 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#include "../vaip/include/vaip/vaip.hpp"
+#include "debug_logger.hpp"
+#include <atomic>
+#include <future>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace vaip_core;
+class ThreadPoolTest : public DebugLogger {};
+
+TEST_F(ThreadPoolTest, ParallelForCoversRange) {
+  ThreadPool pool(4);
+  std::vector<int> hits(100003, 0);
+  pool.parallel_for(0, (int64_t)hits.size(), 100, [&](int64_t b, int64_t e) {
+    for (auto i = b; i < e; ++i) {
+      hits[i]++;
+    }
+  });
+  for (auto h : hits) {
+    EXPECT_EQ(h, 1);
+  }
+}
+
+TEST_F(ThreadPoolTest, NestedParallelFor) {
+  ThreadPool pool(4);
+  std::atomic<int64_t> sum{0};
+  pool.parallel_for(0, 16, 1, [&](int64_t b, int64_t e) {
+    for (auto i = b; i < e; ++i) {
+      pool.parallel_for(0, 1000, 10,
+                        [&](int64_t b2, int64_t e2) { sum += e2 - b2; });
+    }
+  });
+  EXPECT_EQ(sum.load(), 16000);
+}
+
+TEST_F(ThreadPoolTest, ParallelForRethrows) {
+  ThreadPool pool(4);
+  EXPECT_THROW(pool.parallel_for(0, 100, 1,
+                                 [](int64_t b, int64_t e) {
+                                   if (b <= 50 && 50 < e) {
+                                     throw std::runtime_error("chunk 50");
+                                   }
+                                 }),
+               std::runtime_error);
+}
+
+TEST_F(ThreadPoolTest, SubmitTasks) {
+  ThreadPool pool(3);
+  std::atomic<int> count{0};
+  std::vector<std::future<void>> futures;
+  for (auto i = 0; i < 1000; ++i) {
+    futures.emplace_back(pool.submit([&count]() { count++; }));
+  }
+  for (auto& f : futures) {
+    f.get();
+  }
+  EXPECT_EQ(count.load(), 1000);
+}
+
+TEST_F(ThreadPoolTest, SingleThread) {
+  ThreadPool pool(1);
+  EXPECT_EQ(pool.size(), 1u);
+  int64_t sum = 0;
+  pool.parallel_for(0, 10, 1, [&](int64_t b, int64_t e) { sum += e - b; });
+  pool.submit([&sum]() { sum++; }).get();
+  EXPECT_EQ(sum, 11);
+}
+
+TEST_F(ThreadPoolTest, SingleThreadAsyncTaskOverlaps) {
+  ThreadPool pool(1);
+  auto caller = std::this_thread::get_id();
+  std::promise<std::thread::id> runner;
+  auto runner_id = runner.get_future();
+  AsyncTask task(
+      [&runner]() { runner.set_value(std::this_thread::get_id()); }, pool);
+  // not wait()ed, so only a worker can run it, unless it ran inline.
+  EXPECT_NE(runner_id.get(), caller);
+}
+
+TEST_F(ThreadPoolTest, AsyncTask) {
+  ThreadPool pool(2);
+  std::atomic<int> count{0};
+  {
+    AsyncTask task([&count]() { count++; }, pool);
+  }
+  EXPECT_EQ(count.load(), 1);
+  AsyncTask task([]() { throw std::runtime_error("task"); }, pool);
+  auto shared = task.share();
+  EXPECT_THROW(task.get(), std::runtime_error);
+  EXPECT_THROW(shared.get(), std::runtime_error);
+}
+
+TEST_F(ThreadPoolTest, GrainSize) {
+  EXPECT_EQ(grain_size(1), 64 * 1024);
+  EXPECT_EQ(grain_size(1 << 20), 1);
+}
@@ -0,0 +1,177 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "../vaip_pass_fuse_transpose/src/transpose_f.hpp"
+#include "debug_logger.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace vaip_core;
+class TransposeTest : public DebugLogger {
+protected:
+  static std::vector<float> iota(const std::vector<int64_t>& shape) {
+    auto size = std::accumulate(shape.begin(), shape.end(), (int64_t)1,
+                                std::multiplies<int64_t>());
+    auto ret = std::vector<float>(size);
+    std::iota(ret.begin(), ret.end(), 0.0f);
+    return ret;
+  }
+
+  // dst[i] = src[j], j the src index of dst index i, element by element.
+  static std::vector<float> naive(const std::vector<int64_t>& shape,
+                                  const std::vector<int64_t>& perm,
+                                  const std::vector<bool>& flip,
+                                  const std::vector<float>& src) {
+    auto rank = shape.size();
+    auto dst_shape = std::vector<int64_t>(rank);
+    for (auto k = 0u; k < rank; ++k) {
+      dst_shape[k] = shape[perm[k]];
+    }
+    auto ret = std::vector<float>(src.size());
+    auto idx = std::vector<int64_t>(rank, 0);
+    for (auto i = 0u; i < ret.size(); ++i) {
+      auto rest = (int64_t)i;
+      for (auto k = rank; k-- > 0;) {
+        idx[k] = rest % dst_shape[k];
+        rest /= dst_shape[k];
+      }
+      auto src_idx = std::vector<int64_t>(rank);
+      for (auto k = 0u; k < rank; ++k) {
+        auto d = perm[k];
+        src_idx[d] = flip[d] ? shape[d] - 1 - idx[k] : idx[k];
+      }
+      auto j = int64_t{0};
+      for (auto d = 0u; d < rank; ++d) {
+        j = j * shape[d] + src_idx[d];
+      }
+      ret[i] = src[j];
+    }
+    return ret;
+  }
+
+  static std::vector<float> transpose(const std::vector<int64_t>& shape,
+                                      const std::vector<int64_t>& perm,
+                                      const std::vector<bool>& flip,
+                                      const std::vector<float>& src) {
+    auto ret = std::vector<float>(src.size());
+    transpose_data<float>(shape, perm, flip, src, ret.data());
+    return ret;
+  }
+
+  static std::string str(const std::vector<int64_t>& v) {
+    std::ostringstream ret;
+    for (auto x : v) {
+      ret << x << " ";
+    }
+    return ret.str();
+  }
+
+  std::mt19937 rng_{1};
+};
+
+TEST_F(TransposeTest, Rank0) {
+  auto src = std::vector<float>{42.0f};
+  EXPECT_EQ(transpose({}, {}, {}, src), src);
+}
+
+TEST_F(TransposeTest, RandomPermsAndFlips) {
+  // dims around the tile size of 16, and 1s.
+  auto dims = std::vector<int64_t>{1, 2, 3, 5, 16, 17, 33};
+  for (auto rank = 1; rank <= 5; ++rank) {
+    for (auto round = 0; round < 40; ++round) {
+      auto shape = std::vector<int64_t>(rank);
+      for (auto& d : shape) {
+        d = dims[rng_() % (rank <= 3 ? dims.size() : 5)];
+      }
+      auto perm = std::vector<int64_t>(rank);
+      std::iota(perm.begin(), perm.end(), 0);
+      std::shuffle(perm.begin(), perm.end(), rng_);
+      auto flip = std::vector<bool>(rank);
+      for (auto d = 0; d < rank; ++d) {
+        flip[d] = round % 2 == 1 && rng_() % 2 == 0;
+      }
+      SCOPED_TRACE("shape " + str(shape) + "perm " + str(perm));
+      auto src = iota(shape);
+      EXPECT_EQ(transpose(shape, perm, flip, src),
+                naive(shape, perm, flip, src));
+    }
+  }
+}
+
+TEST_F(TransposeTest, IdentityPerm) {
+  for (auto shape : std::vector<std::vector<int64_t>>{
+           {7}, {17, 3}, {2, 33, 5}, {1, 3, 18, 19}}) {
+    auto perm = std::vector<int64_t>(shape.size());
+    std::iota(perm.begin(), perm.end(), 0);
+    auto src = iota(shape);
+    EXPECT_EQ(transpose(shape, perm, std::vector<bool>(shape.size()), src),
+              src)
+        << str(shape);
+  }
+}
+
+TEST_F(TransposeTest, EmptyTensor) {
+  // nothing is read or written.
+  transpose_data<float>(std::vector<int64_t>{3, 0, 2},
+                        std::vector<int64_t>{2, 0, 1},
+                        std::vector<bool>(3), std::vector<float>(), nullptr);
+}
+
+TEST_F(TransposeTest, ComposeFlipHw) {
+  // OIHW weights, turned by 180 degrees and transposed to OHWI.
+  auto shape = std::vector<int64_t>{3, 4, 5, 17};
+  auto perm = std::vector<int64_t>{0, 2, 3, 1};
+  auto view = TransposeViews().compose("w", shape, perm, true);
+  EXPECT_EQ(view.source, "w");
+  EXPECT_EQ(view.perm, perm);
+  EXPECT_EQ(view.flip, (std::vector<bool>{false, false, true, true}));
+  auto src = iota(shape);
+  EXPECT_EQ(transpose(view.shape, view.perm, view.flip, src),
+            naive(shape, perm, {false, false, true, true}, src));
+}
+
+TEST_F(TransposeTest, ComposeChain) {
+  auto views = TransposeViews();
+  auto shape0 = std::vector<int64_t>{2, 3, 17, 5};
+  auto src = iota(shape0);
+  // w1 = transpose(w0), w2 = transpose(flip_hw(w1))
+  auto perm1 = std::vector<int64_t>{0, 2, 3, 1};
+  auto w1 = naive(shape0, perm1, std::vector<bool>(4), src);
+  auto v1 = views.compose("w0", shape0, perm1, false);
+  views.set("w1", v1);
+  auto shape1 = v1.dst_shape();
+
+  auto perm2 = std::vector<int64_t>{3, 1, 0, 2};
+  auto w2 = naive(shape1, perm2, {false, false, true, true}, w1);
+  auto v2 = views.compose("w1", shape1, perm2, true);
+  views.set("w2", v2);
+  // w2 is read from w0 in one go.
+  EXPECT_EQ(v2.source, "w0");
+  EXPECT_EQ(v2.shape, shape0);
+  EXPECT_EQ(transpose(v2.shape, v2.perm, v2.flip, src), w2);
+
+  // w3 = transpose(w2 with a leading 1), e.g. the other input of a
+  // broadcast op of higher rank.
+  auto shape2 = expand_shape(v2.dst_shape(), 5);
+  auto perm3 = std::vector<int64_t>{2, 0, 4, 1, 3};
+  auto w3 = naive(shape2, perm3, std::vector<bool>(5), w2);
+  auto v3 = views.compose("w2", shape2, perm3, false);
+  EXPECT_EQ(v3.source, "w0");
+  EXPECT_EQ(v3.shape, expand_shape(shape0, 5));
+  EXPECT_EQ(transpose(v3.shape, v3.perm, v3.flip, src), w3);
+}
+
+TEST_F(TransposeTest, ComposeUnknownShape) {
+  // a view whose shape does not match is not composed, `name` is read.
+  auto views = TransposeViews();
+  views.set("w1", views.compose("w0", {4, 6}, {1, 0}, false));
+  auto v = views.compose("w1", {3, 8}, {1, 0}, false);
+  EXPECT_EQ(v.source, "w1");
+  EXPECT_EQ(v.perm, (std::vector<int64_t>{1, 0}));
+}
@@ -9,11 +9,14 @@
 #include "onnxruntime_api.hpp"
 #include "vaip/capability.pb.h"
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <vaip/custom_op.h>
 struct OrtSession;
 typedef struct OrtSession OrtSession;
 
 namespace vaip_core {
+struct CustomOpCpuSession;
 
 class ExecutionProviderConcrete
     : public ExecutionProvider,
@@ -121,6 +124,8 @@ public:
   meta_def->set_fallback_cpu(true);
   2. In custom_op.cpp, if you need to fall back to CPU, call ComputeCpu(api,
   context);
+  The CPU session is created on the first call, ops of the same subgraph
+  share it.
   */
   VAIP_DLL_SPEC void ComputeCpu(const OrtApi* api,
                                 OrtKernelContext* context) const;
@@ -131,7 +136,12 @@ public:
 protected:
   std::shared_ptr<const PassContext> context_;
   std::shared_ptr<MetaDefProto> meta_def_;
-  Ort::Session session_;
+
+private:
+  // the subgraph of a fallback_cpu op until its CPU session is created.
+  mutable onnxruntime::Model* model_;
+  mutable std::once_flag cpu_session_once_;
+  mutable std::shared_ptr<const CustomOpCpuSession> cpu_session_;
 };
 
 } // namespace vaip_core
@@ -13,6 +13,60 @@ using namespace vaip_core;
 
 namespace vaip::dd::qmatmulcalc {
 
+/// The rows of a [in_ch, out_ch] weight matrix, without copying them. The
+/// calculators only need the column sums of the weights, so a constant is
+/// passed as a flat span instead of being folded into nested vectors.
+template <typename T> class WeightsView {
+public:
+  /// row i of `data` starts at `i * row_stride`.
+  WeightsView(gsl::span<const T> data, size_t rows, size_t cols,
+              size_t row_stride) {
+    init(data, rows, cols, row_stride);
+  }
+  /// a contiguous [rows, cols] constant.
+  WeightsView(gsl::span<const T> data, const std::vector<int64_t>& shape) {
+    CHECK_EQ(shape.size(), 2u);
+    CHECK_EQ(data.size(), (size_t)(shape[0] * shape[1]));
+    init(data, (size_t)shape[0], (size_t)shape[1], (size_t)shape[1]);
+  }
+  /// implicit, so that callers with nested vectors do not change.
+  WeightsView(const std::vector<std::vector<T>>& weights)
+      : cols_{weights.empty() ? 0 : weights[0].size()} {
+    rows_.reserve(weights.size());
+    for (auto& row : weights) {
+      CHECK_EQ(row.size(), cols_);
+      rows_.push_back(row.data());
+    }
+  }
+
+  size_t rows() const { return rows_.size(); }
+  size_t cols() const { return cols_; }
+  const T* row(size_t i) const { return rows_[i]; }
+
+private:
+  void init(gsl::span<const T> data, size_t rows, size_t cols,
+            size_t row_stride) {
+    CHECK(rows == 0 || (rows - 1) * row_stride + cols <= data.size())
+        << "rows=" << rows << " cols=" << cols << " stride=" << row_stride
+        << " size=" << data.size();
+    cols_ = cols;
+    rows_.reserve(rows);
+    for (size_t i = 0; i < rows; ++i) {
+      rows_.push_back(data.data() + i * row_stride);
+    }
+  }
+
+private:
+  std::vector<const T*> rows_;
+  size_t cols_ = 0;
+};
+
+/// The sum of every column of `weights`. Rows are added to narrow
+/// accumulators in blocks of columns, which vectorizes, and the blocks are
+/// split over the host thread pool.
+std::vector<int64_t> column_sums(const WeightsView<uint8_t>& weights);
+std::vector<int64_t> column_sums(const WeightsView<uint16_t>& weights);
+
 struct MatmulQDQParams {
   std::vector<int64_t> c0_coeffs;
   std::vector<int32_t> qdq_params;
@@ -54,44 +108,50 @@ std::pair<int32_t, int16_t> find_closest_shifted_int32_gap(double float_val,
 std::pair<int16_t, int16_t> find_closest_shifted_int16(double float_val,
                                                        int32_t max_value);
 MatmulQDQParams calculate_matmuladd_qdq_params_uint8_uint8(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<uint16_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp);
 
 MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<uint16_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp);
 
 MatmulQDQParams calculate_matmul_qdq_params_uint8_uint8(
-    const std::vector<std::vector<uint8_t>>& weights, float a_sc, uint16_t a_zp,
+    const WeightsView<uint8_t>& weights, float a_sc, uint16_t a_zp,
     float w_sc, uint16_t w_zp, float q_sc, uint16_t q_zp);
 
 MatmulQDQParams calculate_matmul_qdq_params_uint16_uint8(
-    const std::vector<std::vector<uint8_t>>& weights, float a_sc, uint16_t a_zp,
+    const WeightsView<uint8_t>& weights, float a_sc, uint16_t a_zp,
     float w_sc, uint16_t w_zp, float q_sc, uint16_t q_zp);
 
 MatmulQDQParams_3d calculate_matmul_3d_qdq_params_uint16_uint8(
     const std::vector<std::vector<std::vector<uint8_t>>>& weights, float a_sc,
     uint16_t a_zp, float w_sc, uint16_t w_zp, float q_sc, uint16_t q_zp);
 
+/// `weights` is a contiguous [batch, in_ch, out_ch] constant.
+MatmulQDQParams_3d calculate_matmul_3d_qdq_params_uint16_uint8(
+    gsl::span<const uint8_t> weights, const std::vector<int64_t>& shape,
+    float a_sc, uint16_t a_zp, float w_sc, uint16_t w_zp, float q_sc,
+    uint16_t q_zp);
+
 MatmulQDQParams calculate_matmuladd_qdq_params_uint8_uint8_b32(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<int32_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp);
 
 MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8_b32(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<int32_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp);
 
 MatmulQDQParams calculate_matmuladd_qdq_params_uint8_uint8_b32(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<int32_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp);
 
 MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8_b32(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<int32_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp);
 
@@ -120,7 +180,7 @@ std::vector<uint16_t> dq_vec_to_bf16(std::vector<T>& data, float& scale,
 
 std::tuple<std::vector<int64_t>, int32_t, int64_t, int64_t, int64_t, int64_t>
 compute_qdq_coeff_matmul_bias(float a_dq_xscale, uint8_t a_dq_xzero_pt,
-                              const std::vector<std::vector<uint8_t>>& weights,
+                              const WeightsView<uint8_t>& weights,
                               float w_dq_xscale, uint8_t w_dq_xzero_pt,
                               const std::vector<uint16_t>& bias,
                               float b_dq_xscale, uint8_t b_dq_xzero_pt,
@@ -230,7 +290,7 @@ dq_uint16A_uint16W_conv_q_param_gen(float in_s, uint16_t in_zp,
 std::tuple<std::vector<int64_t>, int32_t, int64_t, int64_t, int64_t, int64_t>
 dq_uint16A_uint8W_bias_matmul_q_param_gen(
     float a_dq_xscale, uint16_t a_dq_xzero_pt,
-    const std::vector<std::vector<uint8_t>>& weights, float w_dq_xscale,
+    const WeightsView<uint8_t>& weights, float w_dq_xscale,
     uint16_t w_dq_xzero_pt, const std::vector<uint16_t>& bias,
     float b_dq_xscale, uint16_t b_dq_xzero_pt, float a_q_yscale,
     uint16_t a_q_yzero_pt);
@@ -238,7 +298,7 @@ dq_uint16A_uint8W_bias_matmul_q_param_gen(
 std::tuple<std::vector<int64_t>, int32_t, int64_t, int64_t, int64_t, int64_t>
 dq_uint16A_uint16W_bias_matmul_q_param_gen(
     float a_dq_xscale, uint16_t a_dq_xzero_pt,
-    const std::vector<std::vector<uint16_t>>& weights, float w_dq_xscale,
+    const WeightsView<uint16_t>& weights, float w_dq_xscale,
     uint16_t w_dq_xzero_pt, const std::vector<uint16_t>& bias,
     float b_dq_xscale, uint16_t b_dq_xzero_pt, float a_q_yscale,
     uint16_t a_q_yzero_pt, std::vector<int> shifts);
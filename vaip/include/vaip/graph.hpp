@@ -355,6 +355,33 @@ VAIP_DLL_SPEC std::string graph_as_string(const Graph& graph);
 std::vector<const Node*>
 graph_get_consumer_nodes(const Graph& graph, const std::string& node_arg_name);
 
+/** @brief the id of a node arg by name, see `NodeArgId`.
+ *
+ *  @return none if the graph has no such node arg.
+ */
+VAIP_DLL_SPEC std::optional<NodeArgId>
+graph_find_node_arg_id(const Graph& graph, const std::string& node_arg_name);
+VAIP_DLL_SPEC std::optional<NodeArgId>
+graph_find_node_arg_id(const Graph& graph, const NodeArg& node_arg);
+
+/** @brief the node arg of an id, nullptr if it is no longer in the graph.
+ */
+VAIP_DLL_SPEC const NodeArg* graph_get_node_arg_by_id(const Graph& graph,
+                                                      NodeArgId id);
+
+/** @brief the producer of a node arg by id, like
+ *  `VAIP_ORT_API(graph_producer_node)`, nullptr for a graph input or an
+ *  initializer.
+ */
+VAIP_DLL_SPEC const Node* graph_get_producer_node_by_id(const Graph& graph,
+                                                        NodeArgId id);
+
+/** @brief the consumers of a node arg by id, like
+ *  `graph_get_consumer_nodes`.
+ */
+VAIP_DLL_SPEC std::vector<const Node*>
+graph_get_consumer_nodes_by_id(const Graph& graph, NodeArgId id);
+
 /** @brief garbage collection by removing dangling nodes.
  *
  *  @param graph
@@ -4,12 +4,26 @@
  */
 
 #pragma once
+#include <cstdint>
 #include <optional>
 #include <ostream>
 #include <vaip/my_ort.h>
 #include <vaip/vaip_gsl.h>
 namespace vaip_core {
 
+/** @brief a dense id of a node arg of a graph.
+ *
+ *  Looking a node arg up by name hashes and compares its name, which is
+ *  long in large transformer models. The node args of a graph are
+ *  interned once into ids from 0, so that code walking many node args,
+ *  e.g. `IPass_try_fuse`, keeps ids and indexes tables by them instead.
+ *
+ *  Ids are from `graph_find_node_arg_id` and valid until `graph_resolve`
+ *  or `graph_gc`; a node added without them is interned on demand and the
+ *  ids handed out so far stay valid.
+ */
+using NodeArgId = uint32_t;
+
 VAIP_DLL_SPEC bool node_arg_exists(const NodeArg& node_arg);
 VAIP_DLL_SPEC const std::string& node_arg_get_name(const NodeArg& node_arg);
 VAIP_DLL_SPEC std::string node_arg_as_string(const NodeArg& node_arg);
@@ -22,6 +36,35 @@ VAIP_DLL_SPEC bool node_arg_is_unknown_shape(const NodeArg& node_arg);
 VAIP_DLL_SPEC bool node_arg_is_scalar(const NodeArg& node_arg);
 VAIP_DLL_SPEC bool node_arg_is_zero_shape(const NodeArg& node_arg);
 VAIP_DLL_SPEC bool node_arg_is_dynamic_shape(const NodeArg& node_arg);
+
+/** @brief the metadata of a node arg of a graph.
+ *
+ *  node_arg_get_shape_i64() copies the shape into a new vector on every
+ *  call, while pattern predicates and passes ask for the same shapes many
+ *  times. The info of a node arg is looked up once per graph and kept
+ *  until `graph_resolve`, `graph_gc` or `node_arg_set_shape_i64`; the
+ *  reference and the spans in it are valid until then.
+ */
+struct NodeArgInfo {
+  /// false for an unknown shape.
+  bool has_shape = false;
+  /// empty for a scalar or an unknown shape.
+  gsl::span<const int64_t> shape;
+  gsl::span<const std::string> denotation;
+  /// negative for a node arg that is not a tensor.
+  int element_type = -1;
+  bool is_dynamic_shape = false;
+  bool is_zero_shape = false;
+};
+VAIP_DLL_SPEC const NodeArgInfo& node_arg_get_info(const Graph& graph,
+                                                   const NodeArg& node_arg);
+/// set the shape of `node_arg` and drop its cached info.
+VAIP_DLL_SPEC void node_arg_set_shape_i64(const NodeArg& node_arg,
+                                          const std::vector<int64_t>& shape);
+/// set the denotation of `node_arg` and drop its cached info.
+VAIP_DLL_SPEC void
+node_arg_set_denotation(const NodeArg& node_arg,
+                        const std::vector<std::string>& denotation);
 VAIP_DLL_SPEC const TensorProto&
 node_arg_get_const_data_as_tensor(const Graph& graph, const NodeArg& node_arg);
 VAIP_DLL_SPEC float node_arg_get_const_data_as_float(const Graph& graph,
@@ -150,6 +193,15 @@ public:
   std::unique_ptr<std::vector<std::string>> denotation() const {
     return vaip_core::node_arg_get_denotation(self_);
   }
+  /**
+   * @brief Gets the cached shape, element type and shape flags of the
+   * NodeArg without allocating.
+   *
+   * @return The info of the NodeArg, valid until the graph is resolved.
+   * */
+  const vaip_core::NodeArgInfo& info() const {
+    return vaip_core::node_arg_get_info(graph_, self_);
+  }
   /**
    * Gets the element type of the node argument.
    *
@@ -183,31 +235,25 @@ public:
    *
    * @return True if the shape is unknown, false otherwise.
    */
-  bool is_unknown_shape() const {
-    return vaip_core::node_arg_is_unknown_shape(self_);
-  }
+  bool is_unknown_shape() const { return !info().has_shape; }
   /**
    * Checks if the node argument is a scalar.
    *
    * @return True if the node argument is a scalar, false otherwise.
    */
-  bool is_scalar() const { return vaip_core::node_arg_is_scalar(self_); }
+  bool is_scalar() const { return info().has_shape && info().shape.empty(); }
   /**
    * Checks if the shape of the node argument is zero.
    *
    * @return True if the shape is zero, false otherwise.
    */
-  bool is_zero_shape() const {
-    return vaip_core::node_arg_is_zero_shape(self_);
-  }
+  bool is_zero_shape() const { return info().is_zero_shape; }
   /**
    * Checks if the shape of the node argument is dynamic.
    *
    * @return True if the shape is dynamic, false otherwise.
    */
-  bool is_dynamic_shape() const {
-    return vaip_core::node_arg_is_dynamic_shape(self_);
-  }
+  bool is_dynamic_shape() const { return info().is_dynamic_shape; }
   /**
    * Checks if the node argument is constant.
    *
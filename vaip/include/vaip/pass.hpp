@@ -323,6 +323,15 @@ IPass_try_fuse(const Graph& graph, const std::string& name,
                const std::vector<std::string>& outputs,
                const std::vector<std::string>& constant_initializers1,
                const std::string& device);
+/** @brief IPass_try_fuse by node arg ids, see `graph_find_node_arg_id`,
+ *  for passes that already hold ids and to skip looking names up.
+ */
+VAIP_DLL_SPEC std::pair<std::unique_ptr<MetaDefProto>, TryFuseError>
+IPass_try_fuse(const Graph& graph, const std::string& name,
+               const std::vector<NodeArgId>& inputs,
+               const std::vector<NodeArgId>& outputs,
+               const std::vector<std::string>& constant_initializers,
+               const std::string& device);
 template <>
 inline std::vector<int64_t>
 IPass::const_data_into<int64_t>(const NodeArg& node_arg) {
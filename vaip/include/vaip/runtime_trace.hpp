@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#pragma once
+#include "./_sanity_check.hpp"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vaip/export.h>
+
+namespace vaip_core {
+
+/// Spans of custom op calls at inference time, to see where the latency
+/// goes without rebuilding.
+///
+/// Set XLNX_RUNTIME_TRACE to a file name to turn it on. Every thread
+/// records into its own preallocated ring of XLNX_RUNTIME_TRACE_EVENTS
+/// spans without taking a lock; a span that finds its ring full is
+/// dropped and counted. A background thread drains the rings every
+/// XLNX_RUNTIME_TRACE_FLUSH_MS into the file, as Chrome trace events like
+/// the compile time ones of PassContext::measure(), and keeps a latency
+/// histogram per op and phase. At finish(), i.e. when the EP is
+/// deinitialized, the count, p50, p90, p99 and max of every op and phase
+/// are logged and appended to the trace.
+///
+/// Off, a span is one compare of its op id against 0.
+namespace runtime_trace {
+
+/// id of `name`, the same for the whole process; 0 when tracing is off.
+/// Ops intern their name and phases once, not per call.
+VAIP_DLL_SPEC uint32_t intern(const std::string& name);
+
+/// A finished span of phase `phase` of op `op`, in ns of now().
+VAIP_DLL_SPEC void record(uint32_t op, uint32_t phase, int64_t begin,
+                          int64_t end) noexcept;
+
+/// Write what the rings hold so far, e.g. before reading the trace.
+VAIP_DLL_SPEC void flush();
+
+/// Stop the background thread, write the rest and the summaries and close
+/// the trace; spans after it are not written. Called from an explicit
+/// shutdown hook, not from a static destructor: joining a thread while a
+/// DLL is unloaded may deadlock on Windows. Without it, the trace ends
+/// with the last periodic write.
+VAIP_DLL_SPEC void finish();
+
+inline int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// the whole call of an op, see Span
+constexpr uint32_t CALL = 0;
+
+} // namespace runtime_trace
+
+/// Records [construction, destruction) as phase `phase` of op `op`.
+/// Phase runtime_trace::CALL is the whole op call, the trace shows it
+/// with the op name and the other phases nested in it.
+class TraceSpan {
+public:
+  TraceSpan(uint32_t op, uint32_t phase)
+      : op_{op}, phase_{phase}, begin_{op != 0 ? runtime_trace::now() : 0} {}
+  ~TraceSpan() {
+    if (op_ != 0) {
+      runtime_trace::record(op_, phase_, begin_, runtime_trace::now());
+    }
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+  uint32_t op_;
+  uint32_t phase_;
+  int64_t begin_;
+};
+
+} // namespace vaip_core
+
+/// A TraceSpan of `op` to the end of the enclosing scope, for a phase
+/// named like the ones of __TIC__(), e.g. VAIP_TRACE_SPAN(op, SYNC_INPUT).
+/// The phase is interned once per call site.
+#define VAIP_TRACE_SPAN(op, phase)                                             \
+  static const uint32_t vaip_trace_phase_##phase =                             \
+      vaip_core::runtime_trace::intern(#phase);                                \
+  vaip_core::TraceSpan vaip_trace_span_##phase((op), vaip_trace_phase_##phase)
@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#pragma once
+#include "./_sanity_check.hpp"
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vaip/export.h>
+
+namespace vaip_core {
+
+/// Process-wide pool for host compute in passes and custom ops.
+///
+/// Every worker owns a task deque; a worker pops its own tasks LIFO and
+/// steals FIFO from the others when it runs dry. parallel_for() lets the
+/// calling thread run chunks as well, so it can be nested and never
+/// waits on a chunk nobody has started.
+///
+/// The pool is created on first use and shared by all sessions, so the
+/// thread budget, XLNX_HOST_THREADS (default: half the hardware
+/// threads), bounds host compute of the whole process. Set
+/// XLNX_HOST_THREAD_AFFINITY=1 to pin worker i to core i. There is at
+/// least one worker, also with a budget of one thread, so that submit()
+/// and AsyncTask still overlap with the caller.
+class VAIP_DLL_SPEC ThreadPool {
+public:
+  static ThreadPool& instance();
+
+  explicit ThreadPool(size_t num_threads, bool affinity = false);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// threads that run parallel_for() chunks, the caller included.
+  size_t size() const;
+
+  /// Run `task` on a worker, never inline. Do not block on the returned future from
+  /// inside another pool task; use parallel_for() for fork/join.
+  std::future<void> submit(std::function<void()> task);
+
+  /// Call `func(b, e)` on disjoint sub-ranges covering [begin, end),
+  /// each at least `grain` long except the last one. The first
+  /// exception thrown by `func` is rethrown after all chunks finished.
+  void parallel_for(int64_t begin, int64_t end, int64_t grain,
+                    const std::function<void(int64_t, int64_t)>& func);
+
+private:
+  struct Imp;
+  std::unique_ptr<Imp> imp_;
+};
+
+/// A task that overlaps with the calling thread, the pool counterpart
+/// of std::async(std::launch::async, func). As with std::async, the
+/// destructor waits for the task, so `func` may capture locals by
+/// reference. wait() runs the task on the calling thread when no worker
+/// has picked it up yet.
+class VAIP_DLL_SPEC AsyncTask {
+public:
+  AsyncTask() = default;
+  explicit AsyncTask(std::function<void()> func,
+                     ThreadPool& pool = ThreadPool::instance());
+  AsyncTask(AsyncTask&&) noexcept = default;
+  AsyncTask& operator=(AsyncTask&& other) noexcept;
+  ~AsyncTask();
+
+  bool valid() const { return state_ != nullptr; }
+  void wait() const;
+  /// wait() and rethrow the exception thrown by `func`, if any.
+  void get() const;
+  /// for callees that take a std::shared_future<void>.
+  std::shared_future<void> share() const;
+
+private:
+  struct State;
+  std::shared_ptr<State> state_;
+};
+
+/// Items per task so that each task touches at least ~64KB; below that
+/// the hand-off costs more than the work.
+VAIP_DLL_SPEC int64_t grain_size(int64_t bytes_per_item);
+
+/// ThreadPool::instance().parallel_for()
+VAIP_DLL_SPEC void
+parallel_for(int64_t begin, int64_t end, int64_t grain,
+             const std::function<void(int64_t, int64_t)>& func);
+
+} // namespace vaip_core
@@ -55,5 +55,7 @@
 #endif
 
 #if VAIP_USER == VAIP_USER__CUSTOM_OP || VAIP_USER == VAIP_USER__PASS
+#  include "./runtime_trace.hpp"
+#  include "./thread_pool.hpp"
 #  include "./transpose.hpp"
 #endif
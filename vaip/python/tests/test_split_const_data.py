@@ -0,0 +1,121 @@
+##
+##  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+##  Licensed under the MIT License.
+##
+# ConvertSplitOp feeds NodeInput.const_data(), a NumPy array, into the attrs
+# of the strided_slice nodes it creates; NodeBuilder.set_attr must get plain
+# ints. The C++ side is faked, so it runs without voe_cpp2py_export.
+import sys
+from unittest import mock
+
+import numpy as np
+
+try:
+    import voe.voe_cpp2py_export  # noqa: F401
+except ImportError:
+    sys.modules["voe.voe_cpp2py_export"] = mock.MagicMock()
+
+from voe.passes.convert_to_xir_op import ConvertSplitOp
+from voe.rule_ext.node import Node
+
+
+class FakeNodeArg:
+    def __init__(self, shape):
+        self._shape = shape
+
+    def shape(self):
+        return list(self._shape)
+
+
+class FakeNode:
+    def __init__(self, attrs, outputs):
+        self._attrs = attrs
+        self._outputs = outputs
+
+    def has_attr(self, name):
+        return name in self._attrs
+
+    def attr(self, name):
+        return self._attrs[name]
+
+    def outputs(self):
+        return self._outputs
+
+
+class FakeNodeInput:
+    def __init__(self, node=None, shape=None, const_data=None):
+        self._node = node
+        self._node_arg = FakeNodeArg(shape or [])
+        self._const_data = const_data
+
+    def node(self):
+        return self._node
+
+    def node_arg(self):
+        return self._node_arg
+
+    def const_data(self, vaip_pass, graph):
+        # like the C++ binding, a read-only view.
+        ret = np.array(self._const_data, dtype=np.int64)
+        ret.flags.writeable = False
+        return ret
+
+
+class FakeBuilder:
+    def __init__(self, attrs):
+        self._attrs = attrs
+
+    def set_op_type(self, op_type, domain):
+        return self
+
+    def set_input_args(self, args):
+        return self
+
+    def set_attr(self, name, value):
+        # like the C++ binding, copied on the call; the rule reuses its lists.
+        self._attrs[name] = list(value) if isinstance(value, list) else value
+        return self
+
+    def set_anchor_point_node_arg1(self, node_arg):
+        return self
+
+    def build(self):
+        return mock.MagicMock()
+
+
+class FakeGraph:
+    def __init__(self):
+        self.attrs = []
+
+    def builder(self, vaip_pass):
+        self.attrs.append({})
+        return FakeBuilder(self.attrs[-1])
+
+
+def is_int_attr(value):
+    if isinstance(value, list):
+        return all(type(v) is int for v in value)
+    return type(value) is int
+
+
+def test_split_sizes_from_const_data():
+    graph = FakeGraph()
+    rule = ConvertSplitOp()
+    rule.initialize(graph, None, None)
+    outs = [FakeNodeInput() for _ in range(3)]
+    main_node = FakeNode({"axis": 1}, outs)
+    x = Node(None, graph, FakeNodeInput(shape=[1, 10, 4]))
+    split = Node(None, graph, FakeNodeInput(const_data=[2, 3, 5]))
+    main = Node(None, graph, FakeNodeInput(node=main_node))
+    assert rule.action(main, x, split=split)
+    assert len(graph.attrs) == 3
+    for attrs in graph.attrs:
+        for name in ("begin", "end", "strides"):
+            assert is_int_attr(attrs[name]), (name, attrs[name])
+    # created from the last output to the first one.
+    assert [a["begin"][1] for a in graph.attrs] == [5, 2, 0]
+    assert [a["end"][1] for a in graph.attrs] == [10, 5, 2]
+
+
+test_split_sizes_from_const_data()
+print("ok")
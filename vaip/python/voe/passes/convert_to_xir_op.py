@@ -196,7 +196,8 @@ class ConvertSplitOp(Rule):
         split = [math.ceil(axis_size / num_outputs)] * num_outputs
         if "split" in _others:
             split_node = _others["split"]
-            split = split_node.const_data()
+            # plain ints for the attrs, not NumPy scalars.
+            split = split_node.const_data().tolist()
 
         begins = [sum(split[:i]) for i in range(num_outputs)]
 
@@ -3,6 +3,7 @@
 ##  Licensed under the MIT License.
 ##
 import voe.voe_cpp2py_export as v
+import numpy as np
 from typing import List, Union, Optional, Any
 
 
@@ -14,10 +15,10 @@ class Node(object):
         self._graph = graph
         self._node_input = node_input
 
-    def const_data(self) -> List[Any]:
+    def const_data(self) -> np.ndarray:
         return self._node_input.const_data(self._vaip_pass, self._graph)
 
-    def create_const(self, data: Union[List[Any], float]) -> None:
+    def create_const(self, data: Union[np.ndarray, List[Any], float]) -> None:
         self._node_input.node().create_const(self._vaip_pass, data)
 
     def get_consumers(self) -> List[v.NodeInput]:
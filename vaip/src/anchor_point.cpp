@@ -11,6 +11,7 @@
 #include <glog/logging.h>
 #include <google/protobuf/util/json_util.h>
 #include <iterator>
+#include <mutex>
 #include <vitis/ai/env_config.hpp>
 DEF_ENV_PARAM(DEBUG_ANCHOR_POINT, "0")
 #define MY_LOG(n) LOG_IF(INFO, ENV_PARAM(DEBUG_ANCHOR_POINT) >= n)
@@ -51,29 +52,23 @@ T fold(
   return ret;
 }
 
-static void copy_anchor_point_proto_payload(const AnchorPointProto& from,
-                                            AnchorPointProto& to) {
-  to.set_op_type(from.op_type());
-  to.set_name(from.name());
-  to.set_pass(from.pass());
-  *to.mutable_attribute() = from.attribute();
-}
-
-static std::pair<std::vector<AnchorPointProto>, std::string>
-split_anchor_point(const AnchorPointProto& anchor_point_proto) {
-  auto ret0 = std::vector<AnchorPointProto>();
-  auto ret1 = std::string();
-  ret0.reserve(5);
-  AnchorPoint::create(anchor_point_proto)
-      ->for_each([&ret0, &ret1](const AnchorPointProto& anchor_point_proto) {
-        auto elt = AnchorPointProto();
-        copy_anchor_point_proto_payload(anchor_point_proto, elt);
-        ret0.push_back(std::move(elt));
-        if (anchor_point_proto.has_origin_node()) {
-          ret1 = anchor_point_proto.origin_node();
-        }
-      });
-  return std::make_pair(ret0, ret1);
+// The links of a chain from the first to the last, and its origin node.
+// `payloads` point into the interned links, which outlive the Links.
+struct Links {
+  std::vector<const AnchorPointProto*> payloads;
+  std::string origin_node;
+};
+
+static Links split_anchor_point(const AnchorPointNode& node) {
+  auto ret = Links();
+  ret.payloads.reserve(node.length);
+  for (auto p = &node; p != nullptr; p = p->next.get()) {
+    ret.payloads.push_back(&p->payload);
+    if (p->next == nullptr) {
+      ret.origin_node = p->payload.origin_node();
+    }
+  }
+  return ret;
 }
 
 static std::string get_name_suffix(int suffix) {
@@ -83,27 +78,35 @@ static std::string get_name_suffix(int suffix) {
   }
   return ret;
 }
-static AnchorPointProto combine_anchor_point(
-    const IPass& pass,
-    const std::pair<std::vector<AnchorPointProto>, std::string>& pair) {
-  auto ret = AnchorPointProto();
-  auto p = &ret;
-  auto q = &ret; // q->next
-  for (auto x = pair.first.begin(); x != pair.first.end(); ++x) {
-    q = p;
-    copy_anchor_point_proto_payload(*x, *p);
-    p = p->mutable_next();
+
+// `payloads` in front of `tail`, which is shared, not copied.
+static AnchorPointNode::Ptr
+link_before(const std::vector<const AnchorPointProto*>& payloads,
+            AnchorPointNode::Ptr tail) {
+  for (auto it = payloads.rbegin(); it != payloads.rend(); ++it) {
+    tail = AnchorPointNode::make(**it, std::move(tail));
   }
-  if (q->has_next()) {
-    q->clear_next();
-  } else {
-    CHECK(pair.first.empty());
-    q->set_op_type(AnchorPoint::IDENTITY_OP);
-    q->set_pass("combine_empty");
+  return tail;
+}
+
+static AnchorPointNode::Ptr combine_anchor_point(const IPass& pass,
+                                                 const Links& links) {
+  auto last = AnchorPointProto();
+  if (links.payloads.empty()) {
+    last.set_op_type(AnchorPoint::IDENTITY_OP);
+    last.set_pass("combine_empty");
     auto& context = dynamic_cast<const PassContextImp&>(*pass.get_context());
-    q->set_name(pair.second + get_name_suffix(context.allocate_suffix()));
+    last.set_name(links.origin_node +
+                  get_name_suffix(context.allocate_suffix()));
+  } else {
+    last = *links.payloads.back();
+  }
+  last.set_origin_node(links.origin_node);
+  auto ret = AnchorPointNode::make(last, nullptr);
+  if (links.payloads.size() > 1) {
+    ret = link_before({links.payloads.begin(), links.payloads.end() - 1},
+                      std::move(ret));
   }
-  q->set_origin_node(pair.second);
   return ret;
 }
 
@@ -117,16 +120,15 @@ std::unique_ptr<AnchorPoint>
 AnchorPoint::create(const IPass& pass, const std::string& node_arg_name,
                     const Description& desciption) {
   auto& context = dynamic_cast<const PassContextImp&>(*pass.get_context());
-  const auto& origin_nodes = context.context_proto.origin_nodes();
-  auto it = origin_nodes.find(node_arg_name);
+  auto next = find_anchor_point_node(context, node_arg_name);
   auto proto = desciption.proto_;
   CHECK(!proto.op_type().empty());
-  auto previous_name = std::string();
-  if (it != origin_nodes.end()) {
-    previous_name = it->second.name();
-    *proto.mutable_next() = it->second;
+  auto previous_name = node_arg_name;
+  auto origin_node_name = node_arg_name;
+  if (next != nullptr) {
+    previous_name = next->payload.name();
+    origin_node_name = next->origin_node();
   } else {
-    previous_name = node_arg_name;
     proto.set_origin_node(node_arg_name);
   }
   proto.set_pass(pass.name());
@@ -135,12 +137,12 @@ AnchorPoint::create(const IPass& pass, const std::string& node_arg_name,
     if (proto.op_type() == AnchorPoint::IDENTITY_OP) {
       proto.set_name(previous_name);
     } else {
-      auto origin_node_name = AnchorPointImp(proto).origin_node_arg_name();
       proto.set_name(origin_node_name +
                      get_name_suffix(context.allocate_suffix()));
     }
   }
-  return std::make_unique<AnchorPointImp>(proto);
+  return std::make_unique<AnchorPointImp>(
+      AnchorPointNode::make(proto, std::move(next)));
 }
 
 std::unique_ptr<AnchorPoint> AnchorPoint::alias1(const IPass& pass,
@@ -151,8 +153,12 @@ std::unique_ptr<AnchorPoint> AnchorPoint::alias1(const IPass& pass,
   // possible cause: tensor_name_remove_xir_suffix returned an invalid name that
   // is not ended with _vaip_\d+
   CHECK(ret != nullptr) << "origin_name = " << origin_name;
-  const_cast<AnchorPointProto&>(ret->get_proto()).set_name(new_name);
-  return ret;
+  // links are shared, rename a new first link instead.
+  auto node = get_anchor_point_node(*ret);
+  auto proto = node->payload;
+  proto.set_name(new_name);
+  return std::make_unique<AnchorPointImp>(
+      AnchorPointNode::make(proto, node->next));
 }
 
 static int get_fix_point(const Graph& graph, const Node& node) {
@@ -253,7 +259,11 @@ AnchorPoint::create_from_siso_path(const IPass& pass, const Graph& graph,
       LOG(FATAL) << "Not supported: " << node_as_string(n);
     }
   }
-  return create(combine_anchor_point(pass, {part, origin_node_name}));
+  auto links = Links{{}, origin_node_name};
+  for (const auto& proto : part) {
+    links.payloads.push_back(&proto);
+  }
+  return std::make_unique<AnchorPointImp>(combine_anchor_point(pass, links));
 }
 
 std::unique_ptr<AnchorPoint>
@@ -266,10 +276,10 @@ AnchorPoint::create(const IPass& pass, const AnchorPointProto& next_proto,
                     const std::string& name, const Description& desciption) {
   auto proto = desciption.proto_;
   CHECK(!proto.op_type().empty());
-  *proto.mutable_next() = next_proto;
   proto.set_pass(pass.name());
   proto.set_name(name);
-  return std::make_unique<AnchorPointImp>(proto);
+  return std::make_unique<AnchorPointImp>(
+      AnchorPointNode::make(proto, AnchorPointNode::from_proto(next_proto)));
 }
 
 AnchorPoint::AnchorPoint() {}
@@ -334,32 +344,24 @@ std::string AnchorPoint::op_debug_string() const {
 }
 
 std::string AnchorPoint::origin_node_arg_name() const {
-  std::string ret = "";
-  ret = fold<std::string>(
-      ret, this->get_proto(),
-      [](const std::string& origin_node_arg_name,
-         const AnchorPointProto& anchor_point_proto) -> std::string {
-        auto ret = origin_node_arg_name;
-        if (anchor_point_proto.has_origin_node()) {
-          CHECK(ret.empty()); // only last one has origin node.
-          ret = anchor_point_proto.origin_node();
-        }
-        return ret;
-      });
+  auto node = get_anchor_point_node(*this);
+  auto ret = std::string();
+  for (auto p = node.get(); p != nullptr; p = p->next.get()) {
+    if (p->payload.has_origin_node()) {
+      CHECK(ret.empty()); // only last one has origin node.
+      ret = p->payload.origin_node();
+    }
+  }
   return ret;
 }
 
 bool AnchorPoint::is_identity(bool test_all) const {
-  auto ret = false;
+  auto node = get_anchor_point_node(*this);
+  auto ret = node->payload.op_type() == AnchorPoint::IDENTITY_OP;
   if (test_all) {
-    ret = fold<bool>(
-        true, this->get_proto(),
-        [](bool value, const AnchorPointProto& anchor_point_proto) -> bool {
-          return value &&
-                 anchor_point_proto.op_type() == AnchorPoint::IDENTITY_OP;
-        });
-  } else {
-    ret = this->get_proto().op_type() == AnchorPoint::IDENTITY_OP;
+    for (auto p = node->next.get(); ret && p != nullptr; p = p->next.get()) {
+      ret = p->payload.op_type() == AnchorPoint::IDENTITY_OP;
+    }
   }
   return ret;
 }
@@ -394,71 +396,90 @@ static bool is_identity_transpose_ap(const AnchorPointProto& ap) {
   return ret;
 }
 
-static std::pair<std::vector<AnchorPointProto>, std::string>
-remove_identity(std::pair<std::vector<AnchorPointProto>, std::string>&& pair) {
-  pair.first.erase(std::remove_if(pair.first.begin(), pair.first.end(),
-                                  [](const AnchorPointProto& ap) {
-                                    return ap.op_type() ==
-                                               AnchorPoint::IDENTITY_OP ||
-                                           is_identity_transpose_ap(ap);
-                                  }),
-                   pair.first.end());
-  return std::move(pair);
-}
-
-static std::pair<std::vector<AnchorPointProto>, std::string>
-merge_fix2float_and_float2fix(
-    std::pair<std::vector<AnchorPointProto>, std::string>&& pair) {
-  auto to_be_removed =
-      std::set<std::vector<AnchorPointProto>::difference_type>{};
-  auto find_next = [](std::vector<AnchorPointProto>::iterator from,
-                      std::vector<AnchorPointProto>::iterator end,
-                      const char* op_type) {
-    return find_if(from, end, [op_type](const AnchorPointProto& proto) {
-      return proto.op_type() == op_type;
+static Links remove_identity(Links&& links) {
+  auto& payloads = links.payloads;
+  payloads.erase(std::remove_if(payloads.begin(), payloads.end(),
+                                [](const AnchorPointProto* ap) {
+                                  return ap->op_type() ==
+                                             AnchorPoint::IDENTITY_OP ||
+                                         is_identity_transpose_ap(*ap);
+                                }),
+                 payloads.end());
+  return std::move(links);
+}
+
+static Links merge_fix2float_and_float2fix(Links&& links) {
+  using iterator = std::vector<const AnchorPointProto*>::iterator;
+  auto& payloads = links.payloads;
+  auto to_be_removed = std::vector<bool>(payloads.size(), false);
+  auto find_next = [](iterator from, iterator end, const char* op_type) {
+    return find_if(from, end, [op_type](const AnchorPointProto* proto) {
+      return proto->op_type() == op_type;
     });
   };
-  for (auto it = pair.first.begin(); it != pair.first.end();) {
-    auto end = pair.first.end();
+  for (auto it = payloads.begin(); it != payloads.end();) {
+    auto end = payloads.end();
     auto next = end;
-    if (it->op_type() == "fix2float") {
+    const auto& op_type = (*it)->op_type();
+    if (op_type == "fix2float") {
       next = find_next(it, end, "float2fix");
-    } else if (it->op_type() == "float2fix") {
+    } else if (op_type == "float2fix") {
       next = find_next(it, end, "fix2float");
-    } else if (it->op_type() == "quantize_linear") {
+    } else if (op_type == "quantize_linear") {
       next = find_next(it, end, "dequantize_linear");
-    } else if (it->op_type() == "dequantize_linear") {
+    } else if (op_type == "dequantize_linear") {
       next = find_next(it, end, "quantize_linear");
     }
     if (next != end) {
-      to_be_removed.insert(it - pair.first.begin());
-      to_be_removed.insert(next - pair.first.begin());
+      to_be_removed[it - payloads.begin()] = true;
+      to_be_removed[next - payloads.begin()] = true;
       it = next + 1;
     } else {
       it = it + 1;
     }
   }
-  auto new_first = std::vector<AnchorPointProto>{};
-  for (std::vector<AnchorPointProto>::difference_type i = 0;
-       i < (std::vector<AnchorPointProto>::difference_type)pair.first.size();
-       ++i) {
-    if (to_be_removed.find(i) == to_be_removed.end()) {
-      new_first.push_back(pair.first[i]);
+  auto kept = size_t(0);
+  for (auto i = 0u; i < payloads.size(); ++i) {
+    if (!to_be_removed[i]) {
+      payloads[kept++] = payloads[i];
     }
   }
-  return std::make_pair(new_first, pair.second);
+  payloads.resize(kept);
+  return std::move(links);
 }
 
-static AnchorPointProto optimize_internal(
-    const IPass& pass,
-    std::pair<std::vector<AnchorPointProto>, std::string>&& pair) {
-  return combine_anchor_point(
-      pass, merge_fix2float_and_float2fix(remove_identity(std::move(pair))));
+// optimize() results are memoized on the links, unless the chain is
+// optimized away, which allocates a new name every time.
+static std::mutex s_optimize_mtx;
+
+static AnchorPointNode::Ptr
+optimize_internal(const IPass& pass, const AnchorPointNode::Ptr& node) {
+  {
+    std::lock_guard<std::mutex> lock(s_optimize_mtx);
+    if (node->optimal) {
+      return node;
+    }
+    if (node->optimized != nullptr) {
+      return node->optimized;
+    }
+  }
+  auto links =
+      merge_fix2float_and_float2fix(remove_identity(split_anchor_point(*node)));
+  auto ret = combine_anchor_point(pass, links);
+  if (!links.payloads.empty()) {
+    std::lock_guard<std::mutex> lock(s_optimize_mtx);
+    if (ret == node) {
+      node->optimal = true;
+    } else {
+      node->optimized = ret;
+    }
+  }
+  return ret;
 }
 
 std::unique_ptr<AnchorPoint> AnchorPoint::optimize(const IPass& pass) const {
-  auto ret =
-      create(optimize_internal(pass, split_anchor_point(this->get_proto())));
+  auto ret = std::unique_ptr<AnchorPoint>(std::make_unique<AnchorPointImp>(
+      optimize_internal(pass, get_anchor_point_node(*this))));
   MY_LOG(1) << "before optimization:\n"
             << this->op_debug_string() << "\nafter optimization:\n"
             << ret->op_debug_string();
@@ -467,16 +488,15 @@ std::unique_ptr<AnchorPoint> AnchorPoint::optimize(const IPass& pass) const {
 
 void AnchorPoint::insert_into_context(IPass& pass) const {
   auto& context = dynamic_cast<PassContextImp&>(*pass.get_context());
-  auto origin_nodes = context.context_proto.mutable_origin_nodes();
-  const auto& name_with_suffix = this->get_proto().name();
-  auto insert_it = origin_nodes->insert(
-      google::protobuf::MapPair{name_with_suffix, this->get_proto()});
-  CHECK(insert_it.second)
+  auto node = get_anchor_point_node(*this);
+  const auto& name_with_suffix = node->payload.name();
+  auto existing = find_anchor_point_node(context, name_with_suffix);
+  CHECK(existing == nullptr)
       << "duplicated node arg name: " << name_with_suffix
       << "original anchor point:\n"
-      << AnchorPoint::create(insert_it.first->second)->op_debug_string()
-      << "new anchor point:\n"
+      << AnchorPointImp(existing).op_debug_string() << "new anchor point:\n"
       << this->op_debug_string();
+  context.anchor_points.emplace(name_with_suffix, std::move(node));
 }
 
 // std::unique_ptr<AnchorPoint>
@@ -488,31 +508,26 @@ void AnchorPoint::insert_into_context(IPass& pass) const {
 //   return anchor_point->append(origin_node_name, description);
 // }
 
+// the links of `a` followed by the whole chain `b`, with the origin node of
+// `b`. Only the links of `a` are created, `b` is shared.
 static std::unique_ptr<AnchorPoint>
-append_internal(const IPass& pass, const AnchorPointProto& a,
-                const AnchorPointProto& b,
-                int use_origin_node_a_or_b /* 0 for 1, 1 for b */) {
-  auto context = pass.get_context();
-  auto p1 = split_anchor_point(a);
-  auto p2 = split_anchor_point(b);
-  auto origin_node_name = use_origin_node_a_or_b == 0 ? p1.second : p2.second;
-  p1.first.reserve(p1.first.size() + p2.first.size());
-  std::copy(p2.first.begin(), p2.first.end(), std::back_inserter(p1.first));
-  p1.second = origin_node_name;
-  return AnchorPoint::create(combine_anchor_point(pass, std::move(p1)));
+append_internal(const AnchorPointNode::Ptr& a, AnchorPointNode::Ptr b) {
+  return std::make_unique<AnchorPointImp>(
+      link_before(split_anchor_point(*a).payloads, std::move(b)));
 }
 
 std::unique_ptr<AnchorPoint>
 AnchorPoint::append(const IPass& pass, const std::string& origin_node_name,
                     const Description& description) const {
   return append_internal(
-      pass, this->get_proto(),
-      create(pass, origin_node_name, description)->get_proto(), 1);
+      get_anchor_point_node(*this),
+      get_anchor_point_node(*create(pass, origin_node_name, description)));
 }
 
 std::unique_ptr<AnchorPoint>
 AnchorPoint::append(const IPass& pass, const AnchorPoint& rest) const {
-  return append_internal(pass, this->get_proto(), rest.get_proto(), 1);
+  return append_internal(get_anchor_point_node(*this),
+                         get_anchor_point_node(rest));
 }
 
 void AnchorPoint::for_each(
@@ -5,10 +5,13 @@
 
 #include "./anchor_point_imp.hpp"
 #include "vaip/anchor_point.hpp"
+#include <algorithm>
 #include <glog/logging.h>
 #include <initializer_list>
 #include <ios>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 #include <vaip/vaip_ort_api.h>
 #ifdef _WIN32
 #  pragma warning(push)
@@ -25,11 +28,141 @@ DEF_ENV_PARAM(DEBUG_ANCHOR_POINT, "0")
 
 namespace vaip_core_imp {
 
-AnchorPointImp::AnchorPointImp(const AnchorPointProto& proto) : proto_{proto} {}
+// Interned links, keyed by AnchorPointNode::hash. Entries of released
+// links are swept when the table has doubled since the last sweep.
+class AnchorPointTable {
+public:
+  static AnchorPointTable& instance() {
+    // never destroyed, links may outlive static destruction
+    static AnchorPointTable* table = new AnchorPointTable();
+    return *table;
+  }
+
+  AnchorPointNode::Ptr intern(const AnchorPointProto& payload,
+                              AnchorPointNode::Ptr next) {
+    auto node = std::make_shared<AnchorPointNode>();
+    auto& p = node->payload;
+    p.set_name(payload.name());
+    p.set_op_type(payload.op_type());
+    p.set_pass(payload.pass());
+    if (payload.has_attribute()) {
+      *p.mutable_attribute() = payload.attribute();
+    }
+    if (next == nullptr && payload.has_origin_node()) {
+      p.set_origin_node(payload.origin_node());
+    }
+    node->payload_bytes = p.SerializeAsString();
+    node->hash = std::hash<std::string>()(node->payload_bytes);
+    if (next != nullptr) {
+      node->hash ^= next->hash + 0x9e3779b97f4a7c15ull + (node->hash << 6) +
+                    (node->hash >> 2);
+      node->length = next->length + 1;
+    }
+    node->next = std::move(next);
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto range = links_.equal_range(node->hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto existing = it->second.lock();
+      if (existing != nullptr && existing->next == node->next &&
+          existing->payload_bytes == node->payload_bytes) {
+        return existing;
+      }
+    }
+    links_.emplace(node->hash, node);
+    if (links_.size() >= 2 * live_after_sweep_) {
+      sweep();
+    }
+    return node;
+  }
+
+private:
+  void sweep() {
+    for (auto it = links_.begin(); it != links_.end();) {
+      it = it->second.expired() ? links_.erase(it) : std::next(it);
+    }
+    live_after_sweep_ = std::max(links_.size(), (size_t)1024);
+    LOG_IF(INFO, ENV_PARAM(DEBUG_ANCHOR_POINT) >= 2)
+        << "anchor point links: " << links_.size();
+  }
+
+  std::mutex mtx_;
+  std::unordered_multimap<size_t, std::weak_ptr<const AnchorPointNode>>
+      links_;
+  size_t live_after_sweep_ = 1024;
+};
+
+AnchorPointNode::Ptr AnchorPointNode::make(const AnchorPointProto& payload,
+                                           Ptr next) {
+  return AnchorPointTable::instance().intern(payload, std::move(next));
+}
+
+AnchorPointNode::Ptr
+AnchorPointNode::from_proto(const AnchorPointProto& proto) {
+  auto links = std::vector<const AnchorPointProto*>{&proto};
+  while (links.back()->has_next()) {
+    links.push_back(&links.back()->next());
+  }
+  auto ret = Ptr();
+  for (auto it = links.rbegin(); it != links.rend(); ++it) {
+    ret = make(**it, std::move(ret));
+  }
+  return ret;
+}
+
+AnchorPointProto AnchorPointNode::to_proto() const {
+  auto ret = AnchorPointProto();
+  auto p = &ret;
+  for (auto node = this; node != nullptr; node = node->next.get()) {
+    *p = node->payload;
+    if (node->next != nullptr) {
+      p = p->mutable_next();
+    }
+  }
+  return ret;
+}
+
+const std::string& AnchorPointNode::origin_node() const {
+  auto node = this;
+  while (node->next != nullptr) {
+    node = node->next.get();
+  }
+  return node->payload.origin_node();
+}
+
+AnchorPointImp::AnchorPointImp(const AnchorPointProto& proto)
+    : node_{AnchorPointNode::from_proto(proto)} {}
+
+AnchorPointImp::AnchorPointImp(AnchorPointNode::Ptr node)
+    : node_{std::move(node)} {
+  CHECK(node_ != nullptr);
+}
 
 AnchorPointImp::~AnchorPointImp() {}
 
-const AnchorPointProto& AnchorPointImp::get_proto() const { return proto_; }
+const AnchorPointProto& AnchorPointImp::get_proto() const {
+  std::call_once(proto_once_, [this]() { proto_ = node_->to_proto(); });
+  return proto_;
+}
+
+AnchorPointNode::Ptr get_anchor_point_node(const AnchorPoint& anchor_point) {
+  auto imp = dynamic_cast<const AnchorPointImp*>(&anchor_point);
+  return imp != nullptr ? imp->get_node()
+                        : AnchorPointNode::from_proto(anchor_point.get_proto());
+}
+
+AnchorPointNode::Ptr find_anchor_point_node(const PassContextImp& context,
+                                            const std::string& name) {
+  auto it = context.anchor_points.find(name);
+  if (it != context.anchor_points.end()) {
+    return it->second;
+  }
+  // loaded from context.json of a cache
+  const auto& origin_nodes = context.context_proto.origin_nodes();
+  auto it2 = origin_nodes.find(name);
+  return it2 != origin_nodes.end() ? AnchorPointNode::from_proto(it2->second)
+                                   : nullptr;
+}
 
 } // namespace vaip_core_imp
 
@@ -43,7 +176,8 @@ std::unique_ptr<AnchorPoint> AnchorPoint::identity(const IPass& pass,
 }
 std::unique_ptr<AnchorPoint>
 AnchorPoint::identity(const IPass& pass, const std::string& node_arg_name) {
-  auto next = find_anchor_point(pass, node_arg_name);
+  auto& context = dynamic_cast<const PassContextImp&>(*pass.get_context());
+  auto next = find_anchor_point_node(context, node_arg_name);
   auto proto = AnchorPointProto();
   proto.set_op_type(AnchorPoint::IDENTITY_OP);
   proto.set_pass(pass.name());
@@ -51,20 +185,19 @@ AnchorPoint::identity(const IPass& pass, const std::string& node_arg_name) {
     proto.set_origin_node(node_arg_name);
     proto.set_name(node_arg_name);
   } else {
-    proto.set_name(next->get_proto().name());
-    *proto.mutable_next() = next->get_proto();
+    proto.set_name(next->payload.name());
   }
-  return std::make_unique<AnchorPointImp>(proto);
+  return std::make_unique<AnchorPointImp>(
+      AnchorPointNode::make(proto, std::move(next)));
 }
 
 std::unique_ptr<AnchorPoint>
 AnchorPoint::find_anchor_point(const IPass& pass, const std::string& name) {
   auto& context = dynamic_cast<const PassContextImp&>(*pass.get_context());
-  const auto& origin_nodes = context.context_proto.origin_nodes();
-  auto it = origin_nodes.find(name);
+  auto node = find_anchor_point_node(context, name);
   auto ret = std::unique_ptr<AnchorPoint>{};
-  if (it != origin_nodes.end()) {
-    ret = std::make_unique<AnchorPointImp>(it->second);
+  if (node != nullptr) {
+    ret = std::make_unique<AnchorPointImp>(std::move(node));
   }
   return ret;
 }
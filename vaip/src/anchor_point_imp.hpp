@@ -2,16 +2,66 @@
  *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
  *  Licensed under the MIT License.
  */
+#pragma once
 
 #include "vaip/anchor_point.hpp"
 
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace vaip_core {
+class PassContextImp;
+} // namespace vaip_core
+
 namespace vaip_core_imp {
 using namespace vaip_core;
+
+/// One link of an anchor point chain.
+///
+/// Links are immutable and interned: equal chains are the same object and
+/// a chain built on top of another one shares it as its tail, so append
+/// only creates the links in front of the tail. Use `AnchorPointNode::make`
+/// to create one.
+struct AnchorPointNode {
+  using Ptr = std::shared_ptr<const AnchorPointNode>;
+
+  /// `payload` is name, op_type, pass and attribute of the link. The last
+  /// link of a chain also carries the origin_node, any next in `payload`
+  /// is ignored.
+  static Ptr make(const AnchorPointProto& payload, Ptr next);
+  /// intern every link of `proto`
+  static Ptr from_proto(const AnchorPointProto& proto);
+  /// the nested proto, as it is saved in context.json
+  AnchorPointProto to_proto() const;
+  /// `origin_node` of the last link
+  const std::string& origin_node() const;
+
+  AnchorPointProto payload;
+  Ptr next;
+  // hash of the payload and of the whole tail
+  size_t hash = 0;
+  // number of links from here to the end of the chain
+  size_t length = 1;
+  // memoized AnchorPoint::optimize() of this chain, see anchor_point.cpp.
+  // Never points back to this link, `optimal` is set instead.
+  mutable Ptr optimized;
+  mutable bool optimal = false;
+
+private:
+  friend class AnchorPointTable;
+  // serialized payload, compared on interning
+  std::string payload_bytes;
+};
+
 class AnchorPointImp : public AnchorPoint {
 public:
   AnchorPointImp(const NodeArg& node_arg, const Description& desciption);
   virtual ~AnchorPointImp();
   AnchorPointImp(const AnchorPointProto& proto);
+  AnchorPointImp(AnchorPointNode::Ptr node);
+
+  const AnchorPointNode::Ptr& get_node() const { return node_; }
 
 private:
   virtual const AnchorPointProto& get_proto() const override final;
@@ -23,6 +73,17 @@ private:
   AnchorPointProto merge_proto(const AnchorPointImp* other) const;
 
 private:
-  const AnchorPointProto proto_;
+  const AnchorPointNode::Ptr node_;
+  // materialized on the first get_proto()
+  mutable std::once_flag proto_once_;
+  mutable AnchorPointProto proto_;
 };
+
+/// The chain of `anchor_point`, without converting it to a proto when it
+/// is an AnchorPointImp.
+AnchorPointNode::Ptr get_anchor_point_node(const AnchorPoint& anchor_point);
+
+/// The chain inserted into `context` as `name`, nullptr if there is none.
+AnchorPointNode::Ptr find_anchor_point_node(const PassContextImp& context,
+                                            const std::string& name);
 } // namespace vaip_core_imp
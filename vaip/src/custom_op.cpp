@@ -7,7 +7,14 @@
 // include glog/logging.h to define CHECK before include vaip_plugin.hpp
 #include "./vaip.hpp"
 #include "vaip/custom_op_imp.hpp"
+#include "3rd-party/hash-library/md5.h"
 // clang-format on
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 namespace vaip_core {
 ExecutionProvider::ExecutionProvider() {}
@@ -23,74 +30,209 @@ ExecutionProviderConcrete::ExecutionProviderConcrete(
 
 ExecutionProviderConcrete::~ExecutionProviderConcrete() {}
 
-template <typename T, typename = void> struct CustomOp_InitSession_t {
-  static Ort::Session
-  CustomOp_InitSession(const T* api, onnxruntime::Model* model,
-                       const std::shared_ptr<MetaDefProto>& meta_def) {
-    if (meta_def->fallback_cpu()) {
-      LOG(FATAL) << "Set fallback_cpu to true. your onnxruntime does not "
-                    "support model_to_proto";
-    }
-    return Ort::Session(nullptr);
+template <typename T, typename = void> struct CustomOp_ModelProto_t {
+  static constexpr bool supported = false;
+  static std::string serialize(const T* api, onnxruntime::Model* model) {
+    return std::string();
   }
+  static void release(const T* api, onnxruntime::Model* model) {}
 };
 
 template <typename T>
-struct CustomOp_InitSession_t<
+struct CustomOp_ModelProto_t<
     T, std::void_t<decltype(std::declval<T&>().model_to_proto)>> {
-  static Ort::Session
-  CustomOp_InitSession(const T* api, onnxruntime::Model* model,
-                       const std::shared_ptr<MetaDefProto>& meta_def) {
-    if (meta_def->fallback_cpu()) {
-      CHECK(model);
-      Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "VitisAI_VAIP_CustomOp");
-      auto model_proto = api->model_to_proto(*model);
-      auto mproto_string = api->model_proto_serialize_as_string(*model_proto);
-      auto session =
-          Ort::Session(env, mproto_string.get()->c_str(),
-                       mproto_string.get()->size(), Ort::SessionOptions());
-      api->model_proto_delete(model_proto);
-      api->model_delete(model);
-      return session;
-    }
-    return Ort::Session(nullptr);
+  static constexpr bool supported = true;
+  static std::string serialize(const T* api, onnxruntime::Model* model) {
+    auto model_proto = api->model_to_proto(*model);
+    auto mproto_string = api->model_proto_serialize_as_string(*model_proto);
+    auto ret = std::string(mproto_string.get()->data(),
+                           mproto_string.get()->size());
+    api->model_proto_delete(model_proto);
+    return ret;
+  }
+  static void release(const T* api, onnxruntime::Model* model) {
+    api->model_delete(model);
   }
 };
+
+using ModelProto_t = CustomOp_ModelProto_t<vaip_core::OrtApiForVaip>;
+
+/// A CPU session of a fallback_cpu subgraph, with the names and the
+/// static shapes of its inputs and outputs looked up once.
+struct CustomOpCpuSession {
+  Ort::Session session{nullptr};
+  Ort::RunOptions run_options;
+  std::vector<std::string> input_names;
+  std::vector<std::string> output_names;
+  std::vector<const char*> input_name_ptrs;
+  std::vector<const char*> output_name_ptrs;
+  // none for an output with a dynamic dimension, it is allocated by the
+  // session and copied.
+  std::vector<std::optional<std::vector<int64_t>>> output_shapes;
+};
+
+// the CPU sessions by the md5 and the size of the serialized model, shared
+// by the ops of the same subgraph, e.g. the same model in several sessions.
+// s_cpu_sessions_mtx guards the map only; a session is created under the
+// lock of its entry, so that different models are loaded in parallel. An
+// entry is erased once its session is gone.
+struct CpuSessionEntry {
+  std::mutex mtx;
+  std::weak_ptr<const CustomOpCpuSession> session;
+};
+static std::mutex s_cpu_sessions_mtx;
+static std::unordered_map<std::string, std::shared_ptr<CpuSessionEntry>>
+    s_cpu_sessions;
+
+static std::shared_ptr<CpuSessionEntry>
+get_cpu_session_entry(const std::string& model_proto) {
+  auto md5 = MD5();
+  md5.add(model_proto.data(), model_proto.size());
+  auto key = md5.getHash() + "_" + std::to_string(model_proto.size());
+  std::lock_guard<std::mutex> lock(s_cpu_sessions_mtx);
+  for (auto e = s_cpu_sessions.begin(); e != s_cpu_sessions.end();) {
+    // an entry in use by another op has no session yet, keep it.
+    auto unused = e->second.use_count() == 1 && e->second->session.expired();
+    e = unused ? s_cpu_sessions.erase(e) : std::next(e);
+  }
+  auto& ret = s_cpu_sessions[key];
+  if (ret == nullptr) {
+    ret = std::make_shared<CpuSessionEntry>();
+  }
+  return ret;
+}
+
+static std::shared_ptr<CustomOpCpuSession>
+create_cpu_session(const std::string& model_proto) {
+  auto ret = std::make_shared<CustomOpCpuSession>();
+  Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "VitisAI_VAIP_CustomOp");
+  ret->session = Ort::Session(env, model_proto.data(), model_proto.size(),
+                              Ort::SessionOptions());
+  Ort::AllocatorWithDefaultOptions allocator;
+  for (auto idx = 0u; idx < ret->session.GetInputCount(); ++idx) {
+    ret->input_names.emplace_back(
+        ret->session.GetInputNameAllocated(idx, allocator).get());
+  }
+  for (auto idx = 0u; idx < ret->session.GetOutputCount(); ++idx) {
+    ret->output_names.emplace_back(
+        ret->session.GetOutputNameAllocated(idx, allocator).get());
+    auto shape = ret->session.GetOutputTypeInfo(idx)
+                     .GetTensorTypeAndShapeInfo()
+                     .GetShape();
+    auto is_static = std::all_of(shape.begin(), shape.end(),
+                                 [](int64_t dim) { return dim >= 0; });
+    ret->output_shapes.push_back(
+        is_static ? std::make_optional(shape) : std::nullopt);
+  }
+  for (auto& name : ret->input_names) {
+    ret->input_name_ptrs.push_back(name.c_str());
+  }
+  for (auto& name : ret->output_names) {
+    ret->output_name_ptrs.push_back(name.c_str());
+  }
+  return ret;
+}
+
+static size_t element_size(ONNXTensorElementDataType type) {
+  switch (type) {
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+    return 1;
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+    return 2;
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+    return 4;
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+  case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+    return 8;
+  default:
+    LOG(FATAL) << "fallback_cpu output element type not supported: "
+               << (int)type;
+  }
+  return 0;
+}
+
 CustomOpImp::CustomOpImp(std::shared_ptr<const PassContext> context,
                          const std::shared_ptr<MetaDefProto>& meta_def,
                          onnxruntime::Model* model)
     : context_{context}, meta_def_{meta_def},
-      session_{CustomOp_InitSession_t<
-          vaip_core::OrtApiForVaip>::CustomOp_InitSession(vaip_core::api(),
-                                                          model, meta_def)} {}
-CustomOpImp::~CustomOpImp() {}
+      model_{meta_def->fallback_cpu() ? model : nullptr} {
+  if (meta_def->fallback_cpu()) {
+    if (!ModelProto_t::supported) {
+      LOG(FATAL) << "Set fallback_cpu to true. your onnxruntime does not "
+                    "support model_to_proto";
+    }
+    CHECK(model);
+  }
+}
+
+CustomOpImp::~CustomOpImp() {
+  if (model_ != nullptr) {
+    ModelProto_t::release(vaip_core::api(), model_);
+  }
+}
+
 void CustomOpImp::ComputeCpu(const OrtApi* api,
                              OrtKernelContext* context) const {
+  // model_ is released only when the session is created: if anything
+  // throws, call_once runs again on the next call and model_ is still there.
+  std::call_once(cpu_session_once_, [this]() {
+    CHECK(model_ != nullptr) << "fallback_cpu is not set";
+    auto model_proto = ModelProto_t::serialize(vaip_core::api(), model_);
+    auto entry = get_cpu_session_entry(model_proto);
+    {
+      std::lock_guard<std::mutex> lock(entry->mtx);
+      cpu_session_ = entry->session.lock();
+      if (cpu_session_ == nullptr) {
+        auto session = create_cpu_session(model_proto);
+        entry->session = session;
+        cpu_session_ = std::move(session);
+      }
+    }
+    ModelProto_t::release(vaip_core::api(), model_);
+    model_ = nullptr;
+  });
+  auto& cpu_session = *cpu_session_;
   Ort::KernelContext ctx(context);
-  Ort::AllocatorWithDefaultOptions allocator;
-  CHECK(session_);
-  std::vector<const OrtValue*> input_values;
-  std::vector<OrtValue*> output_values;
-  std::vector<const char*> input_names;
-  std::vector<const char*> output_names;
-  std::vector<Ort::AllocatedStringPtr> string_ptr;
-  for (auto idx = 0u; idx < ctx.GetInputCount(); ++idx) {
-    input_values.push_back(ctx.GetInput(idx));
-    auto name = session_.GetInputNameAllocated(idx, allocator);
-    input_names.push_back(name.get());
-    string_ptr.push_back(std::move(name));
+  auto num_of_inputs = ctx.GetInputCount();
+  auto num_of_outputs = ctx.GetOutputCount();
+  CHECK_LE(num_of_inputs, cpu_session.input_names.size());
+  CHECK_LE(num_of_outputs, cpu_session.output_names.size());
+  auto input_values = std::vector<const OrtValue*>(num_of_inputs);
+  for (auto idx = 0u; idx < num_of_inputs; ++idx) {
+    input_values[idx] = ctx.GetInput(idx);
+  }
+  auto output_values = std::vector<OrtValue*>(num_of_outputs, nullptr);
+  for (auto idx = 0u; idx < num_of_outputs; ++idx) {
+    auto& shape = cpu_session.output_shapes[idx];
+    if (shape) {
+      output_values[idx] = ctx.GetOutput(idx, *shape);
+    }
   }
-  for (auto idx = 0u; idx < ctx.GetOutputCount(); ++idx) {
-    auto shape =
-        session_.GetOutputTypeInfo(idx).GetTensorTypeAndShapeInfo().GetShape();
-    output_values.push_back(ctx.GetOutput(idx, shape));
-    auto name = session_.GetOutputNameAllocated(idx, allocator);
-    output_names.push_back(name.get());
-    string_ptr.push_back(std::move(name));
+  Ort::ThrowOnError(api->Run(
+      cpu_session.session, cpu_session.run_options,
+      cpu_session.input_name_ptrs.data(), input_values.data(), num_of_inputs,
+      cpu_session.output_name_ptrs.data(), num_of_outputs,
+      output_values.data()));
+  // the outputs with dynamic dimensions are allocated by the session now
+  // that their shapes are known.
+  for (auto idx = 0u; idx < num_of_outputs; ++idx) {
+    if (cpu_session.output_shapes[idx]) {
+      continue;
+    }
+    auto value = Ort::Value(output_values[idx]);
+    auto info = value.GetTensorTypeAndShapeInfo();
+    auto output = ctx.GetOutput(idx, info.GetShape());
+    std::memcpy(output.GetTensorMutableData<uint8_t>(),
+                value.GetTensorData<uint8_t>(),
+                info.GetElementCount() * element_size(info.GetElementType()));
   }
-  Ort::ThrowOnError(api->Run(session_, Ort::RunOptions(), input_names.data(),
-                             input_values.data(), input_names.size(),
-                             output_names.data(), output_names.size(),
-                             output_values.data()));
 }
 } // namespace vaip_core
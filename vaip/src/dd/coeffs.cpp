@@ -3,6 +3,8 @@
  *  Licensed under the MIT License.
  */
 #include "vaip/dd/coeffs.hpp"
+#include "vaip/thread_pool.hpp"
+#include <limits>
 
 namespace vaip::dd::qmatmulcalc {
 
@@ -12,6 +14,67 @@ namespace vaip::dd::qmatmulcalc {
 #  pragma GCC diagnostic ignored "-Wconversion"
 #endif
 
+// columns summed at a time, their accumulators stay in L1
+constexpr size_t COLUMN_BLOCK = 2048;
+
+template <typename T>
+static std::vector<int64_t> column_sums_imp(const WeightsView<T>& weights) {
+  auto rows = weights.rows();
+  auto cols = weights.cols();
+  auto ret = std::vector<int64_t>(cols, 0);
+  // rows summed into uint32_t before they could overflow it
+  const auto rows_per_flush =
+      std::max(std::numeric_limits<uint32_t>::max() /
+                   std::numeric_limits<T>::max(),
+               1u);
+  vaip_core::parallel_for(
+      0, (int64_t)cols, vaip_core::grain_size((int64_t)(rows * sizeof(T))),
+      [&](int64_t begin, int64_t end) {
+        uint32_t acc[COLUMN_BLOCK];
+        for (auto c0 = (size_t)begin; c0 < (size_t)end; c0 += COLUMN_BLOCK) {
+          auto n = std::min(COLUMN_BLOCK, (size_t)end - c0);
+          for (size_t r0 = 0; r0 < rows; r0 += rows_per_flush) {
+            std::fill_n(acc, n, 0u);
+            auto r1 = std::min(rows, r0 + rows_per_flush);
+            // row by row, widening adds over contiguous columns
+            for (auto r = r0; r < r1; ++r) {
+              const T* row = weights.row(r) + c0;
+              for (size_t c = 0; c < n; ++c) {
+                acc[c] += row[c];
+              }
+            }
+            for (size_t c = 0; c < n; ++c) {
+              ret[c0 + c] += acc[c];
+            }
+          }
+        }
+      });
+  return ret;
+}
+
+std::vector<int64_t> column_sums(const WeightsView<uint8_t>& weights) {
+  return column_sums_imp(weights);
+}
+
+std::vector<int64_t> column_sums(const WeightsView<uint16_t>& weights) {
+  return column_sums_imp(weights);
+}
+
+// `coeff` scaled by 2^`shift` rescaled to 2^`to_shift`, so that two
+// coefficients share one shift.
+static int64_t rescale_shift(int64_t coeff, int64_t shift, int64_t to_shift) {
+  return to_shift >= shift ? coeff << (to_shift - shift)
+                           : coeff >> (shift - to_shift);
+}
+
+// the right shift that makes `value` fit into int32.
+static int64_t int32_fit_shift(int64_t value) {
+  if (std::abs(value) <= 2147483647) { // Max int32 number
+    return 0;
+  }
+  return static_cast<int64_t>(std::ceil(std::log2(std::abs(value))) - 31);
+}
+
 std::pair<int32_t, int16_t>
 find_closest_shifted_int32_shiftmax(double float_val, int32_t max_value,
                                     float shift_max) {
@@ -184,24 +247,17 @@ std::pair<int16_t, int16_t> find_closest_shifted_int16(double float_val,
 }
 
 MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<uint16_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp) {
   int64_t a_zp_int64 = static_cast<int64_t>(a_zp);
   int64_t w_zp_int64 = static_cast<int64_t>(w_zp);
   int64_t b_zp_int64 = static_cast<int64_t>(b_zp);
   int64_t q_zp_int64 = static_cast<int64_t>(q_zp);
-  int64_t weights_in_ch = static_cast<int64_t>(weights.size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights.rows());
   int64_t matmul_shift = (int64_t)(std::min(
       std::max((int)std::ceil(std::log2(weights_in_ch)) - 7, 0), 7));
-  // Copy weights to int64_t
-  std::vector<std::vector<int64_t>> weights_int64(
-      weights.size(), std::vector<int64_t>(weights[0].size()));
-  for (size_t i = 0; i < weights.size(); ++i) {
-    for (size_t j = 0; j < weights[i].size(); ++j) {
-      weights_int64[i][j] = static_cast<int64_t>(weights[i][j]);
-    }
-  }
+  auto weights_sum = column_sums(weights);
   std::vector<int64_t> bias_min_zp(bias.size());
   for (size_t i = 0; i < bias.size(); ++i) {
     bias_min_zp[i] = (int64_t)bias[i] - b_zp_int64;
@@ -213,26 +269,12 @@ MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8(
   auto [_c4_coeff_prime, shft_c4] =
       find_closest_shifted_int32(c4_coeff, 8388607);
   int64_t c4_coeff_prime = _c4_coeff_prime;
-  if (shft_c2 != shft_c4) {
-    auto diff_shft_c2_c4 = shft_c2 - shft_c4;
-    auto abs_diff_shft_c2_c4 = std::abs((int64_t)(diff_shft_c2_c4));
-    if (diff_shft_c2_c4 > 0)
-      c4_coeff_prime = c4_coeff_prime << abs_diff_shft_c2_c4;
-    else if (diff_shft_c2_c4 < 0)
-      c4_coeff_prime = c4_coeff_prime >> abs_diff_shft_c2_c4;
-    else
-      c4_coeff_prime = c4_coeff_prime;
-  }
+  c4_coeff_prime = rescale_shift(c4_coeff_prime, shft_c4, shft_c2);
 
   c2_coeff_prime = static_cast<int64_t>(c2_coeff_prime);
-  std::vector<int64_t> c1_coeff(weights[0].size());
-  for (size_t i = 0; i < weights[0].size(); ++i) {
-    int64_t weights_sum = 0;
-    for (size_t j = 0; j < weights.size(); ++j) {
-      weights_sum += weights_int64[j][i];
-    }
-
-    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum +
+  std::vector<int64_t> c1_coeff(weights.cols());
+  for (size_t i = 0; i < weights.cols(); ++i) {
+    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum[i] +
                   (q_zp_int64 << shft_c2) + bias_min_zp[i] * c4_coeff_prime;
   }
 
@@ -240,21 +282,15 @@ MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8(
   int32_t c3_coeff_offset = (int32_t)(-a_zp_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_zp_int64;
 
-  int64_t c3_coeff_scale_shift = 0;
   // right shift c3 coeff_scale to ensure fits into int32
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
   int32_t c2 = int(c2_coeff_prime << matmul_shift);
   int32_t c1 = int(c3_coeff_scale);
 
   MatmulQDQParams ret;
-  std::vector<int64_t> c0(weights[0].size(), 0);
+  std::vector<int64_t> c0(weights.cols(), 0);
 
   int64_t temp2 = static_cast<int64_t>(
       c3_coeff_scale * ((int64_t)c3_coeff_offset << c3_coeff_scale_shift));
@@ -427,23 +463,16 @@ std::vector<int32_t> calculate_add_qdq_params(float a_sc, uint16_t a_zp,
   return qdq_params;
 }
 MatmulQDQParams calculate_matmuladd_qdq_params_uint8_uint8(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<uint16_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp) {
   int64_t a_zp_int64 = static_cast<int64_t>(a_zp);
   int64_t w_zp_int64 = static_cast<int64_t>(w_zp);
   int64_t b_zp_int64 = static_cast<int64_t>(b_zp);
   int64_t q_zp_int64 = static_cast<int64_t>(q_zp);
-  int64_t weights_in_ch = static_cast<int64_t>(weights.size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights.rows());
   int64_t matmul_shift = 0;
-  // Copy weights to int64_t
-  std::vector<std::vector<int64_t>> weights_int64(
-      weights.size(), std::vector<int64_t>(weights[0].size()));
-  for (size_t i = 0; i < weights.size(); ++i) {
-    for (size_t j = 0; j < weights[i].size(); ++j) {
-      weights_int64[i][j] = static_cast<int64_t>(weights[i][j]);
-    }
-  }
+  auto weights_sum = column_sums(weights);
   std::vector<int64_t> bias_min_zp(bias.size());
   for (size_t i = 0; i < bias.size(); ++i) {
     bias_min_zp[i] = (int64_t)bias[i] - b_zp_int64;
@@ -454,39 +483,20 @@ MatmulQDQParams calculate_matmuladd_qdq_params_uint8_uint8(
       find_closest_shifted_int32(c2_coeff, 8388607);
   auto [c4_coeff_prime, shft_c4] =
       find_closest_shifted_int32(c4_coeff, 8388607);
-  if (shft_c2 != shft_c4) {
-    auto diff_shft_c2_c4 = shft_c2 - shft_c4;
-    auto abs_diff_shft_c2_c4 = std::abs((int64_t)(diff_shft_c2_c4));
-    if (diff_shft_c2_c4 > 0)
-      c4_coeff_prime = c4_coeff_prime << abs_diff_shft_c2_c4;
-    else if (diff_shft_c2_c4 < 0)
-      c4_coeff_prime = c4_coeff_prime >> abs_diff_shft_c2_c4;
-    else
-      c4_coeff_prime = c4_coeff_prime;
-  }
+  c4_coeff_prime = rescale_shift(c4_coeff_prime, shft_c4, shft_c2);
 
   c2_coeff_prime = static_cast<int64_t>(c2_coeff_prime);
-  std::vector<int64_t> c1_coeff(weights[0].size());
-  for (size_t i = 0; i < weights[0].size(); ++i) {
-    int64_t weights_sum = 0;
-    for (size_t j = 0; j < weights.size(); ++j) {
-      weights_sum += weights_int64[j][i];
-    }
-    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum +
+  std::vector<int64_t> c1_coeff(weights.cols());
+  for (size_t i = 0; i < weights.cols(); ++i) {
+    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum[i] +
                   (q_zp_int64 << shft_c2) + bias_min_zp[i] * c4_coeff_prime;
   }
   int64_t num_weights_unrolled = weights_in_ch;
   int32_t c3_coeff_offset = (int32_t)(-a_zp_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_zp_int64;
 
-  int64_t c3_coeff_scale_shift = 0;
   // right shift c3 coeff_scale to ensure fits into int32
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
   int64_t temp = c3_coeff_scale * c3_coeff_offset;
@@ -515,24 +525,17 @@ MatmulQDQParams calculate_matmuladd_qdq_params_uint8_uint8(
 }
 
 MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8_b32(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<int32_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp) {
   int64_t a_zp_int64 = static_cast<int64_t>(a_zp);
   int64_t w_zp_int64 = static_cast<int64_t>(w_zp);
   int64_t b_zp_int64 = static_cast<int64_t>(b_zp);
   int64_t q_zp_int64 = static_cast<int64_t>(q_zp);
-  int64_t weights_in_ch = static_cast<int64_t>(weights.size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights.rows());
   int64_t matmul_shift = (int64_t)(std::min(
       std::max((int)std::ceil(std::log2(weights_in_ch)) - 7, 0), 7));
-  // Copy weights to int64_t
-  std::vector<std::vector<int64_t>> weights_int64(
-      weights.size(), std::vector<int64_t>(weights[0].size()));
-  for (size_t i = 0; i < weights.size(); ++i) {
-    for (size_t j = 0; j < weights[i].size(); ++j) {
-      weights_int64[i][j] = static_cast<int64_t>(weights[i][j]);
-    }
-  }
+  auto weights_sum = column_sums(weights);
   std::vector<int64_t> bias_min_zp(bias.size());
   for (size_t i = 0; i < bias.size(); ++i) {
     bias_min_zp[i] = (int64_t)bias[i] - b_zp_int64;
@@ -544,26 +547,12 @@ MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8_b32(
   auto [_c4_coeff_prime, shft_c4] =
       find_closest_shifted_int32(c4_coeff, 8388607);
   int64_t c4_coeff_prime = _c4_coeff_prime;
-  if (shft_c2 != shft_c4) {
-    auto diff_shft_c2_c4 = shft_c2 - shft_c4;
-    auto abs_diff_shft_c2_c4 = std::abs((int64_t)(diff_shft_c2_c4));
-    if (diff_shft_c2_c4 > 0)
-      c4_coeff_prime = c4_coeff_prime << abs_diff_shft_c2_c4;
-    else if (diff_shft_c2_c4 < 0)
-      c4_coeff_prime = c4_coeff_prime >> abs_diff_shft_c2_c4;
-    else
-      c4_coeff_prime = c4_coeff_prime;
-  }
+  c4_coeff_prime = rescale_shift(c4_coeff_prime, shft_c4, shft_c2);
 
   c2_coeff_prime = static_cast<int64_t>(c2_coeff_prime);
-  std::vector<int64_t> c1_coeff(weights[0].size());
-  for (size_t i = 0; i < weights[0].size(); ++i) {
-    int64_t weights_sum = 0;
-    for (size_t j = 0; j < weights.size(); ++j) {
-      weights_sum += weights_int64[j][i];
-    }
-
-    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum +
+  std::vector<int64_t> c1_coeff(weights.cols());
+  for (size_t i = 0; i < weights.cols(); ++i) {
+    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum[i] +
                   (q_zp_int64 << shft_c2) + bias_min_zp[i] * c4_coeff_prime;
   }
 
@@ -571,21 +560,15 @@ MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8_b32(
   int32_t c3_coeff_offset = (int32_t)(-a_zp_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_zp_int64;
 
-  int64_t c3_coeff_scale_shift = 0;
   // right shift c3 coeff_scale to ensure fits into int32
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
   int32_t c2 = int(c2_coeff_prime << matmul_shift);
   int32_t c1 = int(c3_coeff_scale);
 
   MatmulQDQParams ret;
-  std::vector<int64_t> c0(weights[0].size(), 0);
+  std::vector<int64_t> c0(weights.cols(), 0);
 
   int64_t temp2 = static_cast<int64_t>(
       c3_coeff_scale * ((int64_t)c3_coeff_offset << c3_coeff_scale_shift));
@@ -615,23 +598,16 @@ MatmulQDQParams calculate_matmuladd_qdq_params_uint16_uint8_b32(
 }
 
 MatmulQDQParams calculate_matmuladd_qdq_params_uint8_uint8_b32(
-    const std::vector<std::vector<uint8_t>>& weights,
+    const WeightsView<uint8_t>& weights,
     const std::vector<int32_t>& bias, float a_sc, uint16_t a_zp, float w_sc,
     uint16_t w_zp, float b_sc, uint16_t b_zp, float q_sc, uint16_t q_zp) {
   int64_t a_zp_int64 = static_cast<int64_t>(a_zp);
   int64_t w_zp_int64 = static_cast<int64_t>(w_zp);
   int64_t b_zp_int64 = static_cast<int64_t>(b_zp);
   int64_t q_zp_int64 = static_cast<int64_t>(q_zp);
-  int64_t weights_in_ch = static_cast<int64_t>(weights.size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights.rows());
   int64_t matmul_shift = 0;
-  // Copy weights to int64_t
-  std::vector<std::vector<int64_t>> weights_int64(
-      weights.size(), std::vector<int64_t>(weights[0].size()));
-  for (size_t i = 0; i < weights.size(); ++i) {
-    for (size_t j = 0; j < weights[i].size(); ++j) {
-      weights_int64[i][j] = static_cast<int64_t>(weights[i][j]);
-    }
-  }
+  auto weights_sum = column_sums(weights);
   std::vector<int64_t> bias_min_zp(bias.size());
   for (size_t i = 0; i < bias.size(); ++i) {
     bias_min_zp[i] = (int64_t)bias[i] - b_zp_int64;
@@ -642,39 +618,20 @@ MatmulQDQParams calculate_matmuladd_qdq_params_uint8_uint8_b32(
       find_closest_shifted_int32(c2_coeff, 8388607);
   auto [c4_coeff_prime, shft_c4] =
       find_closest_shifted_int32(c4_coeff, 8388607);
-  if (shft_c2 != shft_c4) {
-    auto diff_shft_c2_c4 = shft_c2 - shft_c4;
-    auto abs_diff_shft_c2_c4 = std::abs((int64_t)(diff_shft_c2_c4));
-    if (diff_shft_c2_c4 > 0)
-      c4_coeff_prime = c4_coeff_prime << abs_diff_shft_c2_c4;
-    else if (diff_shft_c2_c4 < 0)
-      c4_coeff_prime = c4_coeff_prime >> abs_diff_shft_c2_c4;
-    else
-      c4_coeff_prime = c4_coeff_prime;
-  }
+  c4_coeff_prime = rescale_shift(c4_coeff_prime, shft_c4, shft_c2);
 
   c2_coeff_prime = static_cast<int64_t>(c2_coeff_prime);
-  std::vector<int64_t> c1_coeff(weights[0].size());
-  for (size_t i = 0; i < weights[0].size(); ++i) {
-    int64_t weights_sum = 0;
-    for (size_t j = 0; j < weights.size(); ++j) {
-      weights_sum += weights_int64[j][i];
-    }
-    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum +
+  std::vector<int64_t> c1_coeff(weights.cols());
+  for (size_t i = 0; i < weights.cols(); ++i) {
+    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum[i] +
                   (q_zp_int64 << shft_c2) + bias_min_zp[i] * c4_coeff_prime;
   }
   int64_t num_weights_unrolled = weights_in_ch;
   int32_t c3_coeff_offset = (int32_t)(-a_zp_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_zp_int64;
 
-  int64_t c3_coeff_scale_shift = 0;
   // right shift c3 coeff_scale to ensure fits into int32
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
   int64_t temp = c3_coeff_scale * c3_coeff_offset;
@@ -703,46 +660,29 @@ MatmulQDQParams calculate_matmuladd_qdq_params_uint8_uint8_b32(
 }
 
 MatmulQDQParams calculate_matmul_qdq_params_uint8_uint8(
-    const std::vector<std::vector<uint8_t>>& weights, float a_sc, uint16_t a_zp,
+    const WeightsView<uint8_t>& weights, float a_sc, uint16_t a_zp,
     float w_sc, uint16_t w_zp, float q_sc, uint16_t q_zp) {
   int64_t a_zp_int64 = static_cast<int64_t>(a_zp);
   int64_t w_zp_int64 = static_cast<int64_t>(w_zp);
   int64_t q_zp_int64 = static_cast<int64_t>(q_zp);
-  int64_t weights_in_ch = static_cast<int64_t>(weights.size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights.rows());
   int64_t matmul_shift = 0;
-  // Copy weights to int64_t
-  std::vector<std::vector<int64_t>> weights_int64(
-      weights.size(), std::vector<int64_t>(weights[0].size()));
-  for (size_t i = 0; i < weights.size(); ++i) {
-    for (size_t j = 0; j < weights[i].size(); ++j) {
-      weights_int64[i][j] = static_cast<int64_t>(weights[i][j]);
-    }
-  }
+  auto weights_sum = column_sums(weights);
   double c2_coeff = (a_sc * w_sc) / q_sc;
   auto [c2_coeff_prime, shft_c2] =
       find_closest_shifted_int32(c2_coeff, 8388607);
   c2_coeff_prime = static_cast<int64_t>(c2_coeff_prime);
-  std::vector<int64_t> c1_coeff(weights[0].size());
-  for (size_t i = 0; i < weights[0].size(); ++i) {
-    int64_t weights_sum = 0;
-    for (size_t j = 0; j < weights.size(); ++j) {
-      weights_sum += weights_int64[j][i];
-    }
-    c1_coeff[i] =
-        (-a_zp_int64) * c2_coeff_prime * weights_sum + (q_zp_int64 << shft_c2);
+  std::vector<int64_t> c1_coeff(weights.cols());
+  for (size_t i = 0; i < weights.cols(); ++i) {
+    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum[i] +
+                  (q_zp_int64 << shft_c2);
   }
   int64_t num_weights_unrolled = weights_in_ch;
   int32_t c3_coeff_offset = (int32_t)(-a_zp_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_zp_int64;
 
-  int64_t c3_coeff_scale_shift = 0;
   // right shift c3 coeff_scale to ensure fits into int32
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
   int64_t temp = c3_coeff_scale * c3_coeff_offset;
@@ -770,20 +710,15 @@ MatmulQDQParams calculate_matmul_qdq_params_uint8_uint8(
   return ret;
 }
 
-MatmulQDQParams_3d calculate_matmul_3d_qdq_params_uint16_uint8(
-    const std::vector<std::vector<std::vector<uint8_t>>>& weights, float a_sc,
+static MatmulQDQParams_3d matmul_3d_qdq_params_uint16_uint8(
+    const std::vector<WeightsView<uint8_t>>& weights, float a_sc,
     uint16_t a_zp, float w_sc, uint16_t w_zp, float q_sc, uint16_t q_zp) {
   int64_t a_zp_int64 = static_cast<int64_t>(a_zp);
   int64_t w_zp_int64 = static_cast<int64_t>(w_zp);
   int64_t q_zp_int64 = static_cast<int64_t>(q_zp);
-  int64_t weights_in_ch = static_cast<int64_t>(weights[0].size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights[0].rows());
   int64_t matmul_shift = (int64_t)(std::min(
       std::max(25 + (int)std::ceil(std::log2(weights_in_ch)) - 32, 0), 7));
-  // Copy weights to int64_t
-  std::vector<std::vector<std::vector<int64_t>>> weights_int64(
-      weights.size(),
-      std::vector<std::vector<int64_t>>(
-          weights[0].size(), std::vector<int64_t>(weights[0][0].size())));
 
   MatmulQDQParams_3d ret;
   ret.c0_coeffs.resize(weights.size());
@@ -796,32 +731,18 @@ MatmulQDQParams_3d calculate_matmul_3d_qdq_params_uint16_uint8(
   int32_t c3_coeff_offset = (int32_t)(-a_zp_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_zp_int64;
 
-  int64_t c3_coeff_scale_shift = 0;
   // right shift c3 coeff_scale to ensure fits into int32
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
   int32_t c2 = (c2_coeff_prime << matmul_shift);
   int64_t temp = c3_coeff_scale * (c3_coeff_offset << c3_coeff_scale_shift);
 
   for (size_t batch = 0; batch < weights.size(); ++batch) {
-    for (size_t i = 0; i < weights[batch].size(); ++i) {
-      for (size_t j = 0; j < weights[batch][i].size(); ++j) {
-        weights_int64[batch][i][j] = static_cast<int64_t>(weights[batch][i][j]);
-      }
-    }
-    std::vector<int64_t> c1_coeff(weights[0][0].size());
-    for (size_t i = 0; i < weights[0][0].size(); ++i) {
-      int64_t weights_sum = 0;
-      for (size_t j = 0; j < weights[0].size(); ++j) {
-        weights_sum += weights_int64[batch][j][i];
-      }
-      c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum +
+    auto weights_sum = column_sums(weights[batch]);
+    std::vector<int64_t> c1_coeff(weights[batch].cols());
+    for (size_t i = 0; i < weights[batch].cols(); ++i) {
+      c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum[i] +
                     (q_zp_int64 << shft_c2);
     }
     std::transform(c1_coeff.begin(), c1_coeff.end(), c1_coeff.begin(),
@@ -848,48 +769,57 @@ MatmulQDQParams_3d calculate_matmul_3d_qdq_params_uint16_uint8(
   return ret;
 }
 
+MatmulQDQParams_3d calculate_matmul_3d_qdq_params_uint16_uint8(
+    const std::vector<std::vector<std::vector<uint8_t>>>& weights, float a_sc,
+    uint16_t a_zp, float w_sc, uint16_t w_zp, float q_sc, uint16_t q_zp) {
+  auto batches = std::vector<WeightsView<uint8_t>>(weights.begin(),
+                                                   weights.end());
+  return matmul_3d_qdq_params_uint16_uint8(batches, a_sc, a_zp, w_sc, w_zp,
+                                           q_sc, q_zp);
+}
+
+MatmulQDQParams_3d calculate_matmul_3d_qdq_params_uint16_uint8(
+    gsl::span<const uint8_t> weights, const std::vector<int64_t>& shape,
+    float a_sc, uint16_t a_zp, float w_sc, uint16_t w_zp, float q_sc,
+    uint16_t q_zp) {
+  CHECK_EQ(shape.size(), 3u);
+  auto batch_size = (size_t)(shape[1] * shape[2]);
+  CHECK_EQ(weights.size(), (size_t)shape[0] * batch_size);
+  auto batches = std::vector<WeightsView<uint8_t>>();
+  for (int64_t batch = 0; batch < shape[0]; ++batch) {
+    batches.emplace_back(
+        weights.subspan((size_t)batch * batch_size, batch_size),
+        (size_t)shape[1], (size_t)shape[2], (size_t)shape[2]);
+  }
+  return matmul_3d_qdq_params_uint16_uint8(batches, a_sc, a_zp, w_sc, w_zp,
+                                           q_sc, q_zp);
+}
+
 MatmulQDQParams calculate_matmul_qdq_params_uint16_uint8(
-    const std::vector<std::vector<uint8_t>>& weights, float a_sc, uint16_t a_zp,
+    const WeightsView<uint8_t>& weights, float a_sc, uint16_t a_zp,
     float w_sc, uint16_t w_zp, float q_sc, uint16_t q_zp) {
   int64_t a_zp_int64 = static_cast<int64_t>(a_zp);
   int64_t w_zp_int64 = static_cast<int64_t>(w_zp);
   int64_t q_zp_int64 = static_cast<int64_t>(q_zp);
-  int64_t weights_in_ch = static_cast<int64_t>(weights.size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights.rows());
   int64_t matmul_shift = (int64_t)(std::min(
       std::max(25 + (int)std::ceil(std::log2(weights_in_ch)) - 32, 0), 7));
-  // Copy weights to int64_t
-  std::vector<std::vector<int64_t>> weights_int64(
-      weights.size(), std::vector<int64_t>(weights[0].size()));
-  for (size_t i = 0; i < weights.size(); ++i) {
-    for (size_t j = 0; j < weights[i].size(); ++j) {
-      weights_int64[i][j] = static_cast<int64_t>(weights[i][j]);
-    }
-  }
+  auto weights_sum = column_sums(weights);
   double c2_coeff = (a_sc * w_sc) / q_sc;
   auto [c2_coeff_prime, shft_c2] =
       find_closest_shifted_int32(c2_coeff, 8388607);
   c2_coeff_prime = static_cast<int64_t>(c2_coeff_prime);
-  std::vector<int64_t> c1_coeff(weights[0].size());
-  for (size_t i = 0; i < weights[0].size(); ++i) {
-    int64_t weights_sum = 0;
-    for (size_t j = 0; j < weights.size(); ++j) {
-      weights_sum += weights_int64[j][i];
-    }
-    c1_coeff[i] =
-        (-a_zp_int64) * c2_coeff_prime * weights_sum + (q_zp_int64 << shft_c2);
+  std::vector<int64_t> c1_coeff(weights.cols());
+  for (size_t i = 0; i < weights.cols(); ++i) {
+    c1_coeff[i] = (-a_zp_int64) * c2_coeff_prime * weights_sum[i] +
+                  (q_zp_int64 << shft_c2);
   }
   int64_t num_weights_unrolled = weights_in_ch;
   int32_t c3_coeff_offset = (int32_t)(-a_zp_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_zp_int64;
 
-  int64_t c3_coeff_scale_shift = 0;
   // right shift c3 coeff_scale to ensure fits into int32
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
   int32_t c2 = (c2_coeff_prime << matmul_shift);
@@ -976,7 +906,7 @@ global_avg_pool_qdq(double a_sc, uint16_t a_zp, double b_sc, uint16_t b_zp) {
 
 std::tuple<std::vector<int64_t>, int32_t, int64_t, int64_t, int64_t, int64_t>
 compute_qdq_coeff_matmul_bias(float a_dq_xscale, uint8_t a_dq_xzero_pt,
-                              const std::vector<std::vector<uint8_t>>& weights,
+                              const WeightsView<uint8_t>& weights,
                               float w_dq_xscale, uint8_t w_dq_xzero_pt,
                               const std::vector<uint16_t>& bias,
                               float b_dq_xscale, uint8_t b_dq_xzero_pt,
@@ -988,17 +918,11 @@ compute_qdq_coeff_matmul_bias(float a_dq_xscale, uint8_t a_dq_xzero_pt,
   // assert(weights.size() > 0 && weights[0].size() > 0);  // weights shape
   // should be 2 dims
 
-  int64_t weights_in_ch = static_cast<int64_t>(weights.size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights.rows());
 
   int64_t matmul_shift = 0;
 
-  std::vector<std::vector<int64_t>> weights_int64(
-      weights.size(), std::vector<int64_t>(weights[0].size()));
-  for (size_t i = 0; i < weights.size(); ++i) {
-    for (size_t j = 0; j < weights[i].size(); ++j) {
-      weights_int64[i][j] = static_cast<int64_t>(weights[i][j]);
-    }
-  }
+  auto weights_sum = column_sums(weights);
 
   std::vector<int64_t> bias_min_zp(bias.size());
   std::transform(bias.begin(), bias.end(), bias_min_zp.begin(),
@@ -1014,25 +938,13 @@ compute_qdq_coeff_matmul_bias(float a_dq_xscale, uint8_t a_dq_xzero_pt,
   auto [c4_coeff_prime, shft_c4] =
       find_closest_shifted_int32(c4_coeff, 8388607);
 
-  if (shft_c2 != shft_c4) {
-    int64_t diff_shft_c2_c4 = shft_c2 - shft_c4;
-    int64_t abs_diff_shft_c2_c4 = std::abs(diff_shft_c2_c4);
-    if (diff_shft_c2_c4 > 0) {
-      c4_coeff_prime = c4_coeff_prime << abs_diff_shft_c2_c4;
-    } else if (diff_shft_c2_c4 < 0) {
-      c4_coeff_prime = c4_coeff_prime >> abs_diff_shft_c2_c4;
-    }
-  }
+  c4_coeff_prime = rescale_shift(c4_coeff_prime, shft_c4, shft_c2);
 
   c2_coeff_prime = static_cast<int64_t>(c2_coeff_prime);
 
-  std::vector<int64_t> c1_coeff(weights[0].size());
-  for (size_t i = 0; i < weights[0].size(); ++i) {
-    int64_t weights_sum = 0;
-    for (size_t j = 0; j < weights.size(); ++j) {
-      weights_sum += weights_int64[j][i];
-    }
-    c1_coeff[i] = (-a_dq_xzero_pt_int64) * c2_coeff_prime * weights_sum +
+  std::vector<int64_t> c1_coeff(weights.cols());
+  for (size_t i = 0; i < weights.cols(); ++i) {
+    c1_coeff[i] = (-a_dq_xzero_pt_int64) * c2_coeff_prime * weights_sum[i] +
                   (a_q_yzero_pt_int64 << shft_c2) +
                   (bias_min_zp[i] * c4_coeff_prime);
   }
@@ -1041,14 +953,7 @@ compute_qdq_coeff_matmul_bias(float a_dq_xscale, uint8_t a_dq_xzero_pt,
   int32_t c3_coeff_offset =
       static_cast<int32_t>(-a_dq_xzero_pt_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_dq_xzero_pt_int64;
-  int64_t c3_coeff_scale_shift = 0;
-
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
   int64_t temp = c3_coeff_scale * c3_coeff_offset;
@@ -1063,7 +968,7 @@ compute_qdq_coeff_matmul_bias(float a_dq_xscale, uint8_t a_dq_xzero_pt,
 std::tuple<std::vector<int64_t>, int32_t, int64_t, int64_t, int64_t, int64_t>
 dq_uint16A_uint16W_bias_matmul_q_param_gen(
     float a_dq_xscale, uint16_t a_dq_xzero_pt,
-    const std::vector<std::vector<uint16_t>>& weights, float w_dq_xscale,
+    const WeightsView<uint16_t>& weights, float w_dq_xscale,
     uint16_t w_dq_xzero_pt, const std::vector<uint16_t>& bias,
     float b_dq_xscale, uint16_t b_dq_xzero_pt, float a_q_yscale,
     uint16_t a_q_yzero_pt, std::vector<int> shifts) {
@@ -1072,20 +977,14 @@ dq_uint16A_uint16W_bias_matmul_q_param_gen(
   int64_t w_dq_xzero_pt_int64 = static_cast<int64_t>(w_dq_xzero_pt);
   int64_t a_q_yzero_pt_int64 = static_cast<int64_t>(a_q_yzero_pt);
 
-  int64_t weights_in_ch = static_cast<int64_t>(weights.size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights.rows());
 
   int64_t matmul_shift = std::min(
       std::max(static_cast<int64_t>(std::ceil(std::log2(weights_in_ch))) - 1,
                int64_t(0)),
       int64_t(15));
 
-  std::vector<std::vector<int64_t>> weights_int64(
-      weights.size(), std::vector<int64_t>(weights[0].size()));
-  for (size_t i = 0; i < weights.size(); ++i) {
-    for (size_t j = 0; j < weights[i].size(); ++j) {
-      weights_int64[i][j] = static_cast<int64_t>(weights[i][j]);
-    }
-  }
+  auto weights_sum = column_sums(weights);
 
   std::vector<int64_t> bias_min_zp(bias.size());
   std::transform(bias.begin(), bias.end(), bias_min_zp.begin(),
@@ -1100,25 +999,13 @@ dq_uint16A_uint16W_bias_matmul_q_param_gen(
   auto [_c4_coeff_prime, shft_c4] = find_closest_shifted_int16(c4_coeff, 32767);
   int64_t c4_coeff_prime = _c4_coeff_prime;
 
-  if (shft_c2 != shft_c4) {
-    int64_t diff_shft_c2_c4 = shft_c2 - shft_c4;
-    int64_t abs_diff_shft_c2_c4 = std::abs(diff_shft_c2_c4);
-    if (diff_shft_c2_c4 > 0) {
-      c4_coeff_prime = c4_coeff_prime << abs_diff_shft_c2_c4;
-    } else if (diff_shft_c2_c4 < 0) {
-      c4_coeff_prime = c4_coeff_prime >> abs_diff_shft_c2_c4;
-    }
-  }
+  c4_coeff_prime = rescale_shift(c4_coeff_prime, shft_c4, shft_c2);
 
   c2_coeff_prime = static_cast<int64_t>(c2_coeff_prime);
 
-  std::vector<int64_t> c1_coeff(weights[0].size());
-  for (size_t i = 0; i < weights[0].size(); ++i) {
-    int64_t weights_sum = 0;
-    for (size_t j = 0; j < weights.size(); ++j) {
-      weights_sum += weights_int64[j][i];
-    }
-    c1_coeff[i] = (-a_dq_xzero_pt_int64) * c2_coeff_prime * weights_sum +
+  std::vector<int64_t> c1_coeff(weights.cols());
+  for (size_t i = 0; i < weights.cols(); ++i) {
+    c1_coeff[i] = (-a_dq_xzero_pt_int64) * c2_coeff_prime * weights_sum[i] +
                   (a_q_yzero_pt_int64 << shft_c2) +
                   (bias_min_zp[i] * c4_coeff_prime);
   }
@@ -1127,14 +1014,7 @@ dq_uint16A_uint16W_bias_matmul_q_param_gen(
   int32_t c3_coeff_offset =
       static_cast<int32_t>(-a_dq_xzero_pt_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_dq_xzero_pt_int64;
-  int64_t c3_coeff_scale_shift = 0;
-
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
 
@@ -1159,7 +1039,7 @@ dq_uint16A_uint16W_bias_matmul_q_param_gen(
 std::tuple<std::vector<int64_t>, int32_t, int64_t, int64_t, int64_t, int64_t>
 dq_uint16A_uint8W_bias_matmul_q_param_gen(
     float a_dq_xscale, uint16_t a_dq_xzero_pt,
-    const std::vector<std::vector<uint8_t>>& weights, float w_dq_xscale,
+    const WeightsView<uint8_t>& weights, float w_dq_xscale,
     uint16_t w_dq_xzero_pt, const std::vector<uint16_t>& bias,
     float b_dq_xscale, uint16_t b_dq_xzero_pt, float a_q_yscale,
     uint16_t a_q_yzero_pt) {
@@ -1171,20 +1051,14 @@ dq_uint16A_uint8W_bias_matmul_q_param_gen(
   // assert(weights.size() > 0 && weights[0].size() > 0);  // weights shape
   // should be 2 dims
 
-  int64_t weights_in_ch = static_cast<int64_t>(weights.size());
+  int64_t weights_in_ch = static_cast<int64_t>(weights.rows());
 
   int64_t matmul_shift = std::min(
       std::max(static_cast<int64_t>(std::ceil(std::log2(weights_in_ch))) - 7,
                int64_t(0)),
       int64_t(7));
 
-  std::vector<std::vector<int64_t>> weights_int64(
-      weights.size(), std::vector<int64_t>(weights[0].size()));
-  for (size_t i = 0; i < weights.size(); ++i) {
-    for (size_t j = 0; j < weights[i].size(); ++j) {
-      weights_int64[i][j] = static_cast<int64_t>(weights[i][j]);
-    }
-  }
+  auto weights_sum = column_sums(weights);
 
   std::vector<int64_t> bias_min_zp(bias.size());
   std::transform(bias.begin(), bias.end(), bias_min_zp.begin(),
@@ -1201,25 +1075,13 @@ dq_uint16A_uint8W_bias_matmul_q_param_gen(
       find_closest_shifted_int32(c4_coeff, 8388607);
   int64_t c4_coeff_prime = _c4_coeff_prime;
 
-  if (shft_c2 != shft_c4) {
-    int64_t diff_shft_c2_c4 = shft_c2 - shft_c4;
-    int64_t abs_diff_shft_c2_c4 = std::abs(diff_shft_c2_c4);
-    if (diff_shft_c2_c4 > 0) {
-      c4_coeff_prime = c4_coeff_prime << abs_diff_shft_c2_c4;
-    } else if (diff_shft_c2_c4 < 0) {
-      c4_coeff_prime = c4_coeff_prime >> abs_diff_shft_c2_c4;
-    }
-  }
+  c4_coeff_prime = rescale_shift(c4_coeff_prime, shft_c4, shft_c2);
 
   c2_coeff_prime = static_cast<int64_t>(c2_coeff_prime);
 
-  std::vector<int64_t> c1_coeff(weights[0].size());
-  for (size_t i = 0; i < weights[0].size(); ++i) {
-    int64_t weights_sum = 0;
-    for (size_t j = 0; j < weights.size(); ++j) {
-      weights_sum += weights_int64[j][i];
-    }
-    c1_coeff[i] = (-a_dq_xzero_pt_int64) * c2_coeff_prime * weights_sum +
+  std::vector<int64_t> c1_coeff(weights.cols());
+  for (size_t i = 0; i < weights.cols(); ++i) {
+    c1_coeff[i] = (-a_dq_xzero_pt_int64) * c2_coeff_prime * weights_sum[i] +
                   (a_q_yzero_pt_int64 << shft_c2) +
                   (bias_min_zp[i] * c4_coeff_prime);
   }
@@ -1228,14 +1090,7 @@ dq_uint16A_uint8W_bias_matmul_q_param_gen(
   int32_t c3_coeff_offset =
       static_cast<int32_t>(-a_dq_xzero_pt_int64 * num_weights_unrolled);
   int64_t c3_coeff_scale = -c2_coeff_prime * w_dq_xzero_pt_int64;
-  int64_t c3_coeff_scale_shift = 0;
-
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
   int64_t temp = c3_coeff_scale * c3_coeff_offset << c3_coeff_scale_shift;
@@ -1366,14 +1221,7 @@ qdq_act_matmul_uint8_uint8_cstm(float a_dq_xscale, int64_t a_dq_xzero_pt,
 
   // Calculate the weight coefficient scale
   int64_t weight_coeff_scale = -c2_coeff_prime * a_dq_xzero_pt_i64;
-  int32_t weight_coeff_scale_shift = 0;
-
-  if (std::abs(weight_coeff_scale) > 2147483647) { // Max int32 number
-    weight_coeff_scale_shift = static_cast<int32_t>(
-        std::ceil(std::log2(std::abs(weight_coeff_scale))) - 31);
-  } else {
-    weight_coeff_scale_shift = 0;
-  }
+  int32_t weight_coeff_scale_shift = int32_fit_shift(weight_coeff_scale);
 
   weight_coeff_scale =
       static_cast<int32_t>(weight_coeff_scale >> weight_coeff_scale_shift);
@@ -1388,13 +1236,7 @@ qdq_act_matmul_uint8_uint8_cstm(float a_dq_xscale, int64_t a_dq_xzero_pt,
   c1_coeff += c3_coeff_scale * static_cast<int64_t>(c3_coeff_offset);
 
   // Calculate the shift for c3 coefficient scale
-  int32_t c3_coeff_scale_shift = 0;
-  if (std::abs(c3_coeff_scale) > 2147483647) { // Max int32 number
-    c3_coeff_scale_shift = static_cast<int32_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  } else {
-    c3_coeff_scale_shift = 0;
-  }
+  int32_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale = static_cast<int32_t>(c3_coeff_scale >> c3_coeff_scale_shift);
 
@@ -1461,10 +1303,10 @@ qdq_act_matmul_uint16_uint16_cstm(float a_dq_xscale, int64_t a_dq_xzero_pt,
 }
 
 std::tuple<int64_t, int32_t, int32_t, int64_t, int64_t, int64_t>
-qdq_matmul_uint16_uint8_cstm(std::vector<uint8_t> weights, float a_dq_xscale,
-                             int64_t a_dq_xzero_pt, float w_dq_xscale,
-                             int64_t w_dq_xzero_pt, float a_q_yscale,
-                             int64_t a_q_yzero_pt) {
+qdq_matmul_uint16_uint8_cstm(gsl::span<const uint8_t> weights,
+                             float a_dq_xscale, int64_t a_dq_xzero_pt,
+                             float w_dq_xscale, int64_t w_dq_xzero_pt,
+                             float a_q_yscale, int64_t a_q_yzero_pt) {
 
   int64_t a_dq_xzero_pt_int64 = static_cast<int64_t>(a_dq_xzero_pt);
   // int64_t w_dq_xzero_pt_int64 = static_cast<int64_t>(w_dq_xzero_pt);
@@ -1475,10 +1317,7 @@ qdq_matmul_uint16_uint8_cstm(std::vector<uint8_t> weights, float a_dq_xscale,
   int64_t matmul_shift = std::min(
       std::max(25 + (int32_t)std::ceil(std::log2(weights_in_ch)) - 32, 0), 7);
 
-  std::vector<int64_t> weights_int64;
-  for (const auto& weight : weights) {
-    weights_int64.push_back(static_cast<int64_t>(weight));
-  }
+  auto weights_sum = std::accumulate(weights.begin(), weights.end(), 0LL);
 
   double c2_coeff = (a_dq_xscale * w_dq_xscale) / a_q_yscale;
 
@@ -1491,7 +1330,7 @@ qdq_matmul_uint16_uint8_cstm(std::vector<uint8_t> weights, float a_dq_xscale,
 
   int64_t c1_coeff =
       (-a_dq_xzero_pt_int64) * c2_coeff_prime_int64 *
-          std::accumulate(weights_int64.begin(), weights_int64.end(), 0LL) +
+          weights_sum +
       (a_q_yzero_pt_int64 << shft_c2);
 
   int64_t c1_coeff_int64 = static_cast<int64_t>(c1_coeff);
@@ -1499,11 +1338,7 @@ qdq_matmul_uint16_uint8_cstm(std::vector<uint8_t> weights, float a_dq_xscale,
   int32_t c3_coeff_offset = -a_dq_xzero_pt_int64 * num_weights_unrolled;
   int64_t c3_coeff_scale = -c2_coeff_prime_int64 * w_dq_xzero_pt;
 
-  int64_t c3_coeff_scale_shift = 0;
-  if (std::abs(c3_coeff_scale) > 2147483647) {
-    c3_coeff_scale_shift = static_cast<int64_t>(
-        std::ceil(std::log2(std::abs(c3_coeff_scale))) - 31);
-  }
+  int64_t c3_coeff_scale_shift = int32_fit_shift(c3_coeff_scale);
 
   c3_coeff_scale >>= c3_coeff_scale_shift;
   int32_t c3_coeff_scale_int32 = static_cast<int32_t>(c3_coeff_scale);
@@ -1854,17 +1689,7 @@ dq_uint16A_int4W_conv_chwise_bias_add_q_param_gen(
   int32_t shft_c4 = 0;
   std::tie(c4_coeff_prime, shft_c4) =
       find_closest_shifted_int32_shiftmax(c4_coeff, 8388607, shift_max);
-  if (shft_c2 != shft_c4) {
-    int64_t diff_shft_c2_c4 = shft_c2 - shft_c4;
-    int64_t abs_diff_shft_c2_c4 = std::abs(diff_shft_c2_c4);
-    if (diff_shft_c2_c4 > 0) {
-      c4_coeff_prime = c4_coeff_prime << abs_diff_shft_c2_c4;
-    } else if (diff_shft_c2_c4 < 0) {
-      c4_coeff_prime = c4_coeff_prime >> abs_diff_shft_c2_c4;
-    } else {
-      c4_coeff_prime = c4_coeff_prime;
-    }
-  }
+  c4_coeff_prime = rescale_shift(c4_coeff_prime, shft_c4, shft_c2);
 
   int64_t o_zp_int64 = static_cast<int64_t>(o_zp);
   std::vector<int64_t> c3_coeff_scale(w_shape[0], 0);
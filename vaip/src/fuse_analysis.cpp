@@ -0,0 +1,179 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "./fuse_analysis.hpp"
+#include "vaip/node.hpp"
+#include "vaip/node_arg.hpp"
+#include <algorithm>
+#include <functional>
+#include <glog/logging.h>
+#include <mutex>
+#include <queue>
+#include <vaip/my_ort.h>
+#include <vaip/vaip_ort_api.h>
+#include <vitis/ai/env_config.hpp>
+DEF_ENV_PARAM(DEBUG_FUSE_ANALYSIS, "0")
+#define MY_LOG(n) LOG_IF(INFO, ENV_PARAM(DEBUG_FUSE_ANALYSIS) >= n)
+
+namespace vaip_core {
+
+static std::mutex s_mtx;
+static std::unordered_map<const Graph*, std::shared_ptr<const FuseAnalysis>>
+    s_analyses;
+
+std::shared_ptr<const FuseAnalysis> FuseAnalysis::get(const Graph& graph) {
+  {
+    std::lock_guard<std::mutex> lock(s_mtx);
+    auto it = s_analyses.find(&graph);
+    if (it != s_analyses.end()) {
+      return it->second;
+    }
+  }
+  auto ret = std::make_shared<const FuseAnalysis>(graph);
+  std::lock_guard<std::mutex> lock(s_mtx);
+  s_analyses[&graph] = ret;
+  return ret;
+}
+
+void FuseAnalysis::invalidate(const Graph& graph) {
+  std::lock_guard<std::mutex> lock(s_mtx);
+  s_analyses.erase(&graph);
+}
+
+FuseAnalysis::FuseAnalysis(const Graph& graph) {
+  auto all_nodes = graph_nodes(graph);
+  auto max_index = size_t(0);
+  for (auto n : all_nodes) {
+    CHECK(n != nullptr);
+    max_index = std::max(max_index, (size_t)VAIP_ORT_API(node_get_index)(*n));
+  }
+  rank_.assign(all_nodes.empty() ? 0 : max_index + 1, -1);
+  auto next_rank = int64_t(0);
+  VAIP_ORT_API(graph_reverse_dfs_from)
+  (
+      graph, all_nodes, nullptr,
+      [this, &next_rank](const Node* n) {
+        rank_[VAIP_ORT_API(node_get_index)(*n)] = next_rank++;
+      },
+      nullptr);
+
+  for (auto arg : graph_get_inputs(graph)) {
+    graph_inputs_.insert(arg);
+  }
+  for (auto arg : graph_get_outputs(graph)) {
+    graph_outputs_.insert(arg);
+  }
+
+  auto reachable = std::vector<bool>(rank_.size(), false);
+  VAIP_ORT_API(graph_reverse_dfs_from)
+  (
+      graph, graph_get_output_nodes(graph),
+      [&reachable](const Node* n) {
+        reachable[VAIP_ORT_API(node_get_index)(*n)] = true;
+      },
+      nullptr, nullptr);
+  for (auto n : all_nodes) {
+    auto index = (size_t)VAIP_ORT_API(node_get_index)(*n);
+    if (reachable[index]) {
+      continue;
+    }
+    auto pos = islands_.size();
+    islands_.push_back(index);
+    auto has_producer = false;
+    for (auto& input : node_get_inputs(*n)) {
+      if (input.node != nullptr) {
+        auto& consumers =
+            islands_by_producer_[VAIP_ORT_API(node_get_index)(*input.node)];
+        if (consumers.empty() || consumers.back() != pos) {
+          consumers.push_back(pos);
+        }
+        has_producer = true;
+      }
+    }
+    if (!has_producer) {
+      free_islands_.push_back(pos);
+    }
+  }
+  MY_LOG(1) << "fuse analysis: nodes=" << all_nodes.size()
+            << " isolated=" << islands_.size();
+}
+
+int64_t FuseAnalysis::rank(const Node& node) const {
+  auto index = (size_t)VAIP_ORT_API(node_get_index)(node);
+  return index < rank_.size() ? rank_[index] : -1;
+}
+
+bool FuseAnalysis::covers(const std::vector<const Node*>& nodes) const {
+  return std::all_of(nodes.begin(), nodes.end(),
+                     [this](const Node* n) { return rank(*n) >= 0; });
+}
+
+bool FuseAnalysis::is_graph_input(const NodeArg* node_arg) const {
+  return graph_inputs_.find(node_arg) != graph_inputs_.end();
+}
+
+bool FuseAnalysis::is_graph_output(const NodeArg* node_arg) const {
+  return graph_outputs_.find(node_arg) != graph_outputs_.end();
+}
+
+std::vector<const Node*>
+FuseAnalysis::islands_of(const Graph& graph,
+                         const std::unordered_set<const Node*>& body) const {
+  auto ret = std::vector<const Node*>();
+  if (islands_.empty()) {
+    return ret;
+  }
+  // positions are visited in increasing order, only later islands are
+  // queued, so this is one pass over the islands in graph order.
+  auto queue = std::priority_queue<size_t, std::vector<size_t>,
+                                   std::greater<size_t>>(free_islands_.begin(),
+                                                         free_islands_.end());
+  auto queue_consumers = [this, &queue](const Node& producer) {
+    auto it = islands_by_producer_.find(VAIP_ORT_API(node_get_index)(producer));
+    if (it != islands_by_producer_.end()) {
+      for (auto pos : it->second) {
+        queue.push(pos);
+      }
+    }
+  };
+  for (auto n : body) {
+    queue_consumers(*n);
+  }
+  auto added = std::unordered_set<const Node*>();
+  auto last = islands_.size();
+  while (!queue.empty()) {
+    auto pos = queue.top();
+    queue.pop();
+    if (pos == last) {
+      continue;
+    }
+    last = pos;
+    auto island = VAIP_ORT_API(graph_get_node)(graph, islands_[pos]);
+    if (island == nullptr) {
+      continue;
+    }
+    auto is_body = true;
+    for (auto& input : node_get_inputs(*island)) {
+      is_body = is_body &&
+                (input.node == nullptr || body.count(input.node) != 0 ||
+                 added.count(input.node) != 0);
+    }
+    if (is_body) {
+      ret.push_back(island);
+      added.insert(island);
+      auto it = islands_by_producer_.find(islands_[pos]);
+      if (it != islands_by_producer_.end()) {
+        for (auto consumer : it->second) {
+          if (consumer > pos) {
+            queue.push(consumer);
+          }
+        }
+      }
+    }
+  }
+  return ret;
+}
+
+} // namespace vaip_core
@@ -0,0 +1,63 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+#include "vaip/graph.hpp"
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace vaip_core {
+
+/// Whole graph facts that IPass_try_fuse() needs for every candidate:
+/// topological ranks, graph inputs and outputs, and the isolated nodes,
+/// i.e. the nodes no graph output depends on.
+///
+/// They are computed once per graph and dropped by graph_resolve(), which
+/// IPass::fuse() and the pass runner call after every change, and when the
+/// model of the graph is created or deleted, so a graph at the address of
+/// a deleted one does not see its analysis. Nodes are
+/// kept by index, a node removed without a resolve is simply not found
+/// any more, and a node added without one has no rank.
+class FuseAnalysis {
+public:
+  /// the analysis of `graph`, built on first use.
+  VAIP_DLL_SPEC static std::shared_ptr<const FuseAnalysis>
+  get(const Graph& graph);
+  /// drop the analysis of `graph`, it has changed.
+  VAIP_DLL_SPEC static void invalidate(const Graph& graph);
+
+  explicit FuseAnalysis(const Graph& graph);
+
+  /// position of `node` in a topological order of the graph, producers
+  /// first. -1 for a node added after the analysis.
+  int64_t rank(const Node& node) const;
+  /// all `nodes` have a rank
+  bool covers(const std::vector<const Node*>& nodes) const;
+  bool is_graph_input(const NodeArg* node_arg) const;
+  bool is_graph_output(const NodeArg* node_arg) const;
+
+  /// Isolated nodes whose producer nodes are all in `body` or in the
+  /// result, in graph order. An isolated node is checked once, in graph
+  /// order, so it may only depend on isolated nodes before it.
+  std::vector<const Node*>
+  islands_of(const Graph& graph,
+             const std::unordered_set<const Node*>& body) const;
+
+private:
+  // by node index
+  std::vector<int64_t> rank_;
+  std::unordered_set<const NodeArg*> graph_inputs_;
+  std::unordered_set<const NodeArg*> graph_outputs_;
+  // node indices of the isolated nodes, in graph order
+  std::vector<size_t> islands_;
+  // producer node index -> positions in islands_ of its consumers
+  std::unordered_map<size_t, std::vector<size_t>> islands_by_producer_;
+  // positions in islands_ of the islands without a producer node
+  std::vector<size_t> free_islands_;
+};
+
+} // namespace vaip_core
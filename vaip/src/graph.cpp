@@ -5,6 +5,9 @@
 
 #include "vaip/pass.hpp"
 #define VAIP_USE_DEPRECATED_API 1
+#include "./fuse_analysis.hpp"
+#include "./graph_symbols.hpp"
+#include "./node_arg_cache.hpp"
 #include "vaip/anchor_point.hpp"
 #include "vaip/graph.hpp"
 #include "vaip/node.hpp"
@@ -30,6 +33,7 @@ graph_add_node(Graph& graph, const std::string& name,
   auto& ret = VAIP_ORT_API(graph_add_node)(graph, name, op_type, description,
                                            input_args, output_args,
                                            *attributes.get(), domain);
+  GraphSymbols::node_added(graph);
   return ret;
 }
 
@@ -427,6 +431,9 @@ void graph_gc(Graph& graph) {
       }, //
       nullptr);
   MY_LOG(1) << "prepare to remove " << all_nodes.size() << " nodes";
+  FuseAnalysis::invalidate(graph);
+  GraphSymbols::invalidate(graph);
+  NodeArgCache::invalidate(graph);
   for (auto n : all_nodes) {
     MY_LOG(1) << "\tremove " << node_as_string(*n);
     VAIP_ORT_API(graph_remove_node)(graph, {n, nullptr});
@@ -434,6 +441,9 @@ void graph_gc(Graph& graph) {
 }
 
 VAIP_DLL_SPEC void graph_resolve(Graph& graph, bool force) {
+  FuseAnalysis::invalidate(graph);
+  GraphSymbols::invalidate(graph);
+  NodeArgCache::invalidate(graph);
   auto status = VAIP_ORT_API(graph_resolve)(graph, force);
   CHECK(status == 0) << " resolve error: " << status;
   return;
@@ -518,6 +528,46 @@ graph_get_consumer_nodes(const Graph& graph, const std::string& node_arg_name) {
   return *VAIP_ORT_API(graph_get_consumer_nodes_unsafe)(graph, node_arg_name);
 }
 
+std::optional<NodeArgId>
+graph_find_node_arg_id(const Graph& graph, const std::string& node_arg_name) {
+  auto ret = GraphSymbols::get(graph)->find(node_arg_name);
+  if (!ret.has_value() &&
+      VAIP_ORT_API(graph_get_node_arg)(graph, node_arg_name) != nullptr) {
+    // created by a node added without a graph_resolve()
+    ret = GraphSymbols::refresh(graph)->find(node_arg_name);
+  }
+  return ret;
+}
+
+std::optional<NodeArgId> graph_find_node_arg_id(const Graph& graph,
+                                                const NodeArg& node_arg) {
+  auto ret = GraphSymbols::get(graph)->find(node_arg);
+  if (!ret.has_value()) {
+    ret = GraphSymbols::refresh(graph)->find(node_arg);
+  }
+  return ret;
+}
+
+static std::shared_ptr<const GraphSymbols>
+get_graph_symbols(const Graph& graph, NodeArgId id) {
+  auto ret = GraphSymbols::get(graph);
+  CHECK_LT(id, ret->size()) << "invalid node arg id";
+  return ret;
+}
+
+const NodeArg* graph_get_node_arg_by_id(const Graph& graph, NodeArgId id) {
+  return get_graph_symbols(graph, id)->node_arg(id);
+}
+
+const Node* graph_get_producer_node_by_id(const Graph& graph, NodeArgId id) {
+  return get_graph_symbols(graph, id)->producer(graph, id);
+}
+
+std::vector<const Node*> graph_get_consumer_nodes_by_id(const Graph& graph,
+                                                        NodeArgId id) {
+  return get_graph_symbols(graph, id)->consumers(graph, id);
+}
+
 void graph_replace_node_arg(const Graph& graph, const IPass& pass,
                             const NodeArg& from, const NodeArg& to) {
   CHECK(*node_arg_get_shape_i64(from) == *node_arg_get_shape_i64(to))
@@ -763,6 +813,9 @@ GraphRef::GraphRef(vaip_core::Graph& graph) : GraphConstRef(graph) {}
 GraphRef::~GraphRef() {}
 
 bool GraphRef::resolve(bool force) {
+  vaip_core::FuseAnalysis::invalidate(*this);
+  vaip_core::GraphSymbols::invalidate(*this);
+  vaip_core::NodeArgCache::invalidate(*this);
   return VAIP_ORT_API(graph_resolve)(*this, force) == 0;
 }
 NodeRef GraphRef::fuse(const vaip_core::MetaDefProto& meta_def) {
@@ -925,6 +978,7 @@ GraphRef::add_node(const std::string& name, const std::string& op_domain,
   auto& new_node = VAIP_ORT_API(graph_add_node)(
       *this, name, op_type, description, inputs_ptr, outputs_ptr,
       *attributes.get(), op_domain);
+  vaip_core::GraphSymbols::node_added(*this);
   return NodeRef(*this, new_node);
 }
 } // namespace vaip_cxx
@@ -0,0 +1,182 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "./graph_symbols.hpp"
+#include "vaip/node.hpp"
+#include "vaip/node_arg.hpp"
+#include <algorithm>
+#include <glog/logging.h>
+#include <mutex>
+#include <unordered_set>
+#include <vaip/my_ort.h>
+#include <vaip/vaip_ort_api.h>
+#include <vitis/ai/env_config.hpp>
+DEF_ENV_PARAM(DEBUG_GRAPH_SYMBOLS, "0")
+#define MY_LOG(n) LOG_IF(INFO, ENV_PARAM(DEBUG_GRAPH_SYMBOLS) >= n)
+
+namespace vaip_core {
+
+static std::mutex s_mtx;
+static std::unordered_map<const Graph*, std::shared_ptr<const GraphSymbols>>
+    s_symbols;
+// graphs with a node added since their table was built
+static std::unordered_set<const Graph*> s_stale;
+
+std::shared_ptr<const GraphSymbols> GraphSymbols::get(const Graph& graph) {
+  {
+    std::lock_guard<std::mutex> lock(s_mtx);
+    auto it = s_symbols.find(&graph);
+    if (it != s_symbols.end() && s_stale.erase(&graph) == 0) {
+      return it->second;
+    }
+    if (it != s_symbols.end()) {
+      it->second =
+          std::make_shared<const GraphSymbols>(graph, it->second.get());
+      return it->second;
+    }
+  }
+  auto ret = std::make_shared<const GraphSymbols>(graph, nullptr);
+  std::lock_guard<std::mutex> lock(s_mtx);
+  // another thread may have built one first, its ids are in use.
+  return s_symbols.emplace(&graph, ret).first->second;
+}
+
+std::shared_ptr<const GraphSymbols>
+GraphSymbols::refresh(const Graph& graph) {
+  std::lock_guard<std::mutex> lock(s_mtx);
+  s_stale.erase(&graph);
+  auto& symbols = s_symbols[&graph];
+  symbols = std::make_shared<const GraphSymbols>(graph, symbols.get());
+  return symbols;
+}
+
+void GraphSymbols::invalidate(const Graph& graph) {
+  std::lock_guard<std::mutex> lock(s_mtx);
+  s_symbols.erase(&graph);
+  s_stale.erase(&graph);
+}
+
+void GraphSymbols::node_added(const Graph& graph) {
+  std::lock_guard<std::mutex> lock(s_mtx);
+  if (s_symbols.count(&graph) != 0) {
+    s_stale.insert(&graph);
+  }
+}
+
+GraphSymbols::GraphSymbols(const Graph& graph, const GraphSymbols* previous) {
+  if (previous != nullptr) {
+    names_ = previous->names_;
+    ids_ = previous->ids_;
+  }
+  node_args_.assign(names_.size(), nullptr);
+  producers_.assign(names_.size(), -1);
+  consumers_.resize(names_.size());
+  graph_inputs_.assign(names_.size(), false);
+  initializers_.assign(names_.size(), false);
+
+  for (auto arg : graph_get_inputs(graph)) {
+    graph_inputs_[intern(node_arg_get_name(*arg), arg)] = true;
+  }
+  for (auto& initializer :
+       VAIP_ORT_API(graph_get_all_initialized_tensors)(graph)) {
+    auto& name = initializer.first;
+    auto arg = VAIP_ORT_API(graph_get_node_arg)(graph, name);
+    initializers_[intern(name, arg)] = true;
+  }
+  auto num_of_nodes = size_t(0);
+  for (auto n : graph_nodes(graph)) {
+    CHECK(n != nullptr);
+    auto index = (size_t)VAIP_ORT_API(node_get_index)(*n);
+    if (index >= nodes_.size()) {
+      nodes_.resize(index + 1, false);
+    }
+    nodes_[index] = true;
+    for (auto arg : node_get_input_node_args(*n)) {
+      if (!node_arg_exists(*arg)) {
+        continue;
+      }
+      // a node consuming the same node arg twice is listed once.
+      auto& consumers = consumers_[intern(node_arg_get_name(*arg), arg)];
+      if (consumers.empty() || consumers.back() != index) {
+        consumers.push_back(index);
+      }
+    }
+    for (auto arg : node_get_output_node_args(*n)) {
+      if (node_arg_exists(*arg)) {
+        producers_[intern(node_arg_get_name(*arg), arg)] = (int64_t)index;
+      }
+    }
+    num_of_nodes++;
+  }
+  for (auto arg : graph_get_outputs(graph)) {
+    intern(node_arg_get_name(*arg), arg);
+  }
+  MY_LOG(1) << "graph symbols: nodes=" << num_of_nodes
+            << " node_args=" << names_.size()
+            << " refreshed=" << (previous != nullptr);
+}
+
+NodeArgId GraphSymbols::intern(const std::string& name,
+                               const NodeArg* node_arg) {
+  auto [it, inserted] = ids_.emplace(name, (NodeArgId)names_.size());
+  auto id = it->second;
+  if (inserted) {
+    names_.push_back(name);
+    node_args_.push_back(nullptr);
+    producers_.push_back(-1);
+    consumers_.emplace_back();
+    graph_inputs_.push_back(false);
+    initializers_.push_back(false);
+  }
+  if (node_arg != nullptr && node_args_[id] == nullptr) {
+    node_args_[id] = node_arg;
+    ids_by_node_arg_.emplace(node_arg, id);
+  }
+  return id;
+}
+
+std::optional<NodeArgId> GraphSymbols::find(const std::string& name) const {
+  auto it = ids_.find(name);
+  if (it == ids_.end() || node_args_[it->second] == nullptr) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+std::optional<NodeArgId> GraphSymbols::find(const NodeArg& node_arg) const {
+  auto it = ids_by_node_arg_.find(&node_arg);
+  if (it == ids_by_node_arg_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+bool GraphSymbols::covers(const std::vector<const Node*>& nodes) const {
+  return std::all_of(nodes.begin(), nodes.end(), [this](const Node* n) {
+    auto index = (size_t)VAIP_ORT_API(node_get_index)(*n);
+    return index < nodes_.size() && nodes_[index];
+  });
+}
+
+const Node* GraphSymbols::producer(const Graph& graph, NodeArgId id) const {
+  auto index = producers_[id];
+  return index < 0 ? nullptr
+                   : VAIP_ORT_API(graph_get_node)(graph, (size_t)index);
+}
+
+std::vector<const Node*> GraphSymbols::consumers(const Graph& graph,
+                                                 NodeArgId id) const {
+  auto ret = std::vector<const Node*>();
+  ret.reserve(consumers_[id].size());
+  for (auto index : consumers_[id]) {
+    auto node = VAIP_ORT_API(graph_get_node)(graph, index);
+    if (node != nullptr) {
+      ret.push_back(node);
+    }
+  }
+  return ret;
+}
+
+} // namespace vaip_core
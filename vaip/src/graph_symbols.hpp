@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+#include "vaip/graph.hpp"
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vaip_core {
+
+/// The node args of a graph interned into dense NodeArgId, with their
+/// producer and consumers, so that IPass_try_fuse() and the graph API
+/// look a node arg up once and then work on ids and node indices instead
+/// of hashing and comparing names.
+///
+/// Like FuseAnalysis, the table is built on first use and dropped by
+/// graph_resolve(). Nodes are kept by index, a node removed without a
+/// resolve is not found any more; a node added without one makes the next
+/// get() rebuild the table, keeping the ids it already handed out.
+class GraphSymbols {
+public:
+  /// the table of `graph`, built on first use.
+  static std::shared_ptr<const GraphSymbols> get(const Graph& graph);
+  /// rebuild the table of `graph`, the ids of the old one stay valid.
+  static std::shared_ptr<const GraphSymbols> refresh(const Graph& graph);
+  /// drop the table of `graph`, it has changed.
+  static void invalidate(const Graph& graph);
+  /// a node was added to `graph`, the next get() refreshes its table.
+  static void node_added(const Graph& graph);
+
+  GraphSymbols(const Graph& graph, const GraphSymbols* previous);
+
+  /// all `nodes` were in the graph when the table was built.
+  bool covers(const std::vector<const Node*>& nodes) const;
+  /// number of ids, every id is less than it.
+  size_t size() const { return names_.size(); }
+  std::optional<NodeArgId> find(const std::string& name) const;
+  std::optional<NodeArgId> find(const NodeArg& node_arg) const;
+  const std::string& name(NodeArgId id) const { return names_[id]; }
+  /// nullptr for a name the graph no longer has.
+  const NodeArg* node_arg(NodeArgId id) const { return node_args_[id]; }
+  /// nullptr for a graph input, an initializer or a removed producer.
+  const Node* producer(const Graph& graph, NodeArgId id) const;
+  /// the consumers that are not removed, in graph order.
+  std::vector<const Node*> consumers(const Graph& graph, NodeArgId id) const;
+  bool is_graph_input(NodeArgId id) const { return graph_inputs_[id]; }
+  bool is_initializer(NodeArgId id) const { return initializers_[id]; }
+
+private:
+  NodeArgId intern(const std::string& name, const NodeArg* node_arg);
+
+private:
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, NodeArgId> ids_;
+  // by id
+  std::vector<const NodeArg*> node_args_;
+  std::unordered_map<const NodeArg*, NodeArgId> ids_by_node_arg_;
+  // by id, node indices, -1 for none
+  std::vector<int64_t> producers_;
+  std::vector<std::vector<size_t>> consumers_;
+  std::vector<bool> graph_inputs_;
+  std::vector<bool> initializers_;
+  // by node index
+  std::vector<bool> nodes_;
+};
+
+} // namespace vaip_core
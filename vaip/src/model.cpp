@@ -7,6 +7,9 @@
 #include "vaip/graph.hpp"
 // clang-format on
 #include "vaip/model.hpp"
+#include "./fuse_analysis.hpp"
+#include "./graph_symbols.hpp"
+#include "./node_arg_cache.hpp"
 #include "glog/logging.h"
 
 #include "vaip/vaip_ort_api.h"
@@ -14,8 +17,23 @@
 DEF_ENV_PARAM(DEBUG_VAIP_MODEL, "0")
 #define MY_LOG(n) LOG_IF(INFO, ENV_PARAM(DEBUG_VAIP_MODEL) >= n)
 namespace vaip_core {
+// The per graph caches are keyed by the address of the graph, and a graph
+// may be at the address of one deleted before. Every model is created and
+// deleted here, so its graph starts and ends without cache entries.
+static void forget_graph(Model& model) {
+  auto& graph = VAIP_ORT_API(model_main_graph)(model);
+  FuseAnalysis::invalidate(graph);
+  GraphSymbols::invalidate(graph);
+  NodeArgCache::invalidate(graph);
+}
+
+static ModelPtr own_model(Model* model) {
+  forget_graph(*model);
+  return ModelPtr(model);
+}
+
 VAIP_DLL_SPEC ModelPtr model_load(const std::string& filename) {
-  return ModelPtr(VAIP_ORT_API(model_load)(filename));
+  return own_model(VAIP_ORT_API(model_load)(filename));
 }
 
 VAIP_DLL_SPEC void model_set_meta_data(Model& model, const std::string& key,
@@ -26,15 +44,16 @@ VAIP_DLL_SPEC void model_set_meta_data(Model& model, const std::string& key,
 VAIP_DLL_SPEC ModelPtr model_clone(const Model& model,
                                    int64_t external_data_threshold) {
 #if VAIP_ORT_API_MAJOR >= 7
-  return ModelPtr(VAIP_ORT_API(model_clone)(model, external_data_threshold));
+  return own_model(VAIP_ORT_API(model_clone)(model, external_data_threshold));
 #else
-  return ModelPtr(VAIP_ORT_API(model_clone)(model));
+  return own_model(VAIP_ORT_API(model_clone)(model));
 #endif
 }
 void ModelDeleter::operator()(Model* model) const {
   MY_LOG(1) << "destroy model(" << ((void*)model) << ") "
             << VAIP_ORT_API(graph_get_name)(
                    VAIP_ORT_API(model_main_graph)(*model));
+  forget_graph(*model);
   VAIP_ORT_API(model_delete)(model);
 }
 } // namespace vaip_core
@@ -47,7 +66,7 @@ std::unique_ptr<Model> Model::load(const std::filesystem::path& model_path) {
 std::unique_ptr<Model>
 Model::create(const std::filesystem::path& model_path,
               const std::vector<std::pair<std::string, int64_t>>& opset) {
-  return std::unique_ptr<Model>(new Model(vaip_core::ModelPtr(
+  return std::unique_ptr<Model>(new Model(vaip_core::own_model(
       VAIP_ORT_API(create_empty_model)(model_path, opset))));
 }
 Model::Model(vaip_core::ModelPtr&& ptr) : self_{std::move(ptr)} {}
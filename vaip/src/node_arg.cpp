@@ -5,6 +5,7 @@
 
 #include <glog/logging.h>
 //
+#include "./node_arg_cache.hpp"
 #include "vaip/graph.hpp"
 #include "vaip/node_arg.hpp"
 #include "vaip/tensor_proto.hpp"
@@ -110,64 +111,69 @@ VAIP_DLL_SPEC int node_arg_get_element_type(const NodeArg& node_arg) {
   return element_type;
 }
 
+// the shape predicates look at the shape from ORT without copying it.
 VAIP_DLL_SPEC bool node_arg_is_unknown_shape(const NodeArg& node_arg) {
   CHECK(node_arg_exists(node_arg)) << "node_arg doesn't exist!";
 
-  auto shape = node_arg_get_shape_i64(node_arg);
-  return nullptr == shape;
+  auto shape = VAIP_ORT_API(node_arg_get_shape_i64_unsafe)(node_arg);
+  return nullptr == shape.get();
 }
 VAIP_DLL_SPEC bool node_arg_is_scalar(const NodeArg& node_arg) {
   CHECK(node_arg_exists(node_arg)) << "node_arg doesn't exist!";
 
-  auto shape = node_arg_get_shape_i64(node_arg);
-  if (nullptr == shape)
+  auto shape = VAIP_ORT_API(node_arg_get_shape_i64_unsafe)(node_arg);
+  if (nullptr == shape.get())
     return false;
 
-  return shape->empty();
+  return shape.get()->empty();
 }
 VAIP_DLL_SPEC bool node_arg_is_zero_shape(const NodeArg& node_arg) {
   CHECK(node_arg_exists(node_arg)) << "node_arg doesn't exist!";
 
-  auto shape = node_arg_get_shape_i64(node_arg);
-  if (nullptr == shape)
+  auto shape = VAIP_ORT_API(node_arg_get_shape_i64_unsafe)(node_arg);
+  if (nullptr == shape.get())
     return false;
 
-  return !std::all_of(shape->begin(), shape->end(),
+  return !std::all_of(shape.get()->begin(), shape.get()->end(),
                       [](int64_t v) { return v != 0; });
 }
 VAIP_DLL_SPEC bool node_arg_is_dynamic_shape(const NodeArg& node_arg) {
   CHECK(node_arg_exists(node_arg)) << "node_arg doesn't exist!";
 
-  auto shape = node_arg_get_shape_i64(node_arg);
-  if (nullptr == shape)
+  auto shape = VAIP_ORT_API(node_arg_get_shape_i64_unsafe)(node_arg);
+  if (nullptr == shape.get())
     return false;
 
-  return !std::all_of(shape->begin(), shape->end(), [](int64_t v) {
+  return !std::all_of(shape.get()->begin(), shape.get()->end(), [](int64_t v) {
     // xilinx op does not support shape = 0
     return v >= 0;
   });
 }
-#if VAIP_ORT_API_MAJOR >= 7
-static Graph* get_original_graph(const std::string& ptr) {
-  uintptr_t ptr1 = std::stoull(ptr);
-  return (Graph*)ptr1;
+
+VAIP_DLL_SPEC const NodeArgInfo& node_arg_get_info(const Graph& graph,
+                                                   const NodeArg& node_arg) {
+  return NodeArgCache::get_info(graph, node_arg);
+}
+
+VAIP_DLL_SPEC void node_arg_set_shape_i64(const NodeArg& node_arg,
+                                          const std::vector<int64_t>& shape) {
+  NodeArgCache::invalidate(node_arg);
+  VAIP_ORT_API(node_arg_set_shape_i64)(node_arg, shape);
+}
+
+VAIP_DLL_SPEC void
+node_arg_set_denotation(const NodeArg& node_arg,
+                        const std::vector<std::string>& denotation) {
+  NodeArgCache::invalidate(node_arg);
+  VAIP_ORT_API(node_arg_set_denotation)(node_arg, denotation);
 }
-#endif
+
 VAIP_DLL_SPEC const TensorProto&
 node_arg_get_const_data_as_tensor(const Graph& graph, const NodeArg& node_arg) {
-#if VAIP_ORT_API_MAJOR >= 7
-  std::string location = "";
-  size_t size = 0;
-  size_t offset = 0;
-  size_t checksum = 0;
-  int external_data = VAIP_ORT_API(node_arg_external_location)(
-      graph, node_arg, location, size, offset, checksum);
-  if (external_data && !location.empty() && location.front() == '<') {
-    auto original_graph = get_original_graph(location.substr(1));
-    return node_arg_get_const_data_as_tensor(*original_graph, node_arg);
-  }
-#endif
-  return VAIP_ORT_API(node_arg_get_const_data_as_tensor)(graph, node_arg);
+  // an initializer of a cloned graph may be left in the original graph.
+  auto& const_data_graph = NodeArgCache::get_const_data_graph(graph, node_arg);
+  return VAIP_ORT_API(node_arg_get_const_data_as_tensor)(const_data_graph,
+                                                          node_arg);
 }
 
 VAIP_DLL_SPEC int8_t node_arg_get_const_data_as_i8(const Graph& graph,
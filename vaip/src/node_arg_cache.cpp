@@ -0,0 +1,138 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "./node_arg_cache.hpp"
+#include <algorithm>
+#include <glog/logging.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vaip/my_ort.h>
+#include <vaip/vaip_ort_api.h>
+#include <vitis/ai/env_config.hpp>
+#include <vector>
+DEF_ENV_PARAM(DEBUG_NODE_ARG_CACHE, "0")
+#define MY_LOG(n) LOG_IF(INFO, ENV_PARAM(DEBUG_NODE_ARG_CACHE) >= n)
+
+namespace vaip_core {
+
+namespace {
+struct Entry {
+  NodeArgInfo info;
+  // the spans of info point into them.
+  std::vector<int64_t> shape;
+  std::vector<std::string> denotation;
+  // nullptr until get_const_data_graph()
+  const Graph* const_data_graph = nullptr;
+};
+// entries are not moved, references to them stay valid until they are
+// dropped.
+using Table = std::unordered_map<const NodeArg*, std::unique_ptr<Entry>>;
+} // namespace
+
+static std::mutex s_mtx;
+static std::unordered_map<const Graph*, Table> s_tables;
+
+static std::unique_ptr<Entry> new_entry(const NodeArg& node_arg) {
+  CHECK(node_arg_exists(node_arg)) << "node_arg doesn't exist!";
+  auto ret = std::make_unique<Entry>();
+  auto shape = VAIP_ORT_API(node_arg_get_shape_i64_unsafe)(node_arg);
+  if (shape.get() != nullptr) {
+    ret->shape = *shape.get();
+    auto denotation = VAIP_ORT_API(node_arg_get_denotation_unsafe)(node_arg);
+    if (denotation.get() != nullptr) {
+      ret->denotation = *denotation.get();
+    }
+  }
+  auto& info = ret->info;
+  info.has_shape = shape.get() != nullptr;
+  info.shape = ret->shape;
+  info.denotation = ret->denotation;
+  info.element_type = VAIP_ORT_API(node_arg_get_element_type)(node_arg);
+  // xilinx op does not support shape = 0
+  info.is_dynamic_shape = std::any_of(ret->shape.begin(), ret->shape.end(),
+                                      [](int64_t v) { return v < 0; });
+  info.is_zero_shape = std::any_of(ret->shape.begin(), ret->shape.end(),
+                                   [](int64_t v) { return v == 0; });
+  return ret;
+}
+
+static Entry& get_entry(const Graph& graph, const NodeArg& node_arg) {
+  {
+    std::lock_guard<std::mutex> lock(s_mtx);
+    auto table = s_tables.find(&graph);
+    if (table != s_tables.end()) {
+      auto it = table->second.find(&node_arg);
+      if (it != table->second.end()) {
+        return *it->second;
+      }
+    }
+  }
+  auto entry = new_entry(node_arg);
+  std::lock_guard<std::mutex> lock(s_mtx);
+  // another thread may have added it first, keep the one in use.
+  return *s_tables[&graph].emplace(&node_arg, std::move(entry)).first->second;
+}
+
+const NodeArgInfo& NodeArgCache::get_info(const Graph& graph,
+                                          const NodeArg& node_arg) {
+  return get_entry(graph, node_arg).info;
+}
+
+#if VAIP_ORT_API_MAJOR >= 7
+static const Graph* get_original_graph(const Graph& graph,
+                                       const NodeArg& node_arg) {
+  std::string location = "";
+  size_t size = 0;
+  size_t offset = 0;
+  size_t checksum = 0;
+  int external_data = VAIP_ORT_API(node_arg_external_location)(
+      graph, node_arg, location, size, offset, checksum);
+  if (external_data && !location.empty() && location.front() == '<') {
+    uintptr_t ptr = std::stoull(location.substr(1));
+    return (const Graph*)ptr;
+  }
+  return nullptr;
+}
+#endif
+
+const Graph& NodeArgCache::get_const_data_graph(const Graph& graph,
+                                                const NodeArg& node_arg) {
+  auto& entry = get_entry(graph, node_arg);
+  {
+    std::lock_guard<std::mutex> lock(s_mtx);
+    if (entry.const_data_graph != nullptr) {
+      return *entry.const_data_graph;
+    }
+  }
+  auto ret = &graph;
+#if VAIP_ORT_API_MAJOR >= 7
+  // a graph may be cloned from a cloned graph.
+  for (auto original = get_original_graph(*ret, node_arg); original != nullptr;
+       original = get_original_graph(*ret, node_arg)) {
+    ret = original;
+  }
+#endif
+  MY_LOG(1) << "const data of " << node_arg_get_name(node_arg) << " in graph "
+            << (const void*)ret << (ret == &graph ? "" : " (original)");
+  std::lock_guard<std::mutex> lock(s_mtx);
+  entry.const_data_graph = ret;
+  return *ret;
+}
+
+void NodeArgCache::invalidate(const Graph& graph) {
+  std::lock_guard<std::mutex> lock(s_mtx);
+  s_tables.erase(&graph);
+}
+
+void NodeArgCache::invalidate(const NodeArg& node_arg) {
+  std::lock_guard<std::mutex> lock(s_mtx);
+  for (auto& table : s_tables) {
+    table.second.erase(&node_arg);
+  }
+}
+
+} // namespace vaip_core
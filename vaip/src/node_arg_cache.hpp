@@ -0,0 +1,29 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+#include "vaip/node_arg.hpp"
+
+namespace vaip_core {
+
+/// The NodeArgInfo of the node args of a graph, and the graph holding the
+/// constant data of a node arg of a cloned graph, looked up once.
+///
+/// Like GraphSymbols, the node args of a graph are cached on first use and
+/// dropped by graph_resolve() and node removal; a node arg whose shape or
+/// denotation is set is dropped from every graph.
+class NodeArgCache {
+public:
+  static const NodeArgInfo& get_info(const Graph& graph,
+                                     const NodeArg& node_arg);
+  /// `graph`, or the graph it was cloned from if `node_arg` is an
+  /// initializer left there.
+  static const Graph& get_const_data_graph(const Graph& graph,
+                                           const NodeArg& node_arg);
+  static void invalidate(const Graph& graph);
+  static void invalidate(const NodeArg& node_arg);
+};
+
+} // namespace vaip_core
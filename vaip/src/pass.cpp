@@ -4,9 +4,13 @@
  */
 
 #include "vaip/pass.hpp"
+#include "./fuse_analysis.hpp"
+#include "./graph_symbols.hpp"
 #include "vaip/graph.hpp"
 #include <algorithm>
 #include <glog/logging.h>
+#include <limits>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 namespace vaip_core {
@@ -52,22 +56,7 @@ IPass::action_t PassInfo::get_action(size_t index) const {
   return ret;
 }
 
-static bool node_arg_is_graph_input(const Graph& graph,
-                                    const std::string& node_arg_name) {
-  auto graph_inputs = graph_get_inputs(graph);
-  bool ret = std::any_of(graph_inputs.begin(), graph_inputs.end(),
-                         [&node_arg_name](const NodeArg* node_arg) -> bool {
-                           return node_arg_get_name(*node_arg) == node_arg_name;
-                         });
-  return ret;
-}
-static bool node_arg_is_initializer(const Graph& graph,
-                                    const std::string& node_arg_name) {
-  auto all_initializer = VAIP_ORT_API(graph_get_all_initialized_tensors)(graph);
-  return all_initializer.count(node_arg_name) > 0;
-}
-
-// return values are Node found by node_arg name and the node_arg names
+// return values are Node found by node_arg id and the node_arg names
 // that cannot find the node through node_arg
 // Cannot find the node are three scenarios where the node cannot be found using
 // the node_arg_name.
@@ -77,31 +66,27 @@ static bool node_arg_is_initializer(const Graph& graph,
 // within the subgraph's body, not the output.  -- This node is contended by two
 // subgraphs, and we must relinquish the fusion of the second subgraph.
 static std::pair<std::vector<const Node*>, std::string>
-node_arg_names_to_nodes(const Graph& graph,
-                        const std::vector<std::string>& node_arg_names,
-                        bool allow_node_not_found) {
+node_arg_ids_to_nodes(const Graph& graph, const GraphSymbols& symbols,
+                      const std::vector<NodeArgId>& node_arg_ids,
+                      bool allow_node_not_found) {
   std::stringstream ss;
   auto ret = std::vector<const Node*>();
-  ret.reserve(node_arg_names.size());
-  for (auto& onnx_node_arg_name : node_arg_names) {
-    auto deq = VAIP_ORT_API(graph_producer_node)(graph, onnx_node_arg_name);
-    // NOTE: todo: potentially deq could be nullptr if node_arg is a
-    // constant initializer or graph inputs.
+  ret.reserve(node_arg_ids.size());
+  for (auto id : node_arg_ids) {
+    auto deq = symbols.producer(graph, id);
     if (deq == nullptr) {
-      // If nodearg does not exist, maybe the node is fused and an exception
-      // should be thrown. The reason why `graph_get_node_arg` is not used
-      // is because ort does not maintain the consistency of nodearg well,
-      // this nodearg not exist but graph_get_node_arg won't return nullptr.
+      // The producer is looked up by node index, a node arg whose producer
+      // was removed is not found, no matter what `graph_get_node_arg`
+      // returns, ort does not maintain the consistency of nodearg well.
       // testcase:#1304
       bool node_arg_is_node_output =
-          (!node_arg_is_graph_input(graph, onnx_node_arg_name)) &&
-          (!node_arg_is_initializer(graph, onnx_node_arg_name));
+          !symbols.is_graph_input(id) && !symbols.is_initializer(id);
       if (node_arg_is_node_output) {
-        ss << onnx_node_arg_name << ",";
+        ss << symbols.name(id) << ",";
       }
       if (!allow_node_not_found) {
         LOG(FATAL) << "cannot find producer. onnx_node_arg_name="
-                   << onnx_node_arg_name;
+                   << symbols.name(id);
       }
     } else {
       auto found = std::find(ret.begin(), ret.end(), deq) != ret.end();
@@ -114,190 +99,231 @@ node_arg_names_to_nodes(const Graph& graph,
   return std::make_pair(ret, std::string(ss.str()));
 }
 
-static std::unordered_set<const NodeArg*>
-node_args_names_to_node_arg(const Graph& graph,
-                            const std::vector<const NodeArg*>& graph_inputs,
-                            const std::vector<std::string>& input_names) {
-  std::unordered_set<const NodeArg*> ret;
-  for (const auto& input_name : input_names) {
-    auto node_arg = VAIP_ORT_API(graph_get_node_arg)(graph, input_name);
-    bool intersection = false;
-    for (auto graph_input : graph_inputs) {
-      intersection = intersection || graph_input == node_arg;
+// The ids of `node_arg_names`. A name the graph does not have cannot find
+// its producer either, it is listed in `not_found`.
+static std::vector<NodeArgId>
+node_arg_names_to_ids(const GraphSymbols& symbols,
+                      const std::vector<std::string>& node_arg_names,
+                      bool allow_node_not_found, std::string& not_found) {
+  auto ret = std::vector<NodeArgId>();
+  ret.reserve(node_arg_names.size());
+  for (auto& name : node_arg_names) {
+    auto id = symbols.find(name);
+    if (id.has_value()) {
+      ret.push_back(*id);
+      continue;
     }
-    if (intersection) {
-      ret.insert(node_arg);
+    if (!allow_node_not_found) {
+      LOG(FATAL) << "cannot find producer. onnx_node_arg_name=" << name;
     }
+    not_found += name + ",";
   }
   return ret;
 }
 
+// Whether `symbols` misses one of `node_arg_names` or its producer, i.e.
+// the node was added without a graph_resolve(). ORT looks producers up
+// only after a resolve, so a node arg unknown to `symbols` counts when the
+// graph has it at all.
+static bool is_stale(const Graph& graph, const GraphSymbols& symbols,
+                     const std::vector<std::string>& node_arg_names) {
+  return std::any_of(
+      node_arg_names.begin(), node_arg_names.end(),
+      [&graph, &symbols](const std::string& name) {
+        auto id = symbols.find(name);
+        if (!id.has_value()) {
+          return VAIP_ORT_API(graph_get_node_arg)(graph, name) != nullptr;
+        }
+        return symbols.producer(graph, *id) == nullptr &&
+               VAIP_ORT_API(graph_producer_node)(graph, name) != nullptr;
+      });
+}
+
 static std::vector<std::string>
-calculate_return_values(const Graph& graph, const Node& output_node,
-                        const std::vector<const Node*>& body_nodes) {
+node_arg_ids_to_names(const GraphSymbols& symbols,
+                      const std::vector<NodeArgId>& ids) {
   auto ret = std::vector<std::string>();
+  ret.reserve(ids.size());
+  for (auto id : ids) {
+    ret.push_back(symbols.name(id));
+  }
+  return ret;
+}
+
+static NodeArgId node_arg_id(const GraphSymbols& symbols,
+                             const NodeArg& node_arg) {
+  auto id = symbols.find(node_arg);
+  CHECK(id.has_value()) << "cannot find node arg "
+                        << node_arg_get_name(node_arg);
+  return *id;
+}
+
+static void
+calculate_return_values(const Graph& graph, const GraphSymbols& symbols,
+                        const FuseAnalysis& analysis, const Node& output_node,
+                        const std::unordered_set<const Node*>& body_nodes,
+                        std::vector<NodeArgId>& ret) {
   auto args = node_get_output_node_args(output_node);
-  auto graph_outputs = graph_get_outputs(graph);
   for (auto arg : args) {
-    auto& arg_name = node_arg_get_name(*arg);
-    auto consumers = graph_get_consumer_nodes(graph, arg_name);
+    if (!node_arg_exists(*arg)) {
+      // optional node output
+      continue;
+    }
+    auto id = node_arg_id(symbols, *arg);
     auto num_of_external_out_edges = 0;
-    auto is_graph_output = std::find(graph_outputs.begin(), graph_outputs.end(),
-                                     arg) != graph_outputs.end();
+    auto is_graph_output = analysis.is_graph_output(arg);
     if (is_graph_output) {
       num_of_external_out_edges = num_of_external_out_edges + 1;
     }
-    for (auto c : consumers) {
-      auto found = std::find(body_nodes.begin(), body_nodes.end(), c) !=
-                   body_nodes.end();
+    for (auto c : symbols.consumers(graph, id)) {
+      auto found = body_nodes.count(c) != 0;
       if (!found) {
         num_of_external_out_edges = num_of_external_out_edges + 1;
       }
     }
     if (num_of_external_out_edges != 0) {
-      ret.push_back(arg_name);
+      ret.push_back(id);
     }
   }
-  return ret;
 }
 
-static std::vector<std::string>
-calculate_arguments(const Graph& graph, const Node& input_node,
-                    const std::vector<const Node*>& body_nodes,
-                    const std::set<std::string>& initializers) {
-  auto ret = std::vector<std::string>();
+static void
+calculate_arguments(const Graph& graph, const GraphSymbols& symbols,
+                    const Node& input_node,
+                    const std::unordered_set<const Node*>& body_nodes,
+                    const std::vector<bool>& initializers,
+                    std::vector<bool>& added, std::vector<NodeArgId>& ret) {
   auto args = node_get_input_node_args(input_node);
-  auto graph_inputs = graph_get_inputs(graph);
   for (auto arg : args) {
     if (!node_arg_exists(*arg)) {
       // testcase : hrnet_w18_small, optional node input
       continue;
     }
-    auto& arg_name = node_arg_get_name(*arg);
-    auto producer = VAIP_ORT_API(graph_producer_node)(graph, arg_name);
+    auto id = node_arg_id(symbols, *arg);
+    auto producer = symbols.producer(graph, id);
     auto num_of_external_in_edges = 0;
-    auto is_graph_input = std::find(graph_inputs.begin(), graph_inputs.end(),
-                                    arg) != graph_inputs.end();
+    auto is_graph_input = symbols.is_graph_input(id);
     if (is_graph_input) {
       num_of_external_in_edges = num_of_external_in_edges + 1;
     }
-    auto found = std::find(body_nodes.begin(), body_nodes.end(), producer) !=
-                 body_nodes.end();
+    auto found = body_nodes.count(producer) != 0;
     if (!found) {
       num_of_external_in_edges = num_of_external_in_edges + 1;
     }
-    auto is_initializer = std::find(initializers.begin(), initializers.end(),
-                                    arg_name) != initializers.end();
-    if (num_of_external_in_edges != 0 && !is_initializer) {
-      ret.push_back(arg_name);
+    auto is_initializer = initializers[id];
+    if (num_of_external_in_edges != 0 && !is_initializer && !added[id]) {
+      added[id] = true;
+      ret.push_back(id);
     }
   }
-  return ret;
 }
 
-static std::vector<std::string>
-calculate_return_values(const Graph& graph,
-                        const std::vector<const Node*>& body_nodes) {
-  auto ret = std::vector<std::string>();
+static std::vector<NodeArgId>
+calculate_return_values(const Graph& graph, const GraphSymbols& symbols,
+                        const FuseAnalysis& analysis,
+                        const std::vector<const Node*>& body_nodes,
+                        const std::unordered_set<const Node*>& body_set) {
+  auto ret = std::vector<NodeArgId>();
   ret.reserve(body_nodes.size());
   for (auto i = 0u; i < body_nodes.size(); ++i) {
     CHECK(body_nodes[i] != nullptr);
-    auto r = calculate_return_values(graph, *body_nodes[i], body_nodes);
-    std::copy(r.begin(), r.end(), std::back_inserter(ret));
+    calculate_return_values(graph, symbols, analysis, *body_nodes[i],
+                            body_set, ret);
   }
   return ret;
 }
 
-static std::vector<std::string>
-calculate_arguments(const Graph& graph,
+static std::vector<NodeArgId>
+calculate_arguments(const Graph& graph, const GraphSymbols& symbols,
                     const std::vector<const Node*>& body_nodes,
-                    const std::set<std::string>& initializers) {
-  auto ret = std::vector<std::string>();
+                    const std::unordered_set<const Node*>& body_set,
+                    const std::vector<bool>& initializers) {
+  auto ret = std::vector<NodeArgId>();
   ret.reserve(body_nodes.size());
-  auto arguments =
-      std::unordered_set<std::string>(); // does not guarantee any order
-  arguments.reserve(body_nodes.size());
+  auto added = std::vector<bool>(symbols.size(), false);
   for (auto i = 0u; i < body_nodes.size(); ++i) {
     CHECK(body_nodes[i] != nullptr);
-    auto calc_res =
-        calculate_arguments(graph, *body_nodes[i], body_nodes, initializers);
-    for (auto r : calc_res) {
-      if (arguments.find(r) == arguments.end()) {
-        arguments.insert(r);
-        ret.push_back(r);
-      }
-    }
+    calculate_arguments(graph, symbols, *body_nodes[i], body_set,
+                        initializers, added, ret);
   }
   return ret;
 }
 
+// Whether one of `input_nodes` depends on one of `output_nodes`, i.e.
+// fusing would create a loop. Returns the path from the input node to the
+// output node, empty if there is no loop.
+//
+// Producers rank before their consumers, so nodes ranked below every
+// output node cannot lead to one and are not searched. The search only
+// covers the nodes ranked between the outputs and the inputs.
 static std::vector<std::string>
-check_loop(const Graph& graph, const std::vector<const Node*>& input_nodes,
+check_loop(const FuseAnalysis& analysis,
+           const std::vector<const Node*>& input_nodes,
            const std::vector<const Node*>& output_nodes) {
-  auto ret = false;
   std::vector<std::string> maybe_loop_path;
-  // key : any node in graph
-  // value : path from one of `input_nodes` to the `key`
-  std::unordered_map<const Node*, std::vector<const Node*>> map_route;
+  if (output_nodes.empty()) {
+    return maybe_loop_path;
+  }
+  auto outputs =
+      std::unordered_set<const Node*>(output_nodes.begin(), output_nodes.end());
+  auto min_output_rank = std::numeric_limits<int64_t>::max();
+  for (auto node : output_nodes) {
+    min_output_rank = std::min(min_output_rank, analysis.rank(*node));
+  }
+  // key : a visited node, value : the node it was reached from
+  std::unordered_map<const Node*, const Node*> from;
+  auto stack = std::vector<const Node*>();
   for (auto input_node : input_nodes) {
-    map_route[input_node] = {input_node};
+    if (from.emplace(input_node, nullptr).second) {
+      stack.push_back(input_node);
+    }
+  }
+  while (!stack.empty()) {
+    auto node = stack.back();
+    stack.pop_back();
+    if (outputs.count(node) != 0) {
+      for (auto n = node; n != nullptr; n = from[n]) {
+        maybe_loop_path.push_back(node_get_first_output_name(*n));
+      }
+      std::reverse(maybe_loop_path.begin(), maybe_loop_path.end());
+      break;
+    }
+    auto rank = analysis.rank(*node);
+    // -1 is a node added after the analysis, it is searched as well.
+    if (rank >= 0 && rank <= min_output_rank) {
+      continue;
+    }
+    for (auto& input : node_get_inputs(*node)) {
+      if (input.node != nullptr && from.emplace(input.node, node).second) {
+        stack.push_back(input.node);
+      }
+    }
   }
-  VAIP_ORT_API(graph_reverse_dfs_from)
-  (
-      // we start traval from inputs_nodes, and if we found any one of
-      // input nodes depends on one of output nodes topolocially, then
-      // a loop is detected.
-      graph, input_nodes,
-      [&output_nodes, &ret, &map_route,
-       &maybe_loop_path](const Node* current_node) mutable {
-        auto hit_output = std::find(output_nodes.begin(), output_nodes.end(),
-                                    current_node) != output_nodes.end();
-        if (hit_output) {
-          ret = true;
-          auto route = map_route[current_node];
-          for (size_t i = 0; i < route.size(); i++) {
-            auto node = route[i];
-            maybe_loop_path.push_back(node_get_first_output_name(*node));
-          }
-        }
-      },
-      nullptr,
-      [&ret, &map_route](const Node* from, const Node* to) -> bool {
-        // There may exist multiple paths and we only find one of them
-        // ,because we only care if has connection
-        CHECK(map_route.find(from) != map_route.end())
-            << "path not exists:" << node_as_string(*from);
-        if (map_route.find(to) == map_route.end()) {
-          auto route = map_route[from];
-          route.push_back(to);
-          map_route[to] = route;
-        }
-        // break if loop is detected. return true,
-        // graph_reverse_dfs_from should terminate travel.
-        return ret;
-      });
   return maybe_loop_path;
 }
 
 // prefer the order of try_fuse argument instead of topological order if
 // possible
-static const std::vector<std::string>
-get_combined_inputs(const std::vector<std::string>& inputs,
-                    const std::vector<std::string>& return_values) {
-  std::vector<std::string> ret;
+static std::vector<NodeArgId>
+get_combined_inputs(const std::vector<NodeArgId>& inputs,
+                    const std::vector<NodeArgId>& return_values) {
+  std::vector<NodeArgId> ret;
 
-  std::map<int, std::string> idx_input;
-  std::unordered_map<std::string, int> input_idx;
+  std::map<int, NodeArgId> idx_input;
+  std::unordered_map<NodeArgId, int> input_idx;
 
   for (size_t i = 0; i < return_values.size(); ++i) {
-    idx_input.insert({i, return_values[i]});
-    input_idx.insert({return_values[i], i});
+    idx_input.insert({(int)i, return_values[i]});
+    input_idx.insert({return_values[i], (int)i});
   }
   for (auto i : inputs) {
     auto iter = input_idx.find(i);
     if (iter != input_idx.end()) {
-      ret.push_back(i);
-      idx_input.erase(idx_input.find(iter->second));
+      auto it = idx_input.find(iter->second);
+      if (it != idx_input.end()) {
+        ret.push_back(i);
+        idx_input.erase(it);
+      }
     }
   }
 
@@ -307,101 +333,63 @@ get_combined_inputs(const std::vector<std::string>& inputs,
   return ret;
 }
 
-static std::vector<std::string> get_edge_node_arg_names(const Node* from,
-                                                        const Node* to) {
-  auto ret = std::vector<std::string>();
+// Whether all the edges from `to` into `from` are in `is_input`.
+static bool edges_are_inputs(const GraphSymbols& symbols,
+                             const std::vector<bool>& is_input,
+                             const Node* from, const Node* to) {
+  auto found = false;
   auto from_input_args = node_get_input_node_args(*from);
   auto to_output_args = node_get_output_node_args(*to);
   for (auto& arg : to_output_args) {
-    if (std::find(from_input_args.begin(), from_input_args.end(), arg) !=
+    if (std::find(from_input_args.begin(), from_input_args.end(), arg) ==
         from_input_args.end()) {
-      ret.push_back(node_arg_get_name(*arg));
+      continue;
     }
-  }
-  CHECK(!ret.empty()) << "[try fuse failed] not exist a edge between "
-                      << node_as_string(*from) << " and "
-                      << node_as_string(*to);
-  return ret;
-}
-
-static bool is_subset(const std::vector<std::string>& subset,
-                      const std::vector<std::string>& superset) {
-  std::unordered_set<std::string> s(superset.begin(), superset.end());
-  for (const auto& item : subset) {
-    if (s.find(item) == s.end()) {
+    found = true;
+    auto id = symbols.find(*arg);
+    if (!id.has_value() || *id >= is_input.size() || !is_input[*id]) {
       return false;
     }
   }
+  CHECK(found) << "[try fuse failed] not exist a edge between "
+               << node_as_string(*from) << " and " << node_as_string(*to);
   return true;
 }
-static std::vector<const Node*> graph_get_isolated_nodes(const Graph& graph) {
-  std::vector<const Node*> leaf_nodes;
-  auto all_nodes = graph_nodes(graph);
-  auto graph_outputs = graph_get_outputs(graph);
-  leaf_nodes.reserve(graph_outputs.size());
-  for (auto n : all_nodes) {
-    CHECK(n != nullptr);
-    auto node_outputs = node_get_output_node_args(*n);
-    auto found = std::any_of(node_outputs.begin(), node_outputs.end(),
-                             [&graph_outputs](const NodeArg* x) {
-                               return std::find(graph_outputs.begin(),
-                                                graph_outputs.end(),
-                                                x) != graph_outputs.end();
-                             });
-    if (found) {
-      leaf_nodes.push_back(n);
-    }
-  }
 
-  VAIP_ORT_API(graph_reverse_dfs_from)
-  (
-      graph,      //
-      leaf_nodes, //
-      nullptr,    //
-      [&all_nodes](const Node* n) mutable {
-        all_nodes.erase(std::remove(all_nodes.begin(), all_nodes.end(), n),
-                        all_nodes.end());
-      }, //
-      nullptr);
-  return all_nodes;
-}
-
-VAIP_DLL_SPEC
-std::pair<std::unique_ptr<MetaDefProto>, TryFuseError>
-IPass::try_fuse(const Graph& graph, const std::string& name,
-                const std::vector<std::string>& inputs,
-                const std::vector<std::string>& outputs,
-                const std::vector<std::string>& constant_initializers1,
-                const std::string& device) const {
-  return IPass_try_fuse(graph, name, inputs, outputs, constant_initializers1,
-                        device);
-}
-
-std::pair<std::unique_ptr<MetaDefProto>, TryFuseError>
-IPass_try_fuse(const Graph& graph, const std::string& name,
-               const std::vector<std::string>& inputs,
-               const std::vector<std::string>& outputs,
-               const std::vector<std::string>& constant_initializers1,
-               const std::string& device) {
+static std::pair<std::unique_ptr<MetaDefProto>, TryFuseError>
+try_fuse(const Graph& graph, std::shared_ptr<const GraphSymbols> symbols,
+         const std::string& name, const std::vector<std::string>& input_names,
+         const std::vector<NodeArgId>& inputs,
+         const std::string& not_found_inputs,
+         const std::vector<NodeArgId>& outputs,
+         const std::vector<std::string>& constant_initializers1,
+         const std::string& device) {
   auto constant_initializers = std::set<std::string>(
       constant_initializers1.begin(), constant_initializers1.end());
-  auto bodies = std::vector<std::string>();
+  auto is_input = std::vector<bool>(symbols->size(), false);
+  for (auto id : inputs) {
+    CHECK_LT(id, symbols->size()) << "invalid node arg id";
+    is_input[id] = true;
+  }
+  for (auto id : outputs) {
+    CHECK_LT(id, symbols->size()) << "invalid node arg id";
+  }
   auto body_nodes = std::vector<const Node*>();
   // The input can be the graph input as well, see issue 1043 for model and
   // pattern
-  auto [input_nodes, find_input_nodes_msg] =
-      node_arg_names_to_nodes(graph, inputs, true /* allow node not found*/);
-  auto [output_nodes, find_output_nodes_msg] =
-      node_arg_names_to_nodes(graph, outputs, false /* node must be found */);
-  auto graph_inputs = graph_get_inputs(graph);
-  auto node_inputs = node_args_names_to_node_arg(graph, graph_inputs, inputs);
-  auto trasverse_out_of_bound = [&graph_inputs,
-                                 &node_inputs](const NodeArg* node_arg) {
-    auto iter = std::find(graph_inputs.begin(), graph_inputs.end(), node_arg);
-    if (iter == graph_inputs.end()) {
+  auto [input_nodes, find_input_nodes_msg] = node_arg_ids_to_nodes(
+      graph, *symbols, inputs, true /* allow node not found*/);
+  find_input_nodes_msg = not_found_inputs + find_input_nodes_msg;
+  auto [output_nodes, find_output_nodes_msg] = node_arg_ids_to_nodes(
+      graph, *symbols, outputs, false /* node must be found */);
+  auto analysis = FuseAnalysis::get(graph);
+  auto trasverse_out_of_bound = [&analysis, &symbols,
+                                 &is_input](const NodeArg* node_arg) {
+    if (!analysis->is_graph_input(node_arg)) {
       return false;
     }
-    bool not_node_input = node_inputs.find(*iter) == node_inputs.end();
+    auto id = symbols->find(*node_arg);
+    bool not_node_input = !id.has_value() || !is_input[*id];
     return not_node_input;
   };
   auto hit_ceiling = false;
@@ -428,12 +416,15 @@ IPass_try_fuse(const Graph& graph, const std::string& name,
         }
       },
       nullptr,
-      [&inputs](const Node* from, const Node* to) -> bool {
-        // input_nodes.contains(to);
-        auto edge_node_arg_names = get_edge_node_arg_names(from, to);
+      [&symbols, &is_input, &hit_ceiling](const Node* from,
+                                          const Node* to) -> bool {
+        // the fuse fails anyway, do not walk up to the graph inputs.
+        if (hit_ceiling) {
+          return true;
+        }
         // The condition for stopping the traversal is the edges all included
         // inputs.
-        return is_subset(edge_node_arg_names, inputs);
+        return edges_are_inputs(*symbols, is_input, from, to);
       });
   if (hit_ceiling) {
     /* If the node's outputs traverse upward all the way to the graph_input
@@ -445,47 +436,57 @@ IPass_try_fuse(const Graph& graph, const std::string& name,
         "hit ceiling [" + find_input_nodes_msg + find_output_nodes_msg + "]";
     return std::make_pair(nullptr, TryFuseError{error_comment, {}, {}, {}, {}});
   }
+  if (!analysis->covers(input_nodes) || !analysis->covers(body_nodes)) {
+    // the graph changed without a graph_resolve()
+    FuseAnalysis::invalidate(graph);
+    analysis = FuseAnalysis::get(graph);
+  }
 
   // after upgrade onnxruntime 1.18 , onnx.onnx has some DequantizeLinear
   // isolated ops. we need remove island ops from return_valus and add to
   // body_nodes.
   // TODO : now only support one layer of isolated node
-  auto isolated_nodes = graph_get_isolated_nodes(graph);
-  for (auto island : isolated_nodes) {
-    // island node's all input node in body_nodes => is_body
-    auto is_body = true;
-    auto node_inputs = node_get_inputs(*island);
-    for (auto& input : node_inputs) {
-      if (input.node != nullptr &&
-          std::find(body_nodes.begin(), body_nodes.end(), input.node) ==
-              body_nodes.end()) {
-        is_body = false;
-        continue;
+  auto body_set =
+      std::unordered_set<const Node*>(body_nodes.begin(), body_nodes.end());
+  // island node's all input node in body_nodes => is_body
+  for (auto island : analysis->islands_of(graph, body_set)) {
+    body_nodes.push_back(island);
+    body_set.insert(island);
+    // insert island's initalizers input args
+    for (auto input : node_get_inputs(*island)) {
+      if (input.node == nullptr) {
+        constant_initializers.insert(node_arg_get_name(*input.node_arg));
       }
     }
-    if (is_body) {
-      body_nodes.push_back(island);
-      // insert island's initalizers input args
-      for (auto input : node_inputs) {
-        if (input.node == nullptr) {
-          constant_initializers.insert(node_arg_get_name(*input.node_arg));
-        }
-      }
+  }
+  if (!symbols->covers(body_nodes)) {
+    // the graph changed without a graph_resolve(), the ids stay valid.
+    symbols = GraphSymbols::refresh(graph);
+  }
+  auto is_constant = std::vector<bool>(symbols->size(), false);
+  for (auto& constant_initializer : constant_initializers) {
+    auto id = symbols->find(constant_initializer);
+    if (id.has_value()) {
+      is_constant[*id] = true;
     }
   }
 
-  auto return_values = calculate_return_values(graph, body_nodes);
+  auto return_values = calculate_return_values(graph, *symbols, *analysis,
+                                               body_nodes, body_set);
   auto arguments =
-      calculate_arguments(graph, body_nodes, constant_initializers);
+      calculate_arguments(graph, *symbols, body_nodes, body_set, is_constant);
 
-  auto [return_output_nodes, find_return_values_msg] = node_arg_names_to_nodes(
-      graph, return_values, false /* node must be found */);
-  auto maybe_loop_path = check_loop(graph, input_nodes, return_output_nodes);
+  auto [return_output_nodes, find_return_values_msg] = node_arg_ids_to_nodes(
+      graph, *symbols, return_values, false /* node must be found */);
+  auto maybe_loop_path =
+      check_loop(*analysis, input_nodes, return_output_nodes);
   if (!maybe_loop_path.empty()) {
     return std::make_pair(
         nullptr,
         TryFuseError{std::string("loop detected"), maybe_loop_path, body_nodes,
-                     inputs, return_values}); // argument = input so far
+                     input_names,
+                     node_arg_ids_to_names(
+                         *symbols, return_values)}); // argument = input so far
   }
 
   // After excluding graph input and initializer type node_arg, if there is
@@ -498,19 +499,20 @@ IPass_try_fuse(const Graph& graph, const std::string& name,
     std::string error_comment = "can't find producer_node of [" +
                                 find_input_nodes_msg + find_output_nodes_msg +
                                 find_return_values_msg + "]";
-    return std::make_pair(nullptr,
-                          TryFuseError{error_comment, maybe_loop_path,
-                                       body_nodes, inputs, return_values});
+    return std::make_pair(
+        nullptr,
+        TryFuseError{error_comment, maybe_loop_path, body_nodes, input_names,
+                     node_arg_ids_to_names(*symbols, return_values)});
   }
   // return  meta def
   auto meta_def = std::make_unique<MetaDefProto>();
   meta_def->set_id(name);
   auto combined_inputs = get_combined_inputs(inputs, arguments);
-  for (auto& input : combined_inputs) {
-    meta_def->add_inputs(input);
+  for (auto input : combined_inputs) {
+    meta_def->add_inputs(symbols->name(input));
   }
-  for (auto& output : return_values) {
-    meta_def->add_outputs(output);
+  for (auto output : return_values) {
+    meta_def->add_outputs(symbols->name(output));
   }
   for (auto& constant_initializer : constant_initializers) {
     meta_def->add_constant_initializers(constant_initializer);
@@ -523,4 +525,51 @@ IPass_try_fuse(const Graph& graph, const std::string& name,
       std::move(meta_def),
       TryFuseError{std::string("try fuse OK"), {}, body_nodes, {}, {}});
 }
+
+VAIP_DLL_SPEC
+std::pair<std::unique_ptr<MetaDefProto>, TryFuseError>
+IPass::try_fuse(const Graph& graph, const std::string& name,
+                const std::vector<std::string>& inputs,
+                const std::vector<std::string>& outputs,
+                const std::vector<std::string>& constant_initializers1,
+                const std::string& device) const {
+  return IPass_try_fuse(graph, name, inputs, outputs, constant_initializers1,
+                        device);
+}
+
+std::pair<std::unique_ptr<MetaDefProto>, TryFuseError>
+IPass_try_fuse(const Graph& graph, const std::string& name,
+               const std::vector<std::string>& inputs,
+               const std::vector<std::string>& outputs,
+               const std::vector<std::string>& constant_initializers1,
+               const std::string& device) {
+  auto symbols = GraphSymbols::get(graph);
+  if (is_stale(graph, *symbols, inputs) || is_stale(graph, *symbols, outputs)) {
+    FuseAnalysis::invalidate(graph);
+    symbols = GraphSymbols::refresh(graph);
+  }
+  auto not_found_inputs = std::string();
+  auto input_ids = node_arg_names_to_ids(
+      *symbols, inputs, true /* allow node not found*/, not_found_inputs);
+  auto not_found_outputs = std::string();
+  auto output_ids = node_arg_names_to_ids(
+      *symbols, outputs, false /* node must be found */, not_found_outputs);
+  return try_fuse(graph, symbols, name, inputs, input_ids, not_found_inputs,
+                  output_ids, constant_initializers1, device);
+}
+
+std::pair<std::unique_ptr<MetaDefProto>, TryFuseError>
+IPass_try_fuse(const Graph& graph, const std::string& name,
+               const std::vector<NodeArgId>& inputs,
+               const std::vector<NodeArgId>& outputs,
+               const std::vector<std::string>& constant_initializers,
+               const std::string& device) {
+  auto symbols = GraphSymbols::get(graph);
+  for (auto id : inputs) {
+    CHECK_LT(id, symbols->size()) << "invalid node arg id";
+  }
+  auto input_names = node_arg_ids_to_names(*symbols, inputs);
+  return try_fuse(graph, symbols, name, input_names, inputs, "", outputs,
+                  constant_initializers, device);
+}
 } // namespace vaip_core
@@ -6,6 +6,7 @@
 #include <fstream>
 #include <google/protobuf/util/json_util.h>
 
+#include "anchor_point_imp.hpp"
 #include "pass_context_imp.hpp"
 #include "profile_utils.hpp"
 #include "tar_ball.hpp"
@@ -628,6 +629,10 @@ void PassContextImp::save_context_json() const {
   ContextProto proto;
   proto.CopyFrom(this->context_proto);
   proto.mutable_config()->clear_encryption_key();
+  auto origin_nodes = proto.mutable_origin_nodes();
+  for (const auto& [name, node] : anchor_points) {
+    (*origin_nodes)[name] = node->to_proto();
+  }
   try {
     if (std::find(proto.mutable_cache_files()->begin(),
                   proto.mutable_cache_files()->end(),
@@ -13,6 +13,10 @@
 #include "vaip/pass_context.hpp"
 #include "vaip/vaip_io.hpp"
 
+namespace vaip_core_imp {
+struct AnchorPointNode;
+} // namespace vaip_core_imp
+
 namespace vaip_core {
 class CacheFileReaderImp : public CacheFileReader {
 public:
@@ -104,6 +108,11 @@ public:
   std::map<std::string, std::vector<AttributeProtoPtr>> node_extra_attrs;
   std::deque<IPass*> current_pass_stack;
   ContextProto context_proto;
+  // anchor points inserted by passes, written to origin_nodes of
+  // context_proto only when context.json is saved.
+  std::unordered_map<std::string,
+                     std::shared_ptr<const vaip_core_imp::AnchorPointNode>>
+      anchor_points;
   bool is_ep_context_model = false;
   bool cache_dir_set = false;
   std::filesystem::path model_path;
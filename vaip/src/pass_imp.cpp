@@ -11,6 +11,7 @@
 
 #include "./cache_dir.hpp"
 #include "./config.hpp"
+#include "./graph_symbols.hpp"
 #include "./profile_utils.hpp"
 #include "mem_xclbin.hpp"
 #include "pass_imp.hpp"
@@ -490,6 +491,7 @@ MetaDefProto& Pass::fuse(Graph& graph, const std::string& name,
   meta_def->set_device(device);
   VAIP_ORT_API(graph_fuse)
   (graph, name, op_type, nodes, inputs, outputs, constant_initializers);
+  GraphSymbols::node_added(graph);
   return *meta_def;
 }
 
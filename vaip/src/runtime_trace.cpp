@@ -0,0 +1,361 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "vaip/runtime_trace.hpp"
+#include "vaip/util.hpp"
+#include "vitis/ai/env_config.hpp"
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+DEF_ENV_PARAM_2(XLNX_RUNTIME_TRACE, "", std::string)
+DEF_ENV_PARAM(XLNX_RUNTIME_TRACE_EVENTS, "65536")
+DEF_ENV_PARAM(XLNX_RUNTIME_TRACE_FLUSH_MS, "100")
+DEF_ENV_PARAM(DEBUG_RUNTIME_TRACE, "0")
+#define LOG_THIS(n) LOG_IF(INFO, ENV_PARAM(DEBUG_RUNTIME_TRACE) >= n)
+
+namespace vaip_core {
+namespace runtime_trace {
+
+namespace {
+struct Event {
+  uint32_t op;
+  uint32_t phase;
+  int64_t begin;
+  int64_t end;
+};
+
+// Written by its thread only and read by the flusher only, so the two
+// indices are all the synchronization it needs.
+class Ring {
+public:
+  Ring(size_t capacity, unsigned int tid) : tid{tid} {
+    auto size = size_t(1);
+    while (size < capacity) {
+      size = size * 2;
+    }
+    events_.resize(size);
+    mask_ = size - 1;
+  }
+
+  void push(const Event& event) noexcept {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) > mask_) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    events_[head & mask_] = event;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  template <typename F> void drain(F&& func) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto head = head_.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      func(events_[tail & mask_]);
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+
+  const unsigned int tid;
+  std::atomic<uint64_t> dropped{0};
+
+private:
+  std::vector<Event> events_;
+  uint64_t mask_;
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+};
+
+// Log-linear buckets: exact below 16ns, then 8 buckets per power of two,
+// i.e. percentiles within 12.5%, in 4KB per op and phase.
+class Histogram {
+public:
+  void add(uint64_t ns) {
+    count_++;
+    max_ = std::max(max_, ns);
+    buckets_[bucket(ns)]++;
+  }
+
+  uint64_t count() const { return count_; }
+  uint64_t max() const { return max_; }
+
+  uint64_t percentile(double p) const {
+    auto rank = (uint64_t)(p * (double)(count_ - 1));
+    auto seen = uint64_t(0);
+    for (auto b = 0u; b < NUM_BUCKETS; ++b) {
+      seen += buckets_[b];
+      if (seen > rank) {
+        return std::min(lower(b), max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  static constexpr size_t NUM_BUCKETS = 16 + 60 * 8;
+
+  static size_t bucket(uint64_t ns) {
+    if (ns < 16) {
+      return (size_t)ns;
+    }
+    auto e = 63;
+    while ((ns >> e) == 0) {
+      --e;
+    }
+    return 16 + (e - 4) * 8 + ((ns >> (e - 3)) & 7);
+  }
+
+  static uint64_t lower(size_t b) {
+    if (b < 16) {
+      return b;
+    }
+    auto e = (b - 16) / 8 + 4;
+    return (8 + (b - 16) % 8) << (e - 3);
+  }
+
+  uint64_t count_ = 0;
+  uint64_t max_ = 0;
+  uint64_t buckets_[NUM_BUCKETS] = {};
+};
+
+class Tracer {
+public:
+  static Tracer* get() {
+    // never deleted, a thread may record after the exit handlers ran.
+    static Tracer* tracer = ENV_PARAM(XLNX_RUNTIME_TRACE).empty()
+                                ? nullptr
+                                : new Tracer(ENV_PARAM(XLNX_RUNTIME_TRACE));
+    return tracer;
+  }
+
+  explicit Tracer(const std::string& filename)
+      : out_(filename, std::ios::out | std::ios::trunc), pid_{get_pid()},
+        start_{now()} {
+    CHECK(out_.good()) << "cannot open " << filename;
+    out_ << "[";
+    names_.push_back("call");
+    thread_ = std::thread([this] { run(); });
+    LOG_THIS(1) << "runtime trace to " << filename;
+  }
+
+  uint32_t intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(names_mtx_);
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    auto id = (uint32_t)names_.size();
+    names_.push_back(name);
+    ids_.emplace(name, id);
+    return id;
+  }
+
+  void record(const Event& event) noexcept {
+    thread_local std::shared_ptr<Ring> ring;
+    if (ring == nullptr) {
+      try {
+        ring = std::make_shared<Ring>(
+            (size_t)std::max(ENV_PARAM(XLNX_RUNTIME_TRACE_EVENTS), 1),
+            get_tid());
+        std::lock_guard<std::mutex> lock(rings_mtx_);
+        rings_.push_back(ring);
+      } catch (...) {
+        ring = nullptr;
+        return;
+      }
+    }
+    ring->push(event);
+  }
+
+  void flush() {
+    std::lock_guard<std::mutex> lock(flush_mtx_);
+    if (!out_.is_open()) {
+      return;
+    }
+    drain();
+    out_.flush();
+  }
+
+  // at shutdown: drain, append the summaries and close the array.
+  void finish() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      if (stop_) {
+        return;
+      }
+      stop_ = true;
+      cv_.notify_all();
+    }
+    thread_.join();
+    std::lock_guard<std::mutex> lock(flush_mtx_);
+    drain();
+    auto ts = now() - start_;
+    for (auto& [key, histogram] : stats_) {
+      auto op = name(key.first);
+      auto phase = key.second == CALL ? std::string("call") : name(key.second);
+      auto p50 = histogram.percentile(0.5);
+      auto p90 = histogram.percentile(0.9);
+      auto p99 = histogram.percentile(0.99);
+      LOG(INFO) << "runtime trace: " << op << " " << phase
+                << " count=" << histogram.count() << " p50=" << p50 / 1000.0
+                << "us p90=" << p90 / 1000.0 << "us p99=" << p99 / 1000.0
+                << "us max=" << histogram.max() / 1000.0 << "us";
+      separator();
+      out_ << "{\"name\":\"summary " << escape(op) << " " << escape(phase)
+           << "\",\"cat\":\"summary\",\"ph\":\"i\",\"s\":\"g\",\"pid\":"
+           << pid_ << ",\"tid\":0,\"ts\":" << us(ts)
+           << ",\"args\":{\"count\":" << histogram.count()
+           << ",\"p50_us\":" << us(p50) << ",\"p90_us\":" << us(p90)
+           << ",\"p99_us\":" << us(p99) << ",\"max_us\":" << us(histogram.max())
+           << "}}";
+    }
+    if (dropped_ != 0) {
+      LOG(WARNING) << "runtime trace: " << dropped_
+                   << " spans dropped, ring full, consider a larger "
+                      "XLNX_RUNTIME_TRACE_EVENTS";
+    }
+    out_ << "\n]\n";
+    out_.close();
+  }
+
+private:
+  void run() {
+    auto period =
+        std::chrono::milliseconds(ENV_PARAM(XLNX_RUNTIME_TRACE_FLUSH_MS));
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!stop_) {
+      cv_.wait_for(lock, period, [this] { return stop_; });
+      lock.unlock();
+      flush();
+      lock.lock();
+    }
+  }
+
+  // under flush_mtx_
+  void drain() {
+    auto rings = std::vector<std::shared_ptr<Ring>>();
+    {
+      std::lock_guard<std::mutex> lock(rings_mtx_);
+      rings = rings_;
+    }
+    for (auto& ring : rings) {
+      ring->drain([this, &ring](const Event& event) { write(event, *ring); });
+      dropped_ += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    // a ring only referenced here and by rings_ belongs to an ended thread
+    // and was drained above.
+    rings.clear();
+    std::lock_guard<std::mutex> lock(rings_mtx_);
+    rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                [](const std::shared_ptr<Ring>& ring) {
+                                  return ring.use_count() == 1;
+                                }),
+                 rings_.end());
+  }
+
+  void write(const Event& event, const Ring& ring) {
+    auto dur = event.end - event.begin;
+    stats_[{event.op, event.phase}].add((uint64_t)std::max(dur, int64_t(0)));
+    auto op = escape(name(event.op));
+    separator();
+    if (event.phase == CALL) {
+      out_ << "{\"name\":\"" << op << "\",\"cat\":\"custom_op\"";
+    } else {
+      out_ << "{\"name\":\"" << escape(name(event.phase)) << "\",\"cat\":\""
+           << op << "\"";
+    }
+    out_ << ",\"ph\":\"X\",\"pid\":" << pid_ << ",\"tid\":" << ring.tid
+         << ",\"ts\":" << us(event.begin - start_) << ",\"dur\":" << us(dur)
+         << "}";
+  }
+
+  void separator() {
+    out_ << (first_ ? "\n" : ",\n");
+    first_ = false;
+  }
+
+  std::string name(uint32_t id) {
+    std::lock_guard<std::mutex> lock(names_mtx_);
+    return id < names_.size() ? names_[id] : std::to_string(id);
+  }
+
+  static std::string us(int64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", (double)ns / 1000.0);
+    return buf;
+  }
+
+  static std::string escape(const std::string& s) {
+    auto ret = std::string();
+    ret.reserve(s.size());
+    for (auto c : s) {
+      if (c == '"' || c == '\\') {
+        ret += '\\';
+      }
+      ret += (unsigned char)c < 0x20 ? ' ' : c;
+    }
+    return ret;
+  }
+
+private:
+  std::mutex names_mtx_;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, uint32_t> ids_;
+
+  std::mutex rings_mtx_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+
+  // the output and everything the flusher owns
+  std::mutex flush_mtx_;
+  std::ofstream out_;
+  bool first_ = true;
+  std::map<std::pair<uint32_t, uint32_t>, Histogram> stats_;
+  uint64_t dropped_ = 0;
+  const unsigned int pid_;
+  const int64_t start_;
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+} // namespace
+
+uint32_t intern(const std::string& name) {
+  auto tracer = Tracer::get();
+  return tracer == nullptr ? 0 : tracer->intern(name);
+}
+
+void record(uint32_t op, uint32_t phase, int64_t begin, int64_t end) noexcept {
+  // op != 0 means intern() found a tracer
+  Tracer::get()->record(Event{op, phase, begin, end});
+}
+
+void flush() {
+  if (auto tracer = Tracer::get()) {
+    tracer->flush();
+  }
+}
+
+void finish() {
+  if (auto tracer = Tracer::get()) {
+    tracer->finish();
+  }
+}
+
+} // namespace runtime_trace
+} // namespace vaip_core
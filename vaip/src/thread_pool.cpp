@@ -0,0 +1,343 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "vaip/thread_pool.hpp"
+#include "vitis/ai/env_config.hpp"
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+DEF_ENV_PARAM(DEBUG_THREAD_POOL, "0")
+DEF_ENV_PARAM(XLNX_HOST_THREADS, "0")
+// the thread count of the former Eigen pool of transpose, read as
+// XLNX_HOST_THREADS when that one is not set.
+DEF_ENV_PARAM(NUM_OF_ENGINE_THREAD, "0")
+DEF_ENV_PARAM(XLNX_HOST_THREAD_AFFINITY, "0")
+#define LOG_THIS(n) LOG_IF(INFO, ENV_PARAM(DEBUG_THREAD_POOL) >= n)
+
+namespace vaip_core {
+
+// bytes a task should touch, see grain_size()
+static constexpr int64_t MIN_BYTES_PER_TASK = 64 * 1024;
+// chunks per thread in parallel_for, for load balance
+static constexpr int64_t CHUNKS_PER_THREAD = 4;
+
+namespace {
+struct TaskQueue {
+  std::mutex mtx;
+  std::deque<std::function<void()>> tasks;
+};
+
+struct ParallelForState {
+  std::atomic<int64_t> next{0};
+  std::atomic<int64_t> done{0};
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::exception_ptr error;
+};
+} // namespace
+
+struct ThreadPool::Imp {
+  std::vector<std::unique_ptr<TaskQueue>> queues;
+  std::vector<std::thread> workers;
+  // threads running parallel_for() chunks, the caller included; may be one
+  // less than the workers, see ThreadPool::ThreadPool().
+  size_t num_threads = 1;
+  std::atomic<size_t> next_queue{0};
+  std::atomic<int64_t> pending{0};
+  std::mutex sleep_mtx;
+  std::condition_variable sleep_cv;
+  bool stop = false;
+
+  // pool and queue index of the current worker thread
+  static inline thread_local const Imp* tls_pool = nullptr;
+  static inline thread_local size_t tls_index = 0;
+
+  void push(std::function<void()> task);
+  bool pop(size_t self, std::function<void()>& task);
+  void worker_main(size_t index);
+};
+
+static void set_affinity(std::thread& thread, size_t cpu) {
+#ifdef _WIN32
+  auto mask = DWORD_PTR(1) << (cpu % (sizeof(DWORD_PTR) * 8));
+  if (SetThreadAffinityMask(thread.native_handle(), mask) == 0) {
+    LOG_THIS(1) << "cannot pin host worker to core " << cpu;
+  }
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % CPU_SETSIZE, &set);
+  if (pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) != 0) {
+    LOG_THIS(1) << "cannot pin host worker to core " << cpu;
+  }
+#else
+  (void)thread;
+  (void)cpu;
+#endif
+}
+
+void ThreadPool::Imp::push(std::function<void()> task) {
+  // a worker queues to itself, so nested work stays cache local and is
+  // stolen only by idle workers.
+  auto index = tls_pool == this ? tls_index
+                                : next_queue.fetch_add(1) % queues.size();
+  {
+    std::lock_guard<std::mutex> lock(queues[index]->mtx);
+    queues[index]->tasks.emplace_back(std::move(task));
+  }
+  pending.fetch_add(1);
+  {
+    // pairs with the predicate check in worker_main()
+    std::lock_guard<std::mutex> lock(sleep_mtx);
+  }
+  sleep_cv.notify_one();
+}
+
+bool ThreadPool::Imp::pop(size_t self, std::function<void()>& task) {
+  {
+    auto& q = *queues[self];
+    std::lock_guard<std::mutex> lock(q.mtx);
+    if (!q.tasks.empty()) {
+      task = std::move(q.tasks.back());
+      q.tasks.pop_back();
+      return true;
+    }
+  }
+  for (auto i = 1u; i < queues.size(); ++i) {
+    auto& q = *queues[(self + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(q.mtx);
+    if (!q.tasks.empty()) {
+      task = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::Imp::worker_main(size_t index) {
+  tls_pool = this;
+  tls_index = index;
+  std::function<void()> task;
+  for (;;) {
+    if (pop(index, task)) {
+      pending.fetch_sub(1);
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mtx);
+    sleep_cv.wait(lock, [this] { return stop || pending.load() > 0; });
+    if (stop && pending.load() == 0) {
+      return;
+    }
+  }
+}
+
+static size_t default_num_threads() {
+  if (ENV_PARAM(XLNX_HOST_THREADS) > 0) {
+    return (size_t)ENV_PARAM(XLNX_HOST_THREADS);
+  }
+  if (ENV_PARAM(NUM_OF_ENGINE_THREAD) > 0) {
+    LOG(WARNING) << "NUM_OF_ENGINE_THREAD is deprecated, use "
+                    "XLNX_HOST_THREADS instead";
+    return (size_t)ENV_PARAM(NUM_OF_ENGINE_THREAD);
+  }
+  return std::max((size_t)std::thread::hardware_concurrency() / 2, (size_t)1);
+}
+
+ThreadPool& ThreadPool::instance() {
+  // never destroyed: joining workers from a static destructor can hang
+  // when the library is unloaded at process exit.
+  static ThreadPool* pool =
+      new ThreadPool(default_num_threads(),
+                     ENV_PARAM(XLNX_HOST_THREAD_AFFINITY) != 0);
+  return *pool;
+}
+
+ThreadPool::ThreadPool(size_t num_threads, bool affinity)
+    : imp_(std::make_unique<Imp>()) {
+  // the thread calling parallel_for() is one of the `num_threads`, but
+  // submit() always needs a worker: a task run inline would not overlap
+  // with its caller. With one thread, that worker takes no chunks.
+  imp_->num_threads = std::max(num_threads, (size_t)1);
+  auto num_workers = std::max(imp_->num_threads - 1, (size_t)1);
+  imp_->queues.resize(num_workers);
+  for (auto& q : imp_->queues) {
+    q = std::make_unique<TaskQueue>();
+  }
+  imp_->workers.reserve(num_workers);
+  for (auto i = 0u; i < num_workers; ++i) {
+    imp_->workers.emplace_back([imp = imp_.get(), i]() { imp->worker_main(i); });
+    if (affinity) {
+      set_affinity(imp_->workers.back(), i);
+    }
+  }
+  LOG_THIS(1) << "host thread pool started, threads=" << imp_->num_threads
+              << " workers=" << num_workers << " affinity=" << affinity;
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(imp_->sleep_mtx);
+    imp_->stop = true;
+  }
+  imp_->sleep_cv.notify_all();
+  for (auto& w : imp_->workers) {
+    w.join();
+  }
+}
+
+size_t ThreadPool::size() const { return imp_->num_threads; }
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+  auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+  auto ret = packaged->get_future();
+  imp_->push([packaged]() { (*packaged)(); });
+  return ret;
+}
+
+void ThreadPool::parallel_for(
+    int64_t begin, int64_t end, int64_t grain,
+    const std::function<void(int64_t, int64_t)>& func) {
+  auto n = end - begin;
+  if (n <= 0) {
+    return;
+  }
+  grain = std::max(grain, (int64_t)1);
+  auto num_chunks = std::min((n + grain - 1) / grain,
+                             (int64_t)size() * CHUNKS_PER_THREAD);
+  if (num_chunks <= 1) {
+    func(begin, end);
+    return;
+  }
+  auto chunk = (n + num_chunks - 1) / num_chunks;
+  num_chunks = (n + chunk - 1) / chunk;
+
+  // Helpers may start after all chunks are taken, or even after this
+  // function returned; they only touch `func` for a chunk they claimed.
+  auto state = std::make_shared<ParallelForState>();
+  auto run = [state, &func, begin, end, chunk, num_chunks]() {
+    for (;;) {
+      auto c = state->next.fetch_add(1);
+      if (c >= num_chunks) {
+        return;
+      }
+      auto b = begin + c * chunk;
+      auto e = std::min(b + chunk, end);
+      try {
+        func(b, e);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        if (!state->error) {
+          state->error = std::current_exception();
+        }
+      }
+      if (state->done.fetch_add(1) + 1 == num_chunks) {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        state->cv.notify_all();
+      }
+    }
+  };
+  auto num_helpers = std::min((size_t)num_chunks, size()) - 1;
+  for (auto i = 0u; i < num_helpers; ++i) {
+    imp_->push(run);
+  }
+  run();
+  {
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->cv.wait(lock,
+                   [&state, num_chunks] { return state->done == num_chunks; });
+  }
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
+
+struct AsyncTask::State {
+  std::atomic<bool> claimed{false};
+  std::function<void()> func;
+  std::promise<void> promise;
+  std::shared_future<void> future;
+
+  void run() {
+    if (claimed.exchange(true)) {
+      return;
+    }
+    try {
+      func();
+      promise.set_value();
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+    func = nullptr;
+  }
+};
+
+AsyncTask::AsyncTask(std::function<void()> func, ThreadPool& pool)
+    : state_(std::make_shared<State>()) {
+  state_->func = std::move(func);
+  state_->future = state_->promise.get_future().share();
+  pool.submit([state = state_]() { state->run(); });
+}
+
+AsyncTask& AsyncTask::operator=(AsyncTask&& other) noexcept {
+  if (this != &other) {
+    if (state_) {
+      state_->run();
+      state_->future.wait();
+    }
+    state_ = std::move(other.state_);
+  }
+  return *this;
+}
+
+AsyncTask::~AsyncTask() {
+  if (state_) {
+    state_->run();
+    state_->future.wait();
+  }
+}
+
+void AsyncTask::wait() const {
+  CHECK(state_ != nullptr) << "wait on an empty AsyncTask";
+  state_->run();
+  state_->future.wait();
+}
+
+void AsyncTask::get() const {
+  wait();
+  state_->future.get();
+}
+
+std::shared_future<void> AsyncTask::share() const {
+  CHECK(state_ != nullptr) << "share an empty AsyncTask";
+  return state_->future;
+}
+
+int64_t grain_size(int64_t bytes_per_item) {
+  return std::max(MIN_BYTES_PER_TASK / std::max(bytes_per_item, (int64_t)1),
+                  (int64_t)1);
+}
+
+void parallel_for(int64_t begin, int64_t end, int64_t grain,
+                  const std::function<void(int64_t, int64_t)>& func) {
+  ThreadPool::instance().parallel_for(begin, end, grain, func);
+}
+
+} // namespace vaip_core
@@ -3,20 +3,11 @@
  *  Licensed under the MIT License.
  */
 
-#define EIGEN_USE_THREADS
 #include "vaip/transpose.hpp"
-#include "vitis/ai/env_config.hpp"
+#include "vaip/thread_pool.hpp"
 #include <glog/logging.h>
 #include <unsupported/Eigen/CXX11/Tensor>
-#include <unsupported/Eigen/CXX11/ThreadPool>
-DEF_ENV_PARAM(NUM_OF_ENGINE_THREAD, "4")
 namespace {
-static Eigen::ThreadPoolDevice& device() {
-  auto num_of_engine_thread = ENV_PARAM(NUM_OF_ENGINE_THREAD);
-  static Eigen::ThreadPool pool(num_of_engine_thread /*number of threads*/);
-  static Eigen::ThreadPoolDevice my_device(&pool, num_of_engine_thread);
-  return my_device;
-}
 
 // in Eigen convention, the first dimention is continous in memory.
 // a(d0, d1, d2, ...., dn), where d0 varis in memory first, i.e. stride = 1
@@ -54,7 +45,24 @@ void transpose1(const T* src, T* dst, const std::array<int, NDIMS>& shape_src,
     shape_dst[i] = shape_src[p[i]];
   }
   Eigen::TensorMap<Eigen::Tensor<T, NDIMS>, Eigen::Aligned> y(dst, shape_dst);
-  y.device(device()) = x.shuffle(p);
+  // split the outermost destination dimension over the host pool
+  int64_t slice_bytes = sizeof(T);
+  for (int i = 0; i < NDIMS - 1; ++i) {
+    slice_bytes *= shape_dst[i];
+  }
+  vaip_core::parallel_for(
+      0, shape_dst[NDIMS - 1], vaip_core::grain_size(2 * slice_bytes),
+      [&](int64_t begin, int64_t end) {
+        Eigen::array<Eigen::Index, NDIMS> offsets;
+        Eigen::array<Eigen::Index, NDIMS> extents;
+        for (int i = 0; i < NDIMS; ++i) {
+          offsets[i] = 0;
+          extents[i] = shape_dst[i];
+        }
+        offsets[NDIMS - 1] = begin;
+        extents[NDIMS - 1] = end - begin;
+        y.slice(offsets, extents) = x.shuffle(p).slice(offsets, extents);
+      });
 }
 
 template <int NDIMS, typename C>
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+// Runtime ISA checks for the host kernels of custom ops, the same way
+// qgemm picks its kernels: the library is built for the baseline ISA, a
+// kernel that needs more is marked with VAIP_CPU_TARGET() and only called
+// when the CPU has it, e.g.
+//
+//   VAIP_CPU_TARGET("avx2") static void kernel_avx2(...);
+//   ...
+//   if (vaip_cpu::has_avx2()) { kernel_avx2(...); } else { ... }
+//
+// MSVC compiles intrinsics in any function, so VAIP_CPU_TARGET() is empty
+// there, but the runtime check is still needed.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#  define VAIP_CPU_X86 1
+#else
+#  define VAIP_CPU_X86 0
+#endif
+
+#if defined(__GNUC__)
+#  define VAIP_CPU_TARGET(isa) __attribute__((target(isa)))
+#else
+#  define VAIP_CPU_TARGET(isa)
+#endif
+
+namespace vaip_cpu {
+
+inline bool detect_avx2() {
+#if VAIP_CPU_X86
+#  if defined(__GNUC__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#  elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  if (!osxsave) {
+    return false;
+  }
+  auto xcr0 = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+#  endif
+#endif
+  return false;
+}
+
+// ssse3 and sse4.1, e.g. pshufb and pmovsxbd.
+inline bool detect_sse41() {
+#if VAIP_CPU_X86
+#  if defined(__GNUC__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+#  elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 9)) != 0 && (info[2] & (1 << 19)) != 0;
+#  endif
+#endif
+  return false;
+}
+
+// avx512f, avx512bw and avx512vnni, i.e. vpdpbusd on zmm registers.
+inline bool detect_avx512_vnni() {
+#if VAIP_CPU_X86
+#  if defined(__GNUC__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") &&
+         __builtin_cpu_supports("avx512bw") &&
+         __builtin_cpu_supports("avx512vnni");
+#  elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  if (!osxsave) {
+    return false;
+  }
+  auto xcr0 = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0 &&
+         (info[2] & (1 << 11)) != 0 && (xcr0 & 0xe6) == 0xe6;
+#  endif
+#endif
+  return false;
+}
+
+inline bool has_sse41() {
+  static const bool value = detect_sse41();
+  return value;
+}
+
+inline bool has_avx2() {
+  static const bool value = detect_avx2();
+  return value;
+}
+
+inline bool has_avx512_vnni() {
+  static const bool value = detect_avx512_vnni();
+  return value;
+}
+
+} // namespace vaip_cpu
@@ -0,0 +1,184 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+// Embedding lookup shared by the gather, gather_add and dqcastgather
+// custom ops.
+//
+// A table is a row-major [num_rows, row_bytes] byte matrix. It is mapped
+// from the cache directory when the cache lives on disk, so it costs
+// page cache instead of resident memory, and is read into memory only
+// for an in-memory cache. Dequantization and casts are applied per row
+// while gathering, through 256-entry lookup tables, so no widened copy
+// of the table is ever built.
+//
+// Indices are checked in one branch-free pass before any row is copied;
+// negative indices count from the end as in onnx Gather. Long index
+// lists are split over the host thread pool.
+
+#include "mapped_file/mapped_file.hpp"
+#include "vaip/vaip.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace vaip_embedding {
+
+using vaip_common::MappedFile;
+
+/// Rows of `row_bytes` bytes, backed by a mapped file or a buffer.
+class Table {
+public:
+  Table() = default;
+
+  /// Load cache file `file`, falling back to `file` as a path for files
+  /// that were never added to the cache. Throws if neither is readable
+  /// or the file is smaller than `num_rows` rows.
+  static Table load(const vaip_core::PassContext& context,
+                    const std::filesystem::path& file, int64_t num_rows,
+                    int64_t row_bytes) {
+    auto name = file.filename().string();
+    auto ret = Table();
+    if (!context.cache_in_mem()) {
+      ret.set(MappedFile::open(context.get_log_dir() / name, true));
+    }
+    if (ret.data_ == nullptr) {
+      auto bytes = context.read_file_u8(name);
+      if (bytes.has_value()) {
+        auto buffer = std::make_shared<std::vector<uint8_t>>(
+            std::move(bytes.value()));
+        ret.data_ = buffer->data();
+        ret.size_ = buffer->size();
+        ret.storage_ = std::move(buffer);
+      }
+    }
+    if (ret.data_ == nullptr) {
+      ret.set(MappedFile::open(file, true));
+    }
+    if (ret.data_ == nullptr) {
+      throw std::runtime_error("cannot read embedding table " + file.string());
+    }
+    if ((int64_t)ret.size_ < num_rows * row_bytes) {
+      throw std::runtime_error(
+          "embedding table " + file.string() + " has " +
+          std::to_string(ret.size_) + " bytes, expected " +
+          std::to_string(num_rows) + " x " + std::to_string(row_bytes));
+    }
+    ret.num_rows_ = num_rows;
+    ret.row_bytes_ = row_bytes;
+    return ret;
+  }
+
+  int64_t num_rows() const { return num_rows_; }
+  int64_t row_bytes() const { return row_bytes_; }
+  const uint8_t* row(int64_t r) const { return data_ + r * row_bytes_; }
+
+private:
+  void set(std::shared_ptr<MappedFile> file) {
+    if (file != nullptr) {
+      data_ = file->data();
+      size_ = file->size();
+      storage_ = std::move(file);
+    }
+  }
+
+  std::shared_ptr<const void> storage_;
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  int64_t num_rows_ = 0;
+  int64_t row_bytes_ = 0;
+};
+
+namespace detail {
+// Same as index_to_row(v) in [0, num_rows). Float indices are truncated
+// like the (int) cast they replace.
+template <typename Index> inline bool valid(Index v, int64_t num_rows) {
+  if constexpr (std::is_floating_point_v<Index>) {
+    return v > (Index)(-num_rows - 1) && v < (Index)num_rows;
+  } else {
+    return (int64_t)v >= -num_rows && (int64_t)v < num_rows;
+  }
+}
+
+template <typename Index>
+inline int64_t index_to_row(Index v, int64_t num_rows) {
+  auto r = (int64_t)v;
+  return r < 0 ? r + num_rows : r;
+}
+} // namespace detail
+
+/// Throw std::out_of_range on the first index outside [-num_rows,
+/// num_rows).
+template <typename Index>
+void check_indices(const Index* indices, int64_t n, int64_t num_rows) {
+  // no early exit, so that the loop vectorizes.
+  auto ok = true;
+  for (int64_t i = 0; i < n; ++i) {
+    ok &= detail::valid(indices[i], num_rows);
+  }
+  if (ok) {
+    return;
+  }
+  for (int64_t i = 0; i < n; ++i) {
+    if (!detail::valid(indices[i], num_rows)) {
+      throw std::out_of_range("gather index " + std::to_string(indices[i]) +
+                              " at " + std::to_string(i) +
+                              " is out of range for " +
+                              std::to_string(num_rows) + " rows");
+    }
+  }
+}
+
+/// For i in [0, n): func(i, table row of indices[i]). The indices are
+/// checked first; func runs on the host thread pool.
+template <typename Index, typename Func>
+void gather(const Table& table, const Index* indices, int64_t n,
+            Func&& func) {
+  check_indices(indices, n, table.num_rows());
+  vaip_core::parallel_for(
+      0, n, vaip_core::grain_size(table.row_bytes()),
+      [&](int64_t b, int64_t e) {
+        for (auto i = b; i < e; ++i) {
+          func(i, table.row(detail::index_to_row(indices[i],
+                                                  table.num_rows())));
+        }
+      });
+}
+
+/// A conversion of every byte value, applied while gathering.
+template <typename T> struct ByteLut {
+  std::array<T, 256> values;
+  // values[b] == T(b), a row is then copied as it is.
+  bool identity = false;
+
+  template <typename Func> static ByteLut make(Func&& func) {
+    auto ret = ByteLut();
+    ret.identity = sizeof(T) == 1;
+    for (auto b = 0; b < 256; ++b) {
+      ret.values[b] = func((uint8_t)b);
+      ret.identity = ret.identity && (uint8_t)ret.values[b] == b;
+    }
+    return ret;
+  }
+
+  void convert(const uint8_t* src, T* dst, int64_t n) const {
+    if (identity) {
+      std::memcpy(dst, src, n * sizeof(T));
+      return;
+    }
+    for (int64_t i = 0; i < n; ++i) {
+      dst[i] = values[src[i]];
+    }
+  }
+};
+
+} // namespace vaip_embedding
@@ -0,0 +1,248 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "vitis/ai/env_config.hpp"
+
+// XLNX_PP_INSTR_CACHE=0 always runs the instruction compilers,
+// XLNX_PP_INSTR_CACHE_CHECK=1 runs them on a cache hit as well and fails if
+// the cached stream differs.
+DEF_ENV_PARAM(XLNX_PP_INSTR_CACHE, "1")
+DEF_ENV_PARAM(XLNX_PP_INSTR_CACHE_CHECK, "0")
+DEF_ENV_PARAM(DEBUG_PP_INSTR_CACHE, "0")
+
+namespace IC {
+
+// Output of `Compiler::generate(rtps)`: the instruction words and the
+// rtps, which some compilers update while generating.
+struct InstrStream {
+  std::vector<std::uint16_t> rtps;
+  std::vector<std::uint32_t> instr;
+};
+
+namespace detail {
+
+static constexpr char INSTR_STREAM_MAGIC[8] = {'P', 'P', 'I', 'N',
+                                               'S', 'T', 'R', '2'};
+
+// the generator code a stream was made by: the version of the code shared
+// by all compilers and the version of `Compiler::generate()`.
+template <class Compiler> constexpr std::uint64_t compiler_version() {
+  return (std::uint64_t(Compiler::COMMON_VERSION) << 32) |
+         std::uint64_t(Compiler::VERSION);
+}
+
+inline std::uint64_t hash_rtps(const std::string& name, std::uint64_t version,
+                               const std::uint16_t* rtps, size_t num_rtps) {
+  // FNV-1a
+  std::uint64_t h = 0xcbf29ce484222325ull;
+  auto mix = [&h](const void* data, size_t size) {
+    auto p = static_cast<const unsigned char*>(data);
+    for (auto i = 0u; i < size; ++i) {
+      h = (h ^ p[i]) * 0x100000001b3ull;
+    }
+  };
+  mix(name.data(), name.size());
+  mix(&version, sizeof(version));
+  mix(rtps, num_rtps * sizeof(std::uint16_t));
+  return h;
+}
+
+template <typename T>
+inline bool read_vector(std::ifstream& in, std::vector<T>& v) {
+  auto size = std::uint32_t(0);
+  if (!in.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+    return false;
+  }
+  v.resize(size);
+  return (bool)in.read(reinterpret_cast<char*>(v.data()), size * sizeof(T));
+}
+
+template <typename T>
+inline void write_vector(std::ofstream& out, const std::vector<T>& v) {
+  auto size = static_cast<std::uint32_t>(v.size());
+  out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  out.write(reinterpret_cast<const char*>(v.data()), size * sizeof(T));
+}
+
+// layout: magic, compiler version, name, input rtps, output rtps,
+// instruction words
+inline std::shared_ptr<const InstrStream>
+load_instr_stream(const std::filesystem::path& file, const std::string& name,
+                  std::uint64_t version,
+                  const std::vector<std::uint16_t>& key) {
+  auto in = std::ifstream(file, std::ios::binary);
+  if (!in) {
+    return nullptr;
+  }
+  char magic[sizeof(INSTR_STREAM_MAGIC)];
+  auto stored_version = std::uint64_t(0);
+  auto stored_name = std::vector<char>();
+  auto stored_key = std::vector<std::uint16_t>();
+  auto ret = std::make_shared<InstrStream>();
+  if (!in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, INSTR_STREAM_MAGIC, sizeof(magic)) != 0 ||
+      !in.read(reinterpret_cast<char*>(&stored_version),
+               sizeof(stored_version)) ||
+      !read_vector(in, stored_name) || !read_vector(in, stored_key) ||
+      !read_vector(in, ret->rtps) || !read_vector(in, ret->instr) ||
+      in.peek() != std::ifstream::traits_type::eof() ||
+      stored_version != version ||
+      std::string(stored_name.begin(), stored_name.end()) != name ||
+      stored_key != key || ret->rtps.size() != key.size()) {
+    LOG(WARNING) << "ignore invalid instruction cache " << file;
+    return nullptr;
+  }
+  return ret;
+}
+
+inline void save_instr_stream(const std::filesystem::path& file,
+                              const std::string& name, std::uint64_t version,
+                              const std::vector<std::uint16_t>& key,
+                              const InstrStream& stream) {
+  // written to a temporary and renamed, so that sessions created in
+  // parallel never read a partial file.
+  auto tmp = file;
+  tmp += ".tmp";
+  {
+    auto out = std::ofstream(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      LOG_IF(INFO, ENV_PARAM(DEBUG_PP_INSTR_CACHE) >= 1)
+          << "cannot write instruction cache " << tmp;
+      return;
+    }
+    out.write(INSTR_STREAM_MAGIC, sizeof(INSTR_STREAM_MAGIC));
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    write_vector(out, std::vector<char>(name.begin(), name.end()));
+    write_vector(out, key);
+    write_vector(out, stream.rtps);
+    write_vector(out, stream.instr);
+  }
+  auto ec = std::error_code();
+  std::filesystem::rename(tmp, file, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+  }
+}
+
+template <class Compiler>
+InstrStream run_compiler(std::uint16_t* rtps, size_t num_rtps,
+                         size_t capacity) {
+  auto ret = InstrStream();
+  ret.instr.resize(capacity);
+  auto compiler = std::make_unique<Compiler>(ret.instr.data());
+  auto n = compiler->generate(rtps);
+  CHECK_LE((size_t)n, capacity) << "instruction buffer overflow";
+  ret.instr.resize(n);
+  ret.rtps.assign(rtps, rtps + num_rtps);
+  return ret;
+}
+
+} // namespace detail
+
+// Same as `Compiler(instr_buffer).generate(rtps)`, returning the number of
+// instruction words written to `instr_buffer`.
+//
+// Instruction streams depend only on the rtps and the generator code, so
+// they are memoized per process, keyed by `name` and the rtps, and
+// persisted as `<cache_dir>/<name>_<hash>.instr` when `cache_dir` is
+// given. A session with the same preprocessing configuration copies the
+// words instead of generating them again. `Compiler::VERSION` and
+// `Compiler::COMMON_VERSION` are part of the key, so files written by
+// an older generator are not used.
+//
+// With `check`, a cached stream is compared with a freshly generated one.
+template <class Compiler>
+std::uint32_t
+generate_cached(const std::string& name, std::uint16_t* rtps, size_t num_rtps,
+                std::uint32_t* instr_buffer, size_t capacity,
+                const std::filesystem::path& cache_dir = {},
+                bool check = ENV_PARAM(XLNX_PP_INSTR_CACHE_CHECK)) {
+  if (!ENV_PARAM(XLNX_PP_INSTR_CACHE)) {
+    return (std::uint32_t)std::make_unique<Compiler>(instr_buffer)->generate(
+        rtps);
+  }
+  static std::mutex mtx;
+  static std::map<std::pair<std::string, std::vector<std::uint16_t>>,
+                  std::shared_ptr<const InstrStream>>
+      memo;
+
+  constexpr auto version = detail::compiler_version<Compiler>();
+  auto key = std::vector<std::uint16_t>(rtps, rtps + num_rtps);
+  auto memo_key = std::make_pair(name, key);
+  std::ostringstream file_name;
+  file_name << name << "_" << std::hex << std::setw(16) << std::setfill('0')
+            << detail::hash_rtps(name, version, rtps, num_rtps) << ".instr";
+  auto file = cache_dir.empty() ? std::filesystem::path()
+                                : cache_dir / file_name.str();
+
+  auto stream = std::shared_ptr<const InstrStream>();
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = memo.find(memo_key);
+    if (it != memo.end()) {
+      stream = it->second;
+    }
+  }
+  auto from = "memory";
+  if (stream == nullptr && !file.empty()) {
+    stream = detail::load_instr_stream(file, name, version, key);
+    from = "file";
+  }
+  if (stream != nullptr && check) {
+    auto tmp_rtps = key;
+    auto fresh =
+        detail::run_compiler<Compiler>(tmp_rtps.data(), num_rtps, capacity);
+    CHECK(fresh.rtps == stream->rtps)
+        << "cached rtps of " << file_name.str() << " are stale";
+    auto mismatch = std::mismatch(fresh.instr.begin(), fresh.instr.end(),
+                                  stream->instr.begin(), stream->instr.end());
+    CHECK(mismatch.first == fresh.instr.end() &&
+          mismatch.second == stream->instr.end())
+        << "cached instructions of " << file_name.str()
+        << " are stale, first difference at word "
+        << (mismatch.first - fresh.instr.begin()) << " of "
+        << fresh.instr.size() << " (cached " << stream->instr.size() << ")";
+  }
+  if (stream == nullptr) {
+    auto generated = std::make_shared<InstrStream>(
+        detail::run_compiler<Compiler>(rtps, num_rtps, capacity));
+    if (!file.empty()) {
+      detail::save_instr_stream(file, name, version, key, *generated);
+    }
+    stream = generated;
+    from = "compiler";
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    memo.emplace(memo_key, stream);
+  }
+  LOG_IF(INFO, ENV_PARAM(DEBUG_PP_INSTR_CACHE) >= 1)
+      << name << ": " << stream->instr.size() << " instruction words from "
+      << from;
+  CHECK_LE(stream->instr.size(), capacity) << "instruction buffer overflow";
+  std::memcpy(instr_buffer, stream->instr.data(),
+              stream->instr.size() * sizeof(std::uint32_t));
+  std::memcpy(rtps, stream->rtps.data(), num_rtps * sizeof(std::uint16_t));
+  return (std::uint32_t)stream->instr.size();
+}
+
+} // namespace IC
@@ -27,6 +27,11 @@ constexpr int NUM_AT_DMA_MM2S_CHS = 1;
 
 template <class Derived> class InstructionCompiler {
 public:
+  // Version of the code shared by all compilers, this file and the aie2
+  // writers. Bump it when the words they emit change: it is part of the
+  // key of cached instruction streams, see pp_instr_cache.hpp.
+  static constexpr std::uint32_t COMMON_VERSION = 1;
+
   // Ctor
   InstructionCompiler(std::uint32_t* instr_buffer = nullptr)
       : m_aie_dma(std::make_unique<AIE2::AieTileDma>()),
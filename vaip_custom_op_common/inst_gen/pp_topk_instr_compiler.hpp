@@ -16,6 +16,8 @@ public:
       : InstructionCompiler(instr_buffer) {}
   // TODO:: Add const for the rtps buffer.
   int generate(std::uint16_t* rtps);
+  // Bump when generate() emits other words for the same rtps.
+  static constexpr std::uint32_t VERSION = 1;
 };
 
 // TODO: create a separate copy of the rtps and must not change the one coming
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#ifdef _WIN32
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace vaip_common {
+
+/// A read-only mapping of a whole file.
+class MappedFile {
+public:
+  /// nullptr if the file cannot be mapped. `random_access` when the file
+  /// is read at scattered places, read-ahead is then mostly wasted.
+  static std::shared_ptr<MappedFile> open(const std::filesystem::path& path,
+                                          bool random_access = false) {
+    auto ret = std::shared_ptr<MappedFile>(new MappedFile());
+#ifdef _WIN32
+    ret->file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                             OPEN_EXISTING,
+                             random_access ? FILE_FLAG_RANDOM_ACCESS
+                                           : FILE_FLAG_SEQUENTIAL_SCAN,
+                             nullptr);
+    if (ret->file_ == INVALID_HANDLE_VALUE) {
+      return nullptr;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(ret->file_, &size) || size.QuadPart == 0) {
+      return nullptr;
+    }
+    ret->size_ = (size_t)size.QuadPart;
+    ret->mapping_ =
+        CreateFileMappingW(ret->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (ret->mapping_ == nullptr) {
+      return nullptr;
+    }
+    ret->data_ = MapViewOfFile(ret->mapping_, FILE_MAP_READ, 0, 0, 0);
+#else
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return nullptr;
+    }
+    ret->size_ = (size_t)st.st_size;
+    auto p = mmap(nullptr, ret->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      return nullptr;
+    }
+    ret->data_ = p;
+    if (random_access) {
+      madvise(p, ret->size_, MADV_RANDOM);
+    }
+#endif
+    return ret->data_ != nullptr ? ret : nullptr;
+  }
+
+  ~MappedFile() {
+#ifdef _WIN32
+    if (data_ != nullptr) {
+      UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+      CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(file_);
+    }
+#else
+    if (data_ != nullptr) {
+      munmap(data_, size_);
+    }
+#endif
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* data() const { return static_cast<const uint8_t*>(data_); }
+  size_t size() const { return size_; }
+
+private:
+  MappedFile() = default;
+  void* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#endif
+};
+
+} // namespace vaip_common
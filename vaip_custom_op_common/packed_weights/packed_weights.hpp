@@ -0,0 +1,433 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+// MatMulNBits constants repacked for ryzenai::mladfmatmulbias, shared by
+// the LLM custom ops (matmul_nbits, mlp, ssmlp, gqo).
+//
+// A packed tensor is addressed by the content of its source constants and
+// the target layout, and kept as `matmul_nbits_<key>.bin`: in the cache
+// files of the PassContext for the ops that have one, otherwise in
+// XLNX_PACKED_WEIGHTS_DIR. It is written once and mapped read-only
+// afterwards, so a second session of the same model neither repacks nor
+// holds a heap copy; every mapping of the file shares the same page cache.
+// Within a library, ops asking for the same key while the first result is
+// alive share one object. With the cache in memory, or without a
+// directory, the packed tensor lives on the heap.
+
+#include "mapped_file/mapped_file.hpp"
+#include "vaip/pass_context.hpp"
+#include "vaip/thread_pool.hpp"
+#include "vitis/ai/env_config.hpp"
+
+#include <glog/logging.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// cache directory of the ops that have no PassContext, empty: no cache
+DEF_ENV_PARAM_2(XLNX_PACKED_WEIGHTS_DIR, "", std::string)
+DEF_ENV_PARAM(DEBUG_PACKED_WEIGHTS, "0")
+
+namespace vaip_packed_weights {
+
+/// MatMulNBits constants as they are in the onnx model.
+struct MatMulNBitsSource {
+  // [n, k / 2], two int4 values per byte, low nibble first
+  const void* weights = nullptr;
+  // [n, k / block_size]
+  const float* scales = nullptr;
+  // [n, zero_point_bytes() / n], nullptr for symmetric quantization
+  const void* zero_points = nullptr;
+  int64_t k = 0;
+  int64_t n = 0;
+  int64_t bits = 4;
+  int64_t block_size = 32;
+
+  int64_t blocks() const { return k / block_size; }
+  // rows of zero points are padded to a whole, even number of int4 values
+  int64_t zero_point_bytes() const {
+    return (int64_t)(n * std::floor((float)((blocks() + 1) * bits) / 8.0f));
+  }
+};
+
+/// The same constants in the layout of mladfmatmulbias. Values are int4
+/// widened to one int8 each, minus 8.
+struct MatMulNBits {
+  // [k, n]
+  const int8_t* weights = nullptr;
+  // [k / block_size, n]
+  const float* scales = nullptr;
+  // [2 * zero_point_bytes / n, n], zeros for symmetric quantization
+  const int8_t* zeros = nullptr;
+  int64_t k = 0;
+  int64_t n = 0;
+  int64_t block_size = 0;
+  // the whole packed tensor, header included, as it is in the file
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  // the mapping or buffer behind the pointers
+  std::shared_ptr<const void> storage;
+
+  // DD tensors take non-const pointers, the data is only read.
+  void* weights_data() const { return const_cast<int8_t*>(weights); }
+  void* scales_data() const { return const_cast<float*>(scales); }
+  void* zeros_data() const { return const_cast<int8_t*>(zeros); }
+};
+
+namespace detail {
+
+static constexpr char MAGIC[8] = {'M', 'N', 'B', 'K', 'N', '0', '0', '1'};
+
+struct Header {
+  char magic[8];
+  uint64_t key[2];
+  int64_t k, n, bits, block_size;
+  // [scales, weights, zeros] follow the header, in this order
+  uint64_t zeros_size;
+  uint64_t reserved[8];
+};
+
+inline uint64_t mix(uint64_t h, uint64_t v) {
+  h ^= v * 0x9e3779b97f4a7c15ull;
+  h = (h ^ (h >> 32)) * 0xd6e8feb86659fd93ull;
+  return h ^ (h >> 32);
+}
+
+// 128-bit content hash, computed per 1MB chunk on the host thread pool and
+// combined in order, so it does not depend on the number of threads.
+inline void hash_bytes(uint64_t key[2], const void* data, size_t size) {
+  constexpr size_t CHUNK = 1u << 20;
+  auto p = static_cast<const uint8_t*>(data);
+  auto num_chunks = (int64_t)((size + CHUNK - 1) / CHUNK);
+  auto chunks = std::vector<uint64_t>(2 * num_chunks);
+  vaip_core::parallel_for(
+      0, num_chunks, 1, [&](int64_t begin, int64_t end) {
+        for (auto c = begin; c < end; ++c) {
+          auto b = p + c * CHUNK;
+          auto e = p + std::min(size, (size_t)(c + 1) * CHUNK);
+          auto h0 = 0x243f6a8885a308d3ull;
+          auto h1 = 0x13198a2e03707344ull;
+          for (; b + 8 <= e; b += 8) {
+            uint64_t v;
+            std::memcpy(&v, b, 8);
+            h0 = mix(h0, v);
+            h1 = mix(h1 + 0x632be59bd9b4e019ull, v);
+          }
+          for (; b < e; ++b) {
+            h0 = mix(h0, *b);
+            h1 = mix(h1 + 0x632be59bd9b4e019ull, *b);
+          }
+          chunks[2 * c] = h0;
+          chunks[2 * c + 1] = h1;
+        }
+      });
+  key[0] = mix(key[0], size);
+  key[1] = mix(key[1], ~size);
+  for (auto c = 0; c < num_chunks; ++c) {
+    key[0] = mix(key[0], chunks[2 * c]);
+    key[1] = mix(key[1], chunks[2 * c + 1]);
+  }
+}
+
+inline std::string key_name(const uint64_t key[2]) {
+  std::ostringstream str;
+  str << "matmul_nbits_" << std::hex << std::setfill('0') << std::setw(16)
+      << key[0] << std::setw(16) << key[1];
+  return str.str();
+}
+
+// the layout of one packed tensor inside its buffer or file
+struct Layout {
+  size_t scales, weights, zeros, end;
+};
+
+inline Layout layout(const MatMulNBitsSource& src) {
+  auto ret = Layout();
+  ret.scales = sizeof(Header);
+  ret.weights = ret.scales + src.blocks() * src.n * sizeof(float);
+  ret.zeros = ret.weights + src.k * src.n;
+  ret.end = ret.zeros + 2 * src.zero_point_bytes();
+  return ret;
+}
+
+// The original loops of the ops, split over the host thread pool.
+inline void pack(const MatMulNBitsSource& src, uint8_t* base) {
+  auto l = layout(src);
+  auto k = src.k;
+  auto n = src.n;
+  auto kblks = src.blocks();
+  auto wts = static_cast<const uint8_t*>(src.weights);
+  auto b = reinterpret_cast<int8_t*>(base + l.weights);
+  // Original weights are in NxK/2 packed as uint8, convert to KxN
+  vaip_core::parallel_for(
+      0, k / 2, vaip_core::grain_size(2 * n), [&](int64_t begin, int64_t end) {
+        for (auto i = 2 * begin; i < 2 * end; i += 2) {
+          for (int64_t j = 0; j < n; j++) {
+            auto srcv = wts[j * k / 2 + i / 2];
+            b[i * n + j] = static_cast<int8_t>((srcv & 0xf) - 8);
+            b[(i + 1) * n + j] = static_cast<int8_t>(((srcv & 0xf0) >> 4) - 8);
+          }
+        }
+      });
+  // Original scales are in Nx(K/BlockSize) shape, convert to
+  // (K/BlockSize)xN
+  auto scales = reinterpret_cast<float*>(base + l.scales);
+  for (int64_t i = 0; i < n; i++) {
+    for (int64_t j = 0; j < kblks; j++) {
+      scales[j * n + i] = src.scales[i * kblks + j];
+    }
+  }
+  // Each row of zero points was padded to have an even length kblks_pad
+  auto zeros = reinterpret_cast<int8_t*>(base + l.zeros);
+  std::memset(zeros, 0, l.end - l.zeros);
+  if (src.zero_points != nullptr) {
+    auto zero_pt = static_cast<const uint8_t*>(src.zero_points);
+    auto kblks_pad = 2 * src.zero_point_bytes() / n;
+    for (int64_t i = 0; i < n; i++) {
+      for (int64_t j = 0; j < kblks_pad; j = j + 2) {
+        auto zpv = zero_pt[(i * kblks_pad) / 2 + j / 2];
+        zeros[j * n + i] = (zpv & 0xf) - 8;
+        zeros[(j + 1) * n + i] = ((zpv & 0xf0) >> 4) - 8;
+      }
+    }
+  }
+}
+
+inline Header make_header(const MatMulNBitsSource& src, const uint64_t key[2]) {
+  auto ret = Header();
+  std::memset(&ret, 0, sizeof(ret));
+  std::memcpy(ret.magic, MAGIC, sizeof(MAGIC));
+  ret.key[0] = key[0];
+  ret.key[1] = key[1];
+  ret.k = src.k;
+  ret.n = src.n;
+  ret.bits = src.bits;
+  ret.block_size = src.block_size;
+  ret.zeros_size = 2 * src.zero_point_bytes();
+  return ret;
+}
+
+inline std::shared_ptr<const MatMulNBits>
+view(const MatMulNBitsSource& src, const uint8_t* base,
+     std::shared_ptr<const void> storage) {
+  auto l = layout(src);
+  auto ret = std::make_shared<MatMulNBits>();
+  ret->weights = reinterpret_cast<const int8_t*>(base + l.weights);
+  ret->scales = reinterpret_cast<const float*>(base + l.scales);
+  ret->zeros = reinterpret_cast<const int8_t*>(base + l.zeros);
+  ret->k = src.k;
+  ret->n = src.n;
+  ret->block_size = src.block_size;
+  ret->data = base;
+  ret->size = l.end;
+  ret->storage = std::move(storage);
+  return ret;
+}
+
+inline bool is_valid(const MatMulNBitsSource& src, const uint8_t* data,
+                     size_t size, const Header& expected) {
+  return size == layout(src).end &&
+         std::memcmp(data, &expected, sizeof(Header)) == 0;
+}
+
+inline std::shared_ptr<const MatMulNBits>
+map_file(const std::filesystem::path& file, const MatMulNBitsSource& src,
+         const Header& expected) {
+  auto mapped = vaip_common::MappedFile::open(file);
+  if (mapped == nullptr) {
+    return nullptr;
+  }
+  if (!is_valid(src, mapped->data(), mapped->size(), expected)) {
+    LOG(WARNING) << "ignore invalid packed weights " << file;
+    return nullptr;
+  }
+  auto base = mapped->data();
+  return view(src, base, std::move(mapped));
+}
+
+inline void save_file(const std::filesystem::path& file, const uint8_t* data,
+                      size_t size) {
+  // written to a temporary and renamed, so that sessions created in
+  // parallel never map a partial file.
+  auto tmp = file;
+  tmp += ".tmp";
+  auto ec = std::error_code();
+  std::filesystem::create_directories(file.parent_path(), ec);
+  {
+    auto out = std::ofstream(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      LOG_IF(INFO, ENV_PARAM(DEBUG_PACKED_WEIGHTS) >= 1)
+          << "cannot write packed weights " << tmp;
+      return;
+    }
+    out.write(reinterpret_cast<const char*>(data), size);
+  }
+  std::filesystem::rename(tmp, file, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+  }
+}
+
+// One per key, held while the key is looked up or packed, so that ops of
+// the same constants wait for the first one instead of packing again, and
+// ops of other constants do not wait at all. Entries whose packed tensor
+// is released are dropped on the next lookup.
+struct Entry {
+  std::mutex mtx;
+  std::weak_ptr<const MatMulNBits> packed;
+};
+
+inline std::shared_ptr<Entry> get_entry(const std::string& name) {
+  static std::mutex mtx;
+  static std::map<std::string, std::shared_ptr<Entry>> entries;
+  std::lock_guard<std::mutex> lock(mtx);
+  for (auto e = entries.begin(); e != entries.end();) {
+    // an entry in use by another op may not have its result yet, keep it.
+    auto unused = e->second.use_count() == 1 && e->second->packed.expired();
+    e = unused ? entries.erase(e) : std::next(e);
+  }
+  auto& ret = entries[name];
+  if (ret == nullptr) {
+    ret = std::make_shared<Entry>();
+  }
+  return ret;
+}
+
+// `has(name)` tells if the cache holds the file of `name`, `load(name,
+// header)` returns it and `save(name, header, data, size)` writes it and
+// returns it mapped; both return nullptr when they cannot.
+template <typename Has, typename Load, typename Save>
+std::shared_ptr<const MatMulNBits> get(const MatMulNBitsSource& src, Has&& has,
+                                       Load&& load, Save&& save) {
+  CHECK(src.weights != nullptr && src.scales != nullptr);
+  CHECK(src.k % 2 == 0 && src.block_size > 0 && src.k % src.block_size == 0)
+      << "k=" << src.k << " block_size=" << src.block_size;
+  uint64_t key[2] = {(uint64_t)src.k, (uint64_t)src.n};
+  key[0] = mix(key[0], (uint64_t)src.bits);
+  key[1] = mix(key[1], (uint64_t)src.block_size);
+  hash_bytes(key, src.weights, src.k * src.n / 2);
+  hash_bytes(key, src.scales, src.blocks() * src.n * sizeof(float));
+  hash_bytes(key, src.zero_points,
+             src.zero_points ? src.zero_point_bytes() : 0);
+  auto name = key_name(key);
+  auto header = make_header(src, key);
+
+  auto entry = get_entry(name);
+  std::lock_guard<std::mutex> lock(entry->mtx);
+  auto ret = entry->packed.lock();
+  auto from = "memory";
+  if (ret != nullptr && !has(name)) {
+    // shared with an op of another cache, which keeps its own file.
+    save(name, header, ret->data, ret->size);
+  }
+  if (ret == nullptr) {
+    ret = load(name, header);
+    from = "cache";
+  }
+  if (ret == nullptr) {
+    auto l = layout(src);
+    auto buffer = std::make_shared<std::vector<uint8_t>>(l.end);
+    std::memcpy(buffer->data(), &header, sizeof(header));
+    pack(src, buffer->data());
+    from = "packing";
+    ret = save(name, header, buffer->data(), buffer->size());
+    if (ret == nullptr) {
+      auto base = buffer->data();
+      ret = view(src, base, std::move(buffer));
+    }
+  }
+  entry->packed = ret;
+  LOG_IF(INFO, ENV_PARAM(DEBUG_PACKED_WEIGHTS) >= 1)
+      << name << " [" << src.k << "x" << src.n << "] from " << from;
+  return ret;
+}
+
+} // namespace detail
+
+/// `src` packed for mladfmatmulbias, kept in the cache files of `context`
+/// like the other files of the custom ops, e.g. it goes into the cache tar
+/// with them. Unless the cache is in memory, the file is mapped from the
+/// log dir. The cache files of a context are not locked, the ops of one
+/// session are created one after the other.
+inline std::shared_ptr<const MatMulNBits>
+get_matmul_nbits(const MatMulNBitsSource& src,
+                 vaip_core::PassContext& context) {
+  using ret_t = std::shared_ptr<const MatMulNBits>;
+  auto in_mem = context.cache_in_mem();
+  auto has = [&](const std::string& name) {
+    return context.has_cache_file(name + ".bin");
+  };
+  auto load = [&](const std::string& name,
+                  const detail::Header& header) -> ret_t {
+    auto filename = name + ".bin";
+    if (!context.has_cache_file(filename)) {
+      return nullptr;
+    }
+    if (!in_mem) {
+      return detail::map_file(context.get_log_dir() / filename, src, header);
+    }
+    auto data = context.read_file_u8(filename);
+    if (!data.has_value() ||
+        !detail::is_valid(src, data->data(), data->size(), header)) {
+      LOG(WARNING) << "ignore invalid packed weights " << filename;
+      return nullptr;
+    }
+    auto buffer = std::make_shared<std::vector<uint8_t>>(std::move(*data));
+    auto base = buffer->data();
+    return detail::view(src, base, std::move(buffer));
+  };
+  auto save = [&](const std::string& name, const detail::Header& header,
+                  const uint8_t* data, size_t size) -> ret_t {
+    auto filename = name + ".bin";
+    context.write_file(
+        filename,
+        gsl::span<const char>(reinterpret_cast<const char*>(data), size));
+    if (in_mem) {
+      return nullptr;
+    }
+    return detail::map_file(context.get_log_dir() / filename, src, header);
+  };
+  return detail::get(src, has, load, save);
+}
+
+/// `src` packed for mladfmatmulbias, for the ops that have no PassContext.
+/// `cache_dir` empty: no file.
+inline std::shared_ptr<const MatMulNBits>
+get_matmul_nbits(const MatMulNBitsSource& src,
+                 const std::filesystem::path& cache_dir) {
+  using ret_t = std::shared_ptr<const MatMulNBits>;
+  auto has = [](const std::string&) { return true; };
+  auto load = [&](const std::string& name,
+                  const detail::Header& header) -> ret_t {
+    if (cache_dir.empty()) {
+      return nullptr;
+    }
+    return detail::map_file(cache_dir / (name + ".bin"), src, header);
+  };
+  auto save = [&](const std::string& name, const detail::Header& header,
+                  const uint8_t* data, size_t size) -> ret_t {
+    if (cache_dir.empty()) {
+      return nullptr;
+    }
+    auto file = cache_dir / (name + ".bin");
+    detail::save_file(file, data, size);
+    return detail::map_file(file, src, header);
+  };
+  return detail::get(src, has, load, save);
+}
+
+} // namespace vaip_packed_weights
@@ -0,0 +1,468 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+// Host int8 x int8 GEMM shared by the gemm / matmul_integer custom ops.
+//
+//   C[m][n] = (sum_k (A[m][k] - a_zp) * B[k][n]) * scale + bias[n]
+//
+// The activation zero point is never subtracted from A. It is folded
+// into the epilogue with the column sums of B:
+//
+//   sum_k (A - a_zp) * B = sum_k A * B - a_zp * colsum(B)[n]
+//
+// Signed activations are mapped to unsigned on load (a ^ 0x80 = a + 128)
+// and the extra 128 goes into a_zp, so the kernels only implement
+// u8 x s8. B is packed once at construction for the ISA picked at
+// runtime: AVX512-VNNI (vpdpbusd), AVX2 (vpmaddwd on int16 pairs, which
+// cannot saturate) or portable C++.
+//
+// The epilogue helpers at the end are used after an NPU run, where the
+// int32 accumulators come from the device instead.
+
+#include "cpu_features/cpu_features.hpp"
+#include "vaip/vaip.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace vaip_qgemm {
+
+enum class Isa { SCALAR, AVX2, AVX512_VNNI };
+
+inline Isa isa() {
+  static const Isa value = vaip_cpu::has_avx512_vnni() ? Isa::AVX512_VNNI
+                           : vaip_cpu::has_avx2()      ? Isa::AVX2
+                                                       : Isa::SCALAR;
+  return value;
+}
+
+/// column sums of a row-major [K, N] int8 matrix.
+inline std::vector<int32_t> column_sums(const int8_t* b, int64_t K,
+                                        int64_t N) {
+  std::vector<int32_t> sums(N, 0);
+  for (int64_t k = 0; k < K; ++k) {
+    auto row = b + k * N;
+    for (int64_t n = 0; n < N; ++n) {
+      sums[n] += row[n];
+    }
+  }
+  return sums;
+}
+
+/// B packed for the kernels of one ISA.
+///
+/// AVX512_VNNI: blocks of 16 columns, 4 consecutive k per column, int8.
+/// AVX2/SCALAR: blocks of 8 columns, 2 consecutive k per column, int16.
+/// K and N are zero padded to whole groups and blocks.
+class PackedWeights {
+public:
+  /// `b` is row-major [K, N]. `b_zp` is subtracted with int8 wrap
+  /// around, the same as the NPU paths do before initialize_weights().
+  PackedWeights(const int8_t* b, int64_t K, int64_t N, int32_t b_zp = 0,
+                Isa target = isa())
+      : isa_(target), K_(K), N_(N) {
+    k_group_ = isa_ == Isa::AVX512_VNNI ? 4 : 2;
+    n_block_ = isa_ == Isa::AVX512_VNNI ? 16 : 8;
+    k_groups_ = (K_ + k_group_ - 1) / k_group_;
+    n_blocks_ = (N_ + n_block_ - 1) / n_block_;
+    auto packed_size = n_blocks_ * k_groups_ * n_block_ * k_group_;
+    if (isa_ == Isa::AVX512_VNNI) {
+      data8_.assign(packed_size, 0);
+    } else {
+      data16_.assign(packed_size, 0);
+    }
+    colsum_.assign(n_blocks_ * n_block_, 0);
+    for (int64_t k = 0; k < K_; ++k) {
+      auto kg = k / k_group_;
+      auto t = k % k_group_;
+      for (int64_t n = 0; n < N_; ++n) {
+        auto v = static_cast<int8_t>(b[k * N_ + n] - b_zp);
+        auto nb = n / n_block_;
+        auto j = n % n_block_;
+        auto pos = ((nb * k_groups_ + kg) * n_block_ + j) * k_group_ + t;
+        if (isa_ == Isa::AVX512_VNNI) {
+          data8_[pos] = v;
+        } else {
+          data16_[pos] = v;
+        }
+        colsum_[n] += v;
+      }
+    }
+  }
+
+  Isa target() const { return isa_; }
+  int64_t K() const { return K_; }
+  int64_t N() const { return N_; }
+  int64_t n_blocks() const { return n_blocks_; }
+  int64_t n_block() const { return n_block_; }
+  int64_t k_groups() const { return k_groups_; }
+  /// padded to n_blocks() * n_block() entries.
+  const int32_t* colsum() const { return colsum_.data(); }
+  const int8_t* data8() const { return data8_.data(); }
+  const int16_t* data16() const { return data16_.data(); }
+
+private:
+  Isa isa_;
+  int64_t K_;
+  int64_t N_;
+  int64_t k_group_;
+  int64_t n_block_;
+  int64_t k_groups_;
+  int64_t n_blocks_;
+  std::vector<int8_t> data8_;
+  std::vector<int16_t> data16_;
+  std::vector<int32_t> colsum_;
+};
+
+/// Where and how the accumulators are written.
+struct Epilogue {
+  int32_t a_zp = 0;
+  float scale = 1.0f;
+  const float* bias = nullptr; // optional, N entries
+  float* out_f32 = nullptr;    // either this ...
+  int32_t* out_s32 = nullptr;  // ... or this, ld = ldc
+  int64_t ldc = 0;
+};
+
+namespace detail {
+
+template <bool SIGNED_A> inline uint8_t load_a1(const uint8_t* p) {
+  return SIGNED_A ? static_cast<uint8_t>(p[0] ^ 0x80) : p[0];
+}
+
+// k quad of one row as a little endian int32, zero beyond `count`.
+template <bool SIGNED_A>
+inline int32_t load_a4(const uint8_t* p, int64_t count) {
+  int32_t v = 0;
+  if (count >= 4) {
+    std::memcpy(&v, p, 4);
+    if (SIGNED_A) {
+      v ^= static_cast<int32_t>(0x80808080u);
+    }
+  } else {
+    for (int64_t t = 0; t < count; ++t) {
+      v |= static_cast<int32_t>(load_a1<SIGNED_A>(p + t)) << (8 * t);
+    }
+  }
+  return v;
+}
+
+// k pair of one row as two uint16 in an int32, zero beyond `count`.
+template <bool SIGNED_A>
+inline int32_t load_a2(const uint8_t* p, int64_t count) {
+  int32_t lo = load_a1<SIGNED_A>(p);
+  int32_t hi = count >= 2 ? load_a1<SIGNED_A>(p + 1) : 0;
+  return lo | (hi << 16);
+}
+
+inline void store_block(const int32_t* acc, int64_t m, int64_t n0,
+                        int64_t count, const int32_t* colsum,
+                        const Epilogue& ep) {
+  if (ep.out_s32 != nullptr) {
+    auto out = ep.out_s32 + m * ep.ldc + n0;
+    for (int64_t j = 0; j < count; ++j) {
+      out[j] = acc[j] - ep.a_zp * colsum[j];
+    }
+  } else {
+    auto out = ep.out_f32 + m * ep.ldc + n0;
+    for (int64_t j = 0; j < count; ++j) {
+      auto v = static_cast<float>(acc[j] - ep.a_zp * colsum[j]) * ep.scale;
+      out[j] = ep.bias != nullptr ? v + ep.bias[n0 + j] : v;
+    }
+  }
+}
+
+template <bool SIGNED_A>
+inline void kernel_scalar(const uint8_t* A, int64_t lda, int64_t m0,
+                          int64_t m1, const PackedWeights& B, int64_t nb0,
+                          int64_t nb1, const Epilogue& ep) {
+  auto K = B.K();
+  auto KG = B.k_groups();
+  int32_t acc[8];
+  for (auto m = m0; m < m1; ++m) {
+    auto a = A + m * lda;
+    for (auto nb = nb0; nb < nb1; ++nb) {
+      std::fill(acc, acc + 8, 0);
+      auto bp = B.data16() + nb * KG * 16;
+      for (int64_t kg = 0; kg < KG; ++kg) {
+        auto k = kg * 2;
+        int32_t a0 = load_a1<SIGNED_A>(a + k);
+        int32_t a1 = k + 1 < K ? load_a1<SIGNED_A>(a + k + 1) : 0;
+        for (int j = 0; j < 8; ++j) {
+          acc[j] += a0 * bp[kg * 16 + j * 2] + a1 * bp[kg * 16 + j * 2 + 1];
+        }
+      }
+      auto n0 = nb * 8;
+      store_block(acc, m, n0, std::min<int64_t>(8, B.N() - n0),
+                  B.colsum() + n0, ep);
+    }
+  }
+}
+
+#if VAIP_CPU_X86
+template <int MR, bool SIGNED_A>
+VAIP_CPU_TARGET("avx2,fma")
+inline void kernel_avx2_block(const uint8_t* A, int64_t lda, int64_t m,
+                              const PackedWeights& B, int64_t nb,
+                              const Epilogue& ep) {
+  auto K = B.K();
+  auto KG = B.k_groups();
+  __m256i acc[MR];
+  for (int r = 0; r < MR; ++r) {
+    acc[r] = _mm256_setzero_si256();
+  }
+  auto bp = B.data16() + nb * KG * 16;
+  for (int64_t kg = 0; kg < KG; ++kg) {
+    auto b = _mm256_loadu_si256((const __m256i*)(bp + kg * 16));
+    auto k = kg * 2;
+    for (int r = 0; r < MR; ++r) {
+      auto a = _mm256_set1_epi32(
+          load_a2<SIGNED_A>(A + (m + r) * lda + k, K - k));
+      acc[r] = _mm256_add_epi32(acc[r], _mm256_madd_epi16(a, b));
+    }
+  }
+  auto n0 = nb * 8;
+  auto count = std::min<int64_t>(8, B.N() - n0);
+  auto colsum = B.colsum() + n0;
+  auto corr = _mm256_mullo_epi32(
+      _mm256_loadu_si256((const __m256i*)colsum), _mm256_set1_epi32(ep.a_zp));
+  for (int r = 0; r < MR; ++r) {
+    auto v = _mm256_sub_epi32(acc[r], corr);
+    alignas(32) int32_t tmp_s32[8];
+    alignas(32) float tmp_f32[8];
+    if (ep.out_s32 != nullptr) {
+      auto out = ep.out_s32 + (m + r) * ep.ldc + n0;
+      if (count == 8) {
+        _mm256_storeu_si256((__m256i*)out, v);
+      } else {
+        _mm256_store_si256((__m256i*)tmp_s32, v);
+        std::memcpy(out, tmp_s32, count * sizeof(int32_t));
+      }
+    } else {
+      auto out = ep.out_f32 + (m + r) * ep.ldc + n0;
+      auto f = _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(ep.scale));
+      if (count == 8) {
+        if (ep.bias != nullptr) {
+          f = _mm256_add_ps(f, _mm256_loadu_ps(ep.bias + n0));
+        }
+        _mm256_storeu_ps(out, f);
+      } else {
+        _mm256_store_ps(tmp_f32, f);
+        for (int64_t j = 0; j < count; ++j) {
+          out[j] = ep.bias != nullptr ? tmp_f32[j] + ep.bias[n0 + j]
+                                      : tmp_f32[j];
+        }
+      }
+    }
+  }
+}
+
+template <int MR, bool SIGNED_A>
+VAIP_CPU_TARGET("avx512f,avx512bw,avx512vnni")
+inline void kernel_vnni_block(const uint8_t* A, int64_t lda, int64_t m,
+                              const PackedWeights& B, int64_t nb,
+                              const Epilogue& ep) {
+  auto K = B.K();
+  auto KG = B.k_groups();
+  __m512i acc[MR];
+  for (int r = 0; r < MR; ++r) {
+    acc[r] = _mm512_setzero_si512();
+  }
+  auto bp = B.data8() + nb * KG * 64;
+  for (int64_t kg = 0; kg < KG; ++kg) {
+    auto b = _mm512_loadu_si512((const void*)(bp + kg * 64));
+    auto k = kg * 4;
+    for (int r = 0; r < MR; ++r) {
+      auto a = _mm512_set1_epi32(
+          load_a4<SIGNED_A>(A + (m + r) * lda + k, K - k));
+      acc[r] = _mm512_dpbusd_epi32(acc[r], a, b);
+    }
+  }
+  auto n0 = nb * 16;
+  auto count = std::min<int64_t>(16, B.N() - n0);
+  auto mask = static_cast<__mmask16>((1u << count) - 1u);
+  auto corr = _mm512_mullo_epi32(
+      _mm512_loadu_si512((const void*)(B.colsum() + n0)),
+      _mm512_set1_epi32(ep.a_zp));
+  for (int r = 0; r < MR; ++r) {
+    auto v = _mm512_sub_epi32(acc[r], corr);
+    if (ep.out_s32 != nullptr) {
+      _mm512_mask_storeu_epi32(ep.out_s32 + (m + r) * ep.ldc + n0, mask, v);
+    } else {
+      auto f = _mm512_mul_ps(_mm512_cvtepi32_ps(v), _mm512_set1_ps(ep.scale));
+      if (ep.bias != nullptr) {
+        f = _mm512_add_ps(f, _mm512_maskz_loadu_ps(mask, ep.bias + n0));
+      }
+      _mm512_mask_storeu_ps(ep.out_f32 + (m + r) * ep.ldc + n0, mask, f);
+    }
+  }
+}
+
+// 4 rows share each load of B.
+template <bool SIGNED_A>
+inline void kernel_simd(const uint8_t* A, int64_t lda, int64_t m0,
+                        int64_t m1, const PackedWeights& B, int64_t nb0,
+                        int64_t nb1, const Epilogue& ep) {
+  constexpr int MR = 4;
+  bool vnni = B.target() == Isa::AVX512_VNNI;
+  for (auto nb = nb0; nb < nb1; ++nb) {
+    auto m = m0;
+    for (; m + MR <= m1; m += MR) {
+      if (vnni) {
+        kernel_vnni_block<MR, SIGNED_A>(A, lda, m, B, nb, ep);
+      } else {
+        kernel_avx2_block<MR, SIGNED_A>(A, lda, m, B, nb, ep);
+      }
+    }
+    for (; m < m1; ++m) {
+      if (vnni) {
+        kernel_vnni_block<1, SIGNED_A>(A, lda, m, B, nb, ep);
+      } else {
+        kernel_avx2_block<1, SIGNED_A>(A, lda, m, B, nb, ep);
+      }
+    }
+  }
+}
+#endif
+
+template <bool SIGNED_A>
+inline void qgemm(const uint8_t* A, int64_t M, int64_t lda,
+                  const PackedWeights& B, const Epilogue& ep) {
+  // N blocks are split between threads so that every thread streams
+  // its own part of B; this also works for M == 1.
+  auto run = [&](int64_t nb0, int64_t nb1) {
+#if VAIP_CPU_X86
+    if (B.target() != Isa::SCALAR) {
+      kernel_simd<SIGNED_A>(A, lda, 0, M, B, nb0, nb1, ep);
+      return;
+    }
+#endif
+    kernel_scalar<SIGNED_A>(A, lda, 0, M, B, nb0, nb1, ep);
+  };
+  auto b_elem = B.target() == Isa::AVX512_VNNI ? 1 : 2;
+  auto block_bytes = B.n_block() * (B.K() * b_elem + M * 4);
+  vaip_core::parallel_for(0, B.n_blocks(), vaip_core::grain_size(block_bytes),
+                          run);
+}
+
+} // namespace detail
+
+/// C = ((A - a_zp) x B) * scale + bias, A row-major [M, K] with row
+/// stride `lda`, C row-major with row stride `ldc`. `bias` may be null.
+inline void qgemm(const uint8_t* A, int64_t M, int64_t lda,
+                  const PackedWeights& B, int32_t a_zp, float scale,
+                  const float* bias, float* C, int64_t ldc) {
+  Epilogue ep;
+  ep.a_zp = a_zp;
+  ep.scale = scale;
+  ep.bias = bias;
+  ep.out_f32 = C;
+  ep.ldc = ldc;
+  detail::qgemm<false>(A, M, lda, B, ep);
+}
+
+inline void qgemm(const int8_t* A, int64_t M, int64_t lda,
+                  const PackedWeights& B, int32_t a_zp, float scale,
+                  const float* bias, float* C, int64_t ldc) {
+  Epilogue ep;
+  ep.a_zp = a_zp + 128;
+  ep.scale = scale;
+  ep.bias = bias;
+  ep.out_f32 = C;
+  ep.ldc = ldc;
+  detail::qgemm<true>(reinterpret_cast<const uint8_t*>(A), M, lda, B, ep);
+}
+
+/// C = (A - a_zp) x B as int32, the MatMulInteger semantic.
+inline void qgemm(const uint8_t* A, int64_t M, int64_t lda,
+                  const PackedWeights& B, int32_t a_zp, int32_t* C,
+                  int64_t ldc) {
+  Epilogue ep;
+  ep.a_zp = a_zp;
+  ep.out_s32 = C;
+  ep.ldc = ldc;
+  detail::qgemm<false>(A, M, lda, B, ep);
+}
+
+inline void qgemm(const int8_t* A, int64_t M, int64_t lda,
+                  const PackedWeights& B, int32_t a_zp, int32_t* C,
+                  int64_t ldc) {
+  Epilogue ep;
+  ep.a_zp = a_zp + 128;
+  ep.out_s32 = C;
+  ep.ldc = ldc;
+  detail::qgemm<true>(reinterpret_cast<const uint8_t*>(A), M, lda, B, ep);
+}
+
+/// uint8 activations for an NPU kernel that takes int8: x - 128 is x
+/// with the sign bit flipped, done 8 bytes at a time. The zero point left
+/// to remove is then a_zp - 128.
+inline void to_s8(const uint8_t* x, int64_t size, int8_t* y) {
+  vaip_core::parallel_for(
+      0, size, vaip_core::grain_size(2), [&](int64_t begin, int64_t end) {
+        auto i = begin;
+        for (; i + 8 <= end; i += 8) {
+          uint64_t v;
+          std::memcpy(&v, x + i, 8);
+          v ^= 0x8080808080808080ull;
+          std::memcpy(y + i, &v, 8);
+        }
+        for (; i < end; ++i) {
+          y[i] = static_cast<int8_t>(x[i] ^ 0x80);
+        }
+      });
+}
+
+/// uint8 activations for an NPU kernel that takes int16: widened as they
+/// are, the whole zero point is left to the epilogue.
+inline void to_s16(const uint8_t* x, int64_t size, int16_t* y) {
+  vaip_core::parallel_for(0, size, vaip_core::grain_size(3),
+                          [&](int64_t begin, int64_t end) {
+                            for (auto i = begin; i < end; ++i) {
+                              y[i] = x[i];
+                            }
+                          });
+}
+
+/// Host epilogue for int32 accumulators computed elsewhere, e.g. on
+/// the NPU without subtracting the activation zero point first:
+/// C = (acc - a_zp * colsum[n]) * scale + bias[n]. `bias` may be null.
+inline void dequant_epilogue(const int32_t* acc, int64_t M, int64_t N,
+                             int64_t ld_acc, const int32_t* colsum,
+                             int32_t a_zp, float scale, const float* bias,
+                             float* C, int64_t ldc) {
+  for (int64_t m = 0; m < M; ++m) {
+    auto a = acc + m * ld_acc;
+    auto c = C + m * ldc;
+    if (bias != nullptr) {
+      for (int64_t n = 0; n < N; ++n) {
+        c[n] = static_cast<float>(a[n] - a_zp * colsum[n]) * scale + bias[n];
+      }
+    } else {
+      for (int64_t n = 0; n < N; ++n) {
+        c[n] = static_cast<float>(a[n] - a_zp * colsum[n]) * scale;
+      }
+    }
+  }
+}
+
+/// C = acc - a_zp * colsum[n], for int32 outputs.
+template <typename AccType>
+inline void zp_epilogue(const AccType* acc, int64_t M, int64_t N,
+                        int64_t ld_acc, const int32_t* colsum, int32_t a_zp,
+                        int32_t* C, int64_t ldc) {
+  for (int64_t m = 0; m < M; ++m) {
+    auto a = acc + m * ld_acc;
+    auto c = C + m * ldc;
+    for (int64_t n = 0; n < N; ++n) {
+      c[n] = static_cast<int32_t>(a[n] - a_zp * colsum[n]);
+    }
+  }
+}
+
+} // namespace vaip_qgemm
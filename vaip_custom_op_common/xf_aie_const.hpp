@@ -11,6 +11,8 @@
 #define RTP_ELEMENTS 64
 #define RTP_SIZE (RTP_ELEMENTS * sizeof(int16_t))
 #define RTP_OFFSETS_SIZE (RTP_SIZE + 32 * 3) // + 3 offset arrays of 32 bytes
+// words of a metadata + instruction buffer
+#define INSTR_BUFFER_WORDS 30000
 
 enum PP_AIE_OPCODES {
   PP_AIE_FD_PRE,
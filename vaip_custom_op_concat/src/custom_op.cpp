@@ -26,31 +26,17 @@ template <typename OutputType>
 inline void QuantizeLinear(const float* Input, OutputType* Output, size_t N,
                            float Scale, float ZeroPoint, float MinimumValue,
                            float MaximumValue) {
-  auto THREAD_NUM =
-      std::max((int)std::thread::hardware_concurrency() / 2, (int)1);
-  std::vector<std::future<int>> thr_fut(THREAD_NUM);
-  size_t THREAD_WORKLOAD = size_t(ceil((float)N / THREAD_NUM));
-  for (size_t i = 0U; i < THREAD_NUM; i++) {
-    thr_fut[i] = std::async(
-        std::launch::async,
-        [&](size_t i) {
-          size_t BASE_POS = i * THREAD_WORKLOAD;
-          auto workload = std::min(THREAD_WORKLOAD + BASE_POS, N);
-          float FloatValue;
-          for (size_t n = BASE_POS; n < workload; n++) {
-            FloatValue = std::nearbyintf(Input[n] / Scale) + ZeroPoint;
-            FloatValue = std::max(FloatValue, MinimumValue);
-            FloatValue = std::min(FloatValue, MaximumValue);
-            Output[n] = (OutputType)(int32_t)FloatValue;
-          }
-          return 0;
-        },
-        i);
-  }
-
-  for (auto i = 0U; i < THREAD_NUM; i++) {
-    thr_fut[i].wait();
-  }
+  vaip_core::parallel_for(
+      0, (int64_t)N, vaip_core::grain_size(sizeof(float) + sizeof(OutputType)),
+      [&](int64_t begin, int64_t end) {
+        float FloatValue;
+        for (auto n = begin; n < end; n++) {
+          FloatValue = std::nearbyintf(Input[n] / Scale) + ZeroPoint;
+          FloatValue = std::max(FloatValue, MinimumValue);
+          FloatValue = std::min(FloatValue, MaximumValue);
+          Output[n] = (OutputType)(int32_t)FloatValue;
+        }
+      });
 }
 void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   // std::cout << " Custom CONCAT computed." <<std::endl;
@@ -23,6 +23,8 @@ DEF_ENV_PARAM_2(XLNX_VART_FIRMWARE, "", std::string)
 
 namespace vaip_decode_filter_boxes_custom_op {
 
+static constexpr float SCORE_THRESHOLD = 0.5f;
+
 template <typename DType, typename Type, int Dim>
 static void ReadFromFile(std::string& filename,
                          std::vector<std::array<Type, Dim>>& buffer) {
@@ -120,6 +122,7 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
   kernel_->sync_instructions(instr_bo_);
 #else
   ReadFromFile<float, float, 4>(std::string("C:\\ssd_anchors.txt"), anchors_);
+  fdpost_cpu_ = std::make_unique<FdPostCpu>(anchors_, SCORE_THRESHOLD);
 #endif
 }
 
@@ -168,7 +171,7 @@ struct Box {
 static std::vector<size_t> ValiateAndFilterBoxes(const float* boxes,
                                                  const float* scores,
                                                  size_t spatial_dim) {
-  constexpr float score_threshold = 0.5f;
+  constexpr float score_threshold = SCORE_THRESHOLD;
   std::vector<size_t> keepIdx;
   for (auto i = 0u; i < spatial_dim; ++i) {
     auto box_ptr = boxes + i * 4;
@@ -325,31 +328,11 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   auto boxes_padded = kernel_->get_host_buffer_boxes();
   auto score_padded = kernel_->get_host_buffer_scores();
 
-  int idx = 0;
-  auto dims = boxes_shape[2];
-  // Pad boxes
-  for (int spd = 0; spd < spatial_dimension; ++spd) {
-    for (int d = 0; d < dims; ++d) {
-      // get value in fixed point
-      boxes_padded[idx++] =
-          static_cast<uint8_t>(boxes_raw[(spd * dims) + d] * 8);
-    }
-    boxes_padded[idx++] = 0;
-    boxes_padded[idx++] = 0;
-  }
-
-  idx = 0;
-  dims = scores_shape[2];
-  // Pad boxes
-  for (int spd = 0; spd < spatial_dimension; ++spd) {
-    for (int d = 0; d < dims; ++d) {
-      // get value in fixed point
-      score_padded[idx++] =
-          static_cast<uint8_t>(score_raw[(spd * dims) + d] * 128);
-    }
-    score_padded[idx++] = 0;
-    score_padded[idx++] = 0;
-  }
+  // boxes: 10 values + 2 pad in Q3, scores: 2 classes + 2 pad in Q7
+  quantize_pad(boxes_raw, boxes_padded, spatial_dimension, boxes_shape[2],
+               boxes_shape[2] + 2, 3);
+  quantize_pad(score_raw, score_padded, spatial_dimension, scores_shape[2],
+               scores_shape[2] + 2, F_BITS);
 
   // Run AIE Kernel
   auto attrs = context_->get_attrs();
@@ -396,43 +379,34 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
     aie_box_ptr += 4;
   }
 #else // FDPOST_CPU_KERNEL
-  // Decoded boxes
-  std::vector<float> decoded_boxes;
-  // Decode Boxes
-  for (int bidx = 0; bidx < spatial_dimension; ++bidx) {
-    auto box_raw = boxes_raw + bidx * 10;
-    auto ycenter =
-        ((box_raw[0] / 10.0f) * anchors_[bidx][2]) + anchors_[bidx][0];
-    auto xcenter =
-        ((box_raw[1] / 10.0f) * anchors_[bidx][3]) + anchors_[bidx][1];
-
-    auto half_h = 0.5f * (std::expf(box_raw[2] / 5.0f)) * anchors_[bidx][2];
-    auto half_w = 0.5f * (std::expf(box_raw[3] / 5.0f)) * anchors_[bidx][3];
-    auto y_min = ycenter - half_h;
-    auto x_min = xcenter - half_w;
-    auto y_max = ycenter + half_h;
-    auto x_max = xcenter + half_w;
-    decoded_boxes.push_back(y_min);
-    decoded_boxes.push_back(x_min);
-    decoded_boxes.push_back(y_max);
-    decoded_boxes.push_back(x_max);
-  }
-
   auto iou_threshold = 0.6000000238418579f;
   auto num_classes = scores_shape[2];
-
-  // Transpose scores
-  std::vector<float> score_tr(scores_shape[0] * scores_shape[1] *
-                              scores_shape[2]);
-
-  for (auto sd = 0; sd < spatial_dimension; ++sd) {
+  CHECK_EQ(spatial_dimension, (int64_t)fdpost_cpu_->num_anchors());
+
+  // Threshold scores first, decode only the anchors that pass.
+  std::lock_guard<std::mutex> lock(decoded_mutex_);
+  fdpost_cpu_->run(boxes_raw, boxes_shape[2], score_raw, num_classes,
+                   decoded_);
+  auto num_kept = decoded_.size;
+  LOG_THIS(1) << "kept " << num_kept << " of " << spatial_dimension
+              << " anchors";
+
+  // Pack kept boxes and their transposed scores for NMS
+  std::vector<float> decoded_boxes(num_kept * 4);
+  std::vector<float> score_tr(num_classes * num_kept);
+  for (auto k = 0u; k < num_kept; ++k) {
+    decoded_boxes[k * 4 + 0] = decoded_.ymin[k];
+    decoded_boxes[k * 4 + 1] = decoded_.xmin[k];
+    decoded_boxes[k * 4 + 2] = decoded_.ymax[k];
+    decoded_boxes[k * 4 + 3] = decoded_.xmax[k];
+    auto scores_k = score_raw + decoded_.index[k] * num_classes;
     for (auto nc = 0; nc < num_classes; ++nc) {
-      score_tr[nc * spatial_dimension + sd] = score_raw[sd * num_classes + nc];
+      score_tr[nc * num_kept + k] = scores_k[nc];
     }
   }
 
   auto detected_boxes = NMSSelectBox(
-      iou_threshold, num_batches, spatial_dimension, num_classes,
+      iou_threshold, num_batches, num_kept, num_classes,
       static_cast<const float*>(decoded_boxes.data()), score_tr.data());
 
   // process
@@ -19,6 +19,7 @@
 // FD Post kernel
 #  include "fdpost.hpp"
 #endif
+#include "fdpost_cpu.hpp"
 
 namespace vaip_decode_filter_boxes_custom_op {
 using namespace vaip_core;
@@ -38,6 +39,10 @@ private:
   xrt::bo instr_bo_;
   std::string kernel_name_;
   const uint32_t box_scale_ = 300;
+#else
+  std::unique_ptr<FdPostCpu> fdpost_cpu_;
+  mutable std::mutex decoded_mutex_;
+  mutable DecodedBoxes decoded_;
 #endif
   virtual void Compute(const OrtApi* api,
                        OrtKernelContext* context) const override final;
@@ -0,0 +1,252 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "vaip/vaip.hpp"
+
+#include "fdpost_cpu.hpp"
+
+#include "cpu_features/cpu_features.hpp"
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vaip_decode_filter_boxes_custom_op {
+
+void DecodedBoxes::reserve(size_t num_anchors) {
+  index.resize(num_anchors);
+  ymin.resize(num_anchors);
+  xmin.resize(num_anchors);
+  ymax.resize(num_anchors);
+  xmax.resize(num_anchors);
+}
+
+FdPostCpu::FdPostCpu(const std::vector<std::array<float, 4>>& anchors,
+                     float score_threshold)
+    : score_threshold_(score_threshold) {
+  anchor_y_.reserve(anchors.size());
+  anchor_x_.reserve(anchors.size());
+  anchor_h_.reserve(anchors.size());
+  anchor_w_.reserve(anchors.size());
+  for (auto& a : anchors) {
+    anchor_y_.push_back(a[0]);
+    anchor_x_.push_back(a[1]);
+    anchor_h_.push_back(a[2]);
+    anchor_w_.push_back(a[3]);
+  }
+}
+
+#if VAIP_CPU_X86
+// push(idx) of the scores >= threshold in [i, last), 8 at a time; returns
+// the index of the first score left.
+template <typename Push>
+VAIP_CPU_TARGET("avx2")
+static size_t select_avx2(const float* scores, float threshold, size_t i,
+                          size_t last, Push&& push) {
+  auto ctz = [](unsigned mask) {
+#  ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return static_cast<size_t>(bit);
+#  else
+    return static_cast<size_t>(__builtin_ctz(mask));
+#  endif
+  };
+  const auto thr = _mm256_set1_ps(threshold);
+  for (; i + 8 <= last; i += 8) {
+    auto v = _mm256_loadu_ps(scores + i);
+    auto mask = _mm256_movemask_ps(_mm256_cmp_ps(v, thr, _CMP_GE_OQ));
+    while (mask != 0) {
+      push(i + ctz(static_cast<unsigned>(mask)));
+      mask &= mask - 1;
+    }
+  }
+  return i;
+}
+#endif
+
+size_t FdPostCpu::select(const float* scores, size_t num_classes,
+                         size_t begin, size_t end, uint32_t* keep) const {
+  size_t n = 0u;
+  auto i = begin * num_classes;
+  auto last = end * num_classes;
+  // The same anchor can be hit by several classes; scores are scanned
+  // in order so a duplicate is always the previous entry.
+  auto push = [&](size_t score_idx) {
+    auto anchor = static_cast<uint32_t>(score_idx / num_classes);
+    if (n == 0u || keep[n - 1] != anchor) {
+      keep[n++] = anchor;
+    }
+  };
+#if VAIP_CPU_X86
+  if (vaip_cpu::has_avx2()) {
+    i = select_avx2(scores, score_threshold_, i, last, push);
+  }
+#endif
+  for (; i < last; ++i) {
+    if (scores[i] >= score_threshold_) {
+      push(i);
+    }
+  }
+  return n;
+}
+
+#if VAIP_CPU_X86
+// exp(x) for 8 floats, Cephes polynomial, relative error ~2e-7.
+VAIP_CPU_TARGET("avx2")
+static inline __m256 exp256_ps(__m256 x) {
+  const auto one = _mm256_set1_ps(1.0f);
+  x = _mm256_min_ps(x, _mm256_set1_ps(88.3762626647949f));
+  x = _mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f));
+  auto fx = _mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f));
+  fx = _mm256_add_ps(fx, _mm256_set1_ps(0.5f));
+  fx = _mm256_floor_ps(fx);
+  x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(0.693359375f)));
+  x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(-2.12194440e-4f)));
+  auto z = _mm256_mul_ps(x, x);
+  auto y = _mm256_set1_ps(1.9875691500E-4f);
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.3981999507E-3f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(8.3334519073E-3f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(4.1665795894E-2f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.6666665459E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(5.0000001201E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, z), _mm256_add_ps(x, one));
+  auto pow2n = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(0x7f)), 23);
+  return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2n));
+}
+
+// the boxes of the kept anchors out.index[0, n / 8 * 8) into out; returns
+// the number decoded.
+VAIP_CPU_TARGET("avx2")
+static size_t decode_avx2(const float* boxes, size_t box_dims,
+                          const float* anchor_y, const float* anchor_x,
+                          const float* anchor_h, const float* anchor_w,
+                          DecodedBoxes& out) {
+  auto n = out.size;
+  size_t i = 0u;
+  alignas(32) float ty[8], tx[8], th[8], tw[8];
+  alignas(32) float ay[8], ax[8], ah[8], aw[8];
+  const auto ten = _mm256_set1_ps(10.0f);
+  const auto five = _mm256_set1_ps(5.0f);
+  const auto half = _mm256_set1_ps(0.5f);
+  for (; i + 8 <= n; i += 8) {
+    // gather the kept anchors into SoA lanes
+    for (auto l = 0u; l < 8u; ++l) {
+      auto idx = out.index[i + l];
+      auto b = boxes + idx * box_dims;
+      ty[l] = b[0];
+      tx[l] = b[1];
+      th[l] = b[2];
+      tw[l] = b[3];
+      ay[l] = anchor_y[idx];
+      ax[l] = anchor_x[idx];
+      ah[l] = anchor_h[idx];
+      aw[l] = anchor_w[idx];
+    }
+    auto vah = _mm256_load_ps(ah);
+    auto vaw = _mm256_load_ps(aw);
+    auto yc = _mm256_add_ps(
+        _mm256_mul_ps(_mm256_div_ps(_mm256_load_ps(ty), ten), vah),
+        _mm256_load_ps(ay));
+    auto xc = _mm256_add_ps(
+        _mm256_mul_ps(_mm256_div_ps(_mm256_load_ps(tx), ten), vaw),
+        _mm256_load_ps(ax));
+    auto eh = exp256_ps(_mm256_div_ps(_mm256_load_ps(th), five));
+    auto ew = exp256_ps(_mm256_div_ps(_mm256_load_ps(tw), five));
+    auto hh = _mm256_mul_ps(_mm256_mul_ps(half, eh), vah);
+    auto hw = _mm256_mul_ps(_mm256_mul_ps(half, ew), vaw);
+    _mm256_storeu_ps(out.ymin.data() + i, _mm256_sub_ps(yc, hh));
+    _mm256_storeu_ps(out.xmin.data() + i, _mm256_sub_ps(xc, hw));
+    _mm256_storeu_ps(out.ymax.data() + i, _mm256_add_ps(yc, hh));
+    _mm256_storeu_ps(out.xmax.data() + i, _mm256_add_ps(xc, hw));
+  }
+  return i;
+}
+#endif
+
+void FdPostCpu::decode(const float* boxes, size_t box_dims,
+                       DecodedBoxes& out) const {
+  auto n = out.size;
+  size_t i = 0u;
+#if VAIP_CPU_X86
+  if (vaip_cpu::has_avx2()) {
+    i = decode_avx2(boxes, box_dims, anchor_y_.data(), anchor_x_.data(),
+                    anchor_h_.data(), anchor_w_.data(), out);
+  }
+#endif
+  for (; i < n; ++i) {
+    auto idx = out.index[i];
+    auto b = boxes + idx * box_dims;
+    auto ycenter = (b[0] / 10.0f) * anchor_h_[idx] + anchor_y_[idx];
+    auto xcenter = (b[1] / 10.0f) * anchor_w_[idx] + anchor_x_[idx];
+    auto half_h = 0.5f * std::exp(b[2] / 5.0f) * anchor_h_[idx];
+    auto half_w = 0.5f * std::exp(b[3] / 5.0f) * anchor_w_[idx];
+    out.ymin[i] = ycenter - half_h;
+    out.xmin[i] = xcenter - half_w;
+    out.ymax[i] = ycenter + half_h;
+    out.xmax[i] = xcenter + half_w;
+  }
+}
+
+void FdPostCpu::run(const float* boxes, size_t box_dims, const float* scores,
+                    size_t num_classes, DecodedBoxes& out) const {
+  CHECK_GE(box_dims, 4u);
+  auto n = num_anchors();
+  out.reserve(n);
+  auto keep = out.index.data();
+
+  auto grain = (size_t)vaip_core::grain_size(num_classes * sizeof(float));
+  auto num_parts = std::clamp(n / grain, (size_t)1,
+                              vaip_core::ThreadPool::instance().size());
+  if (num_parts == 1) {
+    out.size = select(scores, num_classes, 0, n, keep);
+  } else {
+    // each part writes its survivors at the start of its own range,
+    // ranges are then compacted in order.
+    auto workload = (n + num_parts - 1) / num_parts;
+    std::vector<size_t> counts(num_parts, 0u);
+    vaip_core::parallel_for(0, (int64_t)num_parts, 1,
+                            [&](int64_t part_begin, int64_t part_end) {
+                              for (auto t = part_begin; t < part_end; ++t) {
+                                auto begin = std::min((size_t)t * workload, n);
+                                auto end = std::min(begin + workload, n);
+                                counts[t] = select(scores, num_classes, begin,
+                                                   end, keep + begin);
+                              }
+                            });
+    size_t total = 0u;
+    for (auto t = 0u; t < num_parts; ++t) {
+      auto count = counts[t];
+      auto begin = std::min(t * workload, n);
+      if (begin != total && count != 0u) {
+        std::memmove(keep + total, keep + begin, count * sizeof(uint32_t));
+      }
+      total += count;
+    }
+    out.size = total;
+  }
+  decode(boxes, box_dims, out);
+}
+
+void quantize_pad(const float* src, uint8_t* dst, size_t rows, size_t dims,
+                  size_t padded_dims, int fbits) {
+  auto scale = static_cast<float>(1 << fbits);
+  for (auto r = 0u; r < rows; ++r) {
+    auto s = src + r * dims;
+    auto d = dst + r * padded_dims;
+    // truncate toward zero and keep the low byte, as the former
+    // static_cast<uint8_t>(float) did, in a form that vectorizes.
+    for (auto i = 0u; i < dims; ++i) {
+      d[i] = static_cast<uint8_t>(static_cast<int32_t>(s[i] * scale));
+    }
+    for (auto i = dims; i < padded_dims; ++i) {
+      d[i] = 0;
+    }
+  }
+}
+
+} // namespace vaip_decode_filter_boxes_custom_op
@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vaip_decode_filter_boxes_custom_op {
+
+/// Decoded boxes of the anchors that passed the score threshold, in
+/// structure-of-arrays layout. Buffers are sized once for the maximum
+/// number of anchors and reused across calls; only the first `size`
+/// entries are valid.
+struct DecodedBoxes {
+  void reserve(size_t num_anchors);
+
+  size_t size = 0u;
+  std::vector<uint32_t> index; // anchor index of each kept box
+  std::vector<float> ymin;
+  std::vector<float> xmin;
+  std::vector<float> ymax;
+  std::vector<float> xmax;
+};
+
+/// Threshold-first SSD box decoder.
+///
+/// Scores are compared against the threshold before anything else, so
+/// only the anchors that can produce a detection are decoded. The
+/// score scan is split over threads by anchor range and decode runs in
+/// SIMD batches with a vectorized exp.
+class FdPostCpu {
+public:
+  FdPostCpu(const std::vector<std::array<float, 4>>& anchors,
+            float score_threshold);
+
+  size_t num_anchors() const { return anchor_y_.size(); }
+
+  /// Select anchors whose score of any class is >= threshold and decode
+  /// them into `out`. `boxes` is [num_anchors, box_dims] and `scores` is
+  /// [num_anchors, num_classes].
+  void run(const float* boxes, size_t box_dims, const float* scores,
+           size_t num_classes, DecodedBoxes& out) const;
+
+private:
+  size_t select(const float* scores, size_t num_classes, size_t begin,
+                size_t end, uint32_t* keep) const;
+  void decode(const float* boxes, size_t box_dims, DecodedBoxes& out) const;
+
+private:
+  float score_threshold_;
+  std::vector<float> anchor_y_;
+  std::vector<float> anchor_x_;
+  std::vector<float> anchor_h_;
+  std::vector<float> anchor_w_;
+};
+
+/// Quantize `rows` x `dims` floats to Q(fbits) bytes with `padded_dims`
+/// bytes per row, zero filling the padding. Used to fill the FD post
+/// input BOs.
+void quantize_pad(const float* src, uint8_t* dst, size_t rows, size_t dims,
+                  size_t padded_dims, int fbits);
+
+} // namespace vaip_decode_filter_boxes_custom_op
@@ -22,6 +22,7 @@
 #pragma once
 
 #include "../../vaip/src/qos_updater.hpp"
+#include "pad.hpp"
 #include "utils.hpp"
 #include <filesystem>
 #include <fstream>
@@ -42,96 +43,72 @@ DEF_ENV_PARAM(DEBUG_DOD_CUSTOM_OP, "0");
 namespace vaip_dod_custom_op {
 
 template <typename SrcDType, typename DstDType>
-void MyCustomOp::pad(const SrcDType* src, std::vector<int64_t>& src_shape,
-                     DstDType* dst, std::vector<size_t>& dst_shape, int dim,
+void MyCustomOp::pad(const SrcDType* src, const std::vector<int64_t>& src_shape,
+                     DstDType* dst, const std::vector<size_t>& dst_shape,
                      DTypeConvert flag, float scale, float zp) const {
-  WRAP(auto t1 = GET_TIMESTAMP();)
-  int elems = 1;
-  for (int i = dim + 1; i < src_shape.size(); ++i)
-    elems *= src_shape[i];
-
-  int iters = 1;
-  for (int i = 0; i < dim; ++i)
-    iters *= src_shape[i];
-
-  int dimx = src_shape[dim];
-  int dimy = dst_shape[dim];
-
-  int s_off = dimx * elems;
-  int d_off = dimy * elems;
-
+  VAIP_TRACE_SPAN(trace_id_, PAD);
+  auto layout = PadLayout(src_shape, dst_shape);
   if (flag == DTypeConvert::AS_IS) {
-    for (auto f = 0; f < iters; ++f) {
-      std::memcpy(dst + (f * d_off), src + (f * s_off),
-                  s_off * sizeof(DstDType));
-    }
+    pad_copy(
+        layout, src, dst,
+        [](const SrcDType* s, DstDType* d, int64_t n) {
+          std::memcpy(d, s, n * sizeof(DstDType));
+        },
+        std::optional<DstDType>{});
   } else if (flag == DTypeConvert::TO_BF16) {
-    for (auto f = 0; f < iters; ++f) {
-      for (auto idx = 0; idx < s_off; ++idx) {
-        float value = (static_cast<float>(src[f * s_off + idx]) - zp) * scale;
-        dst[f * d_off + idx] = float_to_bfloat16_1(value);
-      }
-    }
-    // Assuming attention mask 4D only 1x1x1x77  would be padded to 1x1x1x128
-    // with bfloat16(-zp*scale).
-    if (dst_shape.size() == 4) {
-      for (int i = 77; i < 128; i++) {
-        float value = (float)((-zp) * (scale));
-        dst[i] = float_to_bfloat16_1(value);
+    if constexpr (std::is_same_v<DstDType, uint16_t>) {
+      // 4D inputs are attention masks, e.g. 1x1x1x77 padded to 1x1x1x128;
+      // their padding is bfloat16(-zp*scale), i.e. masked out.
+      auto fill = std::optional<uint16_t>{};
+      if (dst_shape.size() == 4) {
+        fill = float_to_bfloat16_1((-zp) * scale);
       }
+      pad_copy(
+          layout, src, dst,
+          [scale, zp](const SrcDType* s, uint16_t* d, int64_t n) {
+            dequantize_to_bf16(s, d, n, scale, zp);
+          },
+          fill);
+    } else {
+      LOG(FATAL) << "- Incorrect destination type for bfloat16 padding.";
     }
   } else {
     LOG(FATAL) << "- Incorrect flag for Padding input, only to_bf16 conversion "
                   "is possible.";
   }
-  WRAP(auto t2 = GET_TIMESTAMP();)
-  WRAP(ddtimer_.pad_time.push_back(GET_INTERVAL(t1, t2));)
 }
 
 template <typename SrcDType, typename DstDType>
-void MyCustomOp::depad(SrcDType* src, std::vector<size_t>& src_shape,
-                       DstDType* dst, std::vector<int64_t>& dst_shape, int dim,
+void MyCustomOp::depad(const SrcDType* src, const std::vector<size_t>& src_shape,
+                       DstDType* dst, const std::vector<int64_t>& dst_shape,
                        DTypeConvert flag, float scale, float zp) const {
-  WRAP(auto t1 = GET_TIMESTAMP();)
-
-  int elems = 1;
-  for (int i = dim + 1; i < src_shape.size(); ++i)
-    elems *= src_shape[i];
-
-  int iters = 1;
-  for (int i = 0; i < dim; ++i)
-    iters *= src_shape[i];
-
-  int dimx = src_shape[dim];
-  int dimy = dst_shape[dim];
-
-  int s_off = dimx * elems;
-  int d_off = dimy * elems;
-
+  VAIP_TRACE_SPAN(trace_id_, DEPAD);
+  auto layout = PadLayout(dst_shape, src_shape);
   if (flag == DTypeConvert::AS_IS) {
-    for (auto f = 0; f < iters; ++f) {
-      std::memcpy(dst + (f * d_off), src + (f * s_off),
-                  d_off * sizeof(DstDType));
-    }
+    depad_copy(layout, src, dst,
+               [](const SrcDType* s, DstDType* d, int64_t n) {
+                 std::memcpy(d, s, n * sizeof(DstDType));
+               });
   } else if (flag == DTypeConvert::FROM_BF16) {
-    for (auto f = 0; f < iters; ++f) {
-      for (auto idx = 0; idx < d_off; ++idx) {
-        float value = bfloat_to_float(src[f * s_off + idx]);
-        dst[f * d_off + idx] = static_cast<DstDType>(
-            std::clamp(std::roundf(value / scale) + zp, 0.0f, 65535.0f));
-      }
+    if constexpr (std::is_same_v<SrcDType, uint16_t>) {
+      depad_copy(layout, src, dst,
+                 [scale, zp](const uint16_t* s, DstDType* d, int64_t n) {
+                   quantize_from_bf16(s, d, n, scale, zp);
+                 });
+    } else {
+      LOG(FATAL) << "- Incorrect source type for bfloat16 de-padding.";
     }
   } else {
     LOG(FATAL) << "- Incorrect flag for De-padding output, only from_bf16 "
                   "conversion is possible.";
   }
-  WRAP(auto t2 = GET_TIMESTAMP();)
-  WRAP(ddtimer_.depad_time.push_back(GET_INTERVAL(t1, t2));)
 }
+
 MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
                        const std::shared_ptr<MetaDefProto>& meta_def,
                        onnxruntime::Model* model)
     : CustomOpImp(context, meta_def, model) { //,
+  trace_id_ = vaip_core::runtime_trace::intern(meta_def->id());
   {
 
     auto mutable_context = const_cast<PassContext*>(context.get());
@@ -196,6 +173,9 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
     out_tensors_ = OpsFusion::MetaUtils::get_output_tensors(meta);
     num_outputs_ = OpsFusion::MetaUtils::get_num_outputs(meta);
+    // sized on first use, most outputs never need them
+    out_buffer_i16_.resize(num_outputs_);
+    out_buffer_i8_.resize(num_outputs_);
 
     auto dod_output_names = meta.fused_tensors.at("out").packed_tensors;
     auto ort_output_names = meta_def->outputs();
@@ -463,25 +443,11 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
   context->save_context_json();
 }
 
-MyCustomOp::~MyCustomOp() {
-#ifdef PROFILE_DOD
-  static DDFileLogger ofs("dd_custom_op_perf.csv");
-  for (const auto& timer : timestamps_) {
-    ofs << timer.compute_time << "," << timer.pre_dod_time << ","
-        << timer.dod_time << "," << timer.post_dod_time << ","
-        << sum_of(timer.pad_time) << "," << sum_of(timer.depad_time) << ","
-        << sum_of(timer.nchw2nhwc_time) << "," << sum_of(timer.nhwc2nchw_time)
-        << "," << sum_of(timer.c4hw2hwc4_time) << ","
-        << sum_of(timer.data_conv_time) << "," << sum_of(timer.iconv_prep_time)
-        << "," << meta_json_ << std::endl;
-  }
-#endif
-}
+MyCustomOp::~MyCustomOp() {}
 
 void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
+  auto call = vaip_core::TraceSpan(trace_id_, vaip_core::runtime_trace::CALL);
   std::lock_guard<std::mutex> guard(execute_mutex_);
-  WRAP(ddtimer_.reset();)
-  WRAP(auto compute_begin = GET_TIMESTAMP());
 
   if (Ort::Global<void>::api_ == nullptr) {
     Ort::Global<void>::api_ = api;
@@ -498,18 +464,12 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   // Invoke kernel
   OpsFusion::FusionRuntime* ptr = (OpsFusion::FusionRuntime*)runner_.get();
 
-  auto dod_exec_start = GET_TIMESTAMP();
-  ptr->execute(in_tensors, out_tensors);
-  auto dod_exec_end = GET_TIMESTAMP();
+  {
+    VAIP_TRACE_SPAN(trace_id_, DOD_EXECUTE);
+    ptr->execute(in_tensors, out_tensors);
+  }
 
   outputs_postprocess(ort_outputs, out_tensors);
-
-  WRAP(auto compute_end = GET_TIMESTAMP();)
-  WRAP(ddtimer_.compute_time = GET_INTERVAL(compute_begin, compute_end);)
-  WRAP(ddtimer_.dod_time = GET_INTERVAL(dod_exec_start, dod_exec_end);)
-  WRAP(ddtimer_.pre_dod_time = GET_INTERVAL(compute_begin, dod_exec_start);)
-  WRAP(ddtimer_.post_dod_time = GET_INTERVAL(dod_exec_end, compute_end);)
-  WRAP(timestamps_.push_back(std::move(ddtimer_));)
 }
 
 void MyCustomOp::inputs_preprocess(OrtKernelContext* context,
@@ -548,11 +508,9 @@ void MyCustomOp::inputs_preprocess(OrtKernelContext* context,
 
     // Enable pad if required
     bool en_pad = false;
-    int pad_dim = -1;
     for (auto dim = 0; dim < input_shape.size(); ++dim) {
       if (input_shape[dim] != in_tensors[i].shape[dim]) {
         en_pad = true;
-        pad_dim = dim;
         break;
       }
     }
@@ -583,16 +541,14 @@ void MyCustomOp::inputs_preprocess(OrtKernelContext* context,
         if (en_pad) {
           pad<uint16_t, uint16_t>(input_data, input_shape,
                                   in_buffer_i16_[i].data(), in_tensors[i].shape,
-                                  pad_dim, DTypeConvert::TO_BF16, scale, zp);
+                                  DTypeConvert::TO_BF16, scale, zp);
         } else {
 
-          WRAP(auto t1 = GET_TIMESTAMP();)
-          for (auto cnt = 0; cnt < elems; cnt++) {
-            float value = (static_cast<float>(input_data[cnt]) - zp) * scale;
-            in_buffer_i16_[i][cnt] = float_to_bfloat16_1(value);
-          }
-          WRAP(auto t2 = GET_TIMESTAMP();)
-          WRAP(ddtimer_.data_conv_time.push_back(GET_INTERVAL(t1, t2));)
+          VAIP_TRACE_SPAN(trace_id_, DATA_CONV);
+          convert_elements(input_data, in_buffer_i16_[i].data(), elems,
+                           [scale, zp](auto s, auto d, int64_t n) {
+                             dequantize_to_bf16(s, d, n, scale, zp);
+                           });
         }
         in_tensors[i].data = (void*)(in_buffer_i16_[i].data());
 
@@ -601,15 +557,13 @@ void MyCustomOp::inputs_preprocess(OrtKernelContext* context,
         if (en_pad) {
           pad<uint8_t, uint16_t>(input_data, input_shape,
                                  in_buffer_i16_[i].data(), in_tensors[i].shape,
-                                 pad_dim, DTypeConvert::TO_BF16, scale, zp);
+                                 DTypeConvert::TO_BF16, scale, zp);
         } else {
-          WRAP(auto t1 = GET_TIMESTAMP();)
-          for (auto cnt = 0; cnt < elems; cnt++) {
-            float value = (static_cast<float>(input_data[cnt]) - zp) * scale;
-            in_buffer_i16_[i][cnt] = float_to_bfloat16_1(value);
-          }
-          WRAP(auto t2 = GET_TIMESTAMP();)
-          WRAP(ddtimer_.data_conv_time.push_back(GET_INTERVAL(t1, t2));)
+          VAIP_TRACE_SPAN(trace_id_, DATA_CONV);
+          convert_elements(input_data, in_buffer_i16_[i].data(), elems,
+                           [scale, zp](auto s, auto d, int64_t n) {
+                             dequantize_to_bf16(s, d, n, scale, zp);
+                           });
         }
       }
       // Provide data pointers to DOD
@@ -620,18 +574,16 @@ void MyCustomOp::inputs_preprocess(OrtKernelContext* context,
                  in_tensors[i].dtype == "uint16") {
         // Input_3 mzdk5
         auto input_data = input_tensor.GetTensorData<float>();
-        for (auto cnt = 0; cnt < elems; cnt++) {
-          in_buffer_i16_[i][cnt] = static_cast<uint16_t>(std::clamp(
-              std::roundf(input_data[cnt] / scale) + zp, 0.0f, 65535.0f));
-        }
+        convert_elements(input_data, in_buffer_i16_[i].data(), elems,
+                         [scale, zp](auto s, auto d, int64_t n) {
+                           quantize_float(s, d, n, scale, zp);
+                         });
         in_tensors[i].data = (void*)(in_buffer_i16_[i].data());
       } else if (input_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT &&
                  in_tensors[i].dtype == "bfloat16") {
         auto input_data = input_tensor.GetTensorData<float>();
-        for (auto cnt = 0; cnt < elems; cnt++) {
-          float value = (static_cast<float>(input_data[cnt]));
-          in_buffer_i16_[i][cnt] = float_to_bfloat16_1(value);
-        }
+        convert_elements(input_data, in_buffer_i16_[i].data(), elems,
+                         float_to_bf16);
         in_tensors[i].data = (void*)(in_buffer_i16_[i].data());
       } else {
         in_tensors[i].data = (void*)(input_tensor.GetTensorData<void>());
@@ -655,7 +607,7 @@ void MyCustomOp::inputs_preprocess(OrtKernelContext* context,
         auto input_data = input_tensor.GetTensorData<uint16_t>();
         convert_NCHW_to_NHWC<uint16_t>(
             input_data, in_buffer_i16_[i].data(), input_shape[0],
-            input_shape[1], input_shape[2], input_shape[3], ddtimer_);
+            input_shape[1], input_shape[2], input_shape[3], trace_id_);
 
         in_tensors[i].data = (void*)(in_buffer_i16_[i].data());
 
@@ -673,14 +625,14 @@ void MyCustomOp::inputs_preprocess(OrtKernelContext* context,
         auto input_data = input_tensor.GetTensorData<uint16_t>();
         first_layer_data.reserve(8 * 230 * 116);
 
-        WRAP(auto t1 = GET_TIMESTAMP();)
-        iconv_matrix::ActTensor<uint16_t> X(8, 230, 116,
-                                            first_layer_data.data());
-        iconv_matrix::fold_conv_ifm<uint16_t>(input_data, 29172, CI, YI, XI, XO,
-                                              7, Sx_no_fold, pad_no_fold,
-                                              fold_factor, Ci_gran, Xi_gran, X);
-        WRAP(auto t2 = GET_TIMESTAMP();)
-        WRAP(ddtimer_.iconv_prep_time.push_back(GET_INTERVAL(t1, t2));)
+        {
+          VAIP_TRACE_SPAN(trace_id_, ICONV_PREP);
+          iconv_matrix::ActTensor<uint16_t> X(8, 230, 116,
+                                              first_layer_data.data());
+          iconv_matrix::fold_conv_ifm<uint16_t>(
+              input_data, 29172, CI, YI, XI, XO, 7, Sx_no_fold, pad_no_fold,
+              fold_factor, Ci_gran, Xi_gran, X);
+        }
 
         in_tensors[i].data = first_layer_data.data(); // working
         in_tensors[i].shape = {1, 8, 230, 116};
@@ -689,17 +641,17 @@ void MyCustomOp::inputs_preprocess(OrtKernelContext* context,
           auto input_data = input_tensor.GetTensorData<uint16_t>();
           pad<uint16_t, uint16_t>(input_data, input_shape,
                                   in_buffer_i16_[i].data(), in_tensors[i].shape,
-                                  pad_dim, DTypeConvert::AS_IS, 0, 0);
+                                  DTypeConvert::AS_IS, 0, 0);
           if (C3HW_to_HWC4_conversion_required(input_shape,
                                                in_tensors[i].shape)) {
             convert_C4HW_to_HWC4(in_buffer_i16_[i], in_buffer_i16_[i],
                                  input_shape[2], input_shape[3],
-                                 uint16_t{29172}, ddtimer_);
+                                 uint16_t{29172}, trace_id_);
           } else if (NC3HW_to_HNWC4_conversion_required(input_shape,
                                                         in_tensors[i].shape)) {
             convert_C4HW_to_HWC4(in_buffer_i16_[i], in_buffer_i16_[i],
                                  input_shape[2], input_shape[3], uint16_t{0},
-                                 ddtimer_);
+                                 trace_id_);
           } else if (NC3HW_to_HNWC8_conversion_required(input_shape,
                                                         in_tensors[i].shape)) {
             convert_NC3HW_to_HNWC8(in_buffer_i16_[i], in_buffer_i16_[i],
@@ -710,12 +662,12 @@ void MyCustomOp::inputs_preprocess(OrtKernelContext* context,
           auto input_data = input_tensor.GetTensorData<uint8_t>();
           pad<uint8_t, uint8_t>(input_data, input_shape,
                                 in_buffer_i8_[i].data(), in_tensors[i].shape,
-                                pad_dim, DTypeConvert::AS_IS, 0, 0);
+                                DTypeConvert::AS_IS, 0, 0);
           if (C3HW_to_HWC4_conversion_required(input_shape,
                                                in_tensors[i].shape)) {
             convert_C4HW_to_HWC4(in_buffer_i8_[i], in_buffer_i8_[i],
                                  input_shape[2], input_shape[3], uint8_t{0},
-                                 ddtimer_);
+                                 trace_id_);
           }
           in_tensors[i].data = (void*)(in_buffer_i8_[i].data());
         }
@@ -740,8 +692,6 @@ MyCustomOp::outputs_preprocess(OrtKernelContext* context,
   std::vector<Ort::UnownedValue> ort_outputs;
   ort_outputs.reserve(num_outputs);
 
-  out_buffer_i16_.clear();
-  out_buffer_i8_.clear();
   for (size_t i = 0; i < num_outputs_; i++) {
 
     // Create ORT output tensor based on original shape
@@ -778,11 +728,9 @@ setting the dtype_convert flag to false (dont convert)
 
     // Enable depad if required
     bool en_depad = false;
-    int depad_dim = -1;
     for (auto dim = 0; dim < output_shape.size(); ++dim) {
       if (output_shape[dim] != out_tensors[i].shape[dim]) {
         en_depad = true;
-        depad_dim = dim;
         break;
       }
     }
@@ -808,30 +756,32 @@ setting the dtype_convert flag to false (dont convert)
     }
     // Convert to bfloat16, if kernel expects it
     else if (out_tensors[i].dtype == "bfloat16") {
-      // no need to check for depad as it is already full sized buffer
-      out_buffer_i16_.emplace_back(size, 0);
-      out_tensors[i].data = (void*)(out_buffer_i16_.back().data());
+      if (output_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16 && !en_depad) {
+        // same size, requantized in place by outputs_postprocess()
+        out_tensors[i].data = (void*)output_data;
+      } else {
+        out_buffer_i16_[i].resize(size);
+        out_tensors[i].data = (void*)(out_buffer_i16_[i].data());
+      }
     } else {
       // if type is either uint16_t or uint8_t
       if (output_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16) {
         if (NCHW_to_NHWC_conversion_required(output_shape,
                                              out_tensors[i].shape)) {
-          out_buffer_i16_.emplace_back(size, 0);
-          out_tensors[i].data = (void*)(out_buffer_i16_.back().data());
+          out_buffer_i16_[i].resize(size);
+          out_tensors[i].data = (void*)(out_buffer_i16_[i].data());
 
         } else if (en_depad) {
-          out_buffer_i16_.emplace_back(size, 0);
-          out_tensors[i].data = (void*)(out_buffer_i16_.back().data());
+          out_buffer_i16_[i].resize(size);
+          out_tensors[i].data = (void*)(out_buffer_i16_[i].data());
         } else {
           out_tensors[i].data = (void*)output_data;
-          out_buffer_i16_.emplace_back(0, 0);
         }
       } else if (output_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8) {
         if (en_depad) {
-          out_buffer_i8_.emplace_back(size, 0);
-          out_tensors[i].data = (void*)(out_buffer_i8_.back().data());
+          out_buffer_i8_[i].resize(size);
+          out_tensors[i].data = (void*)(out_buffer_i8_[i].data());
         } else {
-          out_buffer_i8_.emplace_back(0, 0);
           out_tensors[i].data = (void*)output_data;
         }
       }
@@ -877,11 +827,9 @@ void MyCustomOp::outputs_postprocess(std::vector<Ort::UnownedValue> ort_outputs,
                            .GetTensorTypeAndShapeInfo()
                            .GetElementType();
     bool en_depad = false;
-    int depad_dim = -1;
     for (auto dim = 0; dim < output_shape.size(); ++dim) {
       if (output_shape[dim] != out_tensors[i].shape[dim]) {
         en_depad = true;
-        depad_dim = dim;
         break;
       }
     }
@@ -909,23 +857,21 @@ void MyCustomOp::outputs_postprocess(std::vector<Ort::UnownedValue> ort_outputs,
       if (tensor_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
         auto output_data =
             ort_outputs[dod_out_index_[i]].GetTensorMutableData<float>();
-        for (auto cnt = 0; cnt < elems; cnt++) {
-          float value = bfloat_to_float(out_buffer_i16_[i][cnt]);
-          output_data[cnt] = value;
-        }
+        convert_elements(out_buffer_i16_[i].data(), output_data, elems,
+                         bf16_to_float);
       } else if (tensor_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16) {
         auto output_data =
             ort_outputs[dod_out_index_[i]].GetTensorMutableData<uint16_t>();
         if (en_depad) {
           depad<uint16_t, uint16_t>(
               out_buffer_i16_[i].data(), out_tensors[i].shape, output_data,
-              output_shape, depad_dim, DTypeConvert::FROM_BF16, scale, zp);
+              output_shape, DTypeConvert::FROM_BF16, scale, zp);
         } else {
-          for (auto cnt = 0; cnt < elems; cnt++) {
-            float value = bfloat_to_float(out_buffer_i16_[i][cnt]);
-            output_data[cnt] = static_cast<uint16_t>(
-                std::clamp(std::roundf(value / scale) + zp, 0.0f, 65535.0f));
-          }
+          // the kernel wrote bfloat16 straight into the ORT output
+          convert_elements(output_data, output_data, elems,
+                           [scale, zp](auto s, auto d, int64_t n) {
+                             quantize_from_bf16(s, d, n, scale, zp);
+                           });
         }
       } else if (tensor_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8) {
         auto output_data =
@@ -933,13 +879,12 @@ void MyCustomOp::outputs_postprocess(std::vector<Ort::UnownedValue> ort_outputs,
         if (en_depad) {
           depad<uint16_t, uint8_t>(
               out_buffer_i16_[i].data(), out_tensors[i].shape, output_data,
-              output_shape, depad_dim, DTypeConvert::FROM_BF16, scale, zp);
+              output_shape, DTypeConvert::FROM_BF16, scale, zp);
         } else {
-          for (auto cnt = 0; cnt < elems; cnt++) {
-            float value = bfloat_to_float(out_buffer_i16_[i][cnt]);
-            output_data[cnt] = static_cast<uint8_t>(
-                std::clamp(std::roundf(value / scale) + zp, 0.0f, 255.0f));
-          }
+          convert_elements(out_buffer_i16_[i].data(), output_data, elems,
+                           [scale, zp](auto s, auto d, int64_t n) {
+                             quantize_from_bf16(s, d, n, scale, zp);
+                           });
         }
       }
     } else {
@@ -954,7 +899,7 @@ void MyCustomOp::outputs_postprocess(std::vector<Ort::UnownedValue> ort_outputs,
         convert_NHWC_to_NCHW<uint16_t>(
             out_buffer_i16_[i].data(), output_data, out_tensors[i].shape[0],
             out_tensors[i].shape[1], out_tensors[i].shape[2],
-            out_tensors[i].shape[3], ddtimer_);
+            out_tensors[i].shape[3], trace_id_);
       } else if (NCHW_to_HNWC_conversion_required(output_shape,
                                                   out_tensors[i].shape)) {
         auto output_data =
@@ -969,18 +914,18 @@ void MyCustomOp::outputs_postprocess(std::vector<Ort::UnownedValue> ort_outputs,
         if (tensor_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16) {
           auto output_data =
               ort_outputs[dod_out_index_[i]].GetTensorMutableData<uint16_t>();
-          if (out_buffer_i16_[i].data() != 0) {
+          if (!out_buffer_i16_[i].empty()) {
             depad<uint16_t, uint16_t>(
                 out_buffer_i16_[i].data(), out_tensors[i].shape, output_data,
-                output_shape, depad_dim, DTypeConvert::AS_IS, 0, 0);
+                output_shape, DTypeConvert::AS_IS, 0, 0);
           }
         } else if (tensor_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8) {
           auto output_data =
               ort_outputs[dod_out_index_[i]].GetTensorMutableData<uint8_t>();
-          if (out_buffer_i8_[i].data() != 0) {
+          if (!out_buffer_i8_[i].empty()) {
             depad<uint8_t, uint8_t>(
                 out_buffer_i8_[i].data(), out_tensors[i].shape, output_data,
-                output_shape, depad_dim, DTypeConvert::AS_IS, 0, 0);
+                output_shape, DTypeConvert::AS_IS, 0, 0);
           }
         } // else, no data conversion / depad required
       }
@@ -19,48 +19,6 @@
 #include "onnxruntime_api.hpp"
 #include <ops/op_interface.hpp>
 
-#include <chrono>
-// #define PROFILE_DOD
-
-#ifdef PROFILE_DOD
-#  define WRAP(msg) msg
-#else
-#  define WRAP(msg)
-#endif
-
-using dd_timer_t = float;
-#define GET_TIMESTAMP() std::chrono::steady_clock::now()
-#define GET_INTERVAL(t1, t2)                                                   \
-  std::chrono::duration<dd_timer_t, std::micro>(t2 - t1).count()
-
-struct DDTimer {
-  dd_timer_t compute_time{0};
-  dd_timer_t dod_time{0};
-  dd_timer_t pre_dod_time{0};
-  dd_timer_t post_dod_time{0};
-  std::vector<dd_timer_t> pad_time;
-  std::vector<dd_timer_t> depad_time;
-  std::vector<dd_timer_t> nchw2nhwc_time;
-  std::vector<dd_timer_t> nhwc2nchw_time;
-  std::vector<dd_timer_t> c4hw2hwc4_time;
-  std::vector<dd_timer_t> data_conv_time;
-  std::vector<dd_timer_t> iconv_prep_time;
-
-  void reset() {
-    compute_time = 0;
-    dod_time = 0;
-    pre_dod_time = 0;
-    post_dod_time = 0;
-    pad_time.clear();
-    depad_time.clear();
-    nchw2nhwc_time.clear();
-    nhwc2nchw_time.clear();
-    c4hw2hwc4_time.clear();
-    data_conv_time.clear();
-    iconv_prep_time.clear();
-  }
-};
-
 namespace vaip_dod_custom_op {
 
 static enum DTypeConvert { TO_BF16 = 1, FROM_BF16 = 2, AS_IS = 3 };
@@ -82,15 +40,18 @@ public:
   template <typename DType>
   std::vector<DType> string_to_values(std::string str_values);
 
+  /// Copy the dense `src` into the padded `dst`, converting on the fly;
+  /// any dims may be padded.
   template <typename SrcDType, typename DstDType>
-  void pad(const SrcDType* src, std::vector<int64_t>& src_shape, DstDType* dst,
-           std::vector<size_t>& dst_shape, int dim, DTypeConvert flag,
-           float scale, float zp) const;
+  void pad(const SrcDType* src, const std::vector<int64_t>& src_shape,
+           DstDType* dst, const std::vector<size_t>& dst_shape,
+           DTypeConvert flag, float scale, float zp) const;
 
+  /// Inverse of pad().
   template <typename SrcDType, typename DstDType>
-  void depad(SrcDType* src, std::vector<size_t>& src_shape, DstDType* dst,
-             std::vector<int64_t>& dst_shape, int dim, DTypeConvert flag,
-             float scale, float zp) const;
+  void depad(const SrcDType* src, const std::vector<size_t>& src_shape,
+             DstDType* dst, const std::vector<int64_t>& dst_shape,
+             DTypeConvert flag, float scale, float zp) const;
 
 private:
   virtual void Compute(const OrtApi* api,
@@ -123,8 +84,8 @@ private:
   std::vector<size_t> dod_out_index_;
   std::string meta_json_;
 
-  mutable std::vector<DDTimer> timestamps_;
-  mutable DDTimer ddtimer_;
+  // runtime_trace id of this op
+  uint32_t trace_id_ = 0;
   mutable std::mutex execute_mutex_;
   std::shared_ptr<vaip::Context> shared_ctx_;
   mutable bool share_context_;
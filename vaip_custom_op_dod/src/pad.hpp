@@ -0,0 +1,323 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include "cpu_features/cpu_features.hpp"
+#include "utils.hpp"
+#include "vaip/thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glog/logging.h>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace vaip_dod_custom_op {
+
+// A dense tensor of `shape` placed in a tensor of `padded_shape`, every
+// dim of which is at least as large. Trailing dims that agree are folded
+// into one contiguous row, so a tensor padded only on its outermost dim
+// is a single row and an unpadded tensor is a plain element-wise loop.
+struct PadLayout {
+  template <typename T1, typename T2>
+  PadLayout(const std::vector<T1>& shape, const std::vector<T2>& padded_shape) {
+    CHECK_EQ(shape.size(), padded_shape.size()) << "pad rank mismatch";
+    auto rank = (int)shape.size();
+    for (auto d = 0; d < rank; ++d) {
+      CHECK_LE((int64_t)shape[d], (int64_t)padded_shape[d])
+          << "cannot pad dim " << d << " to a smaller size";
+      padded_size *= (int64_t)padded_shape[d];
+    }
+    auto k = rank - 1;
+    int64_t stride = 1;
+    for (; k >= 0 && (int64_t)shape[k] == (int64_t)padded_shape[k]; --k) {
+      row *= (int64_t)shape[k];
+      stride *= (int64_t)padded_shape[k];
+    }
+    if (k >= 0) {
+      row *= (int64_t)shape[k];
+      stride *= (int64_t)padded_shape[k];
+    }
+    for (auto d = k - 1; d >= 0; --d) {
+      outer.insert(outer.begin(), (int64_t)shape[d]);
+      padded_stride.insert(padded_stride.begin(), stride);
+      num_rows *= (int64_t)shape[d];
+      stride *= (int64_t)padded_shape[d];
+    }
+  }
+
+  int64_t padded_offset(int64_t r) const {
+    int64_t offset = 0;
+    for (auto d = (int)outer.size() - 1; d >= 0; --d) {
+      offset += (r % outer[d]) * padded_stride[d];
+      r /= outer[d];
+    }
+    return offset;
+  }
+
+  int64_t size() const { return num_rows * row; }
+
+  int64_t row = 1;
+  int64_t num_rows = 1;
+  int64_t padded_size = 1;
+  // logical sizes and padded strides of the dims above the row
+  std::vector<int64_t> outer;
+  std::vector<int64_t> padded_stride;
+};
+
+// Walk the dense elements of `layout` in parallel chunks; `func(dense,
+// padded, n, row_end)` gets n elements that are contiguous on both sides
+// and whether they end a row.
+template <typename Func>
+static void for_each_segment(const PadLayout& layout, int64_t bytes_per_elem,
+                             Func&& func) {
+  vaip_core::parallel_for(
+      0, layout.size(), vaip_core::grain_size(bytes_per_elem),
+      [&](int64_t b, int64_t e) {
+        while (b < e) {
+          auto r = b / layout.row;
+          auto in_row = b - r * layout.row;
+          auto n = std::min(e - b, layout.row - in_row);
+          func(b, layout.padded_offset(r) + in_row, n,
+               in_row + n == layout.row ? r : int64_t{-1});
+          b += n;
+        }
+      });
+}
+
+// dst[padded] = convert(src[dense]). With `fill`, the padding after each
+// row is written as well; without it the padding is left untouched.
+template <typename Src, typename Dst, typename Convert>
+static void pad_copy(const PadLayout& layout, const Src* src, Dst* dst,
+                     Convert&& convert, std::optional<Dst> fill) {
+  for_each_segment(
+      layout, sizeof(Src) + sizeof(Dst),
+      [&](int64_t dense, int64_t padded, int64_t n, int64_t row_end) {
+        convert(src + dense, dst + padded, n);
+        if (fill && row_end >= 0) {
+          auto next = row_end + 1 < layout.num_rows
+                          ? layout.padded_offset(row_end + 1)
+                          : layout.padded_size;
+          std::fill(dst + padded + n, dst + next, *fill);
+        }
+      });
+}
+
+// dst[dense] = convert(src[padded])
+template <typename Src, typename Dst, typename Convert>
+static void depad_copy(const PadLayout& layout, const Src* src, Dst* dst,
+                       Convert&& convert) {
+  for_each_segment(layout, sizeof(Src) + sizeof(Dst),
+                   [&](int64_t dense, int64_t padded, int64_t n, int64_t) {
+                     convert(src + padded, dst + dense, n);
+                   });
+}
+
+template <typename Src, typename Dst, typename Convert>
+static void convert_elements(const Src* src, Dst* dst, int64_t n,
+                             Convert&& convert) {
+  vaip_core::parallel_for(
+      0, n, vaip_core::grain_size(sizeof(Src) + sizeof(Dst)),
+      [&](int64_t b, int64_t e) { convert(src + b, dst + b, e - b); });
+}
+
+#if VAIP_CPU_X86
+VAIP_CPU_TARGET("avx2")
+static inline __m256 load_ps(const uint8_t* p) {
+  return _mm256_cvtepi32_ps(
+      _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+VAIP_CPU_TARGET("avx2")
+static inline __m256 load_ps(const uint16_t* p) {
+  return _mm256_cvtepi32_ps(
+      _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)));
+}
+VAIP_CPU_TARGET("avx2")
+static inline __m256 load_bf16_ps(const uint16_t* p) {
+  return _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)), 16));
+}
+// 8 x int32 in [0, 65535] to 8 x uint16
+VAIP_CPU_TARGET("avx2")
+static inline __m128i pack_epu16(__m256i v) {
+  return _mm_packus_epi32(_mm256_castsi256_si128(v),
+                          _mm256_extracti128_si256(v, 1));
+}
+VAIP_CPU_TARGET("avx2")
+static inline void store_epi32(uint16_t* p, __m256i v) {
+  _mm_storeu_si128((__m128i*)p, pack_epu16(v));
+}
+VAIP_CPU_TARGET("avx2")
+static inline void store_epi32(uint8_t* p, __m256i v) {
+  auto w = pack_epu16(v);
+  _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(w, w));
+}
+// same bits as float_to_bfloat16_1(), in the low half of each lane
+VAIP_CPU_TARGET("avx2")
+static inline __m256i ps_to_bf16_epi32(__m256 x) {
+  auto i = _mm256_castps_si256(x);
+  auto lsb = _mm256_and_si256(_mm256_srli_epi32(i, 16), _mm256_set1_epi32(1));
+  i = _mm256_add_epi32(i, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7fff)));
+  return _mm256_srli_epi32(i, 16);
+}
+// std::roundf(), i.e. halfway cases away from zero
+VAIP_CPU_TARGET("avx2")
+static inline __m256 round_half_away_ps(__m256 x) {
+  auto sign = _mm256_set1_ps(-0.0f);
+  auto t = _mm256_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+  auto frac = _mm256_andnot_ps(sign, _mm256_sub_ps(x, t));
+  auto step = _mm256_or_ps(_mm256_and_ps(x, sign), _mm256_set1_ps(1.0f));
+  auto away = _mm256_cmp_ps(frac, _mm256_set1_ps(0.5f), _CMP_GE_OQ);
+  return _mm256_add_ps(t, _mm256_and_ps(away, step));
+}
+VAIP_CPU_TARGET("avx2")
+static inline __m256i quantize_ps(__m256 x, __m256 scale, __m256 zp,
+                                  __m256 q_max) {
+  auto q = _mm256_add_ps(round_half_away_ps(_mm256_div_ps(x, scale)), zp);
+  q = _mm256_min_ps(_mm256_max_ps(q, _mm256_setzero_ps()), q_max);
+  return _mm256_cvttps_epi32(q);
+}
+
+// The AVX2 kernels below convert the first n / 8 * 8 elements and return
+// how many they did; the callers finish the tail, or all of it when the
+// CPU has no AVX2.
+template <typename Q>
+VAIP_CPU_TARGET("avx2")
+static int64_t dequantize_to_bf16_avx2(const Q* src, uint16_t* dst, int64_t n,
+                                       float scale, float zp) {
+  int64_t i = 0;
+  auto scale_v = _mm256_set1_ps(scale);
+  auto zp_v = _mm256_set1_ps(zp);
+  for (; i + 8 <= n; i += 8) {
+    auto x = _mm256_mul_ps(_mm256_sub_ps(load_ps(src + i), zp_v), scale_v);
+    store_epi32(dst + i, ps_to_bf16_epi32(x));
+  }
+  return i;
+}
+
+template <typename Q>
+VAIP_CPU_TARGET("avx2")
+static int64_t quantize_from_bf16_avx2(const uint16_t* src, Q* dst, int64_t n,
+                                       float scale, float zp, float q_max) {
+  int64_t i = 0;
+  auto scale_v = _mm256_set1_ps(scale);
+  auto zp_v = _mm256_set1_ps(zp);
+  auto q_max_v = _mm256_set1_ps(q_max);
+  for (; i + 8 <= n; i += 8) {
+    store_epi32(dst + i,
+                quantize_ps(load_bf16_ps(src + i), scale_v, zp_v, q_max_v));
+  }
+  return i;
+}
+
+VAIP_CPU_TARGET("avx2")
+static int64_t quantize_float_avx2(const float* src, uint16_t* dst, int64_t n,
+                                   float scale, float zp) {
+  int64_t i = 0;
+  auto scale_v = _mm256_set1_ps(scale);
+  auto zp_v = _mm256_set1_ps(zp);
+  auto q_max_v = _mm256_set1_ps(65535.0f);
+  for (; i + 8 <= n; i += 8) {
+    store_epi32(dst + i,
+                quantize_ps(_mm256_loadu_ps(src + i), scale_v, zp_v, q_max_v));
+  }
+  return i;
+}
+
+VAIP_CPU_TARGET("avx2")
+static int64_t float_to_bf16_avx2(const float* src, uint16_t* dst,
+                                  int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    store_epi32(dst + i, ps_to_bf16_epi32(_mm256_loadu_ps(src + i)));
+  }
+  return i;
+}
+
+VAIP_CPU_TARGET("avx2")
+static int64_t bf16_to_float_avx2(const uint16_t* src, float* dst,
+                                  int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(dst + i, load_bf16_ps(src + i));
+  }
+  return i;
+}
+#endif
+
+// bf16((q - zp) * scale)
+template <typename Q>
+static void dequantize_to_bf16(const Q* src, uint16_t* dst, int64_t n,
+                               float scale, float zp) {
+  int64_t i = 0;
+#if VAIP_CPU_X86
+  if (vaip_cpu::has_avx2()) {
+    i = dequantize_to_bf16_avx2(src, dst, n, scale, zp);
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = float_to_bfloat16_1((static_cast<float>(src[i]) - zp) * scale);
+  }
+}
+
+// clamp(round(bf16 / scale) + zp), in place when src == dst
+template <typename Q>
+static void quantize_from_bf16(const uint16_t* src, Q* dst, int64_t n,
+                               float scale, float zp) {
+  constexpr auto q_max = (float)std::numeric_limits<Q>::max();
+  int64_t i = 0;
+#if VAIP_CPU_X86
+  if (vaip_cpu::has_avx2()) {
+    i = quantize_from_bf16_avx2(src, dst, n, scale, zp, q_max);
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = static_cast<Q>(std::clamp(
+        std::roundf(bfloat_to_float(src[i]) / scale) + zp, 0.0f, q_max));
+  }
+}
+
+static void quantize_float(const float* src, uint16_t* dst, int64_t n,
+                           float scale, float zp) {
+  int64_t i = 0;
+#if VAIP_CPU_X86
+  if (vaip_cpu::has_avx2()) {
+    i = quantize_float_avx2(src, dst, n, scale, zp);
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = static_cast<uint16_t>(
+        std::clamp(std::roundf(src[i] / scale) + zp, 0.0f, 65535.0f));
+  }
+}
+
+static void float_to_bf16(const float* src, uint16_t* dst, int64_t n) {
+  int64_t i = 0;
+#if VAIP_CPU_X86
+  if (vaip_cpu::has_avx2()) {
+    i = float_to_bf16_avx2(src, dst, n);
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = float_to_bfloat16_1(src[i]);
+  }
+}
+
+static void bf16_to_float(const uint16_t* src, float* dst, int64_t n) {
+  int64_t i = 0;
+#if VAIP_CPU_X86
+  if (vaip_cpu::has_avx2()) {
+    i = bf16_to_float_avx2(src, dst, n);
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = bfloat_to_float(src[i]);
+  }
+}
+
+} // namespace vaip_dod_custom_op
@@ -3,8 +3,14 @@
  *  Licensed under the MIT License.
  */
 
+#pragma once
+
+#include "vaip/runtime_trace.hpp"
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <numeric>
+#include <sstream>
 #include <vector>
 
 namespace vaip_dod_custom_op {
@@ -80,8 +86,8 @@ cs_string_to_nested_list(const std::string& msg) {
 // Function to convert NCHW to NHWC
 template <typename T>
 static void convert_NCHW_to_NHWC(const T* input_nchw, T* output_nhwc, int N,
-                                 int C, int H, int W, DDTimer& ddtimer) {
-  WRAP(auto t1 = GET_TIMESTAMP();)
+                                 int C, int H, int W, uint32_t trace_id) {
+  VAIP_TRACE_SPAN(trace_id, NCHW2NHWC);
   for (int n = 0; n < N; ++n) {
     for (int c = 0; c < C; ++c) {
       for (int h = 0; h < H; ++h) {
@@ -95,15 +101,13 @@ static void convert_NCHW_to_NHWC(const T* input_nchw, T* output_nhwc, int N,
       }
     }
   }
-  WRAP(auto t2 = GET_TIMESTAMP();)
-  WRAP(ddtimer.nchw2nhwc_time.push_back(GET_INTERVAL(t1, t2));)
 }
 
 // Function to convert NHWC to NCHW
 template <typename T>
 static void convert_NHWC_to_NCHW(const T* input_nhwc, T* output_nchwc, int N,
-                                 int H, int W, int C, DDTimer& ddtimer) {
-  WRAP(auto t1 = GET_TIMESTAMP();)
+                                 int H, int W, int C, uint32_t trace_id) {
+  VAIP_TRACE_SPAN(trace_id, NHWC2NCHW);
   for (int n = 0; n < N; ++n) {
     for (int c = 0; c < C; ++c) {
       for (int h = 0; h < H; ++h) {
@@ -117,8 +121,6 @@ static void convert_NHWC_to_NCHW(const T* input_nhwc, T* output_nchwc, int N,
       }
     }
   }
-  WRAP(auto t2 = GET_TIMESTAMP();)
-  WRAP(ddtimer.nhwc2nchw_time.push_back(GET_INTERVAL(t1, t2));)
 }
 
 // Function to convert NHWC to NCHW
@@ -309,12 +311,10 @@ NCHW_to_HNWC_conversion_required(const std::vector<OrtType>& ort_shape,
 
 template <typename T>
 static void convert_C4HW_to_HWC4(const std::vector<T>& src, std::vector<T>& dst,
-                                 int H, int W, T pad_value, DDTimer& ddtimer) {
-  WRAP(auto t1 = GET_TIMESTAMP();)
+                                 int H, int W, T pad_value, uint32_t trace_id) {
+  VAIP_TRACE_SPAN(trace_id, C4HW2HWC4);
   auto tmp_src(src);
   C4HWtoHWC4(tmp_src.data(), dst.data(), H, W, pad_value);
-  WRAP(auto t2 = GET_TIMESTAMP();)
-  WRAP(ddtimer.c4hw2hwc4_time.push_back(GET_INTERVAL(t1, t2));)
 }
 
 template <typename T>
@@ -324,120 +324,5 @@ static void convert_NC3HW_to_HNWC8(const std::vector<T>& src,
   auto tmp_src(src);
   C3HWtoHWC8(tmp_src.data(), dst.data(), H, W, pad_value);
 }
-#if 0
-template <typename SrcDType, typename DstDType>
-void pad(const SrcDType* src, std::vector<int64_t>& src_shape,
-                     DstDType* dst, std::vector<size_t>& dst_shape, int dim,
-                     DTypeConvert flag, float scale, float zp) const {
-  int elems = 1;
-  for (int i = dim + 1; i < src_shape.size(); ++i)
-    elems *= src_shape[i];
-
-  int iters = 1;
-  for (int i = 0; i < dim; ++i)
-    iters *= src_shape[i];
-
-  int dimx = src_shape[dim];
-  int dimy = dst_shape[dim];
-
-  int s_off = dimx * elems;
-  int d_off = dimy * elems;
-
-  if (flag == DTypeConvert::AS_IS) {
-    for (auto f = 0; f < iters; ++f) {
-      std::memcpy(dst + (f * d_off), src + (f * s_off),
-                  s_off * sizeof(DstDType));
-    }
-  } else if (flag == DTypeConvert::TO_BF16) {
-    for (auto f = 0; f < iters; ++f) {
-      for (auto idx = 0; idx < s_off; ++idx) {
-        float value = (static_cast<float>(src[f * s_off + idx]) - zp) * scale;
-        dst[f * d_off + idx] = float_to_bfloat16_1(value);
-      }
-    }
-    // Assuming attention mask 4D only 1x1x1x77  would be padded to 1x1x1x128
-    // with bfloat16(-zp*scale).
-    if (dst_shape.size() == 4) {
-      for (int i = 77; i < 128; i++) {
-        float value = (float)((-zp) * (scale));
-        dst[i] = float_to_bfloat16_1(value);
-      }
-    }
-  } else {
-    LOG(FATAL) << "- Incorrect flag for Padding input, only to_bf16 conversion "
-                  "is possible.";
-  }
-}
-
-static enum DTypeConvert { TO_BF16 = 1, FROM_BF16 = 2, AS_IS = 3 };
-
-template <typename SrcDType, typename DstDType>
-void depad(SrcDType* src, std::vector<size_t>& src_shape,
-                       DstDType* dst, std::vector<int64_t>& dst_shape, int dim,
-                       DTypeConvert flag, float scale, float zp) const {
-  WRAP(auto t1 = GET_TIMESTAMP();)
-
-  int elems = 1;
-  for (int i = dim + 1; i < src_shape.size(); ++i)
-    elems *= src_shape[i];
-
-  int iters = 1;
-  for (int i = 0; i < dim; ++i)
-    iters *= src_shape[i];
-
-  int dimx = src_shape[dim];
-  int dimy = dst_shape[dim];
-
-  int s_off = dimx * elems;
-  int d_off = dimy * elems;
-
-  if (flag == DTypeConvert::AS_IS) {
-    for (auto f = 0; f < iters; ++f) {
-      std::memcpy(dst + (f * d_off), src + (f * s_off),
-                  d_off * sizeof(DstDType));
-    }
-  } else if (flag == DTypeConvert::FROM_BF16) {
-    for (auto f = 0; f < iters; ++f) {
-      for (auto idx = 0; idx < d_off; ++idx) {
-        float value = bfloat_to_float(src[f * s_off + idx]);
-        dst[f * d_off + idx] = static_cast<DstDType>(
-            std::clamp(std::roundf(value / scale) + zp, 0.0f, 65535.0f));
-      }
-    }
-  } else {
-    LOG(FATAL) << "- Incorrect flag for De-padding output, only from_bf16 "
-                  "conversion is possible.";
-  }
-  WRAP(auto t2 = GET_TIMESTAMP();)
-  WRAP(ddtimer_.depad_time.push_back(GET_INTERVAL(t1, t2));)
-}
-#endif
-
-static dd_timer_t sum_of(const std::vector<dd_timer_t>& vec) {
-  return std::accumulate(vec.begin(), vec.end(), dd_timer_t{0});
-}
-
-struct DDFileLogger {
-private:
-  std::ofstream ofs;
-
-public:
-  DDFileLogger(const std::string& filename) : ofs(filename) {
-    ofs << "compute_time,pre_dod_time,dod_time,post_dod_time,"
-        << "pad_time,depad_time,nchw2nhwc_time,nhwc2nchw_time,"
-        << "c4hw2hwc4_time,data_conv_time,iconv_prep_time,subgraph"
-        << std::endl;
-  }
-
-  template <typename T> DDFileLogger& operator<<(const T& item) {
-    ofs << item;
-    return *this;
-  }
-
-  DDFileLogger& operator<<(std::ostream& (*func)(std::ostream&)) {
-    ofs << func;
-    return *this;
-  }
-};
 
 } // namespace vaip_dod_custom_op
\ No newline at end of file
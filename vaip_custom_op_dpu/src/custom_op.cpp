@@ -15,7 +15,6 @@
 
 #include "./graph_holder.hpp"
 #include "vitis/ai/env_config.hpp"
-#include "vitis/ai/profiling.hpp"
 #include <cmath>
 #include <cstdlib>
 #include <filesystem>
@@ -58,8 +57,11 @@ DEF_ENV_PARAM(XLINX_VART_DUMP_OUTPUT, "0");
 DEF_ENV_PARAM(DEBUG_DPU_CUSTOM_OP, "0");
 DEF_ENV_PARAM(XLNX_ENABLE_GRAPH_ENGINE_PAD, "1")
 
-DEF_ENV_PARAM(XLNX_ENABLE_STAT_LOG, "0")
 DEF_ENV_PARAM(XLNX_ENABLE_BATCH, "0")
+// overlap the input and output copies of concurrent calls with the device
+// jobs of each other, see RunnerRequestsQueue::takeTicket(). Without
+// num_of_dpu_runners, 2 runners are created.
+DEF_ENV_PARAM(XLNX_ENABLE_DPU_PIPELINE, "0")
 
 DEF_ENV_PARAM(GET_WORKLOADONARCH_BY_EGOPS, "0");
 
@@ -69,6 +71,9 @@ namespace vaip_dpu_custom_op {
 
 static void real_compute(const MyCustomOp* custom_op, const OrtApi* api,
                          OrtKernelContext* context, vart::RunnerExt* runner);
+static void pipelined_compute(const MyCustomOp* custom_op, const OrtApi* api,
+                              OrtKernelContext* context,
+                              RunnerRequestsQueue::Ticket& ticket);
 void fill_inputs(
     const MyCustomOp* custom_op, Ort::KernelContext& context,
     const std::vector<vart::TensorBuffer*>& vart_input_tensor_buffers);
@@ -176,10 +181,12 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
       subgraph_{find_dpu_subgraph(graph_holder_,
                                   meta_def->dpu_param().subgraph_name())},
       input_schedules_(meta_def->dpu_param().input_schedule()),
-      output_schedules_(meta_def->dpu_param().output_schedule()) {
+      output_schedules_(meta_def->dpu_param().output_schedule()),
+      pipeline_{ENV_PARAM(XLNX_ENABLE_DPU_PIPELINE) != 0} {
   // LOG(INFO) << " Vitis AI EP running " << meta_def->nodes_size() << " Nodes";
 
   CHECK(subgraph_ != nullptr);
+  trace_id_ = vaip_core::runtime_trace::intern(subgraph_->get_name());
 #ifdef ENABLE_XRT_SHARED_CONTEXT
 #else
   std::shared_ptr<xir::Attrs> shared_attrs = xir::Attrs::create();
@@ -188,7 +195,8 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
   auto cfg_sess_opts = context->get_config_proto().provider_options();
   if (cfg_sess_opts.contains("model_category"))
     model_category_ = cfg_sess_opts.at("model_category");
-  int num_of_runners = 1;
+  // a single runner cannot overlap anything
+  int num_of_runners = pipeline_ ? 2 : 1;
   auto runners_num = cfg_sess_opts.find("num_of_dpu_runners");
   if (runners_num != cfg_sess_opts.end()) {
     std::string num_string = runners_num->second;
@@ -504,54 +512,52 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
       initialized_ = true;
     }
   }
-  __TIC__(GET_RUNNER);
-  auto runner_request = runnerRequestsQueue_->getIdleRequest();
-  __TOC__(GET_RUNNER);
-  auto runner = runner_request->runner_.get();
+  auto call = vaip_core::TraceSpan(trace_id_, vaip_core::runtime_trace::CALL);
+  auto runner_request = std::shared_ptr<RunnerHolder>();
+  auto ticket = std::unique_ptr<RunnerRequestsQueue::Ticket>();
+  {
+    VAIP_TRACE_SPAN(trace_id_, GET_RUNNER);
+    if (pipeline_) {
+      ticket = runnerRequestsQueue_->takeTicket();
+    } else {
+      runner_request = runnerRequestsQueue_->getIdleRequest();
+    }
+  }
 
-  __TIC__(COMPUTE);
   MY_LOG(1) << "dpu kernel " << subgraph_->get_name() << "\n";
-  auto __customop_start_time = std::chrono::steady_clock::now();
-  real_compute(this, api, context, runner);
-  auto __customop_end_time = std::chrono::steady_clock::now();
-  auto dpu_time = std::chrono::duration_cast<std::chrono::microseconds>(
-                      __customop_end_time - __customop_start_time)
-                      .count();
-  if (ENV_PARAM(XLNX_ENABLE_STAT_LOG)) {
-    std::cout << "[Vitis AI EP] IPU subgraph : " << subgraph_->get_name()
-              << " \t No. of Ops " << meta_def_->nodes_size() << " \tLatency "
-              << dpu_time << " us" << std::endl;
+  if (pipeline_) {
+    pipelined_compute(this, api, context, *ticket);
+  } else {
+    real_compute(this, api, context, runner_request->runner_.get());
   }
-  __TOC__(COMPUTE);
 
-  __TIC__(PUT_RUNNER);
-  runnerRequestsQueue_->putIdleRequest(runner_request);
-  __TOC__(PUT_RUNNER);
+  VAIP_TRACE_SPAN(trace_id_, PUT_RUNNER);
+  if (pipeline_) {
+    ticket = nullptr;
+  } else {
+    runnerRequestsQueue_->putIdleRequest(runner_request);
+  }
 }
 
-static void real_compute(const MyCustomOp* custom_op, const OrtApi* api,
-                         OrtKernelContext* context, vart::RunnerExt* runner) {
-
-  __TIC__(COPY_INPUT_PREPARE);
-  Ort::KernelContext ctx(context);
+// layout transform and fill dpu input from onnx OrtValue, then sync input
+// tensor buffers
+static void prepare_inputs(const MyCustomOp* custom_op,
+                           Ort::KernelContext& ctx, vart::RunnerExt* runner) {
+  auto trace_id = custom_op->trace_id();
   auto num_inputs = ctx.GetInputCount();
   auto num_outputs = ctx.GetOutputCount();
   auto vart_input_tensor_buffers = runner->get_inputs();
-  auto vart_output_tensor_buffers = runner->get_outputs();
   MY_LOG(1) << "num_inputs " << num_inputs << " "                        //
             << "num_outputs " << num_outputs << " "                      //
             << "\tnum_vart_inputs: " << vart_input_tensor_buffers.size() //
-            << "\tnum_vart_outputs: " << vart_output_tensor_buffers.size();
-
-  __TOC__(COPY_INPUT_PREPARE);
+            << "\tnum_vart_outputs: " << runner->get_outputs().size();
 
-  // layout transform and fill dpu input from onnx OrtValue
-  __TIC__(COPY_INPUT);
-  fill_inputs(custom_op, ctx, vart_input_tensor_buffers);
-  __TOC__(COPY_INPUT);
+  {
+    VAIP_TRACE_SPAN(trace_id, COPY_INPUT);
+    fill_inputs(custom_op, ctx, vart_input_tensor_buffers);
+  }
 
-  // sync input tensor buffers
-  __TIC__(SYNC_INPUT);
+  VAIP_TRACE_SPAN(trace_id, SYNC_INPUT);
   for (auto& input : vart_input_tensor_buffers) {
     auto batch = input->get_tensor()->get_shape()[0];
     if (!ENV_PARAM(XLNX_ENABLE_BATCH)) {
@@ -560,35 +566,76 @@ static void real_compute(const MyCustomOp* custom_op, const OrtApi* api,
     }
     input->sync_for_write(0, input->get_tensor()->get_data_size() / batch);
   }
-  __TOC__(SYNC_INPUT);
+}
 
-  // run dpu runner
-  __TIC__(RUN);
+static uint32_t launch(vart::RunnerExt* runner) {
   vitis::ai::trace::add_trace("user-task", vitis::ai::trace::func_start,
                               "graph_engine::dpu_kernel_run", "");
-  auto v = runner->execute_async(vart_input_tensor_buffers,
-                                 vart_output_tensor_buffers);
-  auto status = runner->wait((int)v.first, -1);
+  return runner->execute_async(runner->get_inputs(), runner->get_outputs())
+      .first;
+}
+
+static void wait_for(vart::RunnerExt* runner, uint32_t job_id) {
+  auto status = runner->wait((int)job_id, -1);
   CHECK_EQ(status, 0) << "failed to run the graph";
   vitis::ai::trace::add_trace("user-task", vitis::ai::trace::func_end,
                               "graph_engine::dpu_kernel_run", "");
-  __TOC__(RUN);
+}
 
-  // sync output tensor buffers
-  __TIC__(SYNC_OUTPUT);
-  for (auto output : vart_output_tensor_buffers) {
-    auto batch = output->get_tensor()->get_shape()[0];
-    if (!ENV_PARAM(XLNX_ENABLE_BATCH)) {
-      // ignore HW batch， the first dim is not batch
-      batch = 1;
+// sync output tensor buffers, then layout tranform and copy dpu output to
+// onnx OrtValue
+static void read_outputs(const MyCustomOp* custom_op, Ort::KernelContext& ctx,
+                         vart::RunnerExt* runner) {
+  auto trace_id = custom_op->trace_id();
+  auto vart_output_tensor_buffers = runner->get_outputs();
+  {
+    VAIP_TRACE_SPAN(trace_id, SYNC_OUTPUT);
+    for (auto output : vart_output_tensor_buffers) {
+      auto batch = output->get_tensor()->get_shape()[0];
+      if (!ENV_PARAM(XLNX_ENABLE_BATCH)) {
+        // ignore HW batch， the first dim is not batch
+        batch = 1;
+      }
+      output->sync_for_read(0, output->get_tensor()->get_data_size() / batch);
     }
-    output->sync_for_read(0, output->get_tensor()->get_data_size() / batch);
   }
-  __TOC__(SYNC_OUTPUT);
-  // layout tranform and copy dpu output to onnx OrtValue
-  __TIC__(COPY_OUTPUT);
+  VAIP_TRACE_SPAN(trace_id, COPY_OUTPUT);
   copy_outputs(custom_op, ctx, vart_output_tensor_buffers);
-  __TOC__(COPY_OUTPUT);
+}
+
+static void real_compute(const MyCustomOp* custom_op, const OrtApi* api,
+                         OrtKernelContext* context, vart::RunnerExt* runner) {
+  Ort::KernelContext ctx(context);
+  prepare_inputs(custom_op, ctx, runner);
+  {
+    VAIP_TRACE_SPAN(custom_op->trace_id(), RUN);
+    wait_for(runner, launch(runner));
+  }
+  read_outputs(custom_op, ctx, runner);
+}
+
+// Same as real_compute(), but the request of `ticket` is only used in
+// ticket order, see RunnerRequestsQueue::takeTicket() and pipelined_run().
+static void pipelined_compute(const MyCustomOp* custom_op, const OrtApi* api,
+                              OrtKernelContext* context,
+                              RunnerRequestsQueue::Ticket& ticket) {
+  Ort::KernelContext ctx(context);
+  auto trace_id = custom_op->trace_id();
+  pipelined_run(
+      trace_id, ticket,
+      [&](vart::RunnerExt* runner) { prepare_inputs(custom_op, ctx, runner); },
+      [&](vart::RunnerExt* runner) {
+        auto job_id = launch(runner);
+        MY_LOG(2) << "ticket " << ticket.id() << " launched job " << job_id;
+        return job_id;
+      },
+      [&](vart::RunnerExt* runner, uint32_t job_id) {
+        {
+          VAIP_TRACE_SPAN(trace_id, RUN);
+          wait_for(runner, job_id);
+        }
+        read_outputs(custom_op, ctx, runner);
+      });
 }
 static int64_t get_onnx_batch(Ort::KernelContext& ctx) {
   auto onnx_tensor = ctx.GetInput(0);
@@ -11,7 +11,9 @@
 #include "vart/runner_ext.hpp"
 
 #include <algorithm>
+#include <condition_variable>
 #include <future>
+#include <memory>
 #include <mutex>
 
 #include <xir/graph/graph.hpp>
@@ -43,6 +45,8 @@ public:
   get_output_schdules() const {
     return output_schedules_;
   }
+  /// see vaip_core::runtime_trace
+  uint32_t trace_id() const { return trace_id_; }
 
 private:
   virtual void Compute(const OrtApi* api,
@@ -55,9 +59,12 @@ private:
   const google::protobuf::RepeatedPtrField<MetaSchedule>& output_schedules_;
   mutable std::unique_ptr<RunnerRequestsQueue> runnerRequestsQueue_;
   bool share_context_;
+  // see XLNX_ENABLE_DPU_PIPELINE
+  bool pipeline_;
   mutable bool initialized_;
   mutable std::mutex init_mutex_;
   std::string model_category_;
+  uint32_t trace_id_ = 0;
 };
 
 struct RunnerHolder {
@@ -77,6 +84,10 @@ public:
       runner_request = std::move(runner);
       runner_requests_.push_back(runner_request);
     }
+    slots_ = runner_requests_;
+    for (auto i = 0u; i < slots_.size(); ++i) {
+      slot_turns_.push_back(i);
+    }
   }
 
   ~RunnerRequestsQueue() {
@@ -107,10 +118,97 @@ public:
     return runner_requests_;
   }
 
+  /// Pipelined mode, do not mix with getIdleRequest().
+  ///
+  /// Calls take tickets in arrival order and ticket t runs on request
+  /// t % N. A request is handed to its next ticket when the previous one
+  /// has copied its outputs, and device jobs are launched in ticket order,
+  /// so while one request runs on the device the others fill their inputs
+  /// or copy their outputs.
+  class Ticket {
+  public:
+    Ticket(RunnerRequestsQueue* queue, uint64_t id,
+           std::shared_ptr<RunnerHolder> request)
+        : queue_{queue}, id_{id}, request_{std::move(request)} {}
+    // also when the call failed, so that later tickets are not blocked.
+    ~Ticket() { queue_->finish(id_); }
+    Ticket(const Ticket&) = delete;
+    Ticket& operator=(const Ticket&) = delete;
+
+    uint64_t id() const { return id_; }
+    vart::RunnerExt* runner() const { return request_->runner_.get(); }
+    /// wait until all earlier tickets have launched their device jobs
+    void wait_launch_turn() { queue_->wait_launch_turn(id_); }
+    /// the device job is launched, the next ticket may launch its own
+    void launched() { queue_->launched(id_); }
+
+  private:
+    RunnerRequestsQueue* queue_;
+    uint64_t id_;
+    std::shared_ptr<RunnerHolder> request_;
+  };
+
+  std::unique_ptr<Ticket> takeTicket() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto id = next_ticket_++;
+    auto slot = id % slots_.size();
+    _cv.wait(lock, [this, id, slot] { return slot_turns_[slot] == id; });
+    return std::make_unique<Ticket>(this, id, slots_[slot]);
+  }
+
+private:
+  void wait_launch_turn(uint64_t id) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this, id] { return next_launch_ == id; });
+  }
+
+  void launched(uint64_t id) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (next_launch_ == id) {
+      next_launch_ = id + 1;
+      _cv.notify_all();
+    }
+  }
+
+  void finish(uint64_t id) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this, id] { return next_launch_ >= id; });
+    if (next_launch_ == id) {
+      next_launch_ = id + 1;
+    }
+    slot_turns_[id % slots_.size()] = id + slots_.size();
+    _cv.notify_all();
+  }
+
 private:
   std::mutex _mutex;
   std::condition_variable _cv;
   std::vector<std::shared_ptr<RunnerHolder>> runner_requests_;
+  // pipelined mode
+  std::vector<std::shared_ptr<RunnerHolder>> slots_;
+  // per slot, the ticket that may take it next
+  std::vector<uint64_t> slot_turns_;
+  uint64_t next_ticket_ = 0;
+  uint64_t next_launch_ = 0;
 };
 
+/// A pipelined call on the request of `ticket`: `prepare(runner)` fills the
+/// inputs, `launch(runner)` starts the device job and returns its id, and
+/// `finish(runner, job_id)` waits for the job and copies the outputs. Only
+/// the launches are serialized, in ticket order; the other steps overlap
+/// with those of the other tickets.
+template <typename Prepare, typename Launch, typename Finish>
+void pipelined_run(uint32_t trace_id, RunnerRequestsQueue::Ticket& ticket,
+                   Prepare&& prepare, Launch&& launch, Finish&& finish) {
+  auto runner = ticket.runner();
+  prepare(runner);
+  {
+    VAIP_TRACE_SPAN(trace_id, LAUNCH_TURN);
+    ticket.wait_launch_turn();
+  }
+  auto job_id = launch(runner);
+  ticket.launched();
+  finish(runner, job_id);
+}
+
 } // namespace vaip_dpu_custom_op
\ No newline at end of file
@@ -21,19 +21,22 @@ GraphHolder::GraphHolder(const vaip_core::PassContext& context,
   auto log_dir = context.get_log_dir();
   auto path = log_dir / filename;
   auto full_filename = path.u8string();
-  auto maybe_xmodel_content = context.read_file_c8(filename);
-  CHECK(maybe_xmodel_content.has_value())
-      << "read cache file error: can't read " << filename;
-  auto xmodel_context = maybe_xmodel_content.value();
-  std::string s;
   if (decryption_key != "") {
-    // TODO : aes_decryption change the first argument to accecpt gsl::span,
-    // not vector<char>
-    s = vaip_encryption::aes_decryption(
-        std::string(xmodel_context.begin(), xmodel_context.end()),
+    // decrypted as it is read, the encrypted xmodel is never held whole.
+    auto stream = context.open_file_for_read(filename);
+    CHECK(stream != nullptr)
+        << "read cache file error: can't read " << filename;
+    auto s = vaip_encryption::aes_decryption(
+        [&stream](char* data, size_t size) {
+          return stream->fread(data, size);
+        },
         decryption_key);
     graph_ = xir::Graph::deserialize_from_memory(s.data(), s.size());
   } else {
+    auto maybe_xmodel_content = context.read_file_c8(filename);
+    CHECK(maybe_xmodel_content.has_value())
+        << "read cache file error: can't read " << filename;
+    auto& xmodel_context = maybe_xmodel_content.value();
     graph_ = xir::Graph::deserialize_from_memory(xmodel_context.data(),
                                                  xmodel_context.size());
   }
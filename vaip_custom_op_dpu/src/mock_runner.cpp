@@ -0,0 +1,210 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "mock_runner.hpp"
+#include "ort_tensor_buffer.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "vitis/ai/env_config.hpp"
+
+DEF_ENV_PARAM(DEBUG_DPU_MOCK_RUNNER_LATENCY_US, "1000")
+DEF_ENV_PARAM(DEBUG_DPU_MOCK_RUNNER, "0")
+#define MY_LOG(n) LOG_IF(INFO, ENV_PARAM(DEBUG_DPU_MOCK_RUNNER) >= n)
+
+namespace vaip_dpu_custom_op {
+
+namespace {
+
+// One in-order device queue shared by all mock runners.
+class MockDevice {
+public:
+  static MockDevice& instance() {
+    static MockDevice device;
+    return device;
+  }
+
+  uint32_t submit(std::function<void()> job) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto id = next_id_++;
+    queue_.emplace_back(id, std::move(job));
+    cv_.notify_all();
+    return id;
+  }
+
+  void wait(uint32_t id) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [this, id] { return done_.count(id) != 0; });
+    done_.erase(id);
+  }
+
+  ~MockDevice() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+      cv_.notify_all();
+    }
+    thread_.join();
+  }
+
+private:
+  MockDevice() : thread_([this] { run(); }) {}
+
+  void run() {
+    auto latency =
+        std::chrono::microseconds(ENV_PARAM(DEBUG_DPU_MOCK_RUNNER_LATENCY_US));
+    for (;;) {
+      auto job = std::pair<uint32_t, std::function<void()>>();
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+          return;
+        }
+        job = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      // sleep_until, so that the latency does not drift with the copy
+      auto end = std::chrono::steady_clock::now() + latency;
+      job.second();
+      std::this_thread::sleep_until(end);
+      MY_LOG(2) << "mock device job " << job.first << " done";
+      std::lock_guard<std::mutex> lock(mtx_);
+      done_.insert(job.first);
+      cv_.notify_all();
+    }
+  }
+
+private:
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<std::pair<uint32_t, std::function<void()>>> queue_;
+  std::unordered_set<uint32_t> done_;
+  uint32_t next_id_ = 0;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+class MockRunner : public vart::RunnerExt {
+public:
+  explicit MockRunner(const xir::Subgraph* subgraph)
+      : inputs_{create_buffers(subgraph->get_input_tensors())},
+        outputs_{create_buffers(subgraph->get_output_tensors())} {
+    MY_LOG(1) << "mock runner for " << subgraph->get_name() << ": "
+              << inputs_.size() << " inputs, " << outputs_.size()
+              << " outputs";
+  }
+
+  virtual std::pair<uint32_t, int>
+  execute_async(const std::vector<vart::TensorBuffer*>& input,
+                const std::vector<vart::TensorBuffer*>& output) override {
+    auto id = MockDevice::instance().submit([input, output]() {
+      auto src = input.empty() ? std::pair<uint64_t, size_t>{0u, 0u}
+                               : input[0]->data({});
+      for (auto tb : output) {
+        auto dst = tb->data({});
+        auto p = reinterpret_cast<uint8_t*>(dst.first);
+        if (src.second == 0) {
+          std::memset(p, 0, dst.second);
+          continue;
+        }
+        auto from = reinterpret_cast<const uint8_t*>(src.first);
+        for (size_t i = 0; i < dst.second; i += src.second) {
+          std::memcpy(p + i, from, std::min(src.second, dst.second - i));
+        }
+      }
+    });
+    return {id, 0};
+  }
+
+  virtual int wait(int jobid, int timeout) override {
+    MockDevice::instance().wait((uint32_t)jobid);
+    return 0;
+  }
+
+  virtual std::vector<const xir::Tensor*> get_input_tensors() override {
+    return get_tensors(inputs_);
+  }
+  virtual std::vector<const xir::Tensor*> get_output_tensors() override {
+    return get_tensors(outputs_);
+  }
+  virtual std::vector<vart::TensorBuffer*> get_inputs() override {
+    return get_buffers(inputs_);
+  }
+  virtual std::vector<vart::TensorBuffer*> get_outputs() override {
+    return get_buffers(outputs_);
+  }
+
+private:
+  struct Buffer {
+    std::vector<char> data;
+    std::shared_ptr<vart::TensorBuffer> tensor_buffer;
+  };
+
+  // sorted by name, so that the first input does not depend on pointer
+  // values.
+  static std::vector<Buffer>
+  create_buffers(const std::set<const xir::Tensor*>& tensors) {
+    auto sorted = std::vector<const xir::Tensor*>(tensors.begin(),
+                                                  tensors.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const xir::Tensor* a, const xir::Tensor* b) {
+                return a->get_name() < b->get_name();
+              });
+    auto ret = std::vector<Buffer>(sorted.size());
+    for (auto i = 0u; i < sorted.size(); ++i) {
+      auto t = sorted[i];
+      ret[i].data.resize(t->get_data_size());
+      ret[i].tensor_buffer = OrtTensorBuffer::create(
+          xir::Tensor::create(t->get_name(), t->get_shape(),
+                              t->get_data_type()),
+          ret[i].data.data());
+    }
+    return ret;
+  }
+
+  static std::vector<const xir::Tensor*>
+  get_tensors(const std::vector<Buffer>& buffers) {
+    auto ret = std::vector<const xir::Tensor*>();
+    for (auto& b : buffers) {
+      ret.push_back(b.tensor_buffer->get_tensor());
+    }
+    return ret;
+  }
+
+  static std::vector<vart::TensorBuffer*>
+  get_buffers(const std::vector<Buffer>& buffers) {
+    auto ret = std::vector<vart::TensorBuffer*>();
+    for (auto& b : buffers) {
+      ret.push_back(b.tensor_buffer.get());
+    }
+    return ret;
+  }
+
+private:
+  std::vector<Buffer> inputs_;
+  std::vector<Buffer> outputs_;
+};
+
+} // namespace
+
+std::unique_ptr<vart::RunnerExt>
+create_mock_runner(const xir::Subgraph* subgraph) {
+  return std::make_unique<MockRunner>(subgraph);
+}
+
+} // namespace vaip_dpu_custom_op
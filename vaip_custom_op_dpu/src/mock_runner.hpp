@@ -0,0 +1,28 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include "vart/runner_ext.hpp"
+
+#include <memory>
+
+#include <xir/graph/subgraph.hpp>
+
+namespace vaip_dpu_custom_op {
+
+/// A runner for `subgraph` that needs no device, for the unit tests of the
+/// custom op on a host without an IPU. It is built into the
+/// vaip_custom_op_dpu_mock_runner library only, not the custom op.
+///
+/// Tensor buffers are host memory. All mock runners of the process share
+/// one simulated device which runs their jobs one at a time, in the order
+/// they are submitted, each for DEBUG_DPU_MOCK_RUNNER_LATENCY_US. A job
+/// fills output byte `i` with byte `i % size` of the first input, so the
+/// outputs only depend on the inputs and a mixed up buffer shows in them.
+std::unique_ptr<vart::RunnerExt>
+create_mock_runner(const xir::Subgraph* subgraph);
+
+} // namespace vaip_dpu_custom_op
@@ -23,29 +23,30 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
   ifm_dim_1 = stoi(meta_def->generic_param().at("ifm_dim_1"));
   indeces_shape = stoi(meta_def->generic_param().at("indeces_shape"));
   std::string zp_file = meta_def->generic_param().at("zp_file");
-  std::string data_file = meta_def->generic_param().at("data_file");
-  auto data_file_opt = context->read_file_c8(
-      std::filesystem::path(data_file).filename().string());
   auto zp_file_opt =
       context->read_file_c8(std::filesystem::path(zp_file).filename().string());
-  if (!data_file_opt.has_value()) {
-    std::cerr << "Error reading file: " << data_file << std::endl;
-  }
   if (!zp_file_opt.has_value()) {
     std::cerr << "Error reading file: " << zp_file << std::endl;
   }
-  auto file = data_file_opt.value();
-  in_data.resize(file.size() / sizeof(int8_t));
-  memcpy(in_data.data(), file.data(), file.size());
-
   auto file_zp = zp_file_opt.value();
   zp = *reinterpret_cast<const int8_t*>(file_zp.data());
+  table_ = vaip_embedding::Table::load(
+      *context, meta_def->generic_param().at("data_file"), ifm_dim_0,
+      ifm_dim_1);
 
-  size_t input_size = ifm_dim_0 * ifm_dim_1;
-  in_dq.resize(input_size);
-  for (size_t i = 0; i < input_size; ++i) {
-    in_dq[i] = (float)((float)in_data[i] - (float)zp) * scale;
-  }
+  // dequantize, then quantize back to int8, fused into the gather. With
+  // the same scale and zero point this is mostly the identity, and rows
+  // are then plain copies.
+  auto in_scale = scale;
+  auto in_zp = zp;
+  lut_ = vaip_embedding::ByteLut<int8_t>::make([=](uint8_t v) {
+    float maxval = 127.0f;
+    float minval = -128.0f;
+    float dq = (float)((float)(int8_t)v - (float)in_zp) * in_scale;
+    float temp = dq / in_scale + static_cast<float>(in_zp);
+    temp = std::min(maxval, std::max(minval, temp));
+    return static_cast<int8_t>(temp);
+  });
 }
 
 MyCustomOp::~MyCustomOp() {}
@@ -63,20 +64,10 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   auto indeces = input_tensor.GetTensorData<float>();
   auto output_tensor = ctx.GetOutput(0, {1, indeces_shape, ifm_dim_1});
   auto out_data = output_tensor.GetTensorMutableData<int8_t>();
-  size_t out_size = indeces_shape * ifm_dim_1;
-  // std::vector<float> dq_out(out_size);
-
-  float maxval = 127.0f;
-  float minval = -128.0f;
-
-  for (size_t i = 0; i < indeces_shape; i++) {
-    int idx_v = (int)indeces[i];
-    for (int j = 0; j < ifm_dim_1; j++) {
-      float temp =
-          in_dq[idx_v * ifm_dim_1 + j] / scale + static_cast<float>(zp);
-      temp = std::min(maxval, std::max(minval, temp));
-      out_data[i * ifm_dim_1 + j] = static_cast<int8_t>(temp);
-    }
-  }
+  vaip_embedding::gather(table_, indeces, indeces_shape,
+                         [&](int64_t i, const uint8_t* row) {
+                           lut_.convert(row, out_data + i * ifm_dim_1,
+                                        ifm_dim_1);
+                         });
 }
 } // namespace vaip_dqcastgather_custom_op
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "vaip/vaip.hpp"
+#include "embedding/embedding.hpp"
 #include "vart/runner_ext.hpp"
 #include <algorithm>
 #include <future>
@@ -34,8 +35,8 @@ private:
   int32_t indeces;
   int ifm_dim_0;
   int ifm_dim_1;
-  std::vector<float> in_dq;
-  std::vector<int8_t> in_data;
+  vaip_embedding::Table table_;
+  vaip_embedding::ByteLut<int8_t> lut_;
 };
 
 } // namespace vaip_dqcastgather_custom_op
\ No newline at end of file
@@ -8,6 +8,7 @@
 **/
 #pragma once
 
+#include "./dqsoftmax_cpu.hpp"
 #include "vaip/vaip.hpp"
 #include "vart/runner_ext.hpp"
 #include <algorithm>
@@ -25,9 +26,8 @@ public:
   virtual ~MyCustomOp();
 
 private:
-  float scale;
-  uint16_t zp;
   int h_w, channel;
+  DqSoftmaxCpu softmax_;
   virtual void Compute(const OrtApi* api,
                        OrtKernelContext* context) const override final;
 };
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "./dqsoftmax_cpu.hpp"
+#include "cpu_features/cpu_features.hpp"
+#include "vaip/thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace vaip_dqsoftmax_custom_op {
+
+DqSoftmaxCpu::DqSoftmaxCpu(float scale) {
+  // indexed by q_max - q, see dqsoftmax_rows()
+  exp_table_.resize(65536);
+  for (size_t k = 0; k < exp_table_.size(); ++k) {
+    exp_table_[k] = std::exp(-scale * static_cast<float>(k));
+  }
+}
+
+#if VAIP_CPU_X86
+// exp_table[q_max - q] of the first n elements, n a multiple of 8, into
+// output; returns their sum.
+VAIP_CPU_TARGET("avx2")
+static float exp_lookup_avx2(const uint16_t* input, float* output,
+                             const float* exp_table, uint16_t q_max, int n) {
+  __m256 sum_exp_vec = _mm256_setzero_ps();
+  const __m256i q_max_vec = _mm256_set1_epi32(q_max);
+  for (int i = 0; i < n; i += 8) {
+    __m256i q =
+        _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)&input[i]));
+    __m256 e = _mm256_i32gather_ps(exp_table, _mm256_sub_epi32(q_max_vec, q),
+                                   sizeof(float));
+    _mm256_storeu_ps(&output[i], e);
+    sum_exp_vec = _mm256_add_ps(sum_exp_vec, e);
+  }
+  alignas(32) float sum_array[8];
+  _mm256_store_ps(sum_array, sum_exp_vec);
+  float sum_exp = 0.0f;
+  for (int j = 0; j < 8; ++j) {
+    sum_exp += sum_array[j];
+  }
+  return sum_exp;
+}
+#endif
+
+// softmax(x)_i = exp(s * (q_i - q_max)) / sum_j exp(s * (q_j - q_max)), the
+// zero point cancels out. exp_table[k] = exp(-s * k) for k = q_max - q_i,
+// every term is in (0, 1] so the sum cannot overflow.
+static void dqsoftmax_rows(const uint16_t* input, float* output,
+                           const float* exp_table, int c_sz, int row_begin,
+                           int row_end, bool avx2) {
+  for (int h = row_begin; h < row_end; h++) {
+    const uint16_t* input_iter = input + (size_t)h * c_sz;
+    float* output_iter = output + (size_t)h * c_sz;
+
+    uint16_t q_max = 0;
+    for (int i = 0; i < c_sz; ++i) {
+      q_max = std::max(q_max, input_iter[i]);
+    }
+
+    int i = 0;
+    float sum_exp = 0.0f;
+#if VAIP_CPU_X86
+    if (avx2) {
+      i = c_sz / 8 * 8;
+      sum_exp = exp_lookup_avx2(input_iter, output_iter, exp_table, q_max, i);
+    }
+#endif
+    for (; i < c_sz; ++i) {
+      float e = exp_table[q_max - input_iter[i]];
+      output_iter[i] = e;
+      sum_exp += e;
+    }
+
+    float sum_exp_inv = 1.0f / sum_exp;
+    for (i = 0; i < c_sz; ++i) {
+      output_iter[i] *= sum_exp_inv;
+    }
+  }
+}
+
+void DqSoftmaxCpu::run(const uint16_t* input, float* output, int channel,
+                       int h_w) const {
+  run(input, output, channel, h_w, vaip_cpu::has_avx2());
+}
+
+void DqSoftmaxCpu::run(const uint16_t* input, float* output, int channel,
+                       int h_w, bool avx2) const {
+  auto row_bytes = (int64_t)channel * (sizeof(uint16_t) + sizeof(float));
+  auto exp_table = exp_table_.data();
+  vaip_core::parallel_for(0, h_w, vaip_core::grain_size(row_bytes),
+                          [=](int64_t begin, int64_t end) {
+                            dqsoftmax_rows(input, output, exp_table, channel,
+                                           (int)begin, (int)end, avx2);
+                          });
+}
+
+} // namespace vaip_dqsoftmax_custom_op
@@ -0,0 +1,32 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace vaip_dqsoftmax_custom_op {
+
+/// Softmax over the channels of uint16 quantized rows, with float output.
+///
+/// A row is normalized by its maximum, so every term is exp(-scale * k)
+/// for k = q_max - q in [0, 65535]; these come from a table built once.
+/// Rows are split over the host thread pool.
+class DqSoftmaxCpu {
+public:
+  explicit DqSoftmaxCpu(float scale);
+
+  /// `input` and `output` are [h_w, channel].
+  void run(const uint16_t* input, float* output, int channel, int h_w) const;
+  /// the same, with the AVX2 gather only if `avx2`, for testing.
+  void run(const uint16_t* input, float* output, int channel, int h_w,
+           bool avx2) const;
+
+private:
+  // exp(-scale * k), k in [0, 65535]
+  std::vector<float> exp_table_;
+};
+
+} // namespace vaip_dqsoftmax_custom_op
@@ -8,6 +8,7 @@
 #include "iostream"
 #include "onnxruntime_api.hpp"
 #include <cstdint>
+#include <cstring>
 #include <glog/logging.h>
 #include <sstream>
 #include <vector>
@@ -23,23 +24,9 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
   indeces_shape = stoi(meta_def->generic_param().at("indeces_shape"));
   is_const = stoi(meta_def->generic_param().at("ind_is_const"));
   // weight tensor as bin file
-  std::string data_file = meta_def->generic_param().at("data_file");
-  auto data_file_opt = context->read_file_u8(
-      std::filesystem::path(data_file).filename().string());
-  if (data_file_opt.has_value()) {
-    in_data = data_file_opt.value();
-  } else {
-    std::ifstream file(data_file, std::ios::binary);
-    file.seekg(0, std::ios::end);
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    in_data.resize(size / sizeof(uint8_t));
-
-    if (!file.read(reinterpret_cast<char*>(in_data.data()), size)) {
-      std::cerr << "Error reading data file!" << std::endl;
-    }
-    file.close();
-  }
+  table_ = vaip_embedding::Table::load(
+      *context, meta_def->generic_param().at("data_file"), ifm_dim_0,
+      ifm_dim_1);
 
   if (is_const) { // if input to gather is constant, read from bin file
     std::string idata_file = meta_def->generic_param().at("idata_file");
@@ -60,6 +47,8 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
       }
       ifile.close();
     }
+    CHECK_GE(in_indeces.size(), (size_t)indeces_shape)
+        << "too few indices in " << idata_file;
   }
 }
 
@@ -86,14 +75,10 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   auto output_tensor = ctx.GetOutput(0, {1, indeces_shape, ifm_dim_1});
 
   auto out_data = output_tensor.GetTensorMutableData<uint8_t>();
-  for (size_t i = 0; i < indeces_shape; i++) {
-
-    int idx_v = (int)indeces[i];
-
-    for (int j = 0; j < ifm_dim_1; j++) {
-      uint8_t temp = in_data[idx_v * ifm_dim_1 + j];
-      out_data[i * ifm_dim_1 + j] = (temp);
-    }
-  }
+  vaip_embedding::gather(table_, indeces, indeces_shape,
+                         [&](int64_t i, const uint8_t* row) {
+                           std::memcpy(out_data + i * ifm_dim_1, row,
+                                       ifm_dim_1);
+                         });
 }
 } // namespace vaip_gather_custom_op
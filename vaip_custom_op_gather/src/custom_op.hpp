@@ -8,6 +8,7 @@
 #pragma once
 
 #include "vaip/vaip.hpp"
+#include "embedding/embedding.hpp"
 #include "vart/runner_ext.hpp"
 #include <algorithm>
 #include <future>
@@ -32,7 +33,7 @@ private:
   int64_t indeces;
   int ifm_dim_0;
   int ifm_dim_1;
-  std::vector<uint8_t> in_data;
+  vaip_embedding::Table table_;
   std::vector<int64_t> in_indeces;
   int is_const; // is indices input to gather constant flag
 };
@@ -29,29 +29,24 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   // weight tensor as bin file
   auto dd_cache_dir = context->get_log_dir();
-  auto data_file = dd_cache_dir / meta_def->generic_param().at("data_file");
-  auto data_file_opt = context->read_file_c8(
-      std::filesystem::path(data_file).filename().string());
-  if (!data_file_opt.has_value()) {
-    std::cerr << "Error reading file: " << data_file << std::endl;
-  }
-  auto file = data_file_opt.value();
-  in_data_.resize(file.size() / sizeof(uint8_t));
-  memcpy(in_data_.data(), file.data(), file.size());
-
-  auto wts_file = dd_cache_dir / meta_def->generic_param().at("wts_file");
-  std::vector<uint8_t> wts_data_tmp;
-  std::streamsize sizew;
-  auto wts_data_opt = context->read_file_u8(
-      std::filesystem::path(wts_file).filename().string());
-  if (!wts_data_opt.has_value()) {
-    std::cerr << "Error reading file: " << wts_file << std::endl;
-  }
-  wts_data_tmp = wts_data_opt.value();
-  sizew = wts_data_tmp.size();
-  wts_data_.resize(sizew / sizeof(uint8_t));
-  for (int i = 0; i < sizew; i++)
-    wts_data_[i] = ((float)wts_data_tmp[i] - wt_zp_) * wt_scale_;
+  table_ = vaip_embedding::Table::load(
+      *context, dd_cache_dir / meta_def->generic_param().at("data_file"),
+      ifm_dim_0_, ifm_dim_1_);
+  // one row per output position, added to the gathered rows
+  wts_ = vaip_embedding::Table::load(
+      *context, dd_cache_dir / meta_def->generic_param().at("wts_file"),
+      indeces_shape_, ifm_dim_1_);
+
+  auto act_zp = act_zp_;
+  auto act_scale = act_scale_;
+  act_lut_ = vaip_embedding::ByteLut<float>::make([=](uint8_t v) {
+    return ((float)v - act_zp) * act_scale;
+  });
+  auto wt_zp = wt_zp_;
+  auto wt_scale = wt_scale_;
+  wts_lut_ = vaip_embedding::ByteLut<float>::make([=](uint8_t v) {
+    return ((float)v - wt_zp) * wt_scale;
+  });
 }
 
 MyCustomOp::~MyCustomOp() {}
@@ -74,15 +69,15 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   auto output_tensor = ctx.GetOutput(0, {1, indeces_shape_, ifm_dim_1_});
 
   auto out_data = output_tensor.GetTensorMutableData<float>();
-  for (size_t i = 0; i < indeces_shape_; i++) {
-
-    int idx_v = (int)indeces[i];
-
-    for (int j = 0; j < ifm_dim_1_; j++) {
-      uint8_t temp = in_data_[idx_v * ifm_dim_1_ + j];
-      float val = ((float)temp - act_zp_) * act_scale_;
-      out_data[i * ifm_dim_1_ + j] = val + wts_data_[i * ifm_dim_1_ + j];
-    }
-  }
+  auto dim = ifm_dim_1_;
+  vaip_embedding::gather(table_, indeces, indeces_shape_,
+                         [&](int64_t i, const uint8_t* row) {
+                           auto out = out_data + i * dim;
+                           auto wts = wts_.row(i);
+                           for (int j = 0; j < dim; j++) {
+                             out[j] = act_lut_.values[row[j]] +
+                                      wts_lut_.values[wts[j]];
+                           }
+                         });
 }
 } // namespace vaip_gather_add_custom_op
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "vaip/vaip.hpp"
+#include "embedding/embedding.hpp"
 #include "vart/runner_ext.hpp"
 #include <algorithm>
 #include <future>
@@ -31,8 +32,11 @@ private:
   int indeces_shape_;
   int ifm_dim_0_;
   int ifm_dim_1_;
-  std::vector<uint8_t> in_data_;
-  std::vector<float> wts_data_;
+  vaip_embedding::Table table_;
+  vaip_embedding::Table wts_;
+  // dequantization of table_ and wts_
+  vaip_embedding::ByteLut<float> act_lut_;
+  vaip_embedding::ByteLut<float> wts_lut_;
   std::vector<int64_t> in_indeces_;
   float act_scale_, wt_scale_;
   int act_zp_, wt_zp_;
@@ -19,6 +19,7 @@
 
 #include "custom_op.hpp"
 #pragma once
+#include "qgemm/qgemm.hpp"
 #include "qlinear_2/qlinear_2.hpp"
 
 #include <filesystem>
@@ -33,6 +34,7 @@ using namespace ryzenai;
 
 DEF_ENV_PARAM(DEBUG_GEMM_CUSTOM_OP, "0")
 DEF_ENV_PARAM_2(XLNX_VART_FIRMWARE, "", std::string)
+DEF_ENV_PARAM(XLNX_GEMM_USE_CPU, "0")
 #define LOG_THIS(n) LOG_IF(INFO, ENV_PARAM(DEBUG_GEMM_CUSTOM_OP) >= n)
 
 namespace vaip_gemm_custom_op {
@@ -58,15 +60,69 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
                        onnxruntime::Model* model)
     : CustomOpImp(context, meta_def, model) { //,
 
+  trace_id_ = vaip_core::runtime_trace::intern(meta_def->id());
   y_scale_ = std::stof(meta_def->generic_param().at("wts_scale"));
   x_scale_ = std::stof(meta_def->generic_param().at("in_scale"));
   input_zp_ = std::stoi(meta_def->generic_param().at("in_zp"));
 
   impl_ = meta_def->generic_param().at("impl");
+  if (impl_ != "v1") {
+    throw std::runtime_error(
+        "ERROR : # Implementaion is not available for this version");
+  }
+
+  std::string inputbin = meta_def->generic_param().at("bias_file");
+  bias_file_ = inputbin;
+
+  std::string inputbin_wts = meta_def->generic_param().at("wts_file");
+  wts_file_ = inputbin_wts;
+
+  auto shape_0 = stoi(meta_def->generic_param().at("wts_shape_dim_1"));
+  auto shape_1 = stoi(meta_def->generic_param().at("wts_shape_dim_0"));
+
+  wts_shape_ = std::make_tuple(shape_0, shape_1);
+
+  if (inputbin != "null") {
+    bias_.resize(std::get<1>(wts_shape_));
+
+    auto infile = std::ifstream(bias_file_, std::ios::in | std::ios::binary);
+    for (unsigned i = 0; infile.read(((char*)&bias_[i]), sizeof(float)); i++)
+      ;
+  }
+
+  auto size = (size_t)fs::file_size(inputbin_wts);
+  CHECK_GE(size, (size_t)shape_0 * shape_1)
+      << "weights file " << inputbin_wts << " is too small";
+  wts_.resize(size);
+  auto infile = std::ifstream(inputbin_wts, std::ios::in | std::ios::binary);
+  infile.read((char*)wts_.data(), size);
+
+  if (ENV_PARAM(XLNX_GEMM_USE_CPU)) {
+    LOG_THIS(1) << "XLNX_GEMM_USE_CPU is set, use CPU kernel";
+  } else {
+    try {
+      init_npu(*context);
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "cannot initialize GEMM NPU kernel, fall back to CPU: "
+                   << e.what();
+      gemm_ = nullptr;
+    }
+  }
+  if (gemm_ == nullptr) {
+    packed_wts_ = std::make_unique<vaip_qgemm::PackedWeights>(
+        wts_.data(), shape_0, shape_1);
+  } else {
+    // The activation zero point is folded into the epilogue with the
+    // column sums instead of being subtracted from every input.
+    wts_colsum_ = vaip_qgemm::column_sums(wts_.data(), shape_0, shape_1);
+  }
+  wts_ = std::vector<int8_t>();
+}
 
+void MyCustomOp::init_npu(const PassContext& context) {
   // Backward compatibility.
   auto xclbin_file = ENV_PARAM(XLNX_VART_FIRMWARE);
-  auto cfg_sess_opts = context->get_config_proto().provider_options();
+  auto cfg_sess_opts = context.get_config_proto().provider_options();
   auto it = cfg_sess_opts.find("xclbin");
   if (it != cfg_sess_opts.end() && !it->second.empty()) {
     xclbin_file = it->second;
@@ -90,52 +146,17 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   auto device_id = 0;
   auto context_id = 0;
-  context_ = vaip::Context::create_shared_context(*context, device_id,
+  context_ = vaip::Context::create_shared_context(context, device_id,
                                                   context_id, xclbin_file);
 
-  std::string inputbin = meta_def->generic_param().at("bias_file");
-  bias_file_ = inputbin;
-
-  std::string inputbin_wts = meta_def->generic_param().at("wts_file");
-  wts_file_ = inputbin_wts;
-
-  auto shape_0 = stoi(meta_def->generic_param().at("wts_shape_dim_1"));
-  auto shape_1 = stoi(meta_def->generic_param().at("wts_shape_dim_0"));
-
-  wts_shape_ = std::make_tuple(shape_0, shape_1);
-
-  if (inputbin != "null") {
-    bias_.resize(std::get<1>(wts_shape_));
-
-    auto infile = std::ifstream(bias_file_, std::ios::in | std::ios::binary);
-    for (unsigned i = 0; infile.read(((char*)&bias_[i]), sizeof(float)); i++)
-      ;
-  }
-
-  unsigned int size = (unsigned int)fs::file_size(inputbin_wts);
-  int8_t* wts = (int8_t*)malloc(size);
-
-  auto infile = std::ifstream(inputbin_wts, std::ios::in | std::ios::binary);
-  for (unsigned i = 0; infile.read(&((char*)wts)[i], sizeof(int8_t)); i++)
-    ;
-
-  if (impl_ == "v1") {
-
-    const std::string& a_dtype = "int8";
-    const std::string& b_dtype = "int8";
-    const std::string& c_dtype = "int32";
-    gemm_ = std::make_shared<qlinear_2<int8_t, int8_t, int32_t>>(
-        a_dtype, b_dtype, c_dtype);
-    qlinear_2<int8_t, int8_t, int32_t>* ptr =
-        (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
-    ptr->initialize_weights(wts, wts_shape_);
-
-  } else {
-    throw std::runtime_error(
-        "ERROR : # Implementaion is not available for this version");
-  }
-
-  free(wts);
+  const std::string& a_dtype = "int8";
+  const std::string& b_dtype = "int8";
+  const std::string& c_dtype = "int32";
+  gemm_ = std::make_shared<qlinear_2<int8_t, int8_t, int32_t>>(
+      a_dtype, b_dtype, c_dtype);
+  qlinear_2<int8_t, int8_t, int32_t>* ptr =
+      (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
+  ptr->initialize_weights(wts_.data(), wts_shape_);
 }
 
 MyCustomOp::~MyCustomOp() {}
@@ -149,17 +170,7 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   auto input_data = input_tensor.GetTensorData<int8_t>();
   auto input_shape = input_tensor.GetTensorTypeAndShapeInfo().GetShape();
   auto num_outputs = ctx.GetOutputCount();
-#ifdef PROFILE_GEMM
-  std::chrono::time_point<std::chrono::high_resolution_clock>
-      _dynamic_scale_start, _dynamic_scale_end;
-  std::chrono::time_point<std::chrono::high_resolution_clock> _bias_add_start,
-      _bias_add_end;
-#endif
-  USE_TIMER_GEMM(_dynamic_scale_start =
-                     std::chrono::high_resolution_clock::now());
-
-  USE_TIMER_GEMM(_dynamic_scale_end =
-                     std::chrono::high_resolution_clock::now());
+  auto call = vaip_core::TraceSpan(trace_id_, vaip_core::runtime_trace::CALL);
   std::vector<int64_t> out_shape;
   int batch;
   if (input_shape.size() == 4) {
@@ -184,54 +195,31 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
                       (int)input_shape[input_shape.size() - 1]);
 
   auto out_base = output_tensor.GetTensorMutableData<float>();
-  size_t in_size = std::accumulate(input_shape.begin(), input_shape.end(), 1,
-                                   std::multiplies<size_t>());
   size_t out_size = std::accumulate(out_shape.begin(), out_shape.end(), 1,
                                     std::multiplies<size_t>());
 
-  std::vector<int8_t> input_data1(in_size, 0);
-  std::vector<int32_t> out_tmp(out_size, 0);
-
-  for (size_t i = 0; i < in_size; i++) {
-    input_data1[i] = (int8_t)(input_data[i] - input_zp_);
-  }
-
-  auto _exec_start = std::chrono::high_resolution_clock::now();
+  auto M = (int64_t)std::get<0>(input_s);
+  auto K = (int64_t)std::get<1>(input_s);
+  auto N = (int64_t)std::get<1>(wts_shape_);
+  auto scale = x_scale_ * y_scale_;
+  auto bias = bias_.empty() ? nullptr : bias_.data();
 
-  qlinear_2<int8_t, int8_t, int32_t>* ptr =
-      (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
-  ptr->execute(input_data1.data(), input_s, out_tmp.data());
-
-  for (int i = 0; i < out_size; i++) {
-    out_base[i] = (float)(out_tmp[i] * x_scale_ * y_scale_);
-  }
-  if (bias_file_ != "null") {
-    USE_TIMER_GEMM(_bias_add_start = std::chrono::high_resolution_clock::now());
-    for (int i = 0; i < std::get<0>(input_s); i++) {
-      for (int j = 0; j < std::get<1>(wts_shape_); j++) {
-        int index = i * std::get<1>(wts_shape_) + j;
-        out_base[index] += bias_[j];
-      }
+  if (packed_wts_ != nullptr) {
+    VAIP_TRACE_SPAN(trace_id_, CPU_GEMM);
+    vaip_qgemm::qgemm(input_data, M, K, *packed_wts_, input_zp_, scale, bias,
+                      out_base, N);
+  } else {
+    std::lock_guard<std::mutex> lock(out_tmp_mutex_);
+    out_tmp_.resize(out_size);
+    qlinear_2<int8_t, int8_t, int32_t>* ptr =
+        (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
+    {
+      VAIP_TRACE_SPAN(trace_id_, EXECUTE);
+      ptr->execute(const_cast<int8_t*>(input_data), input_s, out_tmp_.data());
     }
-
-    USE_TIMER_GEMM(_bias_add_end = std::chrono::high_resolution_clock::now());
+    VAIP_TRACE_SPAN(trace_id_, DEQUANT);
+    vaip_qgemm::dequant_epilogue(out_tmp_.data(), M, N, N, wts_colsum_.data(),
+                                 input_zp_, scale, bias, out_base, N);
   }
-
-  auto _exec_stop = std::chrono::high_resolution_clock::now();
-  auto exec_total = (_exec_stop - _exec_start) / std::chrono::microseconds(1);
-#ifdef PROFILE_GEMM
-  std::stringstream _csv_out;
-  _csv_out << "input scale calculate, bias add"
-           << "\n";
-  _csv_out << (_dynamic_scale_end - _dynamic_scale_start) /
-                  std::chrono::microseconds(1)
-           << ",";
-  _csv_out << (_bias_add_end - _bias_add_start) / std::chrono::microseconds(1)
-           << ",";
-  std::ofstream csv_file_out("./gemmop.csv", std::ios::app | std::ios::out);
-
-  csv_file_out << _csv_out.str() << std::endl;
-#endif
-  auto out = out_base;
 }
 } // namespace vaip_gemm_custom_op
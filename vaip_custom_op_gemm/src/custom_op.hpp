@@ -17,13 +17,9 @@
 
 #include "../../xrt_shared_context/xrt_shared_context.hpp"
 
-#include <chrono>
-// #define PROFILE_GEMM
-#ifdef PROFILE_GEMM
-#  define USE_TIMER_GEMM(timer) timer
-#else
-#  define USE_TIMER_GEMM(timer)
-#endif
+namespace vaip_qgemm {
+class PackedWeights;
+} // namespace vaip_qgemm
 
 namespace vaip_gemm_custom_op {
 using namespace vaip_core;
@@ -38,6 +34,7 @@ public:
 private:
   virtual void Compute(const OrtApi* api,
                        OrtKernelContext* context) const override final;
+  void init_npu(const PassContext& context);
   std::shared_ptr<void> gemm_;
   std::shared_ptr<vaip::Context> context_;
   std::unique_ptr<xrt::xclbin> _xclbin;
@@ -50,6 +47,14 @@ private:
   std::vector<float> bias_;
   int input_zp_;
   std::string impl_;
+  // host GEMM when the NPU kernel is not available
+  std::unique_ptr<vaip_qgemm::PackedWeights> packed_wts_;
+  // zero point correction of the NPU output
+  std::vector<int32_t> wts_colsum_;
+  // runtime_trace id of this op
+  uint32_t trace_id_ = 0;
+  mutable std::mutex out_tmp_mutex_;
+  mutable std::vector<int32_t> out_tmp_;
 };
 
 } // namespace vaip_gemm_custom_op
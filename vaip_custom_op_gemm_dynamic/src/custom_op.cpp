@@ -19,6 +19,7 @@
 
 #include "custom_op.hpp"
 #pragma once
+#include "qgemm/qgemm.hpp"
 #include "qlinear_2/qlinear_2.hpp"
 
 #include <filesystem>
@@ -33,6 +34,7 @@ using namespace ryzenai;
 
 DEF_ENV_PARAM(DEBUG_GEMM_DYNAMIC_CUSTOM_OP, "0")
 DEF_ENV_PARAM_2(XLNX_VART_FIRMWARE, "", std::string)
+DEF_ENV_PARAM(XLNX_GEMM_DYNAMIC_USE_CPU, "0")
 #define LOG_THIS(n) LOG_IF(INFO, ENV_PARAM(DEBUG_GEMM_DYNAMIC_CUSTOM_OP) >= n)
 
 namespace vaip_gemm_dynamic_custom_op {
@@ -58,6 +60,7 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
                        onnxruntime::Model* model)
     : CustomOpImp(context, meta_def, model) { //,
 
+  trace_id_ = vaip_core::runtime_trace::intern(meta_def->id());
   a_scale_ = std::stof(meta_def->generic_param().at("a_in_scale"));
   a_input_zp_ = std::stoi(meta_def->generic_param().at("a_in_zp"));
   b_scale_ = std::stof(meta_def->generic_param().at("b_in_scale"));
@@ -65,15 +68,33 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   impl_ = meta_def->generic_param().at("impl");
 
+  if (impl_ != "v1") {
+    throw std::runtime_error(
+        "ERROR : # Implementaion is not available for this version");
+  }
+
+  if (ENV_PARAM(XLNX_GEMM_DYNAMIC_USE_CPU)) {
+    LOG_THIS(1) << "XLNX_GEMM_DYNAMIC_USE_CPU is set, use CPU kernel";
+  } else {
+    try {
+      init_npu(*context);
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "cannot initialize GEMM NPU kernel, fall back to CPU: "
+                   << e.what();
+      gemm_ = nullptr;
+    }
+  }
+}
+
+void MyCustomOp::init_npu(const PassContext& context) {
   // Backward compatibility.
   auto xclbin_file = ENV_PARAM(XLNX_VART_FIRMWARE);
-  auto cfg_sess_opts = context->get_config_proto().provider_options();
+  auto cfg_sess_opts = context.get_config_proto().provider_options();
   auto it = cfg_sess_opts.find("xclbin");
   if (it != cfg_sess_opts.end() && !it->second.empty()) {
     xclbin_file = it->second;
   }
 
-  std::string file = "dynamic_profile_log.csv";
   bool share_context = false;
   if (cfg_sess_opts.contains(vaip::Context::CTX_SHARE_OPTION_KEY)) {
     try {
@@ -92,21 +113,14 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   auto device_id = 0;
   auto context_id = 0;
-  context_ = vaip::Context::create_shared_context(*context, device_id,
+  context_ = vaip::Context::create_shared_context(context, device_id,
                                                   context_id, xclbin_file);
 
-  if (impl_ == "v1") {
-    const std::string& a_dtype = "int8";
-    const std::string& b_dtype = "int8";
-    const std::string& c_dtype = "int32";
-    gemm_ = std::make_shared<qlinear_2<int8_t, int8_t, int32_t>>(
-        a_dtype, b_dtype, c_dtype);
-    qlinear_2<int8_t, int8_t, int32_t>* ptr =
-        (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
-  } else {
-    throw std::runtime_error(
-        "ERROR : # Implementaion is not available for this version");
-  }
+  const std::string& a_dtype = "int8";
+  const std::string& b_dtype = "int8";
+  const std::string& c_dtype = "int32";
+  gemm_ = std::make_shared<qlinear_2<int8_t, int8_t, int32_t>>(
+      a_dtype, b_dtype, c_dtype);
 }
 
 MyCustomOp::~MyCustomOp() {}
@@ -135,22 +149,12 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   auto b_input_shape = b_input_tensor.GetTensorTypeAndShapeInfo().GetShape();
 
   auto num_outputs = ctx.GetOutputCount();
+  auto call = vaip_core::TraceSpan(trace_id_, vaip_core::runtime_trace::CALL);
 
   auto shape_0 = b_input_shape[2];
   auto shape_1 = b_input_shape[3];
 
   wts_shape_ = std::make_tuple((int)shape_0, (int)shape_1);
-#ifdef PROFILE_GEMM
-  std::chrono::time_point<std::chrono::high_resolution_clock>
-      _dynamic_scale_start, _dynamic_scale_end;
-  std::chrono::time_point<std::chrono::high_resolution_clock> _bias_add_start,
-      _bias_add_end;
-#endif
-  USE_TIMER_GEMM(_dynamic_scale_start =
-                     std::chrono::high_resolution_clock::now());
-
-  USE_TIMER_GEMM(_dynamic_scale_end =
-                     std::chrono::high_resolution_clock::now());
   std::vector<int64_t> out_shape;
   int batch;
   if (a_input_shape.size() == 4) {
@@ -188,62 +192,57 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
 
   auto out_base = output_tensor.GetTensorMutableData<float>();
 
-  size_t a_in_size = std::accumulate(a_input_shape.begin(), a_input_shape.end(),
-                                     1, std::multiplies<size_t>());
-
   size_t b_in_size = std::accumulate(b_input_shape.begin(), b_input_shape.end(),
                                      1, std::multiplies<size_t>());
 
-  size_t out_size = std::accumulate(out_shape.begin(), out_shape.end(), 1,
-                                    std::multiplies<size_t>());
-
-  std::vector<int8_t> a_input_data(a_in_size, 0);
-  std::vector<int8_t> b_input_data(b_in_size, 0);
-  std::vector<int32_t> out_tmp(out_size, 0);
-
-  for (size_t i = 0; i < a_in_size; i++) {
-    a_input_data[i] = (int8_t)(a_intensor_data[i] - a_input_zp_);
-  }
-
-  for (size_t i = 0; i < b_in_size; i++) {
-    b_input_data[i] = (int8_t)(b_intensor_data[i] - b_input_zp_);
-  }
-
-  auto _exec_start = std::chrono::high_resolution_clock::now();
-
-  qlinear_2<int8_t, int8_t, int32_t>* ptr =
-      (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
+  auto M = (int64_t)std::get<0>(a_input_s);
+  auto K = (int64_t)std::get<1>(a_input_s);
+  auto N = (int64_t)std::get<1>(wts_shape_);
+  auto scale = a_scale_ * b_scale_;
+
+  if (gemm_ == nullptr) {
+    VAIP_TRACE_SPAN(trace_id_, CPU_GEMM);
+    for (int bat_id = 0; bat_id < batch; bat_id++) {
+      auto packed = vaip_qgemm::PackedWeights(
+          b_intensor_data + (bat_id * b_2d_size), K, N, b_input_zp_);
+      vaip_qgemm::qgemm(a_intensor_data + (bat_id * a_2d_size), M, K, packed,
+                        a_input_zp_, scale, nullptr,
+                        out_base + (bat_id * c_2d_size), N);
+    }
+  } else {
+    std::lock_guard<std::mutex> lock(gemm_mutex_);
+    std::vector<int8_t> b_input_data(b_in_size, 0);
+    std::vector<int32_t> out_tmp(c_2d_size, 0);
 
-  for (int bat_id = 0; bat_id < batch; bat_id++) {
-    int32_t* out_ptr = out_tmp.data() + (bat_id * c_2d_size);
-    int8_t* a_ptr = a_input_data.data() + (bat_id * a_2d_size);
-    int8_t* b_ptr = b_input_data.data() + (bat_id * b_2d_size);
+    for (size_t i = 0; i < b_in_size; i++) {
+      b_input_data[i] = (int8_t)(b_intensor_data[i] - b_input_zp_);
+    }
 
-    // Fill B Matrix
-    ptr->initialize_weights(b_ptr, wts_shape_);
-    ptr->execute(a_ptr, a_input_s, out_ptr);
-  }
+    qlinear_2<int8_t, int8_t, int32_t>* ptr =
+        (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
 
-  for (int i = 0; i < out_size; i++) {
-    out_base[i] = (float)(out_tmp[i] * a_scale_ * b_scale_);
+    for (int bat_id = 0; bat_id < batch; bat_id++) {
+      auto a_ptr = const_cast<int8_t*>(a_intensor_data + (bat_id * a_2d_size));
+      int8_t* b_ptr = b_input_data.data() + (bat_id * b_2d_size);
+
+      // Fill B Matrix
+      {
+        VAIP_TRACE_SPAN(trace_id_, INIT_WEIGHTS);
+        ptr->initialize_weights(b_ptr, wts_shape_);
+      }
+      {
+        VAIP_TRACE_SPAN(trace_id_, EXECUTE);
+        ptr->execute(a_ptr, a_input_s, out_tmp.data());
+      }
+      // A is passed as is, its zero point is removed with the column
+      // sums of this batch of B.
+      VAIP_TRACE_SPAN(trace_id_, DEQUANT);
+      auto colsum = vaip_qgemm::column_sums(b_ptr, K, N);
+      vaip_qgemm::dequant_epilogue(out_tmp.data(), M, N, N, colsum.data(),
+                                   a_input_zp_, scale, nullptr,
+                                   out_base + (bat_id * c_2d_size), N);
+    }
   }
 
-  auto out = out_base;
-  auto _exec_stop = std::chrono::high_resolution_clock::now();
-  auto exec_total = (_exec_stop - _exec_start) / std::chrono::microseconds(1);
-
-#ifdef PROFILE_GEMM
-  std::stringstream _csv_out;
-  _csv_out << "input scale calculate, bias add"
-           << "\n";
-  _csv_out << (_dynamic_scale_end - _dynamic_scale_start) /
-                  std::chrono::microseconds(1)
-           << ",";
-  _csv_out << (_bias_add_end - _bias_add_start) / std::chrono::microseconds(1)
-           << ",";
-  std::ofstream csv_file_out("./gemmop.csv", std::ios::app | std::ios::out);
-
-  csv_file_out << _csv_out.str() << std::endl;
-#endif
 }
 } // namespace vaip_gemm_dynamic_custom_op
@@ -17,14 +17,6 @@
 
 #include "../../xrt_shared_context/xrt_shared_context.hpp"
 
-#include <chrono>
-// #define PROFILE_GEMM
-#ifdef PROFILE_GEMM
-#  define USE_TIMER_GEMM(timer) timer
-#else
-#  define USE_TIMER_GEMM(timer)
-#endif
-
 namespace vaip_gemm_dynamic_custom_op {
 using namespace vaip_core;
 class MyCustomOp : public CustomOpImp {
@@ -38,7 +30,10 @@ public:
 private:
   virtual void Compute(const OrtApi* api,
                        OrtKernelContext* context) const override final;
+  void init_npu(const PassContext& context);
   std::shared_ptr<void> gemm_;
+  // initialize_weights() and execute() of one batch must not interleave
+  mutable std::mutex gemm_mutex_;
   std::shared_ptr<vaip::Context> context_;
   std::unique_ptr<xrt::xclbin> _xclbin;
   float a_scale_;
@@ -53,6 +48,8 @@ private:
   int a_input_zp_;
   int b_input_zp_;
   std::string impl_;
+  // runtime_trace id of this op
+  uint32_t trace_id_ = 0;
 };
 
 } // namespace vaip_gemm_dynamic_custom_op
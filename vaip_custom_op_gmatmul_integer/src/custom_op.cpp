@@ -5,12 +5,15 @@
 #include "onnxruntime_api.hpp"
 
 #include "./custom_op.hpp"
+#include "vitis/ai/env_config.hpp"
 #include <filesystem>
 #include <fstream>
 #include <glog/logging.h>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #pragma once
+#include "qgemm/qgemm.hpp"
 #include "qlinear_2/qlinear_2.hpp"
 #if defined(_WIN32)
 #  pragma warning(disable : 4996)
@@ -21,6 +24,11 @@ using namespace ryzenai;
 
 #define OUT_TYPE int32_t
 
+DEF_ENV_PARAM(DEBUG_GMATMUL_INTEGER_CUSTOM_OP, "0")
+DEF_ENV_PARAM(XLNX_GMATMUL_INTEGER_USE_CPU, "0")
+#define LOG_THIS(n)                                                            \
+  LOG_IF(INFO, ENV_PARAM(DEBUG_GMATMUL_INTEGER_CUSTOM_OP) >= n)
+
 namespace vaip_gmatmul_integer_custom_op {
 MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
                        const std::shared_ptr<MetaDefProto>& meta_def,
@@ -44,35 +52,54 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   wts_shape_ = std::make_tuple(shape_0, shape_1);
 
-  unsigned int size = (unsigned int)fs::file_size(inputbin_wts);
-  int8_t* wts = (int8_t*)malloc(size);
-
-  auto infile = std::ifstream(inputbin_wts, std::ios::in | std::ios::binary);
-  for (unsigned i = 0; infile.read(&((char*)wts)[i], sizeof(int8_t)); i++)
-    ;
-
-  if (impl_ == "v1") {
-    const std::string& a_dtype = "int8";
-    const std::string& b_dtype = "int8";
-    const std::string& c_dtype = "int32";
-    gemm_ = std::make_shared<qlinear_2<int8_t, int8_t, OUT_TYPE>>(
-        a_dtype, b_dtype, c_dtype);
-    qlinear_2<int8_t, int8_t, OUT_TYPE>* ptr =
-        (qlinear_2<int8_t, int8_t, OUT_TYPE>*)gemm_.get();
-    ptr->initialize_weights(wts, wts_shape_);
-  } else {
+  if (impl_ != "v1") {
     throw std::runtime_error(
         "ERROR : # Implementaion is not available for this device");
   }
 
-  wts_sum_.reserve(std::get<1>(wts_shape_));
-  for (int i = 0; i < std::get<1>(wts_shape_); i++) {
-    wts_sum_[i] = 0;
-    for (int j = 0; j < std::get<0>(wts_shape_); j++) {
-      wts_sum_[i] += wts[j * std::get<1>(wts_shape_) + i];
+  auto size = (size_t)fs::file_size(inputbin_wts);
+  CHECK_GE(size, (size_t)shape_0 * shape_1)
+      << "weights file " << inputbin_wts << " is too small";
+  std::vector<int8_t> wts(size);
+  auto infile = std::ifstream(inputbin_wts, std::ios::in | std::ios::binary);
+  infile.read((char*)wts.data(), size);
+
+  if (ENV_PARAM(XLNX_GMATMUL_INTEGER_USE_CPU)) {
+    LOG_THIS(1) << "XLNX_GMATMUL_INTEGER_USE_CPU is set, use CPU kernel";
+  } else {
+    try {
+      const std::string& a_dtype = "int8";
+      const std::string& b_dtype = "int8";
+      const std::string& c_dtype = "int32";
+      gemm_ = std::make_shared<qlinear_2<int8_t, int8_t, OUT_TYPE>>(
+          a_dtype, b_dtype, c_dtype);
+      qlinear_2<int8_t, int8_t, OUT_TYPE>* ptr =
+          (qlinear_2<int8_t, int8_t, OUT_TYPE>*)gemm_.get();
+      ptr->initialize_weights(wts.data(), wts_shape_);
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "cannot initialize MatMulInteger NPU kernel, fall back "
+                      "to CPU: "
+                   << e.what();
+      gemm_ = nullptr;
     }
   }
-  free(wts);
+  if (gemm_ == nullptr) {
+    // one packed matrix per output so that each is written in place
+    std::vector<int8_t> split_wts;
+    int offset = 0;
+    for (auto split : wts_shape_dim_split_) {
+      split_wts.resize((size_t)shape_0 * split);
+      for (int k = 0; k < shape_0; k++) {
+        std::memcpy(split_wts.data() + (size_t)k * split,
+                    wts.data() + (size_t)k * shape_1 + offset, split);
+      }
+      packed_wts_.emplace_back(std::make_unique<vaip_qgemm::PackedWeights>(
+          split_wts.data(), shape_0, split));
+      offset += split;
+    }
+  } else {
+    wts_sum_ = vaip_qgemm::column_sums(wts.data(), shape_0, shape_1);
+  }
 }
 
 MyCustomOp::~MyCustomOp() {}
@@ -109,52 +136,67 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   size_t in_size = std::get<0>(input_s) * std::get<1>(input_s);
   size_t out_size = std::get<0>(input_s) * std::get<1>(wts_shape_);
 
-  USE_TIMER_GMATMULINTEGER(preproc_start =
-                               std::chrono::high_resolution_clock::now());
-  std::vector<int8_t> input_data1(in_size, 0);
-  std::vector<OUT_TYPE> out_tmp(out_size, 0);
-
-  for (size_t i = 0; i < in_size; i++) {
-    input_data1[i] = (int8_t)(input_data[i] - 128);
-  }
-  USE_TIMER_GMATMULINTEGER(preproc_end =
-                               std::chrono::high_resolution_clock::now());
-
-  USE_TIMER_GMATMULINTEGER(kernel_start =
-                               std::chrono::high_resolution_clock::now());
-
-  qlinear_2<int8_t, int8_t, OUT_TYPE>* ptr =
-      (qlinear_2<int8_t, int8_t, OUT_TYPE>*)gemm_.get();
-  ptr->execute(input_data1.data(), input_s, out_tmp.data());
-
-  USE_TIMER_GMATMULINTEGER(kernel_end =
-                               std::chrono::high_resolution_clock::now());
-  USE_TIMER_GMATMULINTEGER(scale_start =
-                               std::chrono::high_resolution_clock::now());
-
   std::vector<int64_t> out_shape;
   for (unsigned i = 0; i < (input_shape.size() - 1); i++)
     out_shape.push_back(input_shape[i]);
 
-  int offset = 0;
-  for (int l = 0; l < wts_shape_dim_split_.size(); l++) {
-    // Reference:
-    // https://leimao.github.io/article/Neural-Networks-Quantization/#Quantized%20Matrix%20Multiplication:~:text=Quantized%20Matrix%20Multiplication-,Quantized%20Matrix%20Multiplication%20Mathematics,-Suppose%20we%20have
-    // Assuming that the zero point of weight is zero
-    int wts_shape_1 = wts_shape_dim_split_[l];
-    out_shape.push_back(wts_shape_1);
-    auto output_tensor = ctx.GetOutput(l, {out_shape.begin(), out_shape.end()});
-    auto out_base = output_tensor.GetTensorMutableData<int32_t>();
-
-    for (int i = 0; i < std::get<0>(input_s); i++) {
-      for (int j = 0; j < wts_shape_1; j++) {
-        int32_t temp = out_tmp[i * std::get<1>(wts_shape_) + j + offset];
-        out_base[i * wts_shape_1 + j] =
-            (temp - ((input_zero_point[0] - 128) * (wts_sum_[j + offset])));
-      }
+  auto M = (int64_t)std::get<0>(input_s);
+  auto K = (int64_t)std::get<1>(input_s);
+  auto N = (int64_t)std::get<1>(wts_shape_);
+
+  if (!packed_wts_.empty()) {
+    USE_TIMER_GMATMULINTEGER(kernel_start =
+                                 std::chrono::high_resolution_clock::now());
+    for (int l = 0; l < wts_shape_dim_split_.size(); l++) {
+      int wts_shape_1 = wts_shape_dim_split_[l];
+      out_shape.push_back(wts_shape_1);
+      auto output_tensor =
+          ctx.GetOutput(l, {out_shape.begin(), out_shape.end()});
+      auto out_base = output_tensor.GetTensorMutableData<int32_t>();
+      vaip_qgemm::qgemm(input_data, M, K, *packed_wts_[l],
+                        (int32_t)input_zero_point[0], out_base, wts_shape_1);
+      out_shape.pop_back();
+    }
+    USE_TIMER_GMATMULINTEGER(kernel_end =
+                                 std::chrono::high_resolution_clock::now());
+  } else {
+    std::lock_guard<std::mutex> lock(tmp_mutex_);
+    USE_TIMER_GMATMULINTEGER(preproc_start =
+                                 std::chrono::high_resolution_clock::now());
+    in_s8_.resize(in_size);
+    out_tmp_.resize(out_size);
+    vaip_qgemm::to_s8(input_data, in_size, in_s8_.data());
+    USE_TIMER_GMATMULINTEGER(preproc_end =
+                                 std::chrono::high_resolution_clock::now());
+
+    USE_TIMER_GMATMULINTEGER(kernel_start =
+                                 std::chrono::high_resolution_clock::now());
+
+    qlinear_2<int8_t, int8_t, OUT_TYPE>* ptr =
+        (qlinear_2<int8_t, int8_t, OUT_TYPE>*)gemm_.get();
+    ptr->execute(in_s8_.data(), input_s, out_tmp_.data());
+
+    USE_TIMER_GMATMULINTEGER(kernel_end =
+                                 std::chrono::high_resolution_clock::now());
+    USE_TIMER_GMATMULINTEGER(scale_start =
+                                 std::chrono::high_resolution_clock::now());
+
+    // The NPU kernel takes signed activations, (x - 128), so the zero
+    // point left to remove is (zp - 128).
+    auto npu_zp = (int32_t)input_zero_point[0] - 128;
+    int offset = 0;
+    for (int l = 0; l < wts_shape_dim_split_.size(); l++) {
+      int wts_shape_1 = wts_shape_dim_split_[l];
+      out_shape.push_back(wts_shape_1);
+      auto output_tensor =
+          ctx.GetOutput(l, {out_shape.begin(), out_shape.end()});
+      auto out_base = output_tensor.GetTensorMutableData<int32_t>();
+      vaip_qgemm::zp_epilogue(out_tmp_.data() + offset, M, wts_shape_1, N,
+                              wts_sum_.data() + offset, npu_zp, out_base,
+                              wts_shape_1);
+      out_shape.pop_back();
+      offset += wts_shape_1;
     }
-    out_shape.pop_back();
-    offset += wts_shape_1;
   }
   USE_TIMER_GMATMULINTEGER(scale_end =
                                std::chrono::high_resolution_clock::now());
@@ -22,6 +22,10 @@
 #  define USE_TIMER_GMATMULINTEGER(timer)
 #endif
 
+namespace vaip_qgemm {
+class PackedWeights;
+} // namespace vaip_qgemm
+
 namespace vaip_gmatmul_integer_custom_op {
 using namespace vaip_core;
 class MyCustomOp : public CustomOpImp {
@@ -40,7 +44,13 @@ private:
   std::tuple<int, int> wts_shape_;
   std::vector<int32_t> wts_sum_;
   std::vector<int32_t> wts_shape_dim_split_;
+  // host GEMM per output when the NPU kernel is not available
+  std::vector<std::unique_ptr<vaip_qgemm::PackedWeights>> packed_wts_;
   std::string device_;
+  // NPU input and output, kept between calls
+  mutable std::mutex tmp_mutex_;
+  mutable std::vector<int8_t> in_s8_;
+  mutable std::vector<int32_t> out_tmp_;
 };
 
 } // namespace vaip_gmatmul_integer_custom_op
@@ -5,12 +5,14 @@
 #include "onnxruntime_api.hpp"
 
 #include "./custom_op.hpp"
+#include "vitis/ai/env_config.hpp"
 #include <filesystem>
 #include <fstream>
 #include <glog/logging.h>
 #include <iostream>
 #include <sstream>
 #pragma once
+#include "qgemm/qgemm.hpp"
 #include "qlinear_2/qlinear_2.hpp"
 #if defined(_WIN32)
 #  pragma warning(disable : 4996)
@@ -21,6 +23,10 @@ using namespace ryzenai;
 
 #define OUT_TYPE int32_t
 
+DEF_ENV_PARAM(DEBUG_MATMUL_INTEGER_CUSTOM_OP, "0")
+DEF_ENV_PARAM(XLNX_MATMUL_INTEGER_USE_CPU, "0")
+#define LOG_THIS(n) LOG_IF(INFO, ENV_PARAM(DEBUG_MATMUL_INTEGER_CUSTOM_OP) >= n)
+
 namespace vaip_matmul_integer_custom_op {
 MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
                        const std::shared_ptr<MetaDefProto>& meta_def,
@@ -35,48 +41,58 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   wts_shape_ = std::make_tuple(shape_0, shape_1);
 
-  unsigned int size = (unsigned int)fs::file_size(inputbin_wts);
-  int8_t* wts = (int8_t*)malloc(size);
+  if (impl_ != "v1") {
+    throw std::runtime_error(
+        "ERROR : # Implementaion is not available for this version");
+  }
 
+  auto size = (size_t)fs::file_size(inputbin_wts);
+  CHECK_GE(size, (size_t)shape_0 * shape_1)
+      << "weights file " << inputbin_wts << " is too small";
+  std::vector<int8_t> wts(size);
   auto infile = std::ifstream(inputbin_wts, std::ios::in | std::ios::binary);
-  for (unsigned i = 0; infile.read(&((char*)wts)[i], sizeof(int8_t)); i++)
-    ;
-
-  if (impl_ == "v1") {
-    if (quant_mode_ == "w8a8") {
-
-      const std::string& a_dtype = "int8";
-      const std::string& b_dtype = "int8";
-      const std::string& c_dtype = "int32";
-      gemm_ = std::make_shared<qlinear_2<int8_t, int8_t, int32_t>>(
-          a_dtype, b_dtype, c_dtype);
-      qlinear_2<int8_t, int8_t, int32_t>* ptr =
-          (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
-      ptr->initialize_weights(wts, wts_shape_);
-
-    } else {
-      const std::string& a_dtype = "int16";
-      const std::string& b_dtype = "int8";
-      const std::string& c_dtype = "int64";
-      gemm_ = std::make_shared<qlinear_2<int16_t, int8_t, int64_t>>(
-          a_dtype, b_dtype, c_dtype);
-      qlinear_2<int16_t, int8_t, int64_t>* ptr =
-          (qlinear_2<int16_t, int8_t, int64_t>*)gemm_.get();
-      ptr->initialize_weights(wts, wts_shape_);
+  infile.read((char*)wts.data(), size);
+
+  if (ENV_PARAM(XLNX_MATMUL_INTEGER_USE_CPU)) {
+    LOG_THIS(1) << "XLNX_MATMUL_INTEGER_USE_CPU is set, use CPU kernel";
+  } else {
+    try {
+      init_npu(wts.data());
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "cannot initialize MatMulInteger NPU kernel, fall back "
+                      "to CPU: "
+                   << e.what();
+      gemm_ = nullptr;
     }
+  }
+  if (gemm_ == nullptr) {
+    packed_wts_ = std::make_unique<vaip_qgemm::PackedWeights>(
+        wts.data(), shape_0, shape_1);
   } else {
-    throw std::runtime_error(
-        "ERROR : # Implementaion is not available for this version");
+    wts_sum_ = vaip_qgemm::column_sums(wts.data(), shape_0, shape_1);
   }
+}
 
-  wts_sum_.reserve(std::get<1>(wts_shape_));
-  for (int i = 0; i < std::get<1>(wts_shape_); i++) {
-    wts_sum_[i] = 0;
-    for (int j = 0; j < std::get<0>(wts_shape_); j++) {
-      wts_sum_[i] += wts[j * std::get<1>(wts_shape_) + i];
-    }
+void MyCustomOp::init_npu(int8_t* wts) {
+  if (quant_mode_ == "w8a8") {
+    const std::string& a_dtype = "int8";
+    const std::string& b_dtype = "int8";
+    const std::string& c_dtype = "int32";
+    gemm_ = std::make_shared<qlinear_2<int8_t, int8_t, int32_t>>(
+        a_dtype, b_dtype, c_dtype);
+    qlinear_2<int8_t, int8_t, int32_t>* ptr =
+        (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
+    ptr->initialize_weights(wts, wts_shape_);
+  } else {
+    const std::string& a_dtype = "int16";
+    const std::string& b_dtype = "int8";
+    const std::string& c_dtype = "int64";
+    gemm_ = std::make_shared<qlinear_2<int16_t, int8_t, int64_t>>(
+        a_dtype, b_dtype, c_dtype);
+    qlinear_2<int16_t, int8_t, int64_t>* ptr =
+        (qlinear_2<int16_t, int8_t, int64_t>*)gemm_.get();
+    ptr->initialize_weights(wts, wts_shape_);
   }
-  free(wts);
 }
 
 MyCustomOp::~MyCustomOp() {}
@@ -121,15 +137,24 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   size_t in_size = std::get<0>(input_s) * std::get<1>(input_s);
   size_t out_size = std::get<0>(input_s) * std::get<1>(wts_shape_);
 
-  if (quant_mode_ == "w8a8") {
+  auto M = (int64_t)std::get<0>(input_s);
+  auto N = (int64_t)std::get<1>(wts_shape_);
+  auto a_zp = (int32_t)input_zero_point[0];
+
+  if (packed_wts_ != nullptr) {
+    USE_TIMER_MATMULINTEGER(kernel_start =
+                                std::chrono::high_resolution_clock::now());
+    vaip_qgemm::qgemm(input_data, M, std::get<1>(input_s), *packed_wts_, a_zp,
+                      out_base, N);
+    USE_TIMER_MATMULINTEGER(kernel_end =
+                                std::chrono::high_resolution_clock::now());
+  } else if (quant_mode_ == "w8a8") {
+    std::lock_guard<std::mutex> lock(tmp_mutex_);
     USE_TIMER_MATMULINTEGER(preproc_start =
                                 std::chrono::high_resolution_clock::now());
-    std::vector<int8_t> input_data1(in_size, 0);
-    std::vector<int32_t> out_tmp(out_size, 0);
-
-    for (size_t i = 0; i < in_size; i++) {
-      input_data1[i] = (int8_t)(input_data[i] - 128);
-    }
+    in_s8_.resize(in_size);
+    out_s32_.resize(out_size);
+    vaip_qgemm::to_s8(input_data, in_size, in_s8_.data());
     USE_TIMER_MATMULINTEGER(preproc_end =
                                 std::chrono::high_resolution_clock::now());
 
@@ -138,7 +163,7 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
 
     qlinear_2<int8_t, int8_t, int32_t>* ptr =
         (qlinear_2<int8_t, int8_t, int32_t>*)gemm_.get();
-    ptr->execute(input_data1.data(), input_s, out_tmp.data());
+    ptr->execute(in_s8_.data(), input_s, out_s32_.data());
 
     USE_TIMER_MATMULINTEGER(kernel_end =
                                 std::chrono::high_resolution_clock::now());
@@ -147,22 +172,15 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
     // Reference:
     // https://leimao.github.io/article/Neural-Networks-Quantization/#Quantized%20Matrix%20Multiplication:~:text=Quantized%20Matrix%20Multiplication-,Quantized%20Matrix%20Multiplication%20Mathematics,-Suppose%20we%20have
     // Assuming that the zero point of weight is zero
-    for (int i = 0; i < std::get<0>(input_s); i++) {
-      for (int j = 0; j < std::get<1>(wts_shape_); j++) {
-        int32_t temp = out_tmp[i * std::get<1>(wts_shape_) + j];
-        out_base[i * std::get<1>(wts_shape_) + j] =
-            (temp - ((input_zero_point[0] - 128) * (wts_sum_[j])));
-      }
-    }
+    vaip_qgemm::zp_epilogue(out_s32_.data(), M, N, N, wts_sum_.data(),
+                            a_zp - 128, out_base, N);
   } else {
-
+    std::lock_guard<std::mutex> lock(tmp_mutex_);
     USE_TIMER_MATMULINTEGER(preproc_start =
                                 std::chrono::high_resolution_clock::now());
-    std::vector<int16_t> input_data1(in_size, 0);
-    std::vector<int64_t> out_tmp(out_size, 0);
-    for (size_t i = 0; i < in_size; i++) {
-      input_data1[i] = (int16_t)(input_data[i] - 128);
-    }
+    in_s16_.resize(in_size);
+    out_s64_.resize(out_size);
+    vaip_qgemm::to_s16(input_data, in_size, in_s16_.data());
     USE_TIMER_MATMULINTEGER(preproc_end =
                                 std::chrono::high_resolution_clock::now());
 
@@ -171,19 +189,14 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
 
     qlinear_2<int16_t, int8_t, int64_t>* ptr =
         (qlinear_2<int16_t, int8_t, int64_t>*)gemm_.get();
-    ptr->execute(input_data1.data(), input_s, out_tmp.data());
+    ptr->execute(in_s16_.data(), input_s, out_s64_.data());
 
     USE_TIMER_MATMULINTEGER(kernel_end =
                                 std::chrono::high_resolution_clock::now());
     USE_TIMER_MATMULINTEGER(scale_start =
                                 std::chrono::high_resolution_clock::now());
-    for (int i = 0; i < std::get<0>(input_s); i++) {
-      for (int j = 0; j < std::get<1>(wts_shape_); j++) {
-        int64_t temp = out_tmp[i * std::get<1>(wts_shape_) + j];
-        out_base[i * std::get<1>(wts_shape_) + j] =
-            (temp - ((input_zero_point[0] - 128) * (wts_sum_[j])));
-      }
-    }
+    vaip_qgemm::zp_epilogue(out_s64_.data(), M, N, N, wts_sum_.data(), a_zp,
+                            out_base, N);
   }
   USE_TIMER_MATMULINTEGER(scale_end =
                               std::chrono::high_resolution_clock::now());
@@ -24,6 +24,10 @@
 #  define USE_TIMER_MATMULINTEGER(timer)
 #endif
 
+namespace vaip_qgemm {
+class PackedWeights;
+} // namespace vaip_qgemm
+
 namespace vaip_matmul_integer_custom_op {
 using namespace vaip_core;
 class MyCustomOp : public CustomOpImp {
@@ -37,11 +41,20 @@ public:
 private:
   virtual void Compute(const OrtApi* api,
                        OrtKernelContext* context) const override final;
+  void init_npu(int8_t* wts);
   std::shared_ptr<void> gemm_;
+  // host GEMM when the NPU kernel is not available
+  std::unique_ptr<vaip_qgemm::PackedWeights> packed_wts_;
   std::tuple<int, int> wts_shape_;
   std::vector<int32_t> wts_sum_;
   std::string impl_;
   std::string quant_mode_;
+  // NPU inputs and outputs, kept between calls
+  mutable std::mutex tmp_mutex_;
+  mutable std::vector<int8_t> in_s8_;
+  mutable std::vector<int32_t> out_s32_;
+  mutable std::vector<int16_t> in_s16_;
+  mutable std::vector<int64_t> out_s64_;
 };
 
 } // namespace vaip_matmul_integer_custom_op
@@ -20,6 +20,8 @@
 #include <immintrin.h>
 
 #include "./custom_op.hpp"
+#include "mapped_file/mapped_file.hpp"
+#include "packed_weights/packed_weights.hpp"
 #include "vitis/ai/env_config.hpp"
 #include <algorithm>
 #include <cmath>
@@ -64,6 +66,14 @@ static void writeToFile(std::string filename, const T* data, size_t size) {
 }
 std::shared_ptr<void> MyCustomOp::gemm__ = nullptr;
 
+static std::shared_ptr<const vaip_common::MappedFile>
+map_const_file(const std::string& fname, size_t min_size) {
+  auto ret = vaip_common::MappedFile::open(fname);
+  CHECK(ret != nullptr) << "cannot open " << fname;
+  CHECK_GE(ret->size(), min_size) << fname;
+  return ret;
+}
+
 MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
                        const std::shared_ptr<MetaDefProto>& meta_def,
                        onnxruntime::Model* model)
@@ -86,36 +96,21 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
     inputbin_zp = meta_def->generic_param().at("zp_file");
   }
 
-  // Get weights
-  unsigned int size_wts = (unsigned int)fs::file_size(inputbin_wts);
-  std::vector<int8_t> wts;
-  wts.reserve(size_wts);
-  auto iwts = std::ifstream(inputbin_wts, std::ios::in | std::ios::binary);
-  iwts.read((char*)wts.data(), size_wts);
-
-  // Get Scales
-  unsigned int size_scl = (unsigned int)fs::file_size(inputbin_scl);
-  std::vector<float> scl;
-  scl.reserve(size_scl / sizeof(float));
-  auto iscl = std::ifstream(inputbin_scl, std::ios::in | std::ios::binary);
-  iscl.read((char*)scl.data(), size_scl);
-
-  // Get Zero Point
-  size_t kblks = k_k / k_block_size;
-  int64_t zp_shape = (k_n * std::floor((float)((kblks + 1) * k_bits) / 8.0f));
-
-  std::vector<int8_t> zero_pt;
+  // Get weights / scales / zero points
+  auto src = vaip_packed_weights::MatMulNBitsSource();
+  src.k = k_k;
+  src.n = k_n;
+  src.bits = k_bits;
+  src.block_size = k_block_size;
+  auto wts = map_const_file(inputbin_wts, src.k * src.n / 2);
+  auto scl = map_const_file(inputbin_scl, src.blocks() * src.n * sizeof(float));
+  auto zero_pt = std::shared_ptr<const vaip_common::MappedFile>();
   if (k_asymmetric) {
-    unsigned int size_zp = (unsigned int)fs::file_size(inputbin_zp);
-    zero_pt.reserve(size_zp);
-    auto izp = std::ifstream(inputbin_zp, std::ios::in | std::ios::binary);
-    izp.read((char*)(zero_pt.data()), size_zp);
-  } else {
-    // zero_pt.reserve(k_k * k_n / k_block_size);
-    // memset(zero_pt.data(), 0, k_k * k_n / k_block_size);
-    zero_pt.reserve(zp_shape * 2);
-    memset(zero_pt.data(), 0, zp_shape * 2);
+    zero_pt = map_const_file(inputbin_zp, src.zero_point_bytes());
   }
+  src.weights = wts->data();
+  src.scales = reinterpret_cast<const float*>(scl->data());
+  src.zero_points = zero_pt ? zero_pt->data() : nullptr;
 
   // Get Bias
   std::string bias_bin;
@@ -128,53 +123,16 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   // Ryzen-AI implementation
 
-  // Re-arrage / expand weights / scales
-  std::vector<int8_t> const_wts(k_k * k_n, 0);
-  std::vector<float> const_scl(k_k * k_n / k_block_size);
-  // fill this with zeros for Symmetric quantization
-  // std::vector<int8_t> const_zps(k_k * k_n / k_block_size, 0);
-  std::vector<int8_t> const_zps(zp_shape * 2, 0);
-
-  // Original weights are in NxK/2 packed as uint8
-  // Convert to KXN uint8
-  for (int64_t i = 0; i < k_k; i += 2) {
-    for (int64_t j = 0; j < k_n; j++) {
-      auto srcv = wts[j * k_k / 2 + i / 2];
-      auto src0 = (srcv & 0xf) - 8;
-      auto src1 = ((srcv & 0xf0) >> 4) - 8;
-      const_wts[i * k_n + j] = static_cast<int8_t>(src0);
-      const_wts[(i + 1) * k_n + j] = static_cast<int8_t>(src1);
-    }
-  }
-
-  // Original Scales are in Nx(K/BlockSize) shape
-  // Convert to (K/BLOCK_SIZE)xN shape
-  for (int i = 0; i < k_n; i++) {
-    for (int j = 0; j < kblks; j++) {
-      const_scl[j * k_n + i] = scl[i * kblks + j];
-    }
-  }
-
-  // fill this with zeros for Symmetric quantization
-  // Each row of zero points was padded to have an even length "kblks_pad"
-  if (k_asymmetric) {
-    int kblks_pad = 2 * zp_shape / k_n;
-    for (int i = 0; i < k_n; i++) {
-      for (int j = 0; j < kblks_pad; j = j + 2) {
-        int8_t zpv;
-        // zpv = zero_pt[(i * (kblks / 2)) + (j / 2)];
-        zpv = zero_pt[(i * kblks_pad) / 2 + j / 2];
-        const_zps[j * k_n + i] = (zpv & 0xf) - 8;
-        const_zps[(j + 1) * k_n + i] = ((zpv & 0xf0) >> 4) - 8;
-      }
-    }
-  }
+  // Re-arrage / expand weights / scales / zero points, or map the result
+  // of an earlier session.
+  auto packed = vaip_packed_weights::get_matmul_nbits(
+      src, const_cast<PassContext&>(*context));
 
   // Update N / Group size
   n_sizes_.push_back({k_k, k_n});
   grp_sizes_.push_back(k_block_size);
 
-  init_op_mladf_dd(const_wts, const_zps, const_scl, bias);
+  init_op_mladf_dd(*packed, bias);
 
 #ifdef _WIN32
   // Input size for token phase
@@ -22,6 +22,10 @@
 #  define USE_TIMER_MATMULNBITS(timer)
 #endif
 
+namespace vaip_packed_weights {
+struct MatMulNBits;
+}
+
 uint16_t float_to_bfloat16(float value);
 
 void float_to_bfloat16_avx512_unrolled(const float* v, uint16_t* out,
@@ -45,8 +49,8 @@ public:
 private:
   virtual void Compute(const OrtApi* api,
                        OrtKernelContext* context) const override final;
-  void init_op_mladf_dd(std::vector<int8_t> b, std::vector<int8_t> zeros,
-                        std::vector<float> scales, std::vector<float> bias);
+  void init_op_mladf_dd(const vaip_packed_weights::MatMulNBits& packed,
+                        std::vector<float> bias);
   void execute_mladf_dd(const uint16_t* input_data, uint16_t* out,
                         std::vector<int64_t> input_shape,
                         std::vector<int> wts_shape, int grp_size,
@@ -18,6 +18,7 @@
 #include <immintrin.h>
 
 #include "./custom_op.hpp"
+#include "packed_weights/packed_weights.hpp"
 #include "reporter.hpp"
 #include "vitis/ai/env_config.hpp"
 #include "vitis/ai/profiling.hpp"
@@ -52,10 +53,8 @@ namespace fs = std::filesystem;
 
 namespace vaip_matmul_nbits_custom_op {
 
-void MyCustomOp::init_op_mladf_dd(std::vector<int8_t> b,
-                                  std::vector<int8_t> zeros,
-                                  std::vector<float> scales,
-                                  std::vector<float> bias) {
+void MyCustomOp::init_op_mladf_dd(
+    const vaip_packed_weights::MatMulNBits& packed, std::vector<float> bias) {
 
   // Create mladfmatmulbias operator handle
   std::string mladf_version_(MLADF_VERSION);
@@ -74,10 +73,11 @@ void MyCustomOp::init_op_mladf_dd(std::vector<int8_t> b,
   std::vector<size_t> b_shape_dd = {static_cast<size_t>(k_k),
                                     static_cast<size_t>(k_n)};
   // Constant tensors
-  Tensor weight_tensor = {b.data(), b_shape_dd, "int4"};
+  Tensor weight_tensor = {packed.weights_data(), b_shape_dd, "int4"};
   Tensor bias_tensor = {bias.data(), {(size_t)k_block_size, 0}, "float"};
-  Tensor scales_tensor = {scales.data(), {(size_t)k_block_size, 0}, "float"};
-  Tensor zeros_tensor = {zeros.data(), b_shape_dd, "int4"};
+  Tensor scales_tensor = {
+      packed.scales_data(), {(size_t)k_block_size, 0}, "float"};
+  Tensor zeros_tensor = {packed.zeros_data(), b_shape_dd, "int4"};
   std::vector<Tensor> constant_tensors = {weight_tensor, bias_tensor,
                                           scales_tensor, zeros_tensor};
   // Initialize constant tensors (setting up XRT BOs)
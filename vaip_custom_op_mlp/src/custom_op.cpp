@@ -18,6 +18,8 @@
 //
 #include "./custom_op.hpp"
 #include "./reporter.hpp"
+#include "mapped_file/mapped_file.hpp"
+#include "packed_weights/packed_weights.hpp"
 #include "vitis/ai/profiling.hpp"
 
 DEF_ENV_PARAM(DRY_RUN, "0")
@@ -255,21 +257,36 @@ static void writeToFile(std::string filename, const T* data, size_t size) {
   file.close();
 }
 
-template <typename dtype>
-std::vector<dtype> MyCustomOp::loadbin(std::string& fname) const {
-  std::ifstream ifs(fname, std::ifstream::binary);
-  std::vector<dtype> bindata;
-  if (ifs) {
-    ifs.seekg(0, ifs.end);
-    auto size = ifs.tellg();
-    ifs.seekg(0, ifs.beg);
-    // Create space
-    bindata.reserve(size / sizeof(dtype));
-    // Read to buffer
-    ifs.read((char*)(bindata.data()), size);
-    return bindata;
+static std::shared_ptr<const vaip_common::MappedFile>
+map_const_file(const std::string& fname, size_t min_size) {
+  auto ret = vaip_common::MappedFile::open(fname);
+  CHECK(ret != nullptr) << "cannot open " << fname;
+  CHECK_GE(ret->size(), min_size) << fname;
+  return ret;
+}
+
+// The constants of one projection, read from the files written by the pass
+// and packed for mladfmatmulbias.
+static std::shared_ptr<const vaip_packed_weights::MatMulNBits>
+get_packed_weights(const PassContext& context, const std::string& wts_file,
+                   const std::string& scl_file, const std::string& zps_file,
+                   int64_t k, int64_t n, int64_t bits, int64_t block_size) {
+  auto src = vaip_packed_weights::MatMulNBitsSource();
+  src.k = k;
+  src.n = n;
+  src.bits = bits;
+  src.block_size = block_size;
+  auto wts = map_const_file(wts_file, k * n / 2);
+  auto scl = map_const_file(scl_file, src.blocks() * n * sizeof(float));
+  auto zps = std::shared_ptr<const vaip_common::MappedFile>();
+  if (!zps_file.empty()) {
+    zps = map_const_file(zps_file, src.zero_point_bytes());
   }
-  return bindata;
+  src.weights = wts->data();
+  src.scales = reinterpret_cast<const float*>(scl->data());
+  src.zero_points = zps ? zps->data() : nullptr;
+  return vaip_packed_weights::get_matmul_nbits(
+      src, const_cast<PassContext&>(context));
 }
 
 MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
@@ -312,12 +329,6 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
   if (meta_def->generic_param().contains("gp_zps_file")) {
     gp_zps_f = meta_def->generic_param().at("gp_zps_file");
   }
-  // Get weights / scales / zps
-  auto gp_wts = loadbin<int8_t>(gp_wts_f);
-  auto gp_scl = loadbin<float>(gp_scl_f);
-  std::vector<int8_t> gp_zps;
-  if (!gp_zps_f.empty())
-    gp_zps = loadbin<int8_t>(gp_zps_f);
 
   // Up proj
   std::string up_wts_f = meta_def->generic_param().at("up_wts_file");
@@ -326,12 +337,6 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
   if (meta_def->generic_param().contains("up_zps_file")) {
     up_zps_f = meta_def->generic_param().at("up_zps_file");
   }
-  // Get weights / scales / zps
-  auto up_wts = loadbin<int8_t>(up_wts_f);
-  auto up_scl = loadbin<float>(up_scl_f);
-  std::vector<int8_t> up_zps;
-  if (!up_zps_f.empty())
-    up_zps = loadbin<int8_t>(up_zps_f);
 
   // Down proj
   std::string dp_wts_f = meta_def->generic_param().at("dp_wts_file");
@@ -340,150 +345,24 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
   if (meta_def->generic_param().contains("dp_zps_file")) {
     dp_zps_f = meta_def->generic_param().at("dp_zps_file");
   }
-  // Get weights / scales / zps
-  auto dp_wts = loadbin<int8_t>(dp_wts_f);
-  auto dp_scl = loadbin<float>(dp_scl_f);
-  std::vector<int8_t> dp_zps;
-  if (!dp_zps_f.empty())
-    dp_zps = loadbin<int8_t>(dp_zps_f);
 
   dry_run_ = 0;
   if (ENV_PARAM(DRY_RUN) == 1)
     dry_run_ = 1;
   /////////////////////////// Gate /////////////////////////////////
-  size_t gp_kblks = gp_k / gp_block_size;
-  int64_t gzp_shape =
-      (gp_n * std::floor((float)((gp_kblks + 1) * gp_bits) / 8.0f));
-
   std::vector<float> gp_bias(gp_n, 0); // fill with zeros
-  std::vector<float> gp_scales(gp_k * gp_n / gp_block_size);
-  std::vector<int8_t> gp_weights(gp_k * gp_n, 0);
-  // fill this with zeros for Symmetric quantization
-  // std::vector<int8_t> gp_zpoints(gp_k * gp_n / gp_block_size, 0);
-  std::vector<int8_t> gp_zpoints(gzp_shape * 2, 0);
-
-  // Original weights are in NxK/2 packed as uint8
-  // Convert to KXN uint8
-  for (int64_t i = 0; i < gp_k; i += 2) {
-    for (int64_t j = 0; j < gp_n; j++) {
-      auto srcv = gp_wts[j * gp_k / 2 + i / 2];
-      auto src0 = (srcv & 0xf) - 8;
-      auto src1 = ((srcv & 0xf0) >> 4) - 8;
-      gp_weights[i * gp_n + j] = static_cast<int8_t>(src0);
-      gp_weights[(i + 1) * gp_n + j] = static_cast<int8_t>(src1);
-    }
-  }
-
-  // Original Scales are in Nx(K/BlockSize) shape
-  // Convert to (K/BLOCK_SIZE)xN shape
-  for (int i = 0; i < gp_n; i++) {
-    for (int j = 0; j < gp_kblks; j++) {
-      gp_scales[j * gp_n + i] = gp_scl[i * gp_kblks + j];
-    }
-  }
-
-  // fill this with zeros for Symmetric quantization
-  if (!gp_zps_f.empty()) {
-    int gp_kblks_pad = 2 * gzp_shape / gp_n;
-    for (int i = 0; i < gp_n; i++) {
-      for (int j = 0; j < gp_kblks_pad; j = j + 2) {
-        // auto zpv = gp_zps[(i * (gp_kblks / 2)) + (j / 2)];
-        auto zpv = gp_zps[((i * gp_kblks_pad) / 2 + j / 2)];
-        gp_zpoints[j * gp_n + i] = (zpv & 0xf) - 8;
-        gp_zpoints[(j + 1) * gp_n + i] = ((zpv & 0xf0) >> 4) - 8;
-      }
-    }
-  }
+  auto gp_packed = get_packed_weights(*context, gp_wts_f, gp_scl_f, gp_zps_f,
+                                      gp_k, gp_n, gp_bits, gp_block_size);
 
   /////////////////////////// Up /////////////////////////////////
-  size_t up_kblks = up_k / up_block_size;
-  int64_t uzp_shape =
-      (up_n * std::floor((float)((up_kblks + 1) * up_bits) / 8.0f));
-
   std::vector<float> up_bias(up_n, 0); // fill with zeros
-  std::vector<float> up_scales(up_k * up_n / up_block_size);
-  std::vector<int8_t> up_weights(up_k * up_n, 0);
-  // fill this with zeros for Symmetric quantization
-  // std::vector<int8_t> up_zpoints(up_k * up_n / up_block_size, 0);
-  std::vector<int8_t> up_zpoints(uzp_shape * 2, 0);
-
-  // Original weights are in NxK/2 packed as uint8
-  // Convert to KXN uint8
-  for (int64_t i = 0; i < up_k; i += 2) {
-    for (int64_t j = 0; j < up_n; j++) {
-      auto srcv = up_wts[j * up_k / 2 + i / 2];
-      auto src0 = (srcv & 0xf) - 8;
-      auto src1 = ((srcv & 0xf0) >> 4) - 8;
-      up_weights[i * up_n + j] = static_cast<int8_t>(src0);
-      up_weights[(i + 1) * up_n + j] = static_cast<int8_t>(src1);
-    }
-  }
-
-  // Original Scales are in Nx(K/BlockSize) shape
-  // Convert to (K/BLOCK_SIZE)xN shape
-  for (int i = 0; i < up_n; i++) {
-    for (int j = 0; j < up_kblks; j++) {
-      up_scales[j * up_n + i] = up_scl[i * up_kblks + j];
-    }
-  }
-
-  // fill this with zeros for Symmetric quantization
-  if (!up_zps_f.empty()) {
-    int up_kblks_pad = 2 * uzp_shape / up_n;
-    for (int i = 0; i < up_n; i++) {
-      for (int j = 0; j < up_kblks_pad; j = j + 2) {
-        // auto zpv = up_zps[(i * (up_kblks / 2)) + (j / 2)];
-        auto zpv = up_zps[((i * up_kblks_pad) / 2 + j / 2)];
-        up_zpoints[j * up_n + i] = (zpv & 0xf) - 8;
-        up_zpoints[(j + 1) * up_n + i] = ((zpv & 0xf0) >> 4) - 8;
-      }
-    }
-  }
+  auto up_packed = get_packed_weights(*context, up_wts_f, up_scl_f, up_zps_f,
+                                      up_k, up_n, up_bits, up_block_size);
 
   /////////////////////////// Down /////////////////////////////////
-  size_t dp_kblks = dp_k / dp_block_size;
-  int64_t zp_shape =
-      (dp_n * std::floor((float)((dp_kblks + 1) * dp_bits) / 8.0f));
   std::vector<float> dp_bias(dp_n, 0); // fill with zeros
-  std::vector<float> dp_scales(dp_k * dp_n / dp_block_size);
-  std::vector<int8_t> dp_weights(dp_k * dp_n, 0);
-  // fill this with zeros for Symmetric quantization
-  // std::vector<int8_t> dp_zpoints(dp_k * dp_n / dp_block_size, 0);
-  std::vector<int8_t> dp_zpoints(zp_shape * 2, 0);
-
-  // Original weights are in NxK/2 packed as uint8
-  // Convert to KXN uint8
-  for (int64_t i = 0; i < dp_k; i += 2) {
-    for (int64_t j = 0; j < dp_n; j++) {
-      auto srcv = dp_wts[j * dp_k / 2 + i / 2];
-      auto src0 = (srcv & 0xf) - 8;
-      auto src1 = ((srcv & 0xf0) >> 4) - 8;
-      dp_weights[i * dp_n + j] = static_cast<int8_t>(src0);
-      dp_weights[(i + 1) * dp_n + j] = static_cast<int8_t>(src1);
-    }
-  }
-
-  // Original Scales are in Nx(K/BlockSize) shape
-  // Convert to (K/BLOCK_SIZE)xN shape
-  for (int i = 0; i < dp_n; i++) {
-    for (int j = 0; j < dp_kblks; j++) {
-      dp_scales[j * dp_n + i] = dp_scl[i * dp_kblks + j];
-    }
-  }
-
-  // fill this with zeros for Symmetric quantization
-  // Each row of zero points was padded to have an even length "dp_kblks_pad"
-  if (!dp_zps_f.empty()) {
-    int dp_kblks_pad = 2 * zp_shape / dp_n;
-    for (int i = 0; i < dp_n; i++) {
-      for (int j = 0; j < dp_kblks_pad; j = j + 2) {
-        // auto zpv = dp_zps[(i * (dp_kblks / 2)) + (j / 2)];
-        auto zpv = dp_zps[((i * dp_kblks_pad) / 2 + j / 2)];
-        dp_zpoints[j * dp_n + i] = (zpv & 0xf) - 8;
-        dp_zpoints[(j + 1) * dp_n + i] = ((zpv & 0xf0) >> 4) - 8;
-      }
-    }
-  }
+  auto dp_packed = get_packed_weights(*context, dp_wts_f, dp_scl_f, dp_zps_f,
+                                      dp_k, dp_n, dp_bits, dp_block_size);
 
   // Create mladfmatmulbias operator handle
   std::string mladf_version_(MLADF_VERSION);
@@ -509,10 +388,10 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
       (ryzenai::mladfmatmulbias<uint16_t, int8_t, uint16_t, uint16_t>*)
           gate_proj_.get();
 
-  Tensor gp_wts_tensor = {gp_weights.data(), gp_wts_shape_dd, "int4"};
+  Tensor gp_wts_tensor = {gp_packed->weights_data(), gp_wts_shape_dd, "int4"};
   Tensor gp_scl_tensor = {
-      gp_scales.data(), {(size_t)gp_block_size, 1}, "float"};
-  Tensor gp_zps_tensor = {gp_zpoints.data(), gp_wts_shape_dd, "int4"};
+      gp_packed->scales_data(), {(size_t)gp_block_size, 1}, "float"};
+  Tensor gp_zps_tensor = {gp_packed->zeros_data(), gp_wts_shape_dd, "int4"};
   Tensor gp_bias_tensor = {gp_bias.data(), {(size_t)gp_block_size, 1}, "float"};
 
   std::vector<Tensor> gp_const_tensors = {gp_wts_tensor, gp_bias_tensor,
@@ -542,10 +421,10 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
       (ryzenai::mladfmatmulbias<uint16_t, int8_t, uint16_t, uint16_t>*)
           up_proj_.get();
 
-  Tensor up_wts_tensor = {up_weights.data(), up_wts_shape_dd, "int4"};
+  Tensor up_wts_tensor = {up_packed->weights_data(), up_wts_shape_dd, "int4"};
   Tensor up_scl_tensor = {
-      up_scales.data(), {(size_t)up_block_size, 1}, "float"};
-  Tensor up_zps_tensor = {up_zpoints.data(), up_wts_shape_dd, "int4"};
+      up_packed->scales_data(), {(size_t)up_block_size, 1}, "float"};
+  Tensor up_zps_tensor = {up_packed->zeros_data(), up_wts_shape_dd, "int4"};
   Tensor up_bias_tensor = {up_bias.data(), {(size_t)up_block_size, 1}, "float"};
 
   std::vector<Tensor> up_const_tensors = {up_wts_tensor, up_bias_tensor,
@@ -576,10 +455,10 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
       (ryzenai::mladfmatmulbias<uint16_t, int8_t, uint16_t, uint16_t>*)
           down_proj_.get();
 
-  Tensor dp_wts_tensor = {dp_weights.data(), dp_wts_shape_dd, "int4"};
+  Tensor dp_wts_tensor = {dp_packed->weights_data(), dp_wts_shape_dd, "int4"};
   Tensor dp_scl_tensor = {
-      dp_scales.data(), {(size_t)dp_block_size, 1}, "float"};
-  Tensor dp_zps_tensor = {dp_zpoints.data(), dp_wts_shape_dd, "int4"};
+      dp_packed->scales_data(), {(size_t)dp_block_size, 1}, "float"};
+  Tensor dp_zps_tensor = {dp_packed->zeros_data(), dp_wts_shape_dd, "int4"};
   Tensor dp_bias_tensor = {dp_bias.data(), {(size_t)dp_block_size, 1}, "float"};
 
   std::vector<Tensor> dp_const_tensors = {dp_wts_tensor, dp_bias_tensor,
@@ -39,9 +39,6 @@ private:
   virtual void Compute(const OrtApi* api,
                        OrtKernelContext* context) const override final;
 
-  template <typename dtype>
-  std::vector<dtype> loadbin(std::string& fname) const;
-
 private:
   uint16_t* input_data_{nullptr};
   int cnt_;
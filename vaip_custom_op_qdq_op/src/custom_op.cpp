@@ -10,7 +10,8 @@
 //
 #include "./custom_op.hpp"
 
-#define _QDQ_MT_ 0
+// large tensors are split on the shared host pool, small ones run inline
+#define _QDQ_MT_ 1
 
 namespace vaip_qdq_op_custom_op {
 
@@ -175,37 +176,13 @@ inline void QuantizeLinear(const float* Input, OutputType* Output, size_t N,
                            float Scale, int ZeroPoint, float MinimumValue,
                            float MaximumValue) {
 #if _QDQ_MT_
-  auto THREAD_NUM =
-      2; // std::max((int)std::thread::hardware_concurrency() / 2, (int)1);
-  std::vector<std::future<int>> thr_fut(THREAD_NUM);
-  size_t THREAD_WORKLOAD = size_t(ceil((float)N / THREAD_NUM));
-  for (size_t i = 0U; i < THREAD_NUM; i++) {
-    thr_fut[i] = std::async(
-        std::launch::async,
-        [&](size_t i) {
-          size_t BASE_POS = i * THREAD_WORKLOAD;
-          auto workload = std::min(THREAD_WORKLOAD + BASE_POS, N);
-          /*float FloatValue;
-          for (size_t n = BASE_POS; n < workload; n++) {
-            FloatValue = std::nearbyintf(Input[n] / Scale) + ZeroPoint;
-            FloatValue = std::max(FloatValue, MinimumValue);
-            FloatValue = std::min(FloatValue, MaximumValue);
-            Output[n] = (OutputType)(int32_t)FloatValue;
-          }*/
-
-          if (workload > BASE_POS)
-            qlinear_op((Input + BASE_POS), (Output + BASE_POS),
-                       (workload - BASE_POS), Scale, (int)ZeroPoint,
-                       (int)MinimumValue, (int)MaximumValue);
-
-          return 0;
-        },
-        i);
-  }
-
-  for (auto i = 0U; i < THREAD_NUM; i++) {
-    thr_fut[i].wait();
-  }
+  vaip_core::parallel_for(
+      0, (int64_t)N, vaip_core::grain_size(sizeof(float) + sizeof(OutputType)),
+      [&](int64_t begin, int64_t end) {
+        qlinear_op((Input + begin), (Output + begin), (size_t)(end - begin),
+                   Scale, (int)ZeroPoint, (int)MinimumValue,
+                   (int)MaximumValue);
+      });
 #else
   qlinear_op(Input, Output, N, Scale, (int)ZeroPoint, (int)MinimumValue,
              (int)MaximumValue);
@@ -216,28 +193,12 @@ template <typename InType>
 inline void DequantizeLinear(const InType* Input, float* Output, std::size_t N,
                              float Scale, int ZeroPoint) {
 #if _QDQ_MT_
-  auto THREAD_NUM =
-      2; // std::max((int)std::thread::hardware_concurrency() / 2, (int)1);
-  std::vector<std::future<int>> thr_fut(THREAD_NUM);
-  size_t THREAD_WORKLOAD = size_t(ceil((float)N / THREAD_NUM));
-  for (size_t i = 0U; i < THREAD_NUM; i++) {
-    thr_fut[i] = std::async(
-        std::launch::async,
-        [&](size_t i) {
-          size_t BASE_POS = i * THREAD_WORKLOAD;
-          auto workload = std::min(THREAD_WORKLOAD + BASE_POS, N);
-          if (workload > BASE_POS)
-            dqlinear_op((Input + BASE_POS), (Output + BASE_POS),
-                        (workload - BASE_POS), Scale, (int)ZeroPoint);
-
-          return 0;
-        },
-        i);
-  }
-
-  for (auto i = 0U; i < THREAD_NUM; i++) {
-    thr_fut[i].wait();
-  }
+  vaip_core::parallel_for(
+      0, (int64_t)N, vaip_core::grain_size(sizeof(InType) + sizeof(float)),
+      [&](int64_t begin, int64_t end) {
+        dqlinear_op((Input + begin), (Output + begin), (size_t)(end - begin),
+                    Scale, (int)ZeroPoint);
+      });
 #else
   dqlinear_op(Input, Output, N, Scale, (int)ZeroPoint);
 #endif
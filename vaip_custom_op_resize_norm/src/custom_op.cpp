@@ -11,6 +11,7 @@
 #include "custom_op.hpp"
 #include "norm.hpp"
 #include "resize_down.hpp"
+#include "resize_norm_cpu.hpp"
 #include "vitis/ai/profiling.hpp"
 #include "xf_aie_host_utils.hpp"
 
@@ -20,6 +21,7 @@
 
 DEF_ENV_PARAM(DEBUG_RESIZE_NORM_CUSTOM_OP, "0")
 DEF_ENV_PARAM_2(XLNX_VART_FIRMWARE, "", std::string)
+DEF_ENV_PARAM(XLNX_RESIZE_NORM_USE_CPU, "0")
 #define LOG_THIS(n) LOG_IF(INFO, ENV_PARAM(DEBUG_RESIZE_NORM_CUSTOM_OP) >= n)
 
 namespace vaip_resize_norm_custom_op {
@@ -95,9 +97,29 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
     LOG_THIS(1) << "No attribute \"size\"\n";
   }
 
+  if (ENV_PARAM(XLNX_RESIZE_NORM_USE_CPU)) {
+    LOG_THIS(1) << "XLNX_RESIZE_NORM_USE_CPU is set, use CPU kernel";
+  } else {
+    try {
+      init_npu(*context);
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "cannot initialize ResizeNorm NPU kernels, fall back to "
+                      "CPU: "
+                   << e.what();
+      kernel_resize_ = nullptr;
+      kernel_norm_ = nullptr;
+    }
+  }
+  if (kernel_norm_ == nullptr) {
+    cpu_kernel_ = std::make_unique<ResizeNormCpu>(input_shape_, target_shape_,
+                                                  fl_bits_, mean_, stddev_);
+  }
+}
+
+void MyCustomOp::init_npu(const PassContext& context) {
   // Backward compatibility.
   auto xclbin_file = ENV_PARAM(XLNX_VART_FIRMWARE);
-  auto cfg_sess_opts = context->get_config_proto().provider_options();
+  auto cfg_sess_opts = context.get_config_proto().provider_options();
   auto it = cfg_sess_opts.find("xclbin");
   if (it != cfg_sess_opts.end() && !it->second.empty()) {
     xclbin_file = it->second;
@@ -121,7 +143,7 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   auto device_id = 0;
   auto context_id = 0;
-  context_ = vaip::Context::create_shared_context(*context, device_id,
+  context_ = vaip::Context::create_shared_context(context, device_id,
                                                   context_id, xclbin_file);
 
   // Get attributes
@@ -144,10 +166,11 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   // Create compute kernel
   kernel_resize_ = std::make_unique<ResizeDown>(
-      *device, *k_resize, input_shape_, output_shape_, target_shape_);
-  kernel_norm_ =
-      std::make_unique<Normalize>(*device, *k_norm, input_shape_, output_shape_,
-                                  target_shape_, fl_bits_, mean_, stddev_);
+      *device, *k_resize, input_shape_, output_shape_, target_shape_,
+      context.get_log_dir());
+  kernel_norm_ = std::make_unique<Normalize>(
+      *device, *k_norm, input_shape_, output_shape_, target_shape_, fl_bits_,
+      mean_, stddev_, context.get_log_dir());
 
   // Create Sub BO
   // 32kb alignment
@@ -228,6 +251,19 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
   auto input_raw = input_tensor.GetTensorData<uint8_t>();
   auto tensor_info = input_tensor.GetTensorTypeAndShapeInfo();
   auto element_num = tensor_info.GetElementCount();
+
+  // Output layout
+  auto ch3 = static_cast<int>(en_transpose_ ? output_shape_[1]
+                                            : output_shape_[3]);
+  auto output_tensor = ctx.GetOutput(0, output_shape_);
+  auto output_raw = output_tensor.GetTensorMutableData<float>();
+
+  if (cpu_kernel_ != nullptr) {
+    cpu_kernel_->run(input_raw, output_raw, ch3, en_transpose_);
+    __TOC__(ResizeNormCompute);
+    return;
+  }
+
   // Copy input data to BO
   auto input_host = kernel_resize_->get_host_buffer_in();
   memcpy((void*)input_host, (void*)input_raw, element_num);
@@ -276,53 +312,15 @@ void MyCustomOp::Compute(const OrtApi* api, OrtKernelContext* context) const {
 #endif
 
   // Copy 3-channel data to output from AIE out buffer
-  auto height = 0;
-  auto width = 0;
-  auto ch3 = 0;
-  auto ch4 = 4;
-
-  // Fill output shape
-  if (en_transpose_) {
-    height = static_cast<int>(output_shape_[2]);
-    width = static_cast<int>(output_shape_[3]);
-    ch3 = static_cast<int>(output_shape_[1]);
-  } else {
-    height = static_cast<int>(output_shape_[1]);
-    width = static_cast<int>(output_shape_[2]);
-    ch3 = static_cast<int>(output_shape_[3]);
-  }
-
-  auto output_tensor = ctx.GetOutput(0, output_shape_);
-  auto output_raw = output_tensor.GetTensorMutableData<float>();
+  auto height = static_cast<int>(en_transpose_ ? output_shape_[2]
+                                               : output_shape_[1]);
+  auto width = static_cast<int>(en_transpose_ ? output_shape_[3]
+                                              : output_shape_[2]);
   auto norm_out = kernel_norm_->get_host_buffer_out();
-
   // get norm output fl bits
   auto norm_out_fl = attrs->get_attr<int>("norm_out_fl");
-  if (en_transpose_) {
-    for (int h = 0; h < height; ++h) {
-      for (int w = 0; w < width; ++w) {
-        for (int c = 0; c < ch3; ++c) {
-          int hwc_index = h * width * ch4 + w * ch4 + c;
-          int chw_index = c * height * width + h * width + w;
-          auto val = static_cast<float>(norm_out[hwc_index]) /
-                     static_cast<float>(1 << norm_out_fl);
-          output_raw[chw_index] = val;
-        }
-      }
-    }
-  } else {
-    for (int row = 0; row < height; ++row) {
-      for (int col = 0; col < width; ++col) {
-        for (int ch = 0; ch < ch3; ++ch) {
-          auto index_ch3 = (row * width * ch3) + (col * ch3) + ch;
-          auto index_ch4 = (row * width * ch4) + (col * ch4) + ch;
-          auto val = static_cast<float>(norm_out[index_ch4]) /
-                     static_cast<float>(1 << norm_out_fl);
-          output_raw[index_ch3] = val;
-        }
-      }
-    }
-  }
+  hwc4_fixed_to_float(norm_out, output_raw, height, width, ch3, norm_out_fl,
+                      en_transpose_);
   __TOC__(ResizeNormCompute);
 }
 } // namespace vaip_resize_norm_custom_op
@@ -12,6 +12,9 @@
 #include <mutex>
 class ResizeDown;
 class Normalize;
+namespace vaip_resize_norm_custom_op {
+class ResizeNormCpu;
+}
 // XRT includes
 #include "../../xrt_shared_context/xrt_shared_context.hpp"
 // FD Post kernel
@@ -26,10 +29,15 @@ public:
 
   virtual ~MyCustomOp();
 
+private:
+  void init_npu(const PassContext& context);
+
 private:
   std::shared_ptr<vaip::Context> context_;
   std::unique_ptr<ResizeDown> kernel_resize_;
   std::unique_ptr<Normalize> kernel_norm_;
+  // used when the NPU kernels are not available
+  std::unique_ptr<ResizeNormCpu> cpu_kernel_;
   // std::uint32_t instr_buffer_norm[INSTR_BUFFER_LENGTH_MAX];
   xrt::bo instr_bo_resize_;
   xrt::bo instr_bo_norm_;
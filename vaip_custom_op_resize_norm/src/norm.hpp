@@ -6,6 +6,7 @@
 
 #include <numeric>
 
+#include "pp_instr_cache.hpp"
 #include "pp_norm_instr_compiler.hpp"
 #include "xf_aie_const.hpp"
 
@@ -35,7 +36,8 @@ public:
   Normalize(xrt::device& device, xrt::kernel& kernel,
             std::vector<int64_t>& in_shape, std::vector<int64_t>& out_shape,
             std::vector<int64_t>& norm_out_shape, std::vector<int>& fl_bits,
-            std::vector<float>& mean, std::vector<float>& std_deviation) {
+            std::vector<float>& mean, std::vector<float>& std_deviation,
+            const std::filesystem::path& cache_dir) {
     // Input/output sizes
     int64_t out_size = 1;
     out_size = std::accumulate(norm_out_shape.begin(), norm_out_shape.end(),
@@ -51,7 +53,7 @@ public:
     // Get alpha/beta values
     get_alpha_beta(mean, std_deviation, alpha, beta, fbits_alpha, fbits_beta);
 
-    rtpData = new uint16_t[RTP_SIZE >> 1];
+    rtpData = new uint16_t[RTP_SIZE >> 1]();
 
     uint16_t opcode = PP_NORM;
     rtpData[PP_OPCODE] = opcode;
@@ -72,16 +74,16 @@ public:
     size_t metadata_words = 1 + (metadata_size / sizeof(uint32_t));
 
     // Create a buffer to hold metadata + instructions
-    instr_buffer_norm = new uint32_t[30000];
+    instr_buffer_norm = new uint32_t[INSTR_BUFFER_WORDS];
 
     // Load metadata
     instr_buffer_norm[0] = static_cast<uint32_t>(metadata_words);
     memcpy(instr_buffer_norm + 1, rtpData, RTP_SIZE);
 
-    // Create instance of compiler
-    auto compiler =
-        std::make_unique<NormInstrCompiler>(instr_buffer_norm + metadata_words);
-    instr_counter = compiler->generate(rtpData);
+    // Generate instructions, or reuse those of an identical configuration
+    instr_counter = IC::generate_cached<NormInstrCompiler>(
+        "pp_norm", rtpData, RTP_SIZE >> 1, instr_buffer_norm + metadata_words,
+        INSTR_BUFFER_WORDS - metadata_words, cache_dir);
     instr_counter = static_cast<uint32_t>(instr_counter + metadata_words);
     // Create BO
     bo_out =
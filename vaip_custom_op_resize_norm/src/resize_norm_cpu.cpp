@@ -0,0 +1,256 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#include "vaip/vaip.hpp"
+
+#include "resize_norm_cpu.hpp"
+
+#include "cpu_features/cpu_features.hpp"
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vaip_resize_norm_custom_op {
+
+// Split `rows` over the host pool, `row_bytes` is what one row reads
+// and writes.
+template <typename Func>
+static void parallel_rows(int rows, int64_t row_bytes, Func&& func) {
+  vaip_core::parallel_for(0, rows, vaip_core::grain_size(row_bytes),
+                          [&func](int64_t begin, int64_t end) {
+                            func((int)begin, (int)end);
+                          });
+}
+
+// Same rounding as compute_scalefactor<16>() in resize_down.hpp, which
+// produces the PP_RESIZE_DOWN_RTP_SCALE_* values.
+static uint32_t q16_scale(int64_t in, int64_t out) {
+  float scale = (float)in / (float)out * (float)(1 << 16);
+  return (uint32_t)(std::roundf(scale));
+}
+
+static void build_taps(std::vector<int32_t>& i0, std::vector<int32_t>& i1,
+                       std::vector<int32_t>& frac, int in_size,
+                       int out_size) {
+  auto scale = (int64_t)q16_scale(in_size, out_size);
+  i0.resize(out_size);
+  i1.resize(out_size);
+  frac.resize(out_size);
+  for (auto o = 0; o < out_size; ++o) {
+    // centre aligned source position in Q16: (o + 0.5) * scale - 0.5
+    auto pos = (((int64_t)(2 * o + 1) * scale) >> 1) - (1 << 15);
+    pos = std::max(pos, (int64_t)0);
+    auto idx = (int32_t)(pos >> 16);
+    auto f = (int32_t)((pos >> 8) & 0xFF);
+    if (idx >= in_size - 1) {
+      idx = in_size - 1;
+      f = 0;
+    }
+    i0[o] = idx;
+    i1[o] = std::min(idx + 1, in_size - 1);
+    frac[o] = f;
+  }
+}
+
+ResizeNormCpu::ResizeNormCpu(const std::vector<int64_t>& in_shape,
+                             const std::vector<int64_t>& rsz_out_shape,
+                             const std::vector<int>& fl_bits,
+                             const std::vector<float>& mean,
+                             const std::vector<float>& std_deviation) {
+  CHECK_GE(in_shape.size(), 2u);
+  CHECK_GE(rsz_out_shape.size(), 2u);
+  if (in_shape.size() > 2u) {
+    CHECK_EQ(in_shape[2], 4) << "expect RGBA input";
+  }
+  CHECK_EQ(fl_bits.size(), 3u) << "expect alpha, beta and output fbits";
+  in_h_ = static_cast<int>(in_shape[0]);
+  in_w_ = static_cast<int>(in_shape[1]);
+  out_h_ = static_cast<int>(rsz_out_shape[0]);
+  out_w_ = static_cast<int>(rsz_out_shape[1]);
+
+  fbits_alpha_ = fl_bits[0];
+  auto fbits_beta = fl_bits[1];
+  fbits_out_ = fl_bits[2];
+  norm_shift_ = fbits_alpha_ + fbits_beta - fbits_out_;
+  CHECK_GE(norm_shift_, 0) << "output fbits exceeds alpha + beta fbits";
+  norm_round_ = norm_shift_ > 0 ? (1 << (norm_shift_ - 1)) : 0;
+
+  // Same quantization as get_alpha_beta() in norm.hpp.
+  for (auto i = 0u; i < 4u; ++i) {
+    auto m = i < mean.size() ? mean[i] : 0.0f;
+    auto s = i < std_deviation.size() ? std_deviation[i] : 0.0f;
+    float a_v = m * static_cast<float>(1 << fbits_alpha_);
+    float b_v =
+        s != 0 ? (1.0f / s) * static_cast<float>(1 << fbits_beta) : 0.0f;
+    alpha_[i] = (unsigned char)a_v;
+    beta_[i] = (char)b_v;
+  }
+
+  std::vector<int32_t> i0, i1, frac;
+  build_taps(i0, i1, frac, in_w_, out_w_);
+  x_taps_.resize(out_w_);
+  for (auto x = 0; x < out_w_; ++x) {
+    x_taps_[x] = Tap{i0[x] * 4, i1[x] * 4, frac[x]};
+  }
+  build_taps(i0, i1, frac, in_h_, out_h_);
+  y_taps_.resize(out_h_);
+  for (auto y = 0; y < out_h_; ++y) {
+    y_taps_[y] = Tap{i0[y], i1[y], frac[y]};
+  }
+}
+
+void ResizeNormCpu::resize_row(const uint8_t* in, int y, uint8_t* row) const {
+  const auto& ty = y_taps_[y];
+  auto stride = static_cast<size_t>(in_w_) * 4;
+  auto r0 = in + ty.i0 * stride;
+  auto r1 = in + ty.i1 * stride;
+  auto fy = ty.frac;
+  for (auto x = 0; x < out_w_; ++x) {
+    const auto& tx = x_taps_[x];
+    auto fx = tx.frac;
+    for (auto c = 0; c < 4; ++c) {
+      auto top = r0[tx.i0 + c] * (256 - fx) + r0[tx.i1 + c] * fx;
+      auto bot = r1[tx.i0 + c] * (256 - fx) + r1[tx.i1 + c] * fx;
+      auto v = (top * (256 - fy) + bot * fy + (1 << 15)) >> 16;
+      row[x * 4 + c] = static_cast<uint8_t>(v);
+    }
+  }
+}
+
+void ResizeNormCpu::normalize_row(const uint8_t* row, int8_t* out) const {
+  for (auto x = 0; x < out_w_ * 4; x += 4) {
+    for (auto c = 0; c < 4; ++c) {
+      auto v = (((int32_t)row[x + c] << fbits_alpha_) - alpha_[c]) * beta_[c];
+      v = (v + norm_round_) >> norm_shift_;
+      out[x + c] = static_cast<int8_t>(std::clamp(v, -128, 127));
+    }
+  }
+}
+
+#if VAIP_CPU_X86
+// RGBA RGBA RGBA RGBA -> RRRR GGGG BBBB, for groups of 4 pixels; returns
+// the number of pixels done.
+VAIP_CPU_TARGET("ssse3,sse4.1")
+static int rgba_to_planar_sse41(const int8_t* src, float* out, size_t plane,
+                                int width, float scale) {
+  const auto vscale = _mm_set1_ps(scale);
+  const auto planar =
+      _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+  auto x = 0;
+  for (; x + 4 <= width; x += 4) {
+    auto px = _mm_loadu_si128((const __m128i*)(src + x * 4));
+    px = _mm_shuffle_epi8(px, planar);
+    auto r = _mm_cvtepi32_ps(_mm_cvtepi8_epi32(px));
+    auto g = _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(px, 4)));
+    auto b = _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(px, 8)));
+    _mm_storeu_ps(out + x, _mm_mul_ps(r, vscale));
+    _mm_storeu_ps(out + plane + x, _mm_mul_ps(g, vscale));
+    _mm_storeu_ps(out + 2 * plane + x, _mm_mul_ps(b, vscale));
+  }
+  return x;
+}
+
+// RGBA RGBA RGBA RGBA -> RGB RGB RGB RGB, for groups of 4 pixels; returns
+// the number of pixels done.
+VAIP_CPU_TARGET("ssse3,sse4.1")
+static int rgba_to_rgb_sse41(const int8_t* src, float* out, int width,
+                             float scale) {
+  const auto vscale = _mm_set1_ps(scale);
+  const auto packed = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                                    -1, -1, -1, -1);
+  auto x = 0;
+  for (; x + 4 <= width; x += 4) {
+    auto px = _mm_loadu_si128((const __m128i*)(src + x * 4));
+    px = _mm_shuffle_epi8(px, packed);
+    auto v0 = _mm_cvtepi32_ps(_mm_cvtepi8_epi32(px));
+    auto v1 = _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(px, 4)));
+    auto v2 = _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(px, 8)));
+    _mm_storeu_ps(out + x * 3, _mm_mul_ps(v0, vscale));
+    _mm_storeu_ps(out + x * 3 + 4, _mm_mul_ps(v1, vscale));
+    _mm_storeu_ps(out + x * 3 + 8, _mm_mul_ps(v2, vscale));
+  }
+  return x;
+}
+#endif
+
+// Convert one HWC4 row of fixed-point values at row `y`.
+static void convert_row(const int8_t* src, float* dst, int y, int height,
+                        int width, int out_channels, float scale,
+                        bool to_chw) {
+  auto x = 0;
+  auto plane = static_cast<size_t>(height) * width;
+  if (to_chw) {
+    auto out = dst + static_cast<size_t>(y) * width;
+#if VAIP_CPU_X86
+    if (out_channels == 3 && vaip_cpu::has_sse41()) {
+      x = rgba_to_planar_sse41(src, out, plane, width, scale);
+    }
+#endif
+    for (; x < width; ++x) {
+      for (auto c = 0; c < out_channels; ++c) {
+        out[c * plane + x] = static_cast<float>(src[x * 4 + c]) * scale;
+      }
+    }
+  } else {
+    auto out = dst + static_cast<size_t>(y) * width * out_channels;
+#if VAIP_CPU_X86
+    if (out_channels == 3 && vaip_cpu::has_sse41()) {
+      x = rgba_to_rgb_sse41(src, out, width, scale);
+    }
+#endif
+    for (; x < width; ++x) {
+      for (auto c = 0; c < out_channels; ++c) {
+        out[x * out_channels + c] = static_cast<float>(src[x * 4 + c]) * scale;
+      }
+    }
+  }
+}
+
+// 1 / 2^fbits is exact in float, so multiplying gives the same result
+// as the division done by the previous per-element loop.
+static float fixed_scale(int fbits) {
+  return std::ldexp(1.0f, -fbits);
+}
+
+void ResizeNormCpu::run(const uint8_t* in, float* out, int out_channels,
+                        bool to_chw) const {
+  CHECK_LE(out_channels, 4);
+  auto scale = fixed_scale(fbits_out_);
+  auto row_bytes = (int64_t)out_w_ * (4 + out_channels * sizeof(float));
+  parallel_rows(out_h_, row_bytes, [&](int begin, int end) {
+    std::vector<uint8_t> rsz(static_cast<size_t>(out_w_) * 4);
+    std::vector<int8_t> nrm(static_cast<size_t>(out_w_) * 4);
+    for (auto y = begin; y < end; ++y) {
+      resize_row(in, y, rsz.data());
+      normalize_row(rsz.data(), nrm.data());
+      convert_row(nrm.data(), out, y, out_h_, out_w_, out_channels, scale,
+                  to_chw);
+    }
+  });
+}
+
+void hwc4_fixed_to_float(const int8_t* src, float* dst, int height, int width,
+                         int out_channels, int fbits, bool to_chw,
+                         int row_begin, int row_end) {
+  auto scale = fixed_scale(fbits);
+  auto stride = static_cast<size_t>(width) * 4;
+  for (auto y = row_begin; y < row_end; ++y) {
+    convert_row(src + y * stride, dst, y, height, width, out_channels, scale,
+                to_chw);
+  }
+}
+
+void hwc4_fixed_to_float(const int8_t* src, float* dst, int height, int width,
+                         int out_channels, int fbits, bool to_chw) {
+  CHECK_LE(out_channels, 4);
+  auto row_bytes = (int64_t)width * (4 + out_channels * sizeof(float));
+  parallel_rows(height, row_bytes, [&](int begin, int end) {
+    hwc4_fixed_to_float(src, dst, height, width, out_channels, fbits, to_chw,
+                        begin, end);
+  });
+}
+
+} // namespace vaip_resize_norm_custom_op
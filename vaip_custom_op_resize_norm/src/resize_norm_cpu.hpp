@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vaip_resize_norm_custom_op {
+
+/// Host implementation of the PP_RESIZE_DOWN + PP_NORM pipeline.
+///
+/// The arithmetic follows the AIE kernels: source coordinates are
+/// computed from the same Q16 scale factors that are written into the
+/// resize RTPs, interpolation weights are 8-bit fractions, and
+/// normalization uses the 8-bit alpha/beta values produced by
+/// get_alpha_beta() with the configured fraction bits. The output of
+/// each pixel therefore equals the int8 value the NPU writes into the
+/// norm output buffer, converted to float.
+class ResizeNormCpu {
+public:
+  ResizeNormCpu(const std::vector<int64_t>& in_shape,
+                const std::vector<int64_t>& rsz_out_shape,
+                const std::vector<int>& fl_bits,
+                const std::vector<float>& mean,
+                const std::vector<float>& std_deviation);
+
+  /// Resize and normalize a HWC4 uint8 image into a 3-channel float
+  /// tensor, HWC or CHW depending on `to_chw`.
+  void run(const uint8_t* in, float* out, int out_channels, bool to_chw) const;
+
+  int out_height() const { return out_h_; }
+  int out_width() const { return out_w_; }
+
+private:
+  struct Tap {
+    int32_t i0;
+    int32_t i1;
+    int32_t frac; // Q8 weight of i1
+  };
+  void resize_row(const uint8_t* in, int y, uint8_t* row) const;
+  void normalize_row(const uint8_t* row, int8_t* out) const;
+
+private:
+  int in_h_;
+  int in_w_;
+  int out_h_;
+  int out_w_;
+  int fbits_alpha_;
+  int fbits_out_;
+  int norm_shift_;
+  int32_t norm_round_;
+  std::array<int32_t, 4> alpha_;
+  std::array<int32_t, 4> beta_;
+  std::vector<Tap> x_taps_;
+  std::vector<Tap> y_taps_;
+};
+
+/// Convert `height` rows of the 4-channel fixed-point norm output to a
+/// 3-channel float tensor in one pass: scale by 2^-fbits, drop the
+/// alpha channel and optionally transpose HWC to CHW. `row_begin` and
+/// `row_end` select a band of rows so callers can split the work.
+void hwc4_fixed_to_float(const int8_t* src, float* dst, int height, int width,
+                         int out_channels, int fbits, bool to_chw,
+                         int row_begin, int row_end);
+
+/// Multi-threaded wrapper of hwc4_fixed_to_float over all rows.
+void hwc4_fixed_to_float(const int8_t* src, float* dst, int height, int width,
+                         int out_channels, int fbits, bool to_chw);
+
+} // namespace vaip_resize_norm_custom_op
@@ -103,7 +103,8 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   // Create compute kernel
   kernel_softmax_ = std::make_unique<SoftMax>(*device, *k_softmax, input_shape_,
-                                              output_shape_);
+                                              output_shape_,
+                                              context->get_log_dir());
 
   // Create Sub BO
   // 32kb alignment
@@ -90,7 +90,8 @@ MyCustomOp::MyCustomOp(std::shared_ptr<const PassContext> context,
 
   // Create compute kernel
   kernel_topk_ =
-      std::make_unique<TopK>(*device, *k_topk, input_shape_, output_shape_);
+      std::make_unique<TopK>(*device, *k_topk, input_shape_, output_shape_,
+                             context->get_log_dir());
 
   // Create Sub BO
   // 32kb alignment
@@ -6,13 +6,15 @@
 
 #include <numeric>
 
+#include "pp_instr_cache.hpp"
 #include "pp_topk_instr_compiler.hpp"
 #include "xf_aie_const.hpp"
 
 class TopK {
 public:
   TopK(xrt::device& device, xrt::kernel& kernel, std::vector<int64_t>& in_shape,
-       std::vector<int64_t>& out_shape) {
+       std::vector<int64_t>& out_shape,
+       const std::filesystem::path& cache_dir) {
     // Input/output sizes
     int64_t in_size = 1;
     in_size = std::accumulate(in_shape.begin(), in_shape.end(), in_size,
@@ -24,7 +26,7 @@ public:
     out_size = std::accumulate(out_shape.begin(), out_shape.end(), out_size,
                                std::multiplies());
 
-    rtpData = new uint16_t[RTP_SIZE >> 1];
+    rtpData = new uint16_t[RTP_SIZE >> 1]();
 
     uint16_t opcode = PP_TOPK;
     rtpData[PP_OPCODE] = opcode;
@@ -38,16 +40,16 @@ public:
     size_t metadata_words = 1 + (metadata_size / sizeof(uint32_t));
 
     // Create a buffer to hold metadata + instructions
-    instr_buffer_topk = new uint32_t[30000];
+    instr_buffer_topk = new uint32_t[INSTR_BUFFER_WORDS];
 
     // Load metadata
     instr_buffer_topk[0] = static_cast<uint32_t>(metadata_words);
     memcpy(instr_buffer_topk + 1, rtpData, RTP_SIZE);
 
-    // Create instance of compiler
-    auto compiler =
-        std::make_unique<TopkInstrCompiler>(instr_buffer_topk + metadata_words);
-    instr_counter = compiler->generate(rtpData);
+    // Generate instructions, or reuse those of an identical configuration
+    instr_counter = IC::generate_cached<TopkInstrCompiler>(
+        "pp_topk", rtpData, RTP_SIZE >> 1, instr_buffer_topk + metadata_words,
+        INSTR_BUFFER_WORDS - metadata_words, cache_dir);
     instr_counter = static_cast<uint32_t>(instr_counter + metadata_words);
 
     // Create BOs
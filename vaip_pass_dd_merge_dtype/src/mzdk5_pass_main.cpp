@@ -2,7 +2,7 @@
  *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
  *  Licensed under the MIT License.
  */
-#include "dtype_util.h"
+#include "precision_solver.h"
 #include "vaip/vaip.hpp"
 #include "vitis/ai/env_config.hpp"
 #include <algorithm>
@@ -20,105 +20,29 @@ using namespace vaip_core;
 struct DDMergeShapemzdk5 {
   DDMergeShapemzdk5(IPass& self) : self_{self} {}
 
-  std::vector<std::string>
-  get_new_in_dtype_attributes(vaip::dtype_util::NodeAttrContext& ctx) {
-    auto node = ctx.node;
-    auto precision = ctx.precision;
-    auto node_op = VAIP_ORT_API(node_op_type)(*node);
-    std::string attr_name = "in_dtypes";
-    auto& attrs = node_get_attributes_ref(*node);
-    auto attr_proto = node_attributes_get(attrs, attr_name);
-    auto strs_value = VAIP_ORT_API(attr_proto_get_strings)(*attr_proto);
-    std::vector<std::string> ret = strs_value;
-
-    if (node_op == "QEltWiseAdd" && !node_has_attr(*node, "generic_fusion")) {
-      int parent_index = 0;
-      for (auto x : ctx.parent_ops) {
-        auto parent_op_type = VAIP_ORT_API(node_op_type)(*x);
-        if (parent_op_type == "QEltWiseAdd") {
-          auto sibling_nodes =
-              vaip::dtype_util::get_all_child_nodes(*ctx.graph, x);
-          for (auto y : sibling_nodes) {
-            if (y == nullptr)
-              continue;
-            auto cop = VAIP_ORT_API(node_op_type)(*y);
-            if (cop == "QLayerNorm") {
-              MY_LOG(1) << "Child is " << cop << std::endl;
-              ret[parent_index] = "bfloat16";
-            }
-          }
-        }
-        parent_index++;
-      }
-    }
-    return ret;
-  }
-
-  std::vector<std::string>
-  get_new_out_dtype_attributes(vaip::dtype_util::NodeAttrContext& ctx) {
-    auto node = ctx.node;
-    auto precision = ctx.precision;
-    auto node_op = VAIP_ORT_API(node_op_type)(*node);
-    auto child_op = ctx.child_op;
-    std::string attr_name = "out_dtypes";
-    auto& attrs = node_get_attributes_ref(*node);
-    auto attr_proto = node_attributes_get(attrs, attr_name);
-    auto strs_value = VAIP_ORT_API(attr_proto_get_strings)(*attr_proto);
-    std::vector<std::string> ret = strs_value;
-
-    if (node_op == "QGroupNorm") {
-      // auto& attrs = node_get_attributes_ref(*node);
-      // auto attr_proto = node_attributes_get(attrs, attr_name);
-      // auto strs_value = VAIP_ORT_API(attr_proto_get_strings)(*attr_proto);
-      ret = {"bfloat16"};
-      for (auto x : child_op) {
-        // std::cout<<VAIP_ORT_API(node_op_type)(*x)<<" ";
-        auto cop = VAIP_ORT_API(node_op_type)(*x);
-        if (cop == "QMatMulAdd") {
-          MY_LOG(1) << "Child is " << cop << std::endl;
-          ret = {"uint16"};
-        }
-      }
-
-      // std::cout<<"\n";
-    } else if (node_op == "QEltWiseAdd" &&
-               !node_has_attr(*node, "generic_fusion")) {
-      // auto& attrs = node_get_attributes_ref(*node);
-      // auto attr_proto = node_attributes_get(attrs, attr_name);
-      // auto strs_value = VAIP_ORT_API(attr_proto_get_strings)(*attr_proto);
-      ret = {"uint16"};
-      for (auto x : child_op) {
-        // std::cout<<VAIP_ORT_API(node_op_type)(*x)<<" ";
-        auto cop = VAIP_ORT_API(node_op_type)(*x);
-        if (cop == "QLayerNorm") {
-          MY_LOG(1) << "Child is " << cop << std::endl;
-          ret = {"bfloat16"};
-        }
-      }
-
-      // std::cout<<"\n";
-    }
-    return ret;
-  }
-
-  bool update_node_attributes(vaip::dtype_util::NodeAttrContext& ctx) {
-    auto node = ctx.node;
-    std::map<std::string, std::vector<std::string>> m;
-
-    m["in_dtypes"] = get_new_in_dtype_attributes(ctx);
-    m["out_dtypes"] = get_new_out_dtype_attributes(ctx);
-    bool replaced = false;
+  bool update_node_attributes(
+      const Node* node,
+      const vaip::dtype_util::PrecisionSolver::Dtypes* dtypes) {
     auto nab = NodeAttributesBuilder();
-    for (const auto& kv : m) {
-      if (kv.second.size()) {
-        nab.add(kv.first, kv.second);
-      }
+    if (dtypes != nullptr && !dtypes->in_dtypes.empty()) {
+      nab.add("in_dtypes", dtypes->in_dtypes);
+    }
+    if (dtypes != nullptr && !dtypes->out_dtypes.empty()) {
+      nab.add("out_dtypes", dtypes->out_dtypes);
     }
     nab.add("design_param", "4x4");
     auto x = const_cast<Node*>(node);
     nab.merge_into(*x);
-    replaced = true;
-    return replaced;
+    return true;
+  }
+  static bool is_excluded(const Node* node) {
+    auto output_name = node_arg_get_name(node_get_output_node_arg(*node));
+    // excluded ops mzdk5
+    return output_name == "input_1_QuantizeLinear_Output" ||
+           output_name == "input_1_channel_first_0_QuantizeLinear_Output" ||
+           output_name == "input_2_QuantizeLinear_Output" ||
+           output_name == "output_1_channel_first_0_DequantizeLinear_Output" ||
+           output_name == "output_1" || output_name == "input_1_q_to_dq";
   }
   void update_qdq_tensor(Graph& graph, const Node* node) {
     auto node_op = VAIP_ORT_API(node_op_type)(*node);
@@ -248,23 +172,35 @@ struct DDMergeShapemzdk5 {
                      ->xclbin_path_to_cache_files(std::filesystem::path(
                          self_.get_pass_proto().pass_dd_param().xclbin()))
                      .string();
-    std::string precision = "a16w8"; // TODO Remove this Hardcoding
+    auto solver = vaip::dtype_util::PrecisionSolver(
+        graph, vaip::dtype_util::CONVERSION_COST, "uint16");
+    auto nodes = std::vector<const Node*>();
     for (const auto node_idx : graph_get_node_in_topoligical_order(graph)) {
       auto node = VAIP_ORT_API(graph_get_node)(graph, node_idx);
-      auto node_ctx = vaip::dtype_util::build_context(graph, node, precision);
-
-      auto node_outputs = node_ctx.node_outputs;
-      auto output_name = node_arg_get_name(*(node_outputs[0]));
-      // excluded ops mzdk5
-      if (output_name == "input_1_QuantizeLinear_Output" ||
-          output_name == "input_1_channel_first_0_QuantizeLinear_Output" ||
-          output_name == "input_2_QuantizeLinear_Output" ||
-          output_name == "output_1_channel_first_0_DequantizeLinear_Output" ||
-          output_name == "output_1" || output_name == "input_1_q_to_dq") {
-        MY_LOG(1) << "excluded op " << output_name;
+      if (is_excluded(node)) {
+        MY_LOG(1) << "excluded op "
+                  << node_arg_get_name(node_get_output_node_arg(*node));
+        continue;
+      }
+      nodes.push_back(node);
+      auto op_type = VAIP_ORT_API(node_op_type)(*node);
+      if (op_type == "QEltWiseAdd" && node_has_attr(*node, "generic_fusion")) {
         continue;
       }
-      if (update_node_attributes(node_ctx)) {
+      // only the adds and groupnorms as before, mzdk5 never rewrote the
+      // in_dtypes of a layernorm; it is a fixed anchor of the solver.
+      if (op_type == "QLayerNorm") {
+        continue;
+      }
+      if (auto rule = vaip::dtype_util::get_dd_dtype_rule(*node)) {
+        solver.add_op(node, *rule);
+      }
+    }
+    auto dtypes = solver.solve();
+    for (auto node : nodes) {
+      auto it = dtypes.find(node);
+      if (update_node_attributes(node, it == dtypes.end() ? nullptr
+                                                          : &it->second)) {
         MY_LOG(1) << "Changed out_dtype attribute";
       }
       update_qdq_tensor(graph, node);
@@ -0,0 +1,304 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+#include "vaip/vaip.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <optional>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace vaip_core;
+
+namespace vaip::dtype_util {
+
+/// Cost of a port, i.e. an activation input or output of a DD op, taking
+/// or producing its activation as its integer dtype, e.g. uint16, or as
+/// bfloat16. INFEASIBLE means the kernel does not support it.
+struct PortCost {
+  static constexpr int64_t INFEASIBLE = int64_t(1) << 40;
+  int64_t int_cost = 0;
+  int64_t bf16_cost = 0;
+};
+
+/// The ports of an op the solver may switch between its integer dtype
+/// and bfloat16, by index of in_dtypes and out_dtypes.
+struct OpDtypeRule {
+  std::map<size_t, PortCost> inputs;
+  std::map<size_t, PortCost> outputs;
+};
+
+/// A dtype conversion between two DD ops costs more than a kernel taking
+/// its less efficient dtype.
+constexpr int64_t CONVERSION_COST = 8;
+
+/// The dtype choices of the DD ops that take or produce bfloat16
+/// activations; none for an op whose dtypes are fixed.
+[[maybe_unused]] static std::optional<OpDtypeRule>
+get_dd_dtype_rule(const Node& node) {
+  auto op_type = VAIP_ORT_API(node_op_type)(node);
+  auto ret = OpDtypeRule();
+  if (op_type == "QEltWiseAdd") {
+    // adds in either dtype, slightly faster in uint16.
+    ret.inputs = {{0, {0, 1}}, {1, {0, 1}}};
+    ret.outputs = {{0, {0, 1}}};
+  } else if (op_type == "QLayerNorm") {
+    // normalizes in bfloat16, a uint16 input is dequantized first.
+    ret.inputs = {{0, {4, 0}}};
+  } else if (op_type == "QGroupNorm") {
+    ret.outputs = {{0, {1, 0}}};
+  } else {
+    return std::nullopt;
+  }
+  return ret;
+}
+
+/// Chooses the dtypes of the activations between DD ops for the whole
+/// graph at once, instead of looking at the direct neighbours of a node.
+///
+/// Every port of the ops added with add_op() is either its integer dtype
+/// or bfloat16. The ports of the other ops keep their in_dtypes and
+/// out_dtypes. A producer and a consumer of the same activation that do
+/// not agree cost `conversion_cost`, every port costs its PortCost, and
+/// solve() returns the assignment of the least total cost.
+///
+/// With two dtypes and a cost only for disagreeing ports, the least cost
+/// assignment is a minimum s-t cut: the ports on the source side are the
+/// integer dtype and the ones on the sink side are bfloat16.
+class PrecisionSolver {
+public:
+  struct Dtypes {
+    std::vector<std::string> in_dtypes;
+    std::vector<std::string> out_dtypes;
+  };
+
+  /// `int_dtype` is the integer dtype of a port that is bfloat16 now.
+  PrecisionSolver(const Graph& graph, int64_t conversion_cost,
+                  const std::string& int_dtype)
+      : graph_{graph}, conversion_cost_{conversion_cost},
+        int_dtype_{int_dtype} {}
+
+  void add_op(const Node* node, const OpDtypeRule& rule) {
+    rules_[node] = rule;
+  }
+
+  /// the new in_dtypes and out_dtypes of the ops added with add_op().
+  std::map<const Node*, Dtypes> solve() {
+    auto ret = std::map<const Node*, Dtypes>();
+    for (auto& [node, rule] : rules_) {
+      auto& dtypes = ret[node];
+      dtypes.in_dtypes = get_dtypes(node, "in_dtypes");
+      dtypes.out_dtypes = get_dtypes(node, "out_dtypes");
+      add_free_ports(node, rule.inputs, true, dtypes.in_dtypes);
+      add_free_ports(node, rule.outputs, false, dtypes.out_dtypes);
+    }
+    for (auto& [node, rule] : rules_) {
+      add_edges(node, rule);
+    }
+    auto is_bf16 = min_cut();
+    for (auto& [key, port] : free_ports_) {
+      auto& dtypes = ret[std::get<0>(key)];
+      auto& dtype = std::get<1>(key) ? dtypes.in_dtypes[std::get<2>(key)]
+                                     : dtypes.out_dtypes[std::get<2>(key)];
+      if (is_bf16[port]) {
+        dtype = "bfloat16";
+      } else if (dtype == "bfloat16") {
+        dtype = int_dtype_;
+      }
+    }
+    return ret;
+  }
+
+private:
+  // (node, is input, index of in_dtypes or out_dtypes)
+  using PortKey = std::tuple<const Node*, bool, size_t>;
+
+  static std::vector<std::string> get_dtypes(const Node* node,
+                                             const std::string& name) {
+    if (!node_has_attr(*node, name)) {
+      return {};
+    }
+    return node_get_attr_strings(*node, name);
+  }
+
+  size_t new_port(int64_t int_cost, int64_t bf16_cost) {
+    auto port = int_costs_.size();
+    int_costs_.push_back(int_cost);
+    bf16_costs_.push_back(bf16_cost);
+    return port;
+  }
+
+  void add_free_ports(const Node* node, const std::map<size_t, PortCost>& ports,
+                      bool is_input, const std::vector<std::string>& dtypes) {
+    for (auto& [index, cost] : ports) {
+      if (index < dtypes.size()) {
+        free_ports_[{node, is_input, index}] =
+            new_port(cost.int_cost, cost.bf16_cost);
+      }
+    }
+  }
+
+  // the port of a free op, or a port fixed to the current dtype of an op
+  // the solver does not change; none if the op has no such dtype.
+  std::optional<size_t> get_port(const Node* node, bool is_input,
+                                 size_t index) {
+    auto key = PortKey{node, is_input, index};
+    auto it = free_ports_.find(key);
+    if (it != free_ports_.end()) {
+      return it->second;
+    }
+    it = fixed_ports_.find(key);
+    if (it != fixed_ports_.end()) {
+      return it->second;
+    }
+    auto dtypes = get_dtypes(node, is_input ? "in_dtypes" : "out_dtypes");
+    if (index >= dtypes.size()) {
+      return std::nullopt;
+    }
+    auto port = dtypes[index] == "bfloat16"
+                    ? new_port(PortCost::INFEASIBLE, 0)
+                    : new_port(0, PortCost::INFEASIBLE);
+    fixed_ports_[key] = port;
+    return port;
+  }
+
+  void add_edges(const Node* node, const OpDtypeRule& rule) {
+    // an edge is added by its consumer if the consumer is free, otherwise
+    // by its producer.
+    auto inputs = node_get_inputs(*node);
+    for (auto& [index, cost] : rule.inputs) {
+      auto port = free_ports_.find({node, true, index});
+      if (port == free_ports_.end() || index >= inputs.size() ||
+          inputs[index].node == nullptr) {
+        continue;
+      }
+      auto producer = inputs[index].node;
+      auto outputs = node_get_output_node_args(*producer);
+      auto k = std::find(outputs.begin(), outputs.end(),
+                         inputs[index].node_arg) -
+               outputs.begin();
+      if (auto other = get_port(producer, false, (size_t)k)) {
+        add_edge(port->second, *other);
+      }
+    }
+    auto outputs = node_get_output_node_args(*node);
+    for (auto& [index, cost] : rule.outputs) {
+      auto port = free_ports_.find({node, false, index});
+      if (port == free_ports_.end() || index >= outputs.size()) {
+        continue;
+      }
+      auto& name = node_arg_get_name(*outputs[index]);
+      for (auto consumer : graph_get_consumer_nodes(graph_, name)) {
+        auto consumer_inputs = node_get_input_node_args(*consumer);
+        for (auto j = 0u; j < consumer_inputs.size(); ++j) {
+          if (consumer_inputs[j] != outputs[index] ||
+              free_ports_.count({consumer, true, j}) != 0) {
+            continue;
+          }
+          if (auto other = get_port(consumer, true, j)) {
+            add_edge(port->second, *other);
+          }
+        }
+      }
+    }
+  }
+
+  void add_edge(size_t a, size_t b) { edges_.emplace_back(a, b); }
+
+  // Dinic's max flow on source -> port (cut: bfloat16), port -> sink (cut:
+  // integer) and port <-> port (cut: they disagree). Returns by port
+  // whether it is on the sink side.
+  std::vector<bool> min_cut() {
+    auto num_of_ports = int_costs_.size();
+    auto source = num_of_ports;
+    auto sink = num_of_ports + 1;
+    auto g = std::vector<std::vector<size_t>>(num_of_ports + 2);
+    auto to = std::vector<size_t>();
+    auto cap = std::vector<int64_t>();
+    auto add = [&](size_t a, size_t b, int64_t c1, int64_t c2) {
+      g[a].push_back(to.size());
+      to.push_back(b);
+      cap.push_back(c1);
+      g[b].push_back(to.size());
+      to.push_back(a);
+      cap.push_back(c2);
+    };
+    for (auto p = 0u; p < num_of_ports; ++p) {
+      add(source, p, bf16_costs_[p], 0);
+      add(p, sink, int_costs_[p], 0);
+    }
+    for (auto& [a, b] : edges_) {
+      add(a, b, conversion_cost_, conversion_cost_);
+    }
+    auto level = std::vector<int64_t>(g.size());
+    auto next = std::vector<size_t>(g.size());
+    auto bfs = [&]() {
+      std::fill(level.begin(), level.end(), -1);
+      auto queue = std::queue<size_t>();
+      level[source] = 0;
+      queue.push(source);
+      while (!queue.empty()) {
+        auto v = queue.front();
+        queue.pop();
+        for (auto e : g[v]) {
+          if (cap[e] > 0 && level[to[e]] < 0) {
+            level[to[e]] = level[v] + 1;
+            queue.push(to[e]);
+          }
+        }
+      }
+      return level[sink] >= 0;
+    };
+    std::function<int64_t(size_t, int64_t)> dfs = [&](size_t v, int64_t f) {
+      if (v == sink) {
+        return f;
+      }
+      for (; next[v] < g[v].size(); ++next[v]) {
+        auto e = g[v][next[v]];
+        if (cap[e] > 0 && level[to[e]] == level[v] + 1) {
+          auto d = dfs(to[e], std::min(f, cap[e]));
+          if (d > 0) {
+            cap[e] -= d;
+            cap[e ^ 1] += d;
+            return d;
+          }
+        }
+      }
+      return int64_t(0);
+    };
+    while (bfs()) {
+      std::fill(next.begin(), next.end(), 0);
+      while (dfs(source, std::numeric_limits<int64_t>::max()) > 0) {
+      }
+    }
+    // after the last bfs(), the ports reachable from the source are on the
+    // source side.
+    auto ret = std::vector<bool>(num_of_ports);
+    for (auto p = 0u; p < num_of_ports; ++p) {
+      ret[p] = level[p] < 0;
+    }
+    return ret;
+  }
+
+private:
+  const Graph& graph_;
+  const int64_t conversion_cost_;
+  const std::string int_dtype_;
+  std::map<const Node*, OpDtypeRule> rules_;
+  std::map<PortKey, size_t> free_ports_;
+  std::map<PortKey, size_t> fixed_ports_;
+  // by port
+  std::vector<int64_t> int_costs_;
+  std::vector<int64_t> bf16_costs_;
+  std::vector<std::pair<size_t, size_t>> edges_;
+};
+
+} // namespace vaip::dtype_util
@@ -94,14 +94,14 @@ struct MergeQMatMul1 {
           if (out_dtype == (int)ONNX_NAMESPACE::TensorProto_DataType_UINT8) {
             qdq_params =
                 vaip::dd::qmatmulcalc::calculate_matmul_qdq_params_uint8_uint8(
-                    vaip::dd::fold2D<uint8_t>(w_data, *(w_shape.get())), a_sc,
-                    a_zp, w_sc, w_zp, q_sc, q_zp);
+                    {w_data, *(w_shape.get())}, a_sc, a_zp, w_sc, w_zp, q_sc,
+                    q_zp);
           } else if (out_dtype ==
                      (int)ONNX_NAMESPACE::TensorProto_DataType_UINT16) {
             qdq_params =
                 vaip::dd::qmatmulcalc::calculate_matmul_qdq_params_uint16_uint8(
-                    vaip::dd::fold2D<uint8_t>(w_data, *(w_shape.get())), a_sc,
-                    a_zp, w_sc, w_zp, q_sc, q_zp);
+                    {w_data, *(w_shape.get())}, a_sc, a_zp, w_sc, w_zp, q_sc,
+                    q_zp);
           } else {
             LOG(FATAL) << "Unknown Data Type";
           }
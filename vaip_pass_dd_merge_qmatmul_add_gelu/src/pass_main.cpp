@@ -110,15 +110,15 @@ struct MergeQMatMulAddGelu {
           if (out_dtype == (int)ONNX_NAMESPACE::TensorProto_DataType_UINT8) {
             qdq_params = vaip::dd::qmatmulcalc::
                 calculate_matmuladd_qdq_params_uint8_uint8(
-                    vaip::dd::fold2D<uint8_t>(w_data, *(w_shape.get())), b_data,
-                    a_sc, a_zp, w_sc, w_zp, b_sc, b_zp, q2_sc, q2_zp);
+                    {w_data, *(w_shape.get())}, b_data, a_sc, a_zp, w_sc, w_zp,
+                    b_sc, b_zp, q2_sc, q2_zp);
 
           } else if (out_dtype ==
                      (int)ONNX_NAMESPACE::TensorProto_DataType_UINT16) {
             qdq_params = vaip::dd::qmatmulcalc::
                 calculate_matmuladd_qdq_params_uint16_uint8(
-                    vaip::dd::fold2D<uint8_t>(w_data, *(w_shape.get())), b_data,
-                    a_sc, a_zp, w_sc, w_zp, b_sc, b_zp, q2_sc, q2_zp);
+                    {w_data, *(w_shape.get())}, b_data, a_sc, a_zp, w_sc, w_zp,
+                    b_sc, b_zp, q2_sc, q2_zp);
           } else {
             LOG(FATAL) << "Unknown Data Type";
           }
@@ -132,8 +132,8 @@ struct MergeQMatMulAddGelu4 {
             if (bias_dtype == (int)ONNX_NAMESPACE::TensorProto_DataType_INT32) {
               qdq_params = vaip::dd::qmatmulcalc::
                   calculate_matmuladd_qdq_params_uint8_uint8_b32(
-                      vaip::dd::fold2D<uint8_t>(w_data, *(w_shape.get())),
-                      b_data, a_sc, a_zp, w_sc, w_zp, b_sc, b_zp, q2_sc, q2_zp);
+                      {w_data, *(w_shape.get())}, b_data, a_sc, a_zp, w_sc,
+                      w_zp, b_sc, b_zp, q2_sc, q2_zp);
             } else {
               // qdq_params = vaip::dd::qmatmulcalc::
               //     calculate_matmuladd_qdq_params_uint8_uint8(
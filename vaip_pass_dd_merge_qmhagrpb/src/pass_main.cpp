@@ -392,7 +392,7 @@ struct MergeQMHAGRPB {
               node_arg_get_const_data_as_u8(*graph, *vsm_zp_node.node_arg);
 
           auto grpb_w_shape = node_arg_get_shape_i64(*grpb_w_node.node_arg);
-          auto grpb_w = vaip::dd::fold2D<uint8_t>(
+          auto grpb_w = vaip::dd::qmatmulcalc::WeightsView<uint8_t>(
               node_arg_get_const_data_as_u8s(*graph, *grpb_w_node.node_arg),
               *(grpb_w_shape.get()));
           float grpb_w_sc = node_arg_get_const_data_as_float(
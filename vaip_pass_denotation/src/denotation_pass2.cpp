@@ -211,11 +211,11 @@ void NodeActionState::check_is_modified() {
 void NodeActionState::update_layout() {
   for (auto i = 0u; i < inputs_.size(); ++i) {
     auto input_layout = input_layouts_[i].get();
-    VAIP_ORT_API(node_arg_set_denotation)(*inputs_[i], *input_layout);
+    vaip_core::node_arg_set_denotation(*inputs_[i], *input_layout);
   }
   for (auto i = 0u; i < outputs_.size(); ++i) {
     auto output_layout = output_layouts_[i].get();
-    VAIP_ORT_API(node_arg_set_denotation)(*outputs_[i], *output_layout);
+    vaip_core::node_arg_set_denotation(*outputs_[i], *output_layout);
   }
 }
 
@@ -34,7 +34,7 @@ struct DynamicInputBatch {
       if (input_shape[0] == -1) {
         MY_LOG(1) << "do graph_input_modify_batch.";
         input_shape[0] = 1;
-        VAIP_ORT_API(node_arg_set_shape_i64)(*input, input_shape);
+        node_arg_set_shape_i64(*input, input_shape);
         changed = true;
         graph_resolve(graph, true);
       }
@@ -6,31 +6,13 @@
 #include <functional>
 #include <glog/logging.h>
 #include <numeric>
+#include <unordered_map>
 
+#include "./transpose_f.hpp"
 #include "node_arg.hpp"
 #include "vaip/vaip.hpp"
 #include "vitis/ai/env_config.hpp"
 
-template <typename T>
-void transpose_data(const gsl::span<const int64_t>& shape,
-                    const gsl::span<const int64_t>& perm,
-                    const gsl::span<const T>& data, bool flip_hw, T* output);
-extern template void transpose_data<char>(const gsl::span<const int64_t>&,
-                                          const gsl::span<const int64_t>&,
-                                          const gsl::span<const char>&, bool,
-                                          char*);
-extern template void transpose_data<float>(const gsl::span<const int64_t>&,
-                                           const gsl::span<const int64_t>&,
-                                           const gsl::span<const float>&, bool,
-                                           float*);
-extern template void transpose_data<uint16_t>(const gsl::span<const int64_t>&,
-                                              const gsl::span<const int64_t>&,
-                                              const gsl::span<const uint16_t>&,
-                                              bool, uint16_t*);
-extern template void transpose_data<int16_t>(const gsl::span<const int64_t>&,
-                                             const gsl::span<const int64_t>&,
-                                             const gsl::span<const int16_t>&,
-                                             bool, int16_t*);
 DEF_ENV_PARAM(DEBUG_FUSE_TRANSPOSE, "0")
 #define MY_LOG(n) LOG_IF(INFO, ENV_PARAM(DEBUG_FUSE_TRANSPOSE) >= n)
 
@@ -84,21 +66,27 @@ layout_transform_vector_axis_alike_attr(const gsl::span<const int64_t>& value,
   return ret;
 }
 
-static std::vector<int64_t> expand_shape(const std::vector<int64_t>& shape,
-                                         size_t size) {
-  auto expand_shape = std::vector<int64_t>();
-  CHECK_LE(shape.size(), size);
-  if (shape.size() < size) {
-    for (auto i = 0u; i < size - shape.size(); i++) {
-      expand_shape.push_back(1);
-    }
-    for (auto dim : shape) {
-      expand_shape.push_back(dim);
-    }
-  } else {
-    expand_shape = std::vector<int64_t>(shape.begin(), shape.end());
-  }
-  return expand_shape;
+// `new_node` is `old_name` transposed by `perm`; its data is filled from
+// the original initializer when someone reads it.
+template <typename T>
+static void create_transposed_const(IPass* pass, TransposeViews& views,
+                                    const Node& new_node,
+                                    const std::string& old_name,
+                                    const std::vector<int64_t>& shape,
+                                    const std::vector<int64_t>& perm,
+                                    bool flip_hw) {
+  auto view = views.compose(old_name, shape, perm, flip_hw);
+  views.set(node_get_output_name(new_node), view);
+  auto size = (size_t)std::accumulate(shape.begin(), shape.end(), 1ull,
+                                      std::multiplies());
+  MY_LOG(1) << "transposed const " << node_get_output_name(new_node)
+            << " is a view of " << view.source;
+  pass->create_lazy_const(
+      new_node, size * sizeof(T), [pass, view](gsl::span<char> data) {
+        auto input_data = pass->get_const_data<T>(view.source.c_str());
+        transpose_data<T>(view.shape, view.perm, view.flip, input_data,
+                          reinterpret_cast<T*>(data.data()));
+      });
 }
 
 static bool change_paddings(NodeBuilder& builder, const Node& transpose_node,
@@ -330,7 +318,8 @@ template <typename From> AsSpan<From> as_span(const From& from) {
 }
 
 static std::unique_ptr<Rule>
-create_broadcast_op_const_rule(IPass* self, const std::string& op_type) {
+create_broadcast_op_const_rule(IPass* self, TransposeViews& views,
+                               const std::string& op_type) {
   auto builder = PatternBuilder();
   std::shared_ptr<Pattern> pat_x = builder.wildcard();
   std::shared_ptr<Pattern> pat_y = builder.xir_const_op();
@@ -383,21 +372,13 @@ create_broadcast_op_const_rule(IPass* self, const std::string& op_type) {
                              .set_shape(y_new_shape)
                              .set_anchor_point2(*ni_y.node_arg, {"const"})
                              .build();
-        auto size = (size_t)std::accumulate(
-            y_new_shape.begin(), y_new_shape.end(), 1ull, std::multiplies());
         auto old_name = node_get_output_name(*ni_y.node);
         // test case: model xilinxSR
         if (self->has_fix_info(old_name.c_str())) {
           self->copy_fix_info(*ni_y.node, new_ni_y);
         }
-        self->create_lazy_const(
-            new_ni_y, size * sizeof(float),
-            [self, y_expand_shape, new_order, old_name](gsl::span<char> data) {
-              auto input_data = self->get_const_data<float>(old_name.c_str());
-              transpose_data<float>(y_expand_shape, new_order, input_data,
-                                    false,
-                                    reinterpret_cast<float*>(data.data()));
-            });
+        create_transposed_const<float>(self, views, new_ni_y, old_name,
+                                       y_expand_shape, new_order, false);
         auto input_args = std::vector<const NodeArg*>();
         input_args.reserve(2u);
         // need keep the input order, otherwise maybe lead to error result, such
@@ -761,7 +742,8 @@ static std::unique_ptr<Rule> create_transpose_transpose_rule(IPass* self) {
       });
 }
 
-static std::unique_ptr<Rule> create_transpose_const_rule(IPass* pass) {
+static std::unique_ptr<Rule> create_transpose_const_rule(IPass* pass,
+                                                         TransposeViews& views) {
   auto builder = PatternBuilder();
   std::shared_ptr<Pattern> pat_const = builder.xir_const_op();
   std::shared_ptr<Pattern> pat_transpose =
@@ -783,23 +765,17 @@ static std::unique_ptr<Rule> create_transpose_const_rule(IPass* pass) {
                              .clone_op_type(*ni_const.node)
                              .set_anchor_point1(*ni_transpose.node)
                              .build();
-        auto size = (size_t)std::accumulate(shape.begin(), shape.end(), 1ull,
-                                            std::multiplies());
         auto old_name = node_get_output_name(*ni_const.node);
         if (pass->has_fix_info(old_name.c_str())) {
           pass->copy_fix_info(*ni_const.node, new_node);
         }
-        pass->create_lazy_const(
-            new_node, size * sizeof(float),
-            [pass, shape, perm, flip_hw, old_name](gsl::span<char> data) {
-              auto input_data = pass->get_const_data<float>(old_name.c_str());
-              transpose_data<float>(shape, perm, input_data, flip_hw == 1,
-                                    reinterpret_cast<float*>(data.data()));
-            });
+        create_transposed_const<float>(pass, views, new_node, old_name, shape,
+                                       perm, flip_hw == 1);
         return true;
       });
 }
-static std::unique_ptr<Rule> create_const_dq_transpose_rule(IPass* pass) {
+static std::unique_ptr<Rule>
+create_const_dq_transpose_rule(IPass* pass, TransposeViews& views) {
   auto builder = PatternBuilder();
   std::shared_ptr<Pattern> pat_x = builder.xir_const_op();
   std::shared_ptr<Pattern> pat_scale = builder.xir_const_op();
@@ -853,41 +829,19 @@ static std::unique_ptr<Rule> create_const_dq_transpose_rule(IPass* pass) {
             .set_anchor_point1(*ni_transpose.node)
             .build();
 
-        auto size = (size_t)std::accumulate(x_shape.begin(), x_shape.end(),
-                                            1ull, std::multiplies());
-
         auto old_name = node_get_output_name(*ni_x.node);
         auto data_type = node_arg_get_element_type(*ni_x.node_arg);
         if (data_type == onnx::TensorProto_DataType_UINT16) {
-          pass->create_lazy_const(
-              new_x, size * sizeof(uint16_t),
-              [pass, x_shape, perm, flip_hw, old_name](gsl::span<char> data) {
-                auto input_data =
-                    pass->get_const_data<uint16_t>(old_name.c_str());
-                transpose_data<uint16_t>(
-                    x_shape, perm, input_data, flip_hw == 1,
-                    reinterpret_cast<uint16_t*>(data.data()));
-              });
+          create_transposed_const<uint16_t>(pass, views, new_x, old_name,
+                                            x_shape, perm, flip_hw == 1);
         } else if (data_type == onnx::TensorProto_DataType_INT16) {
-          pass->create_lazy_const(
-              new_x, size * sizeof(int16_t),
-              [pass, x_shape, perm, flip_hw, old_name](gsl::span<char> data) {
-                auto input_data =
-                    pass->get_const_data<int16_t>(old_name.c_str());
-                transpose_data<int16_t>(
-                    x_shape, perm, input_data, flip_hw == 1,
-                    reinterpret_cast<int16_t*>(data.data()));
-              });
+          create_transposed_const<int16_t>(pass, views, new_x, old_name,
+                                           x_shape, perm, flip_hw == 1);
         } else if (data_type == onnx::TensorProto_DataType_UINT8 ||
                    data_type == onnx::TensorProto_DataType_INT8) {
           // create_lazy_const int8/uint8
-          pass->create_lazy_const(
-              new_x, size * sizeof(char),
-              [pass, x_shape, perm, flip_hw, old_name](gsl::span<char> data) {
-                auto input_data = pass->get_const_data<char>(old_name.c_str());
-                transpose_data<char>(x_shape, perm, input_data, flip_hw == 1,
-                                     reinterpret_cast<char*>(data.data()));
-              });
+          create_transposed_const<char>(pass, views, new_x, old_name, x_shape,
+                                        perm, flip_hw == 1);
         } else {
           LOG(WARNING) << "cancel fuse transpose with dequantize_linear, not "
                           "supported data_type "
@@ -899,7 +853,8 @@ static std::unique_ptr<Rule> create_const_dq_transpose_rule(IPass* pass) {
 }
 
 // test case modelzoo #1 #26
-static std::unique_ptr<Rule> create_concat_rule(IPass* pass) {
+static std::unique_ptr<Rule> create_concat_rule(IPass* pass,
+                                                TransposeViews& views) {
   auto builder = PatternBuilder();
   std::shared_ptr<Pattern> pat_concat = builder.wildcard();
   return Rule::create_rule(
@@ -968,20 +923,12 @@ static std::unique_ptr<Rule> create_concat_rule(IPass* pass) {
                     .set_shape(new_shape)
                     .set_anchor_point2(*concat_input.node_arg, {"const"})
                     .build();
-            auto size = (size_t)std::accumulate(
-                new_shape.begin(), new_shape.end(), 1ull, std::multiplies());
             auto old_name = node_get_output_name(*concat_input.node);
             if (pass->has_fix_info(old_name.c_str())) {
               pass->copy_fix_info(*concat_input.node, new_node);
             }
-            pass->create_lazy_const(
-                new_node, size * sizeof(float),
-                [pass, shape, new_order, old_name](gsl::span<char> data) {
-                  auto input_data =
-                      pass->get_const_data<float>(old_name.c_str());
-                  transpose_data<float>(shape, new_order, input_data, false,
-                                        reinterpret_cast<float*>(data.data()));
-                });
+            create_transposed_const<float>(pass, views, new_node, old_name,
+                                           shape, new_order, false);
             input_args.push_back(&((node_get_output_node_arg)(new_node)));
           } else {
             auto transpose_inputs =
@@ -1359,33 +1306,34 @@ struct FuseTranspose {
                                       "reduction_sum"), // model resnest14d
         create_shape_squeeze_siso_rule(&self),          // model jx_nest_base
         create_transpose_transpose_rule(&self),         //
-        create_transpose_const_rule(&self),             //
-        create_const_dq_transpose_rule(&self),          //
+        create_transpose_const_rule(&self, views_),     //
+        create_const_dq_transpose_rule(&self, views_), //
         create_broadcast_op_rule(&self, "add"),         //
         create_broadcast_op_rule(&self, "sub"),         //
         create_broadcast_op_rule(&self, "mul"),         //
         create_broadcast_op_rule(&self, "pow"),         //
         create_expand_op_rule(&self),                   // model mxgan
         create_tile_op_rule(&self),                     // model G3/GT
-        create_broadcast_op_const_rule(&self, "prelu"), // issue #1246
-        create_broadcast_op_const_rule(&self, "add"),   //
-        create_broadcast_op_const_rule(&self, "sub"),   //
-        create_broadcast_op_const_rule(&self, "div"),   //
-        create_broadcast_op_const_rule(&self, "max"),   //
-        create_broadcast_op_const_rule(&self, "min"),   //
-        create_broadcast_op_const_rule(&self, "mul"),   // model efficientnet-b4
-        create_broadcast_op_const_rule(&self, "pow"),
+        create_broadcast_op_const_rule(&self, views_, "prelu"), // issue #1246
+        create_broadcast_op_const_rule(&self, views_, "add"),   //
+        create_broadcast_op_const_rule(&self, views_, "sub"),   //
+        create_broadcast_op_const_rule(&self, views_, "div"),   //
+        create_broadcast_op_const_rule(&self, views_, "max"),   //
+        create_broadcast_op_const_rule(&self, views_, "min"),   //
+        create_broadcast_op_const_rule(&self, views_,
+                                       "mul"), // model efficientnet-b4
+        create_broadcast_op_const_rule(&self, views_, "pow"),
         create_broadcast_op_transpose_immune_rule(&self, "pow"),
         create_broadcast_op_transpose_immune_rule(&self, "add"), // no test
         create_broadcast_op_transpose_immune_rule(&self, "sub"), // no PSO0
         create_broadcast_op_transpose_immune_rule(&self, "div"), // no PSO0
         // case now
         create_broadcast_op_transpose_immune_rule(
-            &self, "mul"),            // model efficientnet-b4
-        create_concat_rule(&self),    //
-        create_batchnorm_rule(&self), // model 5001
-                                      // model 22 : reshape(transpose(*))
-        create_reshape_rule(&self),   // model # RetinaNet
+            &self, "mul"),                 // model efficientnet-b4
+        create_concat_rule(&self, views_), //
+        create_batchnorm_rule(&self),      // model 5001
+                                           // model 22 : reshape(transpose(*))
+        create_reshape_rule(&self),        // model # RetinaNet
         create_siso_rule(&self, "com.xilinx:identity"),
     };
     auto chain =
@@ -1396,6 +1344,7 @@ struct FuseTranspose {
   } // namespace
 
 public:
+  TransposeViews views_;
 };
 } // namespace
 
@@ -3,90 +3,127 @@
  *  Licensed under the MIT License.
  */
 
+#include "./transpose_f.hpp"
 #include "vaip/vaip.hpp"
 #include <glog/logging.h>
-#include <vitis/ai/dim_calc.hpp>
-static std::vector<int32_t>
-get_dst_shape(const std::vector<int32_t>& src_shape,
-              const gsl::span<const int32_t>& order) {
-  auto dim_size = src_shape.size();
-  auto dst_shape = std::vector<int32_t>(); // src OIHW dst OHWI
-  dst_shape.reserve(dim_size);
-  for (auto idx : order) {
-    dst_shape.push_back(src_shape[idx]);
-  }
-  return dst_shape;
-}
-static int get_element_num(const std::vector<int32_t> shape) {
-  auto ret = 1;
-  for (auto dim : shape) {
-    ret *= dim;
-  }
-  return ret;
-}
-static std::vector<int32_t>
-trans_shape_i64_to_i32(const gsl::span<const int64_t>& shape) {
-  auto ret = std::vector<int32_t>(shape.size());
-  for (auto i = 0u; i < shape.size(); ++i) {
-    ret[i] = (int32_t)shape[i];
-  }
-  return ret;
-}
 
-static std::vector<int32_t> trans_idx(const std::vector<int32_t>& input_idx,
-                                      const std::vector<int32_t>& order) {
-  auto sz = input_idx.size();
-  auto output_idx = std::vector<int32_t>(sz, 0);
-  for (auto i = 0u; i < sz; ++i) {
-    output_idx[i] = input_idx[order[i]];
-  }
-  return output_idx;
-}
+// square tile over the dst innermost dim and the dim that is innermost in
+// src, so both the reads and the writes stay within a few cache lines.
+static constexpr int64_t TILE = 16;
 
+// dst = transpose(src, perm), where dst dim k is src dim perm[k] and the
+// src dims with flip[d] set are read in reverse. Every element is moved
+// once; the offsets are stepped by strides, no per element index math.
 template <typename T>
 void transpose_data(const gsl::span<const int64_t>& shape,
                     const gsl::span<const int64_t>& perm,
-                    const gsl::span<const T>& data, bool flip_hw, T* ret) {
-  auto src_shape = trans_shape_i64_to_i32(shape);
-  auto order = trans_shape_i64_to_i32(perm);
-  CHECK_EQ(src_shape.size(), order.size());
-  auto dst_shape = get_dst_shape(src_shape, order);
-
-  auto size = get_element_num(src_shape);
-  CHECK_EQ(data.size(), size);
-  auto src_dim_calc = std::make_unique<vitis::ai::DimCalc>(src_shape);
-  auto dst_dim_calc = std::make_unique<vitis::ai::DimCalc>(dst_shape);
-  if (flip_hw) {
-    for (auto i = 0u; i < data.size(); ++i) {
-      auto src_idx = src_dim_calc->index(i);
-      src_idx[2] = src_shape[2] - src_idx[2] - 1;
-      src_idx[3] = src_shape[3] - src_idx[3] - 1;
-      auto dst_idx = trans_idx(src_idx, order);
-      auto dst_offset = dst_dim_calc->offset(dst_idx);
-      ret[dst_offset] = data[i];
+                    const std::vector<bool>& flip,
+                    const gsl::span<const T>& data, T* ret) {
+  auto rank = (int)shape.size();
+  CHECK_EQ(perm.size(), shape.size());
+  CHECK_EQ(flip.size(), shape.size());
+  auto src_stride = std::vector<int64_t>(rank, 1);
+  for (auto d = rank - 2; d >= 0; --d) {
+    src_stride[d] = src_stride[d + 1] * shape[d + 1];
+  }
+  auto size = rank == 0 ? (int64_t)1 : src_stride[0] * shape[0];
+  CHECK_EQ((int64_t)data.size(), size);
+  if (size == 0) {
+    return;
+  }
+  // dst dim k walks src with `step[k]`, starting from `base`
+  auto dst_shape = std::vector<int64_t>(rank);
+  auto dst_stride = std::vector<int64_t>(rank, 1);
+  auto step = std::vector<int64_t>(rank);
+  int64_t base = 0;
+  for (auto d = 0; d < rank; ++d) {
+    if (flip[d]) {
+      base += (shape[d] - 1) * src_stride[d];
+    }
+  }
+  for (auto k = 0; k < rank; ++k) {
+    dst_shape[k] = shape[perm[k]];
+    step[k] = flip[perm[k]] ? -src_stride[perm[k]] : src_stride[perm[k]];
+  }
+  for (auto k = rank - 2; k >= 0; --k) {
+    dst_stride[k] = dst_stride[k + 1] * dst_shape[k + 1];
+  }
+  if (rank == 0) {
+    ret[0] = data[0];
+    return;
+  }
+  auto a = rank - 1;
+  auto b = a;
+  for (auto k = 0; k < rank; ++k) {
+    if (perm[k] == rank - 1) {
+      b = k;
+    }
+  }
+  // the remaining dims are walked with an odometer
+  auto outer = std::vector<int>();
+  for (auto k = 0; k < rank; ++k) {
+    if (k != a && k != b) {
+      outer.push_back(k);
+    }
+  }
+  auto counter = std::vector<int64_t>(outer.size(), 0);
+  auto src_off = base;
+  auto dst_off = int64_t{0};
+  const T* src = data.data();
+  for (;;) {
+    if (a == b) {
+      auto s = src + src_off;
+      auto d = ret + dst_off;
+      for (auto i = 0; i < dst_shape[a]; ++i) {
+        d[i] = s[i * step[a]];
+      }
+    } else {
+      for (int64_t jb = 0; jb < dst_shape[b]; jb += TILE) {
+        auto eb = std::min(jb + TILE, dst_shape[b]);
+        for (int64_t ja = 0; ja < dst_shape[a]; ja += TILE) {
+          auto ea = std::min(ja + TILE, dst_shape[a]);
+          for (auto ib = jb; ib < eb; ++ib) {
+            auto s = src + src_off + ib * step[b];
+            auto d = ret + dst_off + ib * dst_stride[b];
+            for (auto ia = ja; ia < ea; ++ia) {
+              d[ia] = s[ia * step[a]];
+            }
+          }
+        }
+      }
+    }
+    auto k = (int)outer.size() - 1;
+    for (; k >= 0; --k) {
+      auto dim = outer[k];
+      src_off += step[dim];
+      dst_off += dst_stride[dim];
+      if (++counter[k] < dst_shape[dim]) {
+        break;
+      }
+      src_off -= step[dim] * dst_shape[dim];
+      dst_off -= dst_stride[dim] * dst_shape[dim];
+      counter[k] = 0;
     }
-  } else {
-    for (auto i = 0u; i < data.size(); ++i) {
-      auto src_idx = src_dim_calc->index(i);
-      auto dst_idx = trans_idx(src_idx, order);
-      auto dst_offset = dst_dim_calc->offset(dst_idx);
-      ret[dst_offset] = data[i];
+    if (k < 0) {
+      break;
     }
   }
-  return;
 }
 template void transpose_data<char>(const gsl::span<const int64_t>&,
                                    const gsl::span<const int64_t>&,
-                                   const gsl::span<const char>&, bool, char*);
+                                   const std::vector<bool>&,
+                                   const gsl::span<const char>&, char*);
 template void transpose_data<float>(const gsl::span<const int64_t>&,
                                     const gsl::span<const int64_t>&,
-                                    const gsl::span<const float>&, bool,
-                                    float*);
+                                    const std::vector<bool>&,
+                                    const gsl::span<const float>&, float*);
 template void transpose_data<uint16_t>(const gsl::span<const int64_t>&,
                                        const gsl::span<const int64_t>&,
-                                       const gsl::span<const uint16_t>&, bool,
+                                       const std::vector<bool>&,
+                                       const gsl::span<const uint16_t>&,
                                        uint16_t*);
 template void transpose_data<int16_t>(const gsl::span<const int64_t>&,
                                       const gsl::span<const int64_t>&,
-                                      const gsl::span<const int16_t>&, bool,
+                                      const std::vector<bool>&,
+                                      const gsl::span<const int16_t>&,
                                       int16_t*);
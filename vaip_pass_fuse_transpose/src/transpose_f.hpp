@@ -0,0 +1,133 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+#pragma once
+
+#include <glog/logging.h>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vaip/vaip.hpp"
+
+// dst = transpose(src, perm), see transpose_f.cpp.
+template <typename T>
+void transpose_data(const gsl::span<const int64_t>& shape,
+                    const gsl::span<const int64_t>& perm,
+                    const std::vector<bool>& flip,
+                    const gsl::span<const T>& data, T* output);
+extern template void transpose_data<char>(const gsl::span<const int64_t>&,
+                                          const gsl::span<const int64_t>&,
+                                          const std::vector<bool>&,
+                                          const gsl::span<const char>&, char*);
+extern template void transpose_data<float>(const gsl::span<const int64_t>&,
+                                           const gsl::span<const int64_t>&,
+                                           const std::vector<bool>&,
+                                           const gsl::span<const float>&,
+                                           float*);
+extern template void transpose_data<uint16_t>(const gsl::span<const int64_t>&,
+                                              const gsl::span<const int64_t>&,
+                                              const std::vector<bool>&,
+                                              const gsl::span<const uint16_t>&,
+                                              uint16_t*);
+extern template void transpose_data<int16_t>(const gsl::span<const int64_t>&,
+                                             const gsl::span<const int64_t>&,
+                                             const std::vector<bool>&,
+                                             const gsl::span<const int16_t>&,
+                                             int16_t*);
+
+namespace vaip_core {
+
+// `shape` with leading 1s added up to `size` dims.
+inline std::vector<int64_t> expand_shape(const std::vector<int64_t>& shape,
+                                         size_t size) {
+  auto expand_shape = std::vector<int64_t>();
+  CHECK_LE(shape.size(), size);
+  if (shape.size() < size) {
+    for (auto i = 0u; i < size - shape.size(); i++) {
+      expand_shape.push_back(1);
+    }
+    for (auto dim : shape) {
+      expand_shape.push_back(dim);
+    }
+  } else {
+    expand_shape = std::vector<int64_t>(shape.begin(), shape.end());
+  }
+  return expand_shape;
+}
+
+// A constant that is `source` transposed by `perm`, with the source dims
+// in `flip` read in reverse.
+struct TransposeView {
+  std::string source;
+  std::vector<int64_t> shape; // of `source`
+  std::vector<int64_t> perm;
+  std::vector<bool> flip;
+
+  std::vector<int64_t> dst_shape() const {
+    auto ret = std::vector<int64_t>(perm.size());
+    for (auto i = 0u; i < perm.size(); ++i) {
+      ret[i] = shape[perm[i]];
+    }
+    return ret;
+  }
+};
+
+// Sinking a transpose through a constant happens again and again on the
+// same weights. Instead of a lazy const that transposes the previous lazy
+// const, every new constant records its view of the original initializer,
+// composed with all transposes so far, and is copied from it once when
+// its data is read.
+class TransposeViews {
+public:
+  // the view of `transpose(name, perm)` with `shape` the shape of `name`,
+  // maybe with leading 1s added.
+  TransposeView compose(const std::string& name,
+                        const std::vector<int64_t>& shape,
+                        const std::vector<int64_t>& perm, bool flip_hw) const {
+    auto view = TransposeView{name, shape, std::vector<int64_t>(shape.size()),
+                              std::vector<bool>(shape.size(), false)};
+    std::iota(view.perm.begin(), view.perm.end(), 0);
+    auto it = views_.find(name);
+    if (it != views_.end() && it->second.perm.size() <= shape.size()) {
+      auto base = it->second;
+      auto expand = shape.size() - base.perm.size();
+      auto expanded = TransposeView{base.source,
+                                    expand_shape(base.shape, shape.size()),
+                                    std::vector<int64_t>(shape.size()),
+                                    std::vector<bool>(expand, false)};
+      std::iota(expanded.perm.begin(), expanded.perm.begin() + expand, 0);
+      for (auto i = 0u; i < base.perm.size(); ++i) {
+        expanded.perm[expand + i] = base.perm[i] + (int64_t)expand;
+      }
+      expanded.flip.insert(expanded.flip.end(), base.flip.begin(),
+                           base.flip.end());
+      if (expanded.dst_shape() == shape) {
+        view = std::move(expanded);
+      }
+    }
+    if (flip_hw) {
+      CHECK_GE(view.perm.size(), 4u) << "flip_hw on a const of rank < 4";
+      view.flip[view.perm[2]] = !view.flip[view.perm[2]];
+      view.flip[view.perm[3]] = !view.flip[view.perm[3]];
+    }
+    auto composed = std::vector<int64_t>(perm.size());
+    CHECK_EQ(perm.size(), view.perm.size());
+    for (auto i = 0u; i < perm.size(); ++i) {
+      composed[i] = view.perm[perm[i]];
+    }
+    view.perm = std::move(composed);
+    return view;
+  }
+
+  void set(const std::string& name, const TransposeView& view) {
+    views_[name] = view;
+  }
+
+private:
+  std::unordered_map<std::string, TransposeView> views_;
+};
+
+} // namespace vaip_core
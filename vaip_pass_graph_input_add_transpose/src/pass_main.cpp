@@ -96,14 +96,13 @@ struct GraphInputAddTranspose {
               .set_anchor_point3(*graph_input, {"transpose"}, *shape)
               .build();
       // correct graph input shape and denotation
-      VAIP_ORT_API(node_arg_set_shape_i64)(*graph_input, new_shape);
-      VAIP_ORT_API(node_arg_set_denotation)(*graph_input, {"N", "H", "W", "C"});
+      node_arg_set_shape_i64(*graph_input, new_shape);
+      node_arg_set_denotation(*graph_input, {"N", "H", "W", "C"});
 
       // get new transpose node arg and correct its denotation
       auto& transpose_output_node_arg =
           node_get_output_node_arg(transpose_node);
-      VAIP_ORT_API(node_arg_set_denotation)
-      (transpose_output_node_arg, {"N", "C", "H", "W"});
+      node_arg_set_denotation(transpose_output_node_arg, {"N", "C", "H", "W"});
 
       // replace consumer nodes
       for (auto node : consumers) {
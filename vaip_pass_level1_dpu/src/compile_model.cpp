@@ -231,22 +231,21 @@ std::string get_xcompiler_fingerprint(const PassContext& pass_context,
   return ret;
 }
 std::unique_ptr<xir::Graph>
-compiler_xir_model(std::unique_ptr<xir::Graph> graph,
-                   const PassContext& pass_context,
+compiler_xir_model(xir::Graph& graph, const PassContext& pass_context,
                    const PassDpuParamProto& dpu_param) {
   auto compile_options = create_compile_attrs(pass_context, dpu_param);
   LOG_IF(INFO, ENV_PARAM(DEBUG_COMPILE_MODEL))
       << " compiler xir model."
       << "\ncompile attrs: " << compile_options->debug_info();
-  if (graph->get_root_subgraph()->is_leaf()) {
-    graph->get_root_subgraph()->create_children(); // xcompiler need this graph
-                                                   // must be create_children();
+  if (graph.get_root_subgraph()->is_leaf()) {
+    graph.get_root_subgraph()->create_children(); // xcompiler need this graph
+                                                  // must be create_children();
   }
 
   std::unique_ptr<xir::Graph> ret;
 #if WITH_XCOMPILER
   auto model = std::string();
-  graph->serialize_to_string(&model);
+  graph.serialize_to_string(&model);
   auto allocator = [](void* state, size_t size) {
     auto s = (std::string*)state;
     s->resize(size);
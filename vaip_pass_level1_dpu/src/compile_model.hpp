@@ -14,9 +14,10 @@ namespace vaip_core {
 std::string get_xclbin_fullpath(const std::string& xclbin);
 std::string get_xcompiler_fingerprint(const PassContext& pass_context,
                                       const PassDpuParamProto& dpu_param);
+// The compiler works on a serialized copy of `graph`, so `graph` is left
+// as it is, except that a leaf root subgraph gets its children created.
 std::unique_ptr<xir::Graph>
-compiler_xir_model(std::unique_ptr<xir::Graph> graph,
-                   const PassContext& pass_context,
+compiler_xir_model(xir::Graph& graph, const PassContext& pass_context,
                    const PassDpuParamProto& dpu_param);
 
 } // namespace vaip_core
@@ -0,0 +1,112 @@
+/*
+ *  Copyright (C) 2023 – 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *  Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include "vaip/xir_headers.hpp"
+#include <cstring>
+#include <functional>
+#include <gsl/span>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace vaip_core {
+
+/// graph attr of an exported xir graph: the name of every constant that
+/// shares another constant's op -> the name of that op.
+constexpr char XIR_CONST_ALIASES[] = "vaip_const_aliases";
+
+/// Constants of one export. xir attrs hold values, not references, so the
+/// only way to share a weight buffer is to share the op: a constant whose
+/// key (data type, shape, attrs) and bytes equal an earlier one is not
+/// added again, its name resolves to the earlier op instead. Identical
+/// weights used by several subgraphs are then held by xir only once.
+///
+/// save_aliases() records the shared names in the xir graph, so that
+/// get_xir_tensor() finds a constant by its onnx name either way.
+class ConstPool {
+public:
+  explicit ConstPool(bool enabled = true) : enabled_{enabled} {}
+
+  /// the op for constant `name`; `add_op` is invoked only if no constant
+  /// with the same key and payload was added before.
+  xir::Op* intern(const std::string& name, const std::string& key,
+                  gsl::span<const char> data,
+                  const std::function<xir::Op*()>& add_op) {
+    if (!enabled_) {
+      return add_op();
+    }
+    // the payload is hashed once; equal hashes are confirmed bytewise.
+    auto hash = std::hash<std::string_view>()(
+                    std::string_view(data.data(), data.size())) ^
+                std::hash<std::string>()(key);
+    auto range = entries_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto& e = it->second;
+      if (e.key == key && e.data.size() == data.size() &&
+          (e.data.data() == data.data() ||
+           std::memcmp(e.data.data(), data.data(), data.size()) == 0)) {
+        aliases_[name] = e.op;
+        bytes_saved_ += data.size();
+        return e.op;
+      }
+    }
+    auto op = add_op();
+    entries_.emplace(hash, Entry{key, data, op});
+    return op;
+  }
+
+  const xir::Op* get_op(const xir::Graph* xir_graph,
+                        const std::string& name) const {
+    auto it = aliases_.find(name);
+    return it != aliases_.end() ? it->second : xir_graph->get_op(name);
+  }
+
+  /// writes the shared names into XIR_CONST_ALIASES of `xir_graph`.
+  void save_aliases(xir::Graph* xir_graph) const {
+    if (aliases_.empty()) {
+      return;
+    }
+    auto aliases = std::map<std::string, std::string>();
+    for (auto& alias : aliases_) {
+      aliases.emplace(alias.first, alias.second->get_name());
+    }
+    xir_graph->set_attr(XIR_CONST_ALIASES, aliases);
+  }
+
+  size_t num_aliases() const { return aliases_.size(); }
+  size_t bytes_saved() const { return bytes_saved_; }
+
+private:
+  struct Entry {
+    std::string key;
+    // points into the onnx graph or the pass context, both outlive the
+    // export.
+    gsl::span<const char> data;
+    xir::Op* op;
+  };
+  bool enabled_;
+  std::unordered_multimap<size_t, Entry> entries_;
+  std::unordered_map<std::string, xir::Op*> aliases_;
+  size_t bytes_saved_ = 0;
+};
+
+/// tensor `name` of an exported xir graph; a shared constant resolves to
+/// the tensor of the op holding its data. nullptr if there is none.
+inline const xir::Tensor* get_xir_tensor(const xir::Graph* xir_graph,
+                                         const std::string& name) {
+  auto ret = xir_graph->get_tensor(name);
+  if (ret != nullptr || !xir_graph->has_attr(XIR_CONST_ALIASES)) {
+    return ret;
+  }
+  auto aliases = xir_graph->get_attr<std::map<std::string, std::string>>(
+      XIR_CONST_ALIASES);
+  auto it = aliases.find(name);
+  return it != aliases.end() ? xir_graph->get_tensor(it->second) : nullptr;
+}
+
+} // namespace vaip_core
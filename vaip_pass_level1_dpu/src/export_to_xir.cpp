@@ -4,14 +4,20 @@
  */
 
 #include <algorithm>
+#include <any>
 #include <cstdint>
+#include <cstring>
 #include <glog/logging.h>
 
+#include "./const_pool.hpp"
 #include "./export_to_xir.hpp"
 
 #include "vitis/ai/env_config.hpp"
+#include <functional>
 #include <memory>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
 #include <vaip/my_ort.h>
 
 #include <xir/op/op_def.hpp>
@@ -21,11 +27,22 @@ using namespace ::onnxruntime;
 #include "./xir_hack.inc"
 
 DEF_ENV_PARAM(DEBUG_EXPORT_TO_XIR, "0")
+DEF_ENV_PARAM(XLNX_EXPORT_XIR_DEDUP_CONST, "1")
 
 using namespace ::xir;
 namespace vaip_core {
-static void build_op(IPass& pass, const onnxruntime::Graph& graph,
-                     xir::Graph* xir_graph, const Node& node);
+
+namespace {
+// the "data" attr of a const op; the bytes are copied once, into the attr.
+static void set_data_attr(xir::Attrs* attrs, gsl::span<const char> data) {
+  attrs->set_attr("data", xir::any(std::in_place_type<std::vector<char>>,
+                                   data.begin(), data.end()));
+}
+} // namespace
+
+static void build_op(IPass& pass, ConstPool& pool,
+                     const onnxruntime::Graph& graph, xir::Graph* xir_graph,
+                     const Node& node);
 static std::vector<int> node_arg_get_shape(const NodeArg& node_arg) {
   auto shape = node_arg_get_shape_i64(node_arg);
   CHECK(shape != nullptr) << node_arg_as_string(node_arg) << " shape absent";
@@ -175,13 +192,13 @@ ints_as_vector_int(const ONNX_NAMESPACE::AttributeProto& attr_proto) {
   }
   return ret;
 }
-static void build_constant(xir::Graph* xir_graph,
+static void build_constant(ConstPool& pool, xir::Graph* xir_graph,
                            const onnxruntime::Graph& graph) {
   auto constants = VAIP_ORT_API(graph_get_all_initialized_tensors)(graph);
   int counter = 0;
   for (auto constant : constants) {
     auto name = constant.first;
-    if (xir_graph->get_op(name)) {
+    if (pool.get_op(xir_graph, name)) {
       // for some reasons, onnx subgraph and parent graph might have same
       // constant intializers.
       continue;
@@ -208,22 +225,26 @@ static void build_constant(xir::Graph* xir_graph,
         s = 1;
       }
     }
-    attrs->set_attr<std::vector<int>>("shape", shape);
-    attrs->set_attr<std::string>(
-        "data_type", onnx_data_type_to_xir_data_type(
+    auto data_type = onnx_data_type_to_xir_data_type(
                          VAIP_ORT_API(tensor_proto_data_type)(tensor_proto))
-                         .to_string());
+                         .to_string();
     auto raw_values = tensor_proto_as_raw(graph, tensor_proto);
-    attrs->set_attr<std::vector<char>>(
-        "data", std::vector<char>(raw_values.begin(), raw_values.end()));
-    auto input_ops_map = std::map<std::string, std::vector<xir::Op*>>{};
-    xir::Subgraph* subgraph = nullptr;
-    LOG_IF(INFO, ENV_PARAM(DEBUG_EXPORT_TO_XIR) >= 1)
-        << "add const xir op:" << name;
-    auto op = xir_graph->add_op(name, type, std::move(attrs), input_ops_map,
-                                subgraph);
+    auto key = data_type + container_as_string(shape);
+    auto op = pool.intern(name, key, raw_values, [&]() {
+      attrs->set_attr<std::vector<int>>("shape", shape);
+      attrs->set_attr<std::string>("data_type", data_type);
+      set_data_attr(attrs.get(), raw_values);
+      auto input_ops_map = std::map<std::string, std::vector<xir::Op*>>{};
+      xir::Subgraph* subgraph = nullptr;
+      LOG_IF(INFO, ENV_PARAM(DEBUG_EXPORT_TO_XIR) >= 1)
+          << "add const xir op:" << name;
+      counter++;
+      return xir_graph->add_op(name, type, std::move(attrs), input_ops_map,
+                               subgraph);
+    });
     CHECK(op != nullptr);
-    counter++;
+    LOG_IF(INFO, ENV_PARAM(DEBUG_EXPORT_TO_XIR) >= 1 && op->get_name() != name)
+        << "const xir op: " << name << " shares data with " << op->get_name();
   }
   LOG_IF(INFO, ENV_PARAM(DEBUG_EXPORT_TO_XIR) >= 1)
       << "there are " << counter << " const ops";
@@ -382,18 +403,19 @@ convert_extra_attrs(const onnxruntime::Graph& graph,
   }
 }
 
-void build_fused_op(IPass& pass, const onnxruntime::Graph& origin_graph,
-                    xir::Graph* xir_graph, const Node& node) {
+static void build_fused_op(IPass& pass, ConstPool& pool,
+                           const onnxruntime::Graph& origin_graph,
+                           xir::Graph* xir_graph, const Node& node) {
   LOG_IF(INFO, ENV_PARAM(DEBUG_EXPORT_TO_XIR) >= 1)
       << "build fused op: node=" << node_as_string(node);
   auto& graph = VAIP_ORT_API(node_get_function_body)(node);
   LOG_IF(INFO, ENV_PARAM(DEBUG_EXPORT_TO_XIR) >= 1)
       << "graph=" << vaip_core::graph_as_string(graph);
-  build_constant(xir_graph, graph);
+  build_constant(pool, xir_graph, graph);
   // GraphViewer graph_viewer(graph);
   for (auto node_idx : graph_get_node_in_topoligical_order(graph)) {
     auto node1 = VAIP_ORT_API(graph_get_node)(graph, node_idx);
-    build_op(pass, origin_graph, xir_graph, *node1);
+    build_op(pass, pool, origin_graph, xir_graph, *node1);
   }
 }
 
@@ -449,14 +471,35 @@ static void build_selector_op(xir::Graph* xir_graph, const xir::Op* op,
   xir_graph->add_op(op_name, type, std::move(attrs), input_ops_map, subgraph);
 }
 
-static void build_op(IPass& pass, const onnxruntime::Graph& graph,
-                     xir::Graph* xir_graph, const Node& node) {
+// everything but the payload that goes into the attrs of a const op
+static std::string
+const_op_key(const NodeArg& node_arg, const std::string& domain,
+             const Node& node,
+             const std::vector<AttributeProtoPtr>& extra_attrs) {
+  std::ostringstream str;
+  str << domain << ":" << node_arg_get_xir_dtype(node_arg).to_string();
+  auto shape = node_arg_get_shape_i64(node_arg);
+  if (shape != nullptr) {
+    str << container_as_string(*shape);
+  }
+  for (auto attr : node_get_attributes(node)) {
+    str << attr_proto_as_string(*attr);
+  }
+  for (auto& attr : extra_attrs) {
+    str << attr_proto_as_string(*attr);
+  }
+  return str.str();
+}
+
+static void build_op(IPass& pass, ConstPool& pool,
+                     const onnxruntime::Graph& graph, xir::Graph* xir_graph,
+                     const Node& node) {
   std::string type = convert_to_xir_op_type(VAIP_ORT_API(node_op_domain)(node),
                                             VAIP_ORT_API(node_op_type)(node));
 
   auto& op_def = *op_def_factory()->get_op_def(type);
   if (VAIP_ORT_API(node_type_is_fused)(node)) {
-    build_fused_op(pass, graph, xir_graph, node);
+    build_fused_op(pass, pool, graph, xir_graph, node);
   } else {
     // test case: /home/public/bevdet/LS_int.onnx
     // op : Split
@@ -474,7 +517,10 @@ static void build_op(IPass& pass, const onnxruntime::Graph& graph,
     auto attrs = xir::Attrs::create();
     auto input_node_args = node_get_input_node_args(node);
     auto input_ops_map = get_ops_map(
-        xir_graph, op_def, const_cast_vector_node_args(input_node_args));
+        [&pool, xir_graph](const std::string& name) {
+          return pool.get_op(xir_graph, name);
+        },
+        op_def, const_cast_vector_node_args(input_node_args));
     xir::Subgraph* subgraph = nullptr;
     auto convert_attrs_func =
         std::function<void(const onnxruntime::Graph&, const xir::OpDef&,
@@ -509,13 +555,6 @@ static void build_op(IPass& pass, const onnxruntime::Graph& graph,
         }
       }
     }
-    if (type == "const") {
-      CHECK(pass.has_const(op_name.c_str()))
-          << "cannot find constant data: " << op_name;
-      auto data = pass.get_const_data<char>(op_name.c_str());
-      attrs->set_attr<std::vector<char>>(
-          "data", std::vector<char>(data.begin(), data.end()));
-    };
     auto is_scalar =
         attrs->has_attr("is_scalar") && attrs->get_attr<int>("is_scalar");
     auto is_dynamic_size = attrs->has_attr("is_dynamic_size") &&
@@ -523,8 +562,29 @@ static void build_op(IPass& pass, const onnxruntime::Graph& graph,
     auto is_unknown_shape_and_not_xilinx_domain =
         attrs->has_attr("is_unknown_shape_and_not_xilinx_domain") &&
         attrs->get_attr<int>("is_unknown_shape_and_not_xilinx_domain");
-    auto op = xir_graph->add_op(op_name, type, std::move(attrs), input_ops_map,
-                                subgraph);
+    auto add_op = [&]() {
+      return xir_graph->add_op(op_name, type, std::move(attrs), input_ops_map,
+                               subgraph);
+    };
+    xir::Op* op = nullptr;
+    if (type == "const") {
+      CHECK(pass.has_const(op_name.c_str()))
+          << "cannot find constant data: " << op_name;
+      CHECK_EQ(node_args.size(), 1u) << "const op has one output: " << op_name;
+      auto data = pass.get_const_data<char>(op_name.c_str());
+      auto key = const_op_key(*node_args[0], domain, node,
+                              pass.node_extra_attrs(op_name.c_str()));
+      op = pool.intern(op_name, key, data, [&]() {
+        set_data_attr(attrs.get(), data);
+        return add_op();
+      });
+      LOG_IF(INFO,
+             ENV_PARAM(DEBUG_EXPORT_TO_XIR) >= 1 && op->get_name() != op_name)
+          << "const xir op: " << op_name << " shares data with "
+          << op->get_name();
+    } else {
+      op = add_op();
+    }
     if (node_args.size() > 1) {
       size_t index = 0;
       for (auto arg : node_args) {
@@ -575,7 +635,8 @@ std::unique_ptr<xir::Graph> export_to_xir(IPass& pass,
   auto xir_graph = xir::Graph::create(VAIP_ORT_API(graph_get_name)(graph));
   auto xir_graph_p = xir_graph.get();
   build_input_data(xir_graph.get(), graph);
-  build_constant(xir_graph.get(), graph);
+  auto pool = ConstPool(ENV_PARAM(XLNX_EXPORT_XIR_DEDUP_CONST) != 0);
+  build_constant(pool, xir_graph.get(), graph);
   auto graph_outputs = graph_get_outputs(graph);
   std::vector<const Node*> leaf_nodes;
   leaf_nodes.reserve(graph_outputs.size());
@@ -599,10 +660,14 @@ std::unique_ptr<xir::Graph> export_to_xir(IPass& pass,
       [](const Node* n) {
         LOG_IF(INFO, false) << "\n\tnode leave: " << node_as_string(*n);
       }, //
-      [&graph, &pass, xir_graph_p](const Node* n) {
-        build_op(pass, graph, xir_graph_p, *n);
+      [&graph, &pass, &pool, xir_graph_p](const Node* n) {
+        build_op(pass, pool, graph, xir_graph_p, *n);
       }, //
       nullptr);
+  pool.save_aliases(xir_graph_p);
+  LOG_IF(INFO, ENV_PARAM(DEBUG_EXPORT_TO_XIR) >= 1)
+      << "const xir ops sharing data: " << pool.num_aliases() << ", "
+      << pool.bytes_saved() << " bytes not copied";
   return xir_graph;
 }
 } // namespace vaip_core
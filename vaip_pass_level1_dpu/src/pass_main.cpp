@@ -83,22 +83,37 @@ static void save_xmodel(const xir::Graph& graph, const std::string& filename,
   const auto& key = pass.get_config_proto().encryption_key();
   std::string s;
   graph.serialize_to_string(&s);
+  auto name = std::filesystem::path(filename).filename().u8string();
   if (key != "") {
-    s = vaip_encryption::aes_encryption(s, key);
+    // chunks are written as they are encrypted
+    auto stream = context->open_file_for_write(name);
+    CHECK(stream != nullptr) << "cannot open " << name << " for write";
+    vaip_encryption::aes_encryption(
+        s.data(), s.size(), key, [&](const char* data, size_t size) {
+          CHECK(stream->fwrite(data, size) == size)
+              << "failed to write " << name;
+        });
+    return;
   }
-  context->write_file(std::filesystem::path(filename).filename().u8string(), s);
+  context->write_file(name, s);
 }
 static std::unique_ptr<xir::Graph> load_xmodel(const std::string& filename,
                                                const IPass& pass) {
   const auto& key = pass.get_config_proto().encryption_key();
   std::ifstream ifs(filename, std::ios::binary);
+  if (key != "") {
+    auto s = vaip_encryption::aes_decryption(
+        [&ifs](char* data, size_t size) {
+          ifs.read(data, (std::streamsize)size);
+          return (size_t)ifs.gcount();
+        },
+        key);
+    return xir::Graph::deserialize_from_string(s);
+  }
   std::vector<char> file_char_array((std::istreambuf_iterator<char>(ifs)),
                                     std::istreambuf_iterator<char>());
   ifs.close();
   std::string s(file_char_array.begin(), file_char_array.end());
-  if (key != "") {
-    s = vaip_encryption::aes_decryption(s, key);
-  }
   return xir::Graph::deserialize_from_string(s);
 }
 
@@ -169,14 +184,6 @@ struct Level1Dpu {
     }
   }
 
-  std::unique_ptr<xir::Graph> clone(xir::Graph* xir_graph) {
-    std::string buffer = "";
-    xir_graph->serialize_to_string(&buffer);
-    std::unique_ptr<xir::Graph> cloned_xir_graph =
-        xir::Graph::deserialize_from_string(buffer);
-    return cloned_xir_graph;
-  }
-
   void process_xcompile(const IPass& pass) {
     std::string subfix =
         ENV_PARAM(VAIP_COMPILE_RESERVE_CONST_DATA) == 1 ? "_fat" : "";
@@ -191,10 +198,10 @@ struct Level1Dpu {
     if (ENV_PARAM(DEBUG_SKIP_COMPILE_XMODEL)) {
       compiled_xir_graph_ = load_xmodel(compiled_xmodel_file.u8string(), pass);
     } else {
-      auto cloned_xir_graph_ = clone(xir_graph_.get());
+      // the compiler takes a serialized copy, no need to clone xir_graph_
+      // first; xir_graph_ is only read by its tensor names afterwards.
       compiled_xir_graph_ = vaip_core::compiler_xir_model(
-          std::move(cloned_xir_graph_), *pass.get_context(),
-          pass_proto.pass_dpu_param());
+          *xir_graph_, *pass.get_context(), pass_proto.pass_dpu_param());
       save_xmodel(*compiled_xir_graph_, compiled_xmodel_file.u8string(), pass);
     }
   }
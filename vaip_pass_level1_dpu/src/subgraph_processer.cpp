@@ -5,6 +5,7 @@
 
 #include "./subgraph_processer.hpp"
 #include "compile_model.hpp"
+#include "const_pool.hpp"
 #include "graph.hpp"
 #include "node_arg.hpp"
 #include "vaip/anchor_point.hpp"
@@ -378,7 +379,7 @@ bool DPUSubgraphProcessor::is_shape_compatible(
     const std::string& tensor_name_on_xir_xmodel,
     const std::string& tensor_name_on_compiled_xmodel) {
   auto tensor_on_xir_xmodel =
-      xir_xmodel_->get_tensor(tensor_name_on_xir_xmodel);
+      get_xir_tensor(xir_xmodel_, tensor_name_on_xir_xmodel);
   auto tensor_on_compiled_xmodel =
       compiled_xmodel_->get_tensor(tensor_name_on_compiled_xmodel);
   if (tensor_on_xir_xmodel == nullptr || tensor_on_compiled_xmodel == nullptr) {
@@ -54,8 +54,8 @@ struct MergeInputTranspose {
             << " " //
             ;
         remove_transpose_node(graph, transpose_node, *graph_input_node_arg);
-        VAIP_ORT_API(node_arg_set_shape_i64)
-        (*graph_input_node_arg, node_get_output_shape(*transpose_node, 0));
+        node_arg_set_shape_i64(*graph_input_node_arg,
+                               node_get_output_shape(*transpose_node, 0));
       }
     }
   }
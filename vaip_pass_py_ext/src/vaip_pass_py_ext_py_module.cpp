@@ -17,6 +17,48 @@ static std::shared_ptr<Pattern> parse_pattern(py::object pattern_def) {
   return parse_pattern0(builder, pattern_def);
 }
 
+// a read-only array over the data of a pass const without copying it.
+// `owner` is the pass, which owns the data and is kept alive as long as
+// the array is.
+template <typename T>
+static py::array const_array(gsl::span<const T> data, const py::object& owner) {
+  auto ret = py::array_t<T>({(py::ssize_t)data.size()},
+                            {(py::ssize_t)sizeof(T)}, data.data(), owner);
+  py::detail::array_proxy(ret.ptr())->flags &=
+      ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+  return ret;
+}
+
+// a copy of the data of an initializer. It is owned by the onnx graph,
+// which may free it, e.g. when the initializer is replaced, while the
+// python pass still holds the array.
+template <typename T> static py::array copy_array(gsl::span<const T> data) {
+  return py::array_t<T>((py::ssize_t)data.size(), data.data());
+}
+
+// the array is only copied if it is not a C-contiguous array of `T`.
+template <typename T>
+static void create_const_from_array(IPass* pass, const Node& node,
+                                    const py::object& obj) {
+  auto array = py::array_t<T, py::array::c_style | py::array::forcecast>(obj);
+  pass->create_const(node, gsl::span<const char>((const char*)array.data(),
+                                                 (size_t)array.nbytes()));
+}
+
+static bool is_numpy_scalar(py::handle obj) {
+  return py::isinstance(obj, py::module::import("numpy").attr("generic"));
+}
+// a Python int or a NumPy integer scalar, e.g. an element of an array from
+// NodeInput.const_data().
+static bool is_integer(py::handle obj) {
+  return py::isinstance<py::int_>(obj) ||
+         py::isinstance(obj, py::module::import("numpy").attr("integer"));
+}
+static bool is_floating(py::handle obj) {
+  return py::isinstance<py::float_>(obj) ||
+         py::isinstance(obj, py::module::import("numpy").attr("floating"));
+}
+
 static bool is_anchor_point(const py::object& anchor_point_json) {
   auto m = py::module::import("voe.anchor_point");
   auto is_anchor_point_f = m.attr("is_anchor_point");
@@ -86,20 +128,23 @@ PYBIND11_MODULE(voe_cpp2py_export, m) {
       .def("set_attr",
            [](NodeBuilder* self, const std::string& name,
               py::object attr_value) {
+             if (py::isinstance<py::array>(attr_value)) {
+               attr_value = attr_value.attr("tolist")();
+             }
              if (py::isinstance<py::list>(attr_value)) {
                std::vector<int64_t> data;
                for (auto item : attr_value) {
-                 if (!py::isinstance<py::int_>(item))
+                 if (!is_integer(item))
                    LOG(FATAL) << "TODO: Unknown: " << py::str(item)
                               << " :: " << py::str(item.get_type())
                               << " attr_name " << name;
                  else
-                   data.push_back(static_cast<int64_t>(py::cast<int>(item)));
+                   data.push_back(py::cast<int64_t>(item));
                }
                self->add(name, data);
-             } else if (py::isinstance<py::int_>(attr_value)) {
-               self->add(name, static_cast<int64_t>(py::cast<int>(attr_value)));
-             } else if (py::isinstance<py::float_>(attr_value)) {
+             } else if (is_integer(attr_value)) {
+               self->add(name, py::cast<int64_t>(attr_value));
+             } else if (is_floating(attr_value)) {
                self->add(name, static_cast<float>(py::cast<float>(attr_value)));
              } else if (py::isinstance<py::str>(attr_value)) {
                if (name == "data_type") {
@@ -221,63 +266,43 @@ PYBIND11_MODULE(voe_cpp2py_export, m) {
            })
       .def("empty", [](const NodeInput& ni) { return !ni.is_matched(); })
       .def("const_data",
-           [](const NodeInput& ni, IPass* pass,
-              GraphWrapper graph) -> py::object {
+           [](const NodeInput& ni, py::object pass_obj,
+              py::object graph_obj) -> py::object {
+             auto pass = py::cast<IPass*>(pass_obj);
+             auto& graph = py::cast<GraphWrapper&>(graph_obj).graph;
              auto ret = py::object();
              if (ni.node != nullptr) {
                auto data_type = node_get_output_element_type(*ni.node);
                if (data_type == onnx::TensorProto_DataType_FLOAT) {
-                 auto const_data = pass->get_const_data<float>(*ni.node);
-                 auto value =
-                     std::vector<float>(const_data.begin(), const_data.end());
-                 ret = py::cast(value);
+                 ret = const_array<float>(
+                     pass->get_const_data<float>(*ni.node), pass_obj);
                } else if (data_type == onnx::TensorProto_DataType_UINT16) {
-                 auto const_data = pass->get_const_data<uint16_t>(*ni.node);
-                 auto value = std::vector<uint16_t>(const_data.begin(),
-                                                    const_data.end());
-                 ret = py::cast(value);
+                 ret = const_array<uint16_t>(
+                     pass->get_const_data<uint16_t>(*ni.node), pass_obj);
                } else if (data_type == onnx::TensorProto_DataType_INT16) {
-                 auto const_data = pass->get_const_data<int16_t>(*ni.node);
-                 auto value =
-                     std::vector<int16_t>(const_data.begin(), const_data.end());
-                 ret = py::cast(value);
+                 ret = const_array<int16_t>(
+                     pass->get_const_data<int16_t>(*ni.node), pass_obj);
                } else if (data_type == onnx::TensorProto_DataType_INT64) {
-                 auto const_data = pass->get_const_data<int64_t>(*ni.node);
-                 auto value =
-                     std::vector<int64_t>(const_data.begin(), const_data.end());
-                 ret = py::cast(value);
+                 ret = const_array<int64_t>(
+                     pass->get_const_data<int64_t>(*ni.node), pass_obj);
                } else {
                  LOG(FATAL) << "not supported data_type : " << data_type;
                }
              } else {
                auto data_type = node_arg_get_element_type(*ni.node_arg);
                auto& tensor =
-                   node_arg_get_const_data_as_tensor(graph.graph, *ni.node_arg);
+                   node_arg_get_const_data_as_tensor(graph, *ni.node_arg);
                if (data_type == onnx::TensorProto_DataType_FLOAT) {
-                 auto const_data = tensor_proto_as_floats(graph.graph, tensor);
-                 auto value =
-                     std::vector<float>(const_data.begin(), const_data.end());
-                 ret = py::cast(value);
+                 ret = copy_array<float>(tensor_proto_as_floats(graph, tensor));
                } else if (data_type == onnx::TensorProto_DataType_INT8) {
-                 auto const_data = tensor_proto_as_i8s(graph.graph, tensor);
-                 auto value =
-                     std::vector<int8_t>(const_data.begin(), const_data.end());
-                 ret = py::cast(value);
+                 ret = copy_array<int8_t>(tensor_proto_as_i8s(graph, tensor));
                } else if (data_type == onnx::TensorProto_DataType_UINT8) {
-                 auto const_data = tensor_proto_as_u8s(graph.graph, tensor);
-                 auto value =
-                     std::vector<uint8_t>(const_data.begin(), const_data.end());
-                 ret = py::cast(value);
+                 ret = copy_array<uint8_t>(tensor_proto_as_u8s(graph, tensor));
                } else if (data_type == onnx::TensorProto_DataType_UINT16) {
-                 auto const_data = tensor_proto_as_u16s(graph.graph, tensor);
-                 auto value = std::vector<uint16_t>(const_data.begin(),
-                                                    const_data.end());
-                 ret = py::cast(value);
+                 ret =
+                     copy_array<uint16_t>(tensor_proto_as_u16s(graph, tensor));
                } else if (data_type == onnx::TensorProto_DataType_INT16) {
-                 auto const_data = tensor_proto_as_i16s(graph.graph, tensor);
-                 auto value =
-                     std::vector<int16_t>(const_data.begin(), const_data.end());
-                 ret = py::cast(value);
+                 ret = copy_array<int16_t>(tensor_proto_as_i16s(graph, tensor));
                } else {
                  LOG(FATAL) << "not supported data_type : " << data_type;
                }
@@ -371,7 +396,36 @@ PYBIND11_MODULE(voe_cpp2py_export, m) {
               const py::object& obj) -> void {
              auto data_type = node_get_output_element_type(self.node);
              gsl::span<char> span_data;
-             if (py::isinstance<py::list>(obj)) {
+             // a NumPy scalar, e.g. an element of NodeInput.const_data(),
+             // is taken as a 0-d array.
+             if (py::isinstance<py::array>(obj) || is_numpy_scalar(obj)) {
+               switch (data_type) {
+               case onnx::TensorProto_DataType_FLOAT:
+                 create_const_from_array<float>(pass, self.node, obj);
+                 break;
+               case onnx::TensorProto_DataType_INT32:
+                 create_const_from_array<int32_t>(pass, self.node, obj);
+                 break;
+               case onnx::TensorProto_DataType_INT8:
+                 create_const_from_array<int8_t>(pass, self.node, obj);
+                 break;
+               case onnx::TensorProto_DataType_UINT8:
+                 create_const_from_array<uint8_t>(pass, self.node, obj);
+                 break;
+               case onnx::TensorProto_DataType_UINT16:
+                 create_const_from_array<uint16_t>(pass, self.node, obj);
+                 break;
+               case onnx::TensorProto_DataType_INT16:
+                 create_const_from_array<int16_t>(pass, self.node, obj);
+                 break;
+               case onnx::TensorProto_DataType_INT64:
+                 create_const_from_array<int64_t>(pass, self.node, obj);
+                 break;
+               default:
+                 LOG(FATAL)
+                     << "create_const not supported! data_type " << data_type;
+               }
+             } else if (py::isinstance<py::list>(obj)) {
                std::vector<float> data;
                std::vector<int32_t> data_int32;
                std::vector<int8_t> data_int8;
@@ -420,9 +474,10 @@ PYBIND11_MODULE(voe_cpp2py_export, m) {
              return node_get_attr_float(n.node, attr_name);
            })
       .def("get_const_data_floats", // TODO: remove this function
-           [](const NodeWrapper& n, IPass* pass) {
-             auto const_data = pass->get_const_data<float>(n.node);
-             return std::vector<float>(const_data.begin(), const_data.end());
+           [](const NodeWrapper& n, py::object pass_obj) {
+             auto pass = py::cast<IPass*>(pass_obj);
+             return const_array<float>(pass->get_const_data<float>(n.node),
+                                       pass_obj);
            })
       .def("__str__",
            [](const NodeWrapper& n) { return node_as_string(n.node); });